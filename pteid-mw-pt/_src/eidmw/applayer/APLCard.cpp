@@ -38,6 +38,7 @@
 #include "SigContainer.h"
 #include "PDFSignature.h"
 #include "MiscUtil.h"
+#include "OcspResponseCache.h"
 #include "Log.h"
 
 #include <time.h>
@@ -342,6 +343,7 @@ APL_SmartCard::APL_SmartCard(APL_ReaderContext *reader) : APL_Card(reader) {
 	m_pins = NULL;
 	m_certs = NULL;
 	m_fileinfo = NULL;
+	m_ocspCache = NULL;
 
 	APL_Config conf_allowTest(CConfig::EIDMW_CONFIG_PARAM_CERTVALID_ALLOWTESTC);
 	m_allowTestParam = conf_allowTest.getLong() ? true : false;
@@ -356,6 +358,12 @@ APL_SmartCard::APL_SmartCard(APL_ReaderContext *reader) : APL_Card(reader) {
 }
 
 APL_SmartCard::~APL_SmartCard() {
+	// Stop the refresh thread first
+	if (m_ocspCache) {
+		delete m_ocspCache;
+		m_ocspCache = NULL;
+	}
+
 	if (m_pins) {
 		delete m_pins;
 		m_pins = NULL;
@@ -543,6 +551,43 @@ APL_Certifs *APL_SmartCard::getCertificates() {
 	return m_certs;
 }
 
+APL_OcspResponseCache *APL_SmartCard::getOcspResponseCache() {
+	APL_Config conf_maxAge(CConfig::EIDMW_CONFIG_PARAM_CERTVALID_OCSP_CACHE_MAXAGE);
+	long maxAge = conf_maxAge.getLong();
+	if (maxAge <= 0)
+		return NULL;
+
+	if (!m_ocspCache) {
+		CAutoMutex autoMutex(&m_Mutex); // We lock for only one instantiation
+		if (!m_ocspCache) {
+			APL_Config conf_refresh(CConfig::EIDMW_CONFIG_PARAM_CERTVALID_OCSP_CACHE_REFRESH);
+			m_ocspCache = new APL_OcspResponseCache(maxAge, conf_refresh.getLong());
+		}
+	}
+
+	return m_ocspCache;
+}
+
+void APL_SmartCard::prefetchOcspResponses() {
+	APL_OcspResponseCache *cache = getOcspResponseCache();
+	if (!cache)
+		return;
+
+	try {
+		// The signature certificate and its sub-CA
+		APL_Certif *cert = getCertificates()->getSignature();
+		for (int i = 0; i < 2 && cert != NULL && !cert->isRoot(); i++) {
+			APL_Certif *issuer = cert->getIssuer();
+			if (issuer == NULL)
+				break;
+			cache->track(cert->getData(), issuer->getData());
+			cert = issuer;
+		}
+	} catch (CMWException &e) {
+		MWLOG(LEV_WARN, MOD_APL, "%s: failed to load the signature certificates: %08x", __FUNCTION__, e.GetError());
+	}
+}
+
 tCert APL_SmartCard::getP15Cert(unsigned long ulIndex) {
 	if (ulIndex >= certificateCount())
 		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
@@ -184,6 +184,7 @@ class APL_Pins;
 class APL_Certif;
 class APL_Certifs;
 class APL_CardFile_Info;
+class APL_OcspResponseCache;
 /******************************************************************************/ /**
   * Abstract base class for smart card (like eid card)
   *********************************************************************************/
@@ -282,6 +283,19 @@ public:
 
 	APL_CardFile_Info *getFileInfo(); /**< Return a pointer to the pseudo file info */
 
+	/**
+	  * Return the cache of the OCSP responses of the card certificates used in LTV signatures (NOT EXPORTED)
+	  *
+	  * Returns NULL if the cache is disabled in the configuration
+	  */
+	APL_OcspResponseCache *getOcspResponseCache();
+
+	/**
+	  * Start fetching the OCSP responses of the signature certificate and its sub-CA in the background, to have
+	  * them ready when the revocation data of a LTV signature is added (NOT EXPORTED)
+	  */
+	void prefetchOcspResponses();
+
 	virtual const char *getTokenSerialNumber() = 0; /**< Return the token serial number (pkcs15 parse) (NOT EXPORTED) */
 	virtual const char *getTokenLabel() = 0;		/**< Return the token label (pkcs15 parse) (NOT EXPORTED) */
 
@@ -298,6 +312,8 @@ protected:
 
 	APL_CardFile_Info *m_fileinfo; /**< Pointer to the "pseudo file" Info */
 
+	APL_OcspResponseCache *m_ocspCache; /**< Pointer to the OCSP response cache */
+
 	bool m_allowTestParam;	/**< Allow test card (from config) */
 	bool m_allowTestAnswer; /**< User's answer to allow test card */
 	bool m_allowTestAsked;	/**< Already asked for allowing test card */
@@ -45,6 +45,8 @@
 
 #include <memory>
 #include <ctime>
+#include <chrono>
+#include <functional>
 
 namespace eIDMW {
 
@@ -391,6 +393,127 @@ const CByteArray &APL_EIDCard::getRawData_TokenInfo() { return getFileTokenInfo(
 
 const CByteArray &APL_EIDCard::getRawData_PersoData() { return getFilePersoData()->getData(); }
 
+void APL_EIDCard::loadFiles(unsigned int files, APL_CardLoadReport &report) {
+	auto start = std::chrono::steady_clock::now();
+	CReader *reader = m_reader->getCalReader();
+	tCardIOStats initialStats;
+
+	report = APL_CardLoadReport();
+	// The photo is part of the ID file on IAS07 and IAS101 cards
+	if (m_cardType != APL_CARDTYPE_PTEID_IAS5 && (files & APL_LOAD_FILE_PHOTO))
+		files |= APL_LOAD_FILE_ID;
+
+	BEGIN_CAL_OPERATION(m_reader)
+	reader->BeginLoadPlan();
+	initialStats = reader->GetIOStats();
+	END_CAL_OPERATION(m_reader)
+
+	auto load = [&](const char *path, const std::function<CByteArray()> &read) {
+		try {
+			report.files[path] = read();
+		} catch (CMWException &e) {
+			MWLOG(LEV_ERROR, MOD_APL, "loadFiles: failed to read file %s: 0x%08lx", path, e.GetError());
+			report.filesFailed++;
+		}
+	};
+
+	try {
+		// Group the reads by card application: the SOD is read first as the ID and photo files are checked against
+		// it, then the eID application files (IAS5) or the remaining files of the only application (IAS07/IAS101)
+		if (m_cardType == APL_CARDTYPE_PTEID_IAS5) {
+			if (files & (APL_LOAD_FILE_SOD | APL_LOAD_FILE_ID | APL_LOAD_FILE_PHOTO))
+				load(PTEID_FILE_SOD_V2, [this]() { return getFileSod()->getData(); });
+			if (files & APL_LOAD_FILE_ID)
+				load(PTEID_FILE_ID_V2, [this]() { return getFileID()->getData(); });
+			if (files & APL_LOAD_FILE_PHOTO)
+				load(PTEID_FILE_PHOTO, [this]() { return *getFileID()->getPhotoObj()->getPhotoRaw(); });
+		} else {
+			if (files & (APL_LOAD_FILE_SOD | APL_LOAD_FILE_ID))
+				load(PTEID_FILE_SOD, [this]() { return getFileSod()->getData(); });
+			if (files & APL_LOAD_FILE_ID)
+				load(PTEID_FILE_ID, [this]() { return getFileID()->getData(); });
+		}
+
+		if (files & APL_LOAD_FILE_TRACE) {
+			if (!m_FileTrace)
+				getFileTrace();
+			load(PTEID_FILE_TRACE, [this]() { return m_FileTrace->getData(); });
+		}
+		if (files & APL_LOAD_FILE_TOKENINFO)
+			load(PTEID_FILE_TOKENINFO, [this]() { return getFileTokenInfo()->getData(); });
+		if (files & APL_LOAD_FILE_CERTS) {
+			APL_Certifs *certs = getCertificates();
+			for (unsigned long i = 0; i < certs->countFromCard(); i++) {
+				std::string path = getP15Cert(i).csPath;
+				load(path.c_str(), [certs, i]() {
+					// The card root certificate is not loaded, the one in the certificate store is used instead
+					APL_Certif *cert = certs->getCertFromCard(i);
+					return cert ? cert->getData() : CByteArray();
+				});
+			}
+		}
+	} catch (...) {
+		BEGIN_CAL_OPERATION(m_reader)
+		reader->EndLoadPlan();
+		END_CAL_OPERATION(m_reader)
+		throw;
+	}
+
+	BEGIN_CAL_OPERATION(m_reader)
+	tCardIOStats stats = reader->GetIOStats();
+	reader->EndLoadPlan();
+
+	report.apdus = stats.ulAPDUs - initialStats.ulAPDUs;
+	report.selectsSkipped = stats.ulSelectsSkipped - initialStats.ulSelectsSkipped;
+	report.transactionsSaved = stats.ulTransactionsSaved - initialStats.ulTransactionsSaved;
+	END_CAL_OPERATION(m_reader)
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	report.elapsedMs = elapsed.count();
+
+	MWLOG(LEV_INFO, MOD_APL,
+		  "loadFiles: %lu files read, %lu failed in %.1f ms: %lu APDUs, %lu SELECTs skipped, %lu transactions saved",
+		  (unsigned long)report.files.size(), report.filesFailed, report.elapsedMs, report.apdus,
+		  report.selectsSkipped, report.transactionsSaved);
+}
+
+void APL_EIDCard::beginSignSession() {
+	BEGIN_CAL_OPERATION(m_reader)
+	CReader *reader = m_reader->getCalReader();
+	reader->BeginSignSession();
+
+	tCardIOStats stats = reader->GetIOStats();
+	m_signSessionStart.signatures = stats.ulSignatures;
+	m_signSessionStart.securityEnvsSkipped = stats.ulSecurityEnvsSkipped;
+	m_signSessionStart.pinVerifiesSkipped = stats.ulPinVerifiesSkipped;
+	m_signSessionStartTime = std::chrono::steady_clock::now();
+	END_CAL_OPERATION(m_reader)
+}
+
+void APL_EIDCard::endSignSession(APL_SignSessionReport &report) {
+	report = APL_SignSessionReport();
+
+	BEGIN_CAL_OPERATION(m_reader)
+	CReader *reader = m_reader->getCalReader();
+	tCardIOStats stats = reader->GetIOStats();
+	reader->EndSignSession();
+
+	report.signatures = stats.ulSignatures - m_signSessionStart.signatures;
+	report.securityEnvsSkipped = stats.ulSecurityEnvsSkipped - m_signSessionStart.securityEnvsSkipped;
+	report.pinVerifiesSkipped = stats.ulPinVerifiesSkipped - m_signSessionStart.pinVerifiesSkipped;
+	END_CAL_OPERATION(m_reader)
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_signSessionStartTime;
+	report.elapsedMs = elapsed.count();
+	if (report.elapsedMs > 0)
+		report.signaturesPerSecond = report.signatures * 1000.0 / report.elapsedMs;
+
+	MWLOG(LEV_INFO, MOD_APL,
+		  "Sign session: %lu signatures in %.1f ms (%.2f signatures/s): %lu MSE SETs and %lu PIN VERIFYs skipped",
+		  report.signatures, report.elapsedMs, report.signaturesPerSecond, report.securityEnvsSkipped,
+		  report.pinVerifiesSkipped);
+}
+
 const char *APL_EIDCard::getTokenSerialNumber() {
 	if (!m_tokenSerial) {
 
@@ -880,6 +1003,17 @@ const char *APL_DocEId::getMRZ3() { return m_card->getFileID()->getMRZ3(); }
 
 const char *APL_DocEId::getAccidentalIndications() { return m_card->getFileID()->getAccidentalIndications(); }
 
+void APL_DocEId::getFields(std::vector<tCardFieldView> &fields) { m_card->getFileID()->getFields(fields); }
+
+const char *APL_DocEId::exportJson() {
+	std::vector<tCardFieldView> fields;
+	getFields(fields);
+
+	m_json.clear();
+	cardFieldsToJson(fields, m_json);
+	return m_json.c_str();
+}
+
 const char *APL_DocEId::getCivilianIdNumber() { return m_card->getFileID()->getCivilianIdNumber(); }
 
 /*****************************************************************************************
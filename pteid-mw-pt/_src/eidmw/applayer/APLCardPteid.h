@@ -28,8 +28,12 @@
 #ifndef __APLCARDEID_H__
 #define __APLCARDEID_H__
 
+#include <chrono>
+#include <map>
 #include <string>
+#include <string_view>
 #include <set>
+#include <vector>
 #include "Export.h"
 #include "APLReader.h"
 #include "APLCertif.h"
@@ -64,6 +68,45 @@ class APL_PersonalNotesEId;
 
 typedef void (*t_callback_addr)(void *, int);
 
+/* Named value of a card file field. The value is valid until the card file is reloaded */
+struct tCardFieldView {
+	const char *name;
+	std::string_view value;
+};
+
+/* Append the fields to json as one flat JSON object */
+EIDMW_APL_API void cardFieldsToJson(const std::vector<tCardFieldView> &fields, std::string &json);
+
+/* Files that can be requested from APL_EIDCard::loadFiles(), same values as PTEID_CardLoadFile */
+enum APL_CardLoadFile {
+	APL_LOAD_FILE_ID = 0x01,		/**< ID file, and MRZ file of IAS5 cards */
+	APL_LOAD_FILE_PHOTO = 0x02,		/**< Photo file of IAS5 cards, it's part of the ID file on older cards */
+	APL_LOAD_FILE_SOD = 0x04,		/**< SOD file */
+	APL_LOAD_FILE_CERTS = 0x08,		/**< Every certificate file listed in the PKCS15 structure */
+	APL_LOAD_FILE_TRACE = 0x10,		/**< Trace file */
+	APL_LOAD_FILE_TOKENINFO = 0x20, /**< PKCS15 TokenInfo file */
+	APL_LOAD_FILE_ALL = 0x3F
+};
+
+/* Result of APL_EIDCard::loadFiles(). The counters only cover the card accesses done by the load plan */
+struct APL_CardLoadReport {
+	std::map<std::string, CByteArray> files; /**< Content of each file read, by card path */
+	unsigned long filesFailed = 0;			 /**< Files that couldn't be read */
+	unsigned long apdus = 0;				 /**< APDUs sent to the card */
+	unsigned long selectsSkipped = 0;		 /**< SELECT commands avoided because the file or app was selected */
+	unsigned long transactionsSaved = 0;	 /**< PC/SC transactions avoided by keeping the card locked */
+	double elapsedMs = 0;
+};
+
+/* Result of a sign session, see APL_EIDCard::beginSignSession() */
+struct APL_SignSessionReport {
+	unsigned long signatures = 0;		   /**< Signatures computed by the card */
+	unsigned long securityEnvsSkipped = 0; /**< MSE SET commands avoided because the key and algorithm were set */
+	unsigned long pinVerifiesSkipped = 0;  /**< PIN VERIFY commands avoided because the PIN was still verified */
+	double elapsedMs = 0;
+	double signaturesPerSecond = 0;
+};
+
 /******************************************************************************/ /**
   * Class that represents a PTEID card
   *
@@ -143,6 +186,33 @@ public:
 	EIDMW_APL_API const CByteArray &getRawData_PersoData(); /**< Get the persoData RawData */
 	EIDMW_APL_API void doSODCheck(bool check);
 
+	/**
+	 * Read a set of card files inside a single PC/SC transaction
+	 *
+	 * The files are read grouped by card application and each application and file is only selected once.
+	 * The files stay loaded in this object, so later calls to getID(), getSod(), getCertificates(), ... don't
+	 * access the card again.
+	 *
+	 * @param files is a combination of APL_CardLoadFile flags
+	 * @param report receives the content of the files and the card access counters
+	 */
+	EIDMW_APL_API void loadFiles(unsigned int files, APL_CardLoadReport &report);
+
+	/**
+	 * Start a sign session for high-volume signing
+	 *
+	 * Until endSignSession() the card stays locked and the signature PIN is only asked for the first signature.
+	 * The following signatures, made with any of the signing methods, reuse the PIN verification and the
+	 * security environment left in the card by the previous one.
+	 */
+	EIDMW_APL_API void beginSignSession();
+	/**
+	 * End the sign session
+	 *
+	 * @param report receives the number of signatures and card commands saved by the session
+	 */
+	EIDMW_APL_API void endSignSession(APL_SignSessionReport &report);
+
 	APL_EidFile_Trace *getFileTrace();	   /**< Return a pointer to the file Trace (NOT EXPORTED) */
 	APL_EidFile_ID *getFileID();		   /**< Return a pointer to the file ID (NOT EXPORTED) */
 	APL_EidFile_Address *getFileAddress(); /**< Return a pointer to the file Address (NOT EXPORTED) */
@@ -196,6 +266,9 @@ private:
 
 	bool m_sodCheck;
 
+	APL_SignSessionReport m_signSessionStart; /**< Card counters when the sign session started */
+	std::chrono::steady_clock::time_point m_signSessionStartTime;
+
 	friend bool APL_ReaderContext::connectCard(); /**< This method must access protected constructor */
 };
 
@@ -278,6 +351,15 @@ public:
 	EIDMW_APL_API const char *getAccidentalIndications(); /**< Return field AccidentalIndications */
 	EIDMW_APL_API const char *getValidation();			  /**< Return field Validation from the Trace file */
 
+	/**
+	 * Fill fields with all the text fields of the ID file in one pass, without copying them
+	 */
+	EIDMW_APL_API void getFields(std::vector<tCardFieldView> &fields);
+	/**
+	 * Return all the text fields of the ID file as one JSON object, valid until the next call
+	 */
+	EIDMW_APL_API const char *exportJson();
+
 protected:
 	/**
 	 * Constructor
@@ -295,6 +377,7 @@ private:
 	// std::string m_FirstName;						/**< Field FirstName1 follow by FirstName2 */
 	APL_XmlUserRequestedInfo *_xmlUInfo;
 	APL_CryptoFwk *m_cryptoFwk;
+	std::string m_json; /**< Last result of exportJson() */
 
 	friend APL_DocEId &APL_EIDCard::getID();				 /**< This method must access protected constructor */
 	friend CByteArray APL_CCXML_Doc::getXML(bool bNoHeader); /* this method accesses getxml(,) */
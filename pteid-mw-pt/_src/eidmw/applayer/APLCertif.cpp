@@ -42,6 +42,7 @@
 #include "Util.h"
 #include "MWException.h"
 #include "CertStatusCache.h"
+#include "OcspResponseCache.h"
 #include "MiscUtil.h"
 #include "PKIFetcher.h"
 #include "CardPteidDef.h"
@@ -155,7 +156,8 @@ void APL_Certifs::addToSODCAs(const CByteArray &cert_ba) {
 		defaultSODCertifs = false;
 	}
 
-	APL_Certif *cert = new APL_Certif(this, cert_ba, APL_CERTIF_TYPE_ROOT);
+	tSharedCert sharedCert = APL_SharedCertStore::instance().getCertificate(cert_ba);
+	APL_Certif *cert = new APL_Certif(this, sharedCert, APL_CERTIF_TYPE_ROOT);
 	MWLOG(LEV_DEBUG, MOD_APL, "addToSODCAs(): Adding certificate %s", cert->getOwnerName());
 	m_sod_cas.push_back(cert);
 }
@@ -255,6 +257,7 @@ APL_Certif *APL_Certifs::getCertFromCard(unsigned long ulIndex) {
 			delete foundCert;
 			m_certifs[ulUniqueId] = cert;
 		}
+		m_issuerIndexValid = false;
 
 		return cert;
 	}
@@ -264,10 +267,12 @@ APL_Certif *APL_Certifs::getCertFromCard(unsigned long ulIndex) {
    one in m_certifs instead, we need this so that initSODCAs() picks up all the certificates in eidstore
  */
 APL_Certif *APL_Certifs::addCert(const CByteArray &certIn, APL_CertifType type, bool needToSetIssuer) {
+	return addCert(APL_SharedCertStore::instance().getCertificate(certIn), type, needToSetIssuer);
+}
 
-	std::map<unsigned long, APL_Certif *>::const_iterator itr;
+APL_Certif *APL_Certifs::addCert(const tSharedCert &certIn, APL_CertifType type, bool needToSetIssuer) {
 
-	unsigned long ulUniqueId = m_cryptoFwk->GetCertUniqueID(certIn);
+	unsigned long ulUniqueId = certIn->getUniqueId();
 
 	{
 		CAutoMutex autoMutex(&m_Mutex); // We lock for unly one instanciation
@@ -278,11 +283,12 @@ APL_Certif *APL_Certifs::addCert(const CByteArray &certIn, APL_CertifType type,
 			(certsIt->second->isFromCard())) { // return existing cert if this cert is already loaded from card
 			return certsIt->second;
 		}
-		if (m_cryptoFwk->isSelfIssuer(certIn)) {
+		if (m_cryptoFwk->isSelfIssuer(certIn->getX509())) {
 			type = APL_CERTIF_TYPE_ROOT;
 		}
 		cert = new APL_Certif(this, certIn, type);
 		m_certifs[ulUniqueId] = cert;
+		m_issuerIndexValid = false;
 
 		std::vector<unsigned long>::iterator itrOrder;
 		// Check for duplicate
@@ -313,8 +319,7 @@ APL_Certif *APL_Certifs::addCert(APL_CardFile_Certificate *file, APL_CertifType
 
 		ulUniqueId = file->getUniqueId();
 	} else {
-		APL_CardFile_Certificate filetmp(m_card, "", cert_data);
-		ulUniqueId = filetmp.getUniqueId();
+		ulUniqueId = APL_SharedCertStore::instance().getCertificate(*cert_data)->getUniqueId();
 	}
 
 	{
@@ -342,6 +347,7 @@ APL_Certif *APL_Certifs::addCert(APL_CardFile_Certificate *file, APL_CertifType
 		APL_Certif *cert = NULL;
 		cert = new APL_Certif(this, file, type, bOnCard, ulIndex, cert_data);
 		m_certifs[ulUniqueId] = cert;
+		m_issuerIndexValid = false;
 		m_certifsOrder.push_back(ulUniqueId);
 
 		resetFlags();
@@ -528,13 +534,18 @@ void APL_Certifs::loadCard() {
 	resetFlags();
 }
 
+/* The directory contents are shared by every APL_Certifs instance: the files are only read from disk
+   the first time and after the directory changes */
 void APL_Certifs::loadFromFile() {
-	bool bStopRequest = false;
-	scanDir(m_certs_dir.c_str(), "", m_certExtension.c_str(), bStopRequest, this, &APL_Certifs::foundCertificate);
+	APL_SharedCertStore &sharedStore = APL_SharedCertStore::instance();
+
+	for (const tSharedCert &cert : sharedStore.getDirectoryCertificates(m_certs_dir, "", m_certExtension.c_str()))
+		addCert(cert, APL_CERTIF_TYPE_UNKNOWN, false);
 #ifndef WIN32
-	bStopRequest = false;
 	APL_Config cachePath(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PTEID_CACHEDIR_CERTS);
-	scanDir(cachePath.getString(), "/", m_certExtension.c_str(), bStopRequest, this, &APL_Certifs::foundCertificate);
+	for (const tSharedCert &cert :
+		 sharedStore.getDirectoryCertificates(cachePath.getString(), "/", m_certExtension.c_str()))
+		addCert(cert, APL_CERTIF_TYPE_UNKNOWN, false);
 #endif
 }
 
@@ -592,74 +603,77 @@ void APL_Certifs::reOrderCerts() {
 	m_certifsOrder.insert(m_certifsOrder.end(), cardRoots.begin(), cardRoots.end());
 }
 
-void APL_Certifs::foundCertificate(const char *dir, const char *SubDir, const char *File, void *param) {
-	APL_Certifs *certifs = static_cast<APL_Certifs *>(param);
-	std::string path = dir;
-	FILE *m_stream;
-	long int bufsize;
-	unsigned char *buf;
-	CByteArray *cert;
-
-#ifdef WIN32
-	errno_t werr;
-	path += "\\"; // Quick Fix for a messy situation with the certificates subdir
-#endif
-	path += SubDir;
-#ifdef WIN32
-	path += (strlen(SubDir) != 0 ? "\\" : "");
-#else
-	path += (strlen(SubDir) != 0 ? "/" : "");
-#endif
-	path += File;
-
-#ifdef WIN32
-	if ((werr = fopen_s(&m_stream, path.c_str(), "rb")) != 0)
-		goto err;
-#else
-	if ((m_stream = fopen(path.c_str(), "rb")) == NULL)
-		goto err;
-#endif
+void APL_Certifs::buildIssuerIndex() {
+	if (m_issuerIndexValid)
+		return;
 
-	if (fseek(m_stream, 0L, SEEK_END))
-		goto err;
+	m_issuerIndex.clear();
+	m_subjectHashIndex.clear();
+	m_skiIndex.clear();
+
+	APL_SharedCertStore &sharedStore = APL_SharedCertStore::instance();
+	for (auto &entry : m_certifs) {
+		tSharedCert shared;
+		try {
+			shared = sharedStore.getCertificate(entry.second->getData());
+		} catch (CMWException &e) {
+			MWLOG(LEV_WARN, MOD_APL, "%s: skipping certificate with error 0x%x", __FUNCTION__, e.GetError());
+			continue;
+		}
+		X509 *pX509 = shared->getX509();
+		if (pX509 == NULL)
+			continue;
 
-	bufsize = ftell(m_stream);
-	buf = (unsigned char *)malloc(bufsize * sizeof(unsigned char));
+		size_t idx = m_issuerIndex.size();
+		m_issuerIndex.push_back({entry.second, shared});
+		m_subjectHashIndex.emplace(X509_subject_name_hash(pX509), idx);
 
-	if (fseek(m_stream, 0L, SEEK_SET)) {
-		free(buf);
-		goto err;
+		const ASN1_OCTET_STRING *ski = X509_get0_subject_key_id(pX509);
+		if (ski)
+			m_skiIndex.emplace(std::string((const char *)ASN1_STRING_get0_data(ski), ASN1_STRING_length(ski)), idx);
 	}
 
-	if (fread(buf, sizeof(unsigned char), bufsize, m_stream) != bufsize) {
-		free(buf);
-		goto err;
-	}
+	m_issuerIndexValid = true;
+}
 
-	cert = new CByteArray(buf, bufsize);
-	certifs->addCert(*cert, APL_CERTIF_TYPE_UNKNOWN);
-	delete cert;
+void APL_Certifs::getIssuerCandidates(X509_NAME *issuerName, const ASN1_OCTET_STRING *akid,
+									  std::vector<std::pair<APL_Certif *, X509 *>> &candidates) {
+	buildIssuerIndex();
 
-	free(buf);
-	fclose(m_stream);
-	return;
+	std::vector<size_t> found;
+	if (akid) {
+		auto range = m_skiIndex.equal_range(
+			std::string((const char *)ASN1_STRING_get0_data(akid), ASN1_STRING_length(akid)));
+		for (auto it = range.first; it != range.second; ++it)
+			found.push_back(it->second);
+	}
 
-err:
-	if (m_stream)
-		fclose(m_stream);
+	// Certificates without SKI, or issued under a different key identifier, are still found by name
+	auto range = m_subjectHashIndex.equal_range(X509_NAME_hash(issuerName));
+	for (auto it = range.first; it != range.second; ++it) {
+		if (std::find(found.begin(), found.end(), it->second) == found.end())
+			found.push_back(it->second);
+	}
 
-	MWLOG(LEV_DEBUG, MOD_APL, L"APL_Certifs::foundCertificate: problem with file %ls ",
-		  utilStringWiden(std::string(path)).c_str());
+	for (size_t idx : found)
+		candidates.push_back(std::make_pair(m_issuerIndex[idx].cert, m_issuerIndex[idx].shared->getX509()));
 }
 
 APL_Certif *APL_Certifs::findIssuer(const APL_Certif *cert) {
-	APL_Certif *issuer = NULL;
+	tSharedCert sharedCert = APL_SharedCertStore::instance().getCertificate(cert->getData());
+	X509 *pX509 = sharedCert->getX509();
+	if (pX509 == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+
 	// First we look in the already loaded
-	std::map<unsigned long, APL_Certif *>::const_iterator itr;
-	for (itr = m_certifs.begin(); itr != m_certifs.end(); itr++) {
-		issuer = itr->second;
-		if (m_cryptoFwk->isIssuer(cert->getData(), issuer->getData())) {
-			return issuer;
+	{
+		CAutoMutex autoMutex(&m_Mutex);
+
+		std::vector<std::pair<APL_Certif *, X509 *>> candidates;
+		getIssuerCandidates(X509_get_issuer_name(pX509), X509_get0_authority_key_id(pX509), candidates);
+		for (auto &candidate : candidates) {
+			if (m_cryptoFwk->isIssuer(pX509, candidate.second))
+				return candidate.first;
 		}
 	}
 
@@ -674,14 +688,32 @@ APL_Certif *APL_Certifs::findIssuer(const APL_Certif *cert) {
 APL_Certif *APL_Certifs::findCrlIssuer(const CByteArray &crldata) {
 	APL_Certif *issuer = NULL;
 
+	X509_CRL *pX509_Crl = m_cryptoFwk->getX509CRL(crldata);
+	if (pX509_Crl == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+
 	// First we look in the already loaded
-	std::map<unsigned long, APL_Certif *>::const_iterator itr;
-	for (itr = m_certifs.begin(); itr != m_certifs.end(); itr++) {
-		issuer = itr->second;
-		if (m_cryptoFwk->isCrlIssuer(crldata, issuer->getData()))
-			return issuer;
+	{
+		CAutoMutex autoMutex(&m_Mutex);
+
+		AUTHORITY_KEYID *akid =
+			(AUTHORITY_KEYID *)X509_CRL_get_ext_d2i(pX509_Crl, NID_authority_key_identifier, NULL, NULL);
+
+		std::vector<std::pair<APL_Certif *, X509 *>> candidates;
+		getIssuerCandidates(X509_CRL_get_issuer(pX509_Crl), akid ? akid->keyid : NULL, candidates);
+		AUTHORITY_KEYID_free(akid);
+
+		for (auto &candidate : candidates) {
+			if (m_cryptoFwk->isCrlIssuer(pX509_Crl, candidate.second)) {
+				issuer = candidate.first;
+				break;
+			}
+		}
 	}
 
+	if (issuer)
+		return issuer;
+
 	// TODO
 
 	// If still not found we can go and see in windows certificate store
@@ -844,11 +876,11 @@ APL_Certif::APL_Certif(APL_Certifs *store, APL_CardFile_Certificate *file, APL_C
 	m_store = store;
 	if (file) {
 		m_certFile = file;
-		m_delCertFile = false;
 	} else {
-		m_certFile = new APL_CardFile_Certificate(store->getCard(), "", cert);
-		m_delCertFile = true;
+		m_certFile = NULL;
+		m_sharedCert = APL_SharedCertStore::instance().getCertificate(*cert);
 	}
+	m_delCertFile = false;
 
 	m_initInfo = false;
 
@@ -867,7 +899,7 @@ APL_Certif::APL_Certif(APL_Certifs *store, APL_CardFile_Certificate *file, APL_C
 	m_info = NULL;
 }
 
-APL_Certif::APL_Certif(APL_Certifs *store, const CByteArray &cert, APL_CertifType type) {
+APL_Certif::APL_Certif(APL_Certifs *store, const tSharedCert &cert, APL_CertifType type) {
 	m_cryptoFwk = AppLayer.getCryptoFwk();
 	m_statusCache = AppLayer.getCertStatusCache();
 
@@ -876,8 +908,9 @@ APL_Certif::APL_Certif(APL_Certifs *store, const CByteArray &cert, APL_CertifTyp
 	m_type = type;
 
 	m_store = store;
-	m_certFile = new APL_CardFile_Certificate(store->getCard(), "", &cert);
-	m_delCertFile = true;
+	m_certFile = NULL;
+	m_delCertFile = false;
+	m_sharedCert = cert;
 
 	m_initInfo = false;
 
@@ -934,12 +967,14 @@ const char *APL_Certif::getLabel() {
 
 unsigned long APL_Certif::getID() const { return m_certP15.ulID; }
 
-unsigned long APL_Certif::getUniqueId() const { return m_certFile->getUniqueId(); }
+unsigned long APL_Certif::getUniqueId() const {
+	return m_sharedCert ? m_sharedCert->getUniqueId() : m_certFile->getUniqueId();
+}
 
-const CByteArray &APL_Certif::getData() const { return m_certFile->getData(); }
+const CByteArray &APL_Certif::getData() const { return m_sharedCert ? m_sharedCert->getData() : m_certFile->getData(); }
 
 void APL_Certif::getFormattedData(CByteArray &data) const {
-	const CByteArray &raw_cert_data = m_certFile->getData();
+	const CByteArray &raw_cert_data = getData();
 	long cert_len = der_certificate_length(raw_cert_data);
 	data = CByteArray(raw_cert_data.GetBytes(), cert_len);
 }
@@ -1005,7 +1040,9 @@ bool APL_Certif::isFromPteidValidChain() {
 		return false;
 }
 
-tCardFileStatus APL_Certif::getFileStatus() { return m_certFile->getStatus(false); }
+tCardFileStatus APL_Certif::getFileStatus() {
+	return m_sharedCert ? CARDFILESTATUS_OK : m_certFile->getStatus(false);
+}
 
 APL_CertifStatus APL_Certif::getStatus(bool useCache, bool validateChain) {
 	APL_ValidationLevel crl = APL_VALIDATION_LEVEL_NONE;
@@ -1115,6 +1152,20 @@ CByteArray APL_Certif::getOCSPResponse() {
 	if (issuer == NULL)
 		return response;
 
+	// The certificates of the card are kept fresh in its cache for LTV signatures. The cache fetches them without
+	// verification, so a cached response is only used once it's verified here like a new one
+	APL_SmartCard *card = m_onCard && m_store ? m_store->getCard() : NULL;
+	APL_OcspResponseCache *cache = card ? card->getOcspResponseCache() : NULL;
+	if (cache) {
+		cache->track(getData(), issuer->getData());
+		if (cache->getResponse(getData(), response)) {
+			if (m_cryptoFwk->VerifyOCSPResponse(getData(), issuer->getData(), response) == FWK_CERTIF_STATUS_VALID)
+				return response;
+			MWLOG(LEV_WARN, MOD_APL, "APL_Certif::getOCSPResponse: cached response doesn't verify, fetching it again");
+			response.ClearContents();
+		}
+	}
+
 	if (m_cryptoFwk->GetOCSPResponse(getData(), issuer->getData(), &response))
 		return response;
 
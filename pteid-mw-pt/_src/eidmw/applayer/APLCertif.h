@@ -29,6 +29,7 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "Export.h"
@@ -38,6 +39,7 @@
 #include "APLCardFile.h"
 #include "APLCrypto.h"
 #include "cryptoFramework.h"
+#include "SharedCertStore.h"
 #include <limits.h>
 
 namespace eIDMW {
@@ -244,14 +246,14 @@ public:
 	EIDMW_APL_API APL_Certif *getChildren(const APL_Certif *cert, unsigned long ulIndex);
 
 	/**
-	 * Loop through m_certifs to find the issuer of the certificate
+	 * Look up the issuer of the certificate by authority key identifier and issuer name
 	 *
 	 * If no issuer is found, NULL is return
 	 */
 	EIDMW_APL_API APL_Certif *findIssuer(const APL_Certif *cert);
 
 	/**
-	 * Loop through m_certifs to find the issuer of the crl
+	 * Look up the issuer of the crl by authority key identifier and issuer name
 	 *
 	 * If no issuer is found, NULL is return
 	 */
@@ -267,6 +269,13 @@ public:
 	APL_Certif *addCert(APL_CardFile_Certificate *file, APL_CertifType type, bool bOnCard,
 						unsigned long ulIndex, const CByteArray *cert);
 
+	/**
+	 * Add a certificate that is already in the process-wide APL_SharedCertStore
+	 *
+	 * No need to export
+	 */
+	APL_Certif *addCert(const tSharedCert &cert, APL_CertifType type, bool needToSetIssuer);
+
 	/**
 	 * Return the card from where the store comes (could be NULL)
 	 *
@@ -295,14 +304,18 @@ private:
 	void resetRoots();	 /**< Reset root flag in the certificates from the store */
 
 	APL_Certif *downloadCAIssuerCertificate(const APL_Certif *cert);
+
 	/**
-	 * This is a callback function for the scanDir
-	 *
-	 * @param SubDir is the sub directory relative the the Dir of scanDir
-	 * @param File is the file to threat
-	 * @param param must be this pointer
+	 * Rebuild the issuer index from m_certifs if it was invalidated since the last lookup
 	 */
-	static void foundCertificate(const char *dir, const char *SubDir, const char *File, void *param);
+	void buildIssuerIndex();
+
+	/**
+	 * Return the indexed certificates that may have issued something with this issuer name and
+	 * authority key identifier (akid may be NULL). Candidates with a matching key identifier come first.
+	 */
+	void getIssuerCandidates(X509_NAME *issuerName, const ASN1_OCTET_STRING *akid,
+							 std::vector<std::pair<APL_Certif *, X509 *>> &candidates);
 
 	APL_SmartCard *m_card;		/**< The smart card from which some certificates come */
 	APL_CryptoFwk *m_cryptoFwk; /**< Pointer to the crypto framework */
@@ -320,6 +333,19 @@ private:
 	std::vector<unsigned long> m_certifsOrder;
 	std::vector<APL_Certif *> my_certifs;
 
+	/**
+	 * Issuer index: every valid certificate of m_certifs, with its decoded X509 kept alive,
+	 * looked up by subject name hash and by subject key identifier
+	 */
+	struct tIssuerIndexEntry {
+		APL_Certif *cert;
+		tSharedCert shared;
+	};
+	std::vector<tIssuerIndexEntry> m_issuerIndex;
+	std::unordered_multimap<unsigned long, size_t> m_subjectHashIndex;
+	std::unordered_multimap<std::string, size_t> m_skiIndex;
+	bool m_issuerIndexValid = false; /**< Must be reset whenever m_certifs changes */
+
 	std::string m_certExtension;
 	std::string m_certs_dir;
 	int cert_dl_count = 0;
@@ -539,9 +565,9 @@ protected:
 	 * Constructor
 	 *
 	 * @param store is the store in which the APL_Certif object is hold
-	 * @param cert is the certificate
+	 * @param cert is the certificate, shared with every other user of the same DER
 	 */
-	APL_Certif(APL_Certifs *store, const CByteArray &cert, APL_CertifType type);
+	APL_Certif(APL_Certifs *store, const tSharedCert &cert, APL_CertifType type);
 
 private:
 	APL_Certif(const APL_Certif &certif);			 /**< Copy not allowed - not implemented */
@@ -560,6 +586,7 @@ private:
 	bool m_certP15Ok;					  /**< P15 structure load at construct time */
 	APL_CardFile_Certificate *m_certFile; /**< The certificate file */
 	bool m_delCertFile;					  /**< Mean that m_certFile must be deleted in destructor */
+	tSharedCert m_sharedCert;			  /**< Certificate not read from the card, used instead of m_certFile */
 
 	APL_CryptoFwk *m_cryptoFwk;			/**< Pointer to the crypto framework */
 	APL_CertStatusCache *m_statusCache; /**< Pointer to the status cache */
@@ -589,7 +616,7 @@ private:
 	APL_Certifs::addCert(APL_CardFile_Certificate *file, APL_CertifType type, bool bOnCard,
 						 unsigned long ulIndex,
 						 const CByteArray *cert); /**< This method must access protected constructor */
-	friend APL_Certif *APL_Certifs::addCert(const CByteArray &cert, APL_CertifType type, bool needToSetIssuer); /**< This method must access protected constructor */
+	friend APL_Certif *APL_Certifs::addCert(const tSharedCert &cert, APL_CertifType type, bool needToSetIssuer); /**< This method must access protected constructor */
 	friend void APL_Certifs::addToSODCAs(const CByteArray &cert);
 };
 
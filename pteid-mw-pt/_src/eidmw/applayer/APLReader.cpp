@@ -47,6 +47,7 @@
 #include "MWException.h"
 #include "cryptoFwkPteid.h"
 #include "CertStatusCache.h"
+#include "OcspResponseCache.h"
 
 #include "../_Builds/pteidversions.h"
 
@@ -392,14 +393,18 @@ void CAppLayer::stopAllServices() {
 	// Stopping is made in the opposite order then starting
 	MWLOG(LEV_INFO, MOD_APL, L"Stop all applayer services");
 
+	// Except for the readers: the OCSP refresh threads of their cards use the crypto framework
+	releaseReaders();
+	APL_OcspResponseCache::waitDetachedThreads();
+
+	delete m_certStatusCache;
+	m_certStatusCache = NULL;
+
 	if (m_cryptoFwk) {
 		delete m_cryptoFwk;
 		m_cryptoFwk = NULL;
 	}
 
-	delete m_certStatusCache;
-	releaseReaders();
-
 	if (m_Cal) {
 		// m_Cal->ForceRelease();  //No need => cause trouble
 		delete m_Cal;
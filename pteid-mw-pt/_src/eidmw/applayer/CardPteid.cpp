@@ -51,6 +51,65 @@
 #include <climits>
 
 namespace eIDMW {
+
+std::string_view cardFieldView(const CByteArray &data, unsigned long pos, unsigned long len) {
+	// Same bounds as CByteArray::GetBytes()
+	if (pos >= data.Size())
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_RANGE);
+	if (pos + len > data.Size())
+		len = data.Size() - pos;
+
+	const char *field = (const char *)data.GetBytes() + pos;
+	while (len > 0 && field[len - 1] == '\0')
+		len--;
+
+	return std::string_view(field, len);
+}
+
+template <class T, size_t N>
+static void mapCardFields(T *file, const CByteArray &data, const tCardFieldLayout<T> (&layout)[N]) {
+	for (const tCardFieldLayout<T> &field : layout) {
+		std::string_view value = cardFieldView(data, field.pos, field.len);
+		(file->*field.member).assign(value.data(), value.size());
+	}
+}
+
+template <class T, size_t N>
+static void getCardFields(T *file, const tCardFieldLayout<T> (&layout)[N], std::vector<tCardFieldView> &fields) {
+	for (const tCardFieldLayout<T> &field : layout)
+		fields.push_back({field.name, file->*field.member});
+}
+
+void cardFieldsToJson(const std::vector<tCardFieldView> &fields, std::string &json) {
+	size_t size = 2;
+	for (const tCardFieldView &field : fields)
+		size += strlen(field.name) + field.value.size() + 6;
+	json.reserve(json.size() + size);
+
+	json += '{';
+	for (size_t i = 0; i < fields.size(); i++) {
+		if (i > 0)
+			json += ',';
+		json += '"';
+		json += fields[i].name;
+		json += "\":\"";
+		for (char c : fields[i].value) {
+			if (c == '"' || c == '\\') {
+				json += '\\';
+				json += c;
+			} else if ((unsigned char)c < 0x20) {
+				char escaped[7];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				json += escaped;
+			} else {
+				json += c;
+			}
+		}
+		json += '"';
+	}
+	json += '}';
+}
+
 /*****************************************************************************************
 ---------------------------------------- APL_EidFile_TRACE -----------------------------------------
 *****************************************************************************************/
@@ -236,6 +295,53 @@ tCardFileStatus APL_EidFile_MRZ::VerifyFile() {
 /*****************************************************************************************
 ---------------------------------------- APL_EidFile_ID -----------------------------------------
 *****************************************************************************************/
+const tCardFieldLayout<APL_EidFile_ID> APL_EidFile_ID::m_FieldLayout[] = {
+	{"documentVersion", PTEIDNG_FIELD_ID_POS_DocumentVersion, PTEIDNG_FIELD_ID_LEN_DocumentVersion,
+	 &APL_EidFile_ID::m_DocumentVersion},
+	{"documentPAN", PTEIDNG_FIELD_ID_POS_DocumentNumberPAN, PTEIDNG_FIELD_ID_LEN_DocumentNumberPAN,
+	 &APL_EidFile_ID::m_ChipNumber},
+	{"country", PTEIDNG_FIELD_ID_POS_Country, PTEIDNG_FIELD_ID_LEN_Country, &APL_EidFile_ID::m_Country},
+	{"validityBeginDate", PTEIDNG_FIELD_ID_POS_ValidityBeginDate, PTEIDNG_FIELD_ID_LEN_ValidityBeginDate,
+	 &APL_EidFile_ID::m_ValidityBeginDate},
+	{"validityEndDate", PTEIDNG_FIELD_ID_POS_ValidityEndDate, PTEIDNG_FIELD_ID_LEN_ValidityEndDate,
+	 &APL_EidFile_ID::m_ValidityEndDate},
+	{"localOfRequest", PTEIDNG_FIELD_ID_POS_LocalofRequest, PTEIDNG_FIELD_ID_LEN_LocalofRequest,
+	 &APL_EidFile_ID::m_LocalofRequest},
+	{"civilianIdNumber", PTEIDNG_FIELD_ID_POS_CivilianIdNumber, PTEIDNG_FIELD_ID_LEN_CivilianIdNumber,
+	 &APL_EidFile_ID::m_CivilianIdNumber},
+	{"surname", PTEIDNG_FIELD_ID_POS_Surname, PTEIDNG_FIELD_ID_LEN_Surname, &APL_EidFile_ID::m_Surname},
+	{"givenName", PTEIDNG_FIELD_ID_POS_Name, PTEIDNG_FIELD_ID_LEN_Name, &APL_EidFile_ID::m_GivenName},
+	{"nationality", PTEIDNG_FIELD_ID_POS_Nacionality, PTEIDNG_FIELD_ID_LEN_Nacionality,
+	 &APL_EidFile_ID::m_Nationality},
+	{"dateOfBirth", PTEIDNG_FIELD_ID_POS_DateOfBirth, PTEIDNG_FIELD_ID_LEN_DateOfBirth,
+	 &APL_EidFile_ID::m_DateOfBirth},
+	{"gender", PTEIDNG_FIELD_ID_POS_Gender, PTEIDNG_FIELD_ID_LEN_Gender, &APL_EidFile_ID::m_Gender},
+	{"documentType", PTEIDNG_FIELD_ID_POS_DocumentType, PTEIDNG_FIELD_ID_LEN_DocumentType,
+	 &APL_EidFile_ID::m_DocumentType},
+	{"height", PTEIDNG_FIELD_ID_POS_Height, PTEIDNG_FIELD_ID_LEN_Height, &APL_EidFile_ID::m_Height},
+	{"documentNumber", PTEIDNG_FIELD_ID_POS_DocumentNumber, PTEIDNG_FIELD_ID_LEN_DocumentNumber,
+	 &APL_EidFile_ID::m_DocumentNumber},
+	{"taxNo", PTEIDNG_FIELD_ID_POS_TaxNo, PTEIDNG_FIELD_ID_LEN_TaxNo, &APL_EidFile_ID::m_TaxNo},
+	{"socialSecurityNumber", PTEIDNG_FIELD_ID_POS_SocialSecurityNo, PTEIDNG_FIELD_ID_LEN_SocialSecurityNo,
+	 &APL_EidFile_ID::m_SocialSecurityNo},
+	{"healthNumber", PTEIDNG_FIELD_ID_POS_HealthNo, PTEIDNG_FIELD_ID_LEN_HealthNo, &APL_EidFile_ID::m_HealthNo},
+	{"issuingEntity", PTEIDNG_FIELD_ID_POS_IssuingEntity, PTEIDNG_FIELD_ID_LEN_IssuingEntity,
+	 &APL_EidFile_ID::m_IssuingEntity},
+	{"givenNameFather", PTEIDNG_FIELD_ID_POS_GivenNameFather, PTEIDNG_FIELD_ID_LEN_GivenNameFather,
+	 &APL_EidFile_ID::m_GivenNameFather},
+	{"surnameFather", PTEIDNG_FIELD_ID_POS_SurnameFather, PTEIDNG_FIELD_ID_LEN_SurnameFather,
+	 &APL_EidFile_ID::m_SurnameFather},
+	{"givenNameMother", PTEIDNG_FIELD_ID_POS_GivenNameMother, PTEIDNG_FIELD_ID_LEN_GivenNameMother,
+	 &APL_EidFile_ID::m_GivenNameMother},
+	{"surnameMother", PTEIDNG_FIELD_ID_POS_SurnameMother, PTEIDNG_FIELD_ID_LEN_SurnameMother,
+	 &APL_EidFile_ID::m_SurnameMother},
+	{"accidentalIndications", PTEIDNG_FIELD_ID_POS_AccidentalIndications, PTEIDNG_FIELD_ID_LEN_AccidentalIndications,
+	 &APL_EidFile_ID::m_AccidentalIndications},
+	{"mrz1", PTEIDNG_FIELD_ID_POS_Mrz1, PTEIDNG_FIELD_ID_LEN_Mrz1, &APL_EidFile_ID::m_MRZ1},
+	{"mrz2", PTEIDNG_FIELD_ID_POS_Mrz2, PTEIDNG_FIELD_ID_LEN_Mrz2, &APL_EidFile_ID::m_MRZ2},
+	{"mrz3", PTEIDNG_FIELD_ID_POS_Mrz3, PTEIDNG_FIELD_ID_LEN_Mrz3, &APL_EidFile_ID::m_MRZ3},
+};
+
 APL_EidFile_ID::APL_EidFile_ID(APL_EIDCard *card) : APL_CardFile(card, PTEID_FILE_ID, NULL) { m_photo = NULL; }
 
 APL_EidFile_ID::APL_EidFile_ID(APL_EIDCard *card, const char *csPath) : APL_CardFile(card, csPath, NULL) {
@@ -363,126 +469,11 @@ void APL_EidFile_ID::EmptyFields() {
 }
 
 void APL_EidFile_ID::MapFieldsInternal() {
-	CByteArray pteidngidBuffer;
-
 	// we dont want to read the fields every time
 	if (m_mappedFields)
 		return;
 
-	// IDVersion - Card Version
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_DocumentVersion, PTEIDNG_FIELD_ID_LEN_DocumentVersion);
-	pteidngidBuffer.TrimRight('\0');
-	m_DocumentVersion.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// ChipNr
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_DocumentNumberPAN, PTEIDNG_FIELD_ID_LEN_DocumentNumberPAN);
-	pteidngidBuffer.TrimRight('\0');
-	m_ChipNumber.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// Country
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Country, PTEIDNG_FIELD_ID_LEN_Country);
-	pteidngidBuffer.TrimRight('\0');
-	m_Country.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// ValidityBeginDate
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_ValidityBeginDate, PTEIDNG_FIELD_ID_LEN_ValidityBeginDate);
-	pteidngidBuffer.TrimRight('\0');
-	m_ValidityBeginDate.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// ValidityEndDate
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_ValidityEndDate, PTEIDNG_FIELD_ID_LEN_ValidityEndDate);
-	pteidngidBuffer.TrimRight('\0');
-	m_ValidityEndDate.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// IssuingMunicipality
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_LocalofRequest, PTEIDNG_FIELD_ID_LEN_LocalofRequest);
-	pteidngidBuffer.TrimRight('\0');
-	m_LocalofRequest.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// Civilian Identification Number (NIC)
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_CivilianIdNumber, PTEIDNG_FIELD_ID_LEN_CivilianIdNumber);
-	pteidngidBuffer.TrimRight('\0');
-	m_CivilianIdNumber.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// Surname
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Surname, PTEIDNG_FIELD_ID_LEN_Surname);
-	pteidngidBuffer.TrimRight('\0');
-	m_Surname.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// FirstName_1
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Name, PTEIDNG_FIELD_ID_LEN_Name);
-	pteidngidBuffer.TrimRight('\0');
-	m_GivenName.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// Nationality
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Nacionality, PTEIDNG_FIELD_ID_LEN_Nacionality);
-	pteidngidBuffer.TrimRight('\0');
-	m_Nationality.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// DateOfBirth
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_DateOfBirth, PTEIDNG_FIELD_ID_LEN_DateOfBirth);
-	pteidngidBuffer.TrimRight('\0');
-	m_DateOfBirth.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// Gender
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Gender, PTEIDNG_FIELD_ID_LEN_Gender);
-	pteidngidBuffer.TrimRight('\0');
-	m_Gender.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// DocumentType
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_DocumentType, PTEIDNG_FIELD_ID_LEN_DocumentType);
-	pteidngidBuffer.TrimRight('\0');
-	m_DocumentType.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// Height
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Height, PTEIDNG_FIELD_ID_LEN_Height);
-	pteidngidBuffer.TrimRight('\0');
-	m_Height.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// DocumentNumber
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_DocumentNumber, PTEIDNG_FIELD_ID_LEN_DocumentNumber);
-	pteidngidBuffer.TrimRight('\0');
-	m_DocumentNumber.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// TaxNo
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_TaxNo, PTEIDNG_FIELD_ID_LEN_TaxNo);
-	pteidngidBuffer.TrimRight('\0');
-	m_TaxNo.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// SocialSecurityNo
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_SocialSecurityNo, PTEIDNG_FIELD_ID_LEN_SocialSecurityNo);
-	pteidngidBuffer.TrimRight('\0');
-	m_SocialSecurityNo.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// HealthNo
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_HealthNo, PTEIDNG_FIELD_ID_LEN_HealthNo);
-	pteidngidBuffer.TrimRight('\0');
-	m_HealthNo.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// IssuingEntity
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_IssuingEntity, PTEIDNG_FIELD_ID_LEN_IssuingEntity);
-	pteidngidBuffer.TrimRight('\0');
-	m_IssuingEntity.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// GivenNameFather
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_GivenNameFather, PTEIDNG_FIELD_ID_LEN_GivenNameFather);
-	pteidngidBuffer.TrimRight('\0');
-	m_GivenNameFather.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// SurnameFather
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_SurnameFather, PTEIDNG_FIELD_ID_LEN_SurnameFather);
-	pteidngidBuffer.TrimRight('\0');
-	m_SurnameFather.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// GivenNameMother
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_GivenNameMother, PTEIDNG_FIELD_ID_LEN_GivenNameMother);
-	pteidngidBuffer.TrimRight('\0');
-	m_GivenNameMother.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// SurnameMother
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_SurnameMother, PTEIDNG_FIELD_ID_LEN_SurnameMother);
-	pteidngidBuffer.TrimRight('\0');
-	m_SurnameMother.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
+	mapCardFields(this, m_data, m_FieldLayout);
 
 	// Photo
 	{
@@ -510,26 +501,6 @@ void APL_EidFile_ID::MapFieldsInternal() {
 
 		cardKey = new APLPublicKey(modulus, exponent);
 	}
-	// MRZ1
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Mrz1, PTEIDNG_FIELD_ID_LEN_Mrz1);
-	pteidngidBuffer.TrimRight('\0');
-	m_MRZ1.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// MRZ2
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Mrz2, PTEIDNG_FIELD_ID_LEN_Mrz2);
-	pteidngidBuffer.TrimRight('\0');
-	m_MRZ2.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// MRZ3
-	pteidngidBuffer = m_data.GetBytes(PTEIDNG_FIELD_ID_POS_Mrz3, PTEIDNG_FIELD_ID_LEN_Mrz3);
-	pteidngidBuffer.TrimRight('\0');
-	m_MRZ3.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
-
-	// AccidentalIndications
-	pteidngidBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ID_POS_AccidentalIndications, PTEIDNG_FIELD_ID_LEN_AccidentalIndications);
-	pteidngidBuffer.TrimRight('\0');
-	m_AccidentalIndications.assign((char *)(pteidngidBuffer.GetBytes()), pteidngidBuffer.Size());
 
 	m_mappedFields = true;
 }
@@ -605,6 +576,11 @@ const char *APL_EidFile_ID::getNationality() {
 	return "";
 }
 
+void APL_EidFile_ID::getFields(std::vector<tCardFieldView> &fields) {
+	if (ShowData())
+		getCardFields(this, m_FieldLayout, fields);
+}
+
 const char *APL_EidFile_ID::getDocumentPAN() {
 	if (ShowData())
 		return m_ChipNumber.c_str();
@@ -1022,6 +998,67 @@ PhotoPteid *APL_EidFile_ID_V2::getPhotoObj() {
 *****************************************************************************************/
 const std::string APL_EidFile_Address::m_NATIONAL = "N";
 const std::string APL_EidFile_Address::m_FOREIGN = "I";
+
+const tCardFieldLayout<APL_EidFile_Address> APL_EidFile_Address::m_CommonLayout[] = {
+	{"addressType", PTEIDNG_FIELD_ADDRESS_POS_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_TYPE,
+	 &APL_EidFile_Address::m_AddressType},
+	{"countryCode", PTEIDNG_FIELD_ADDRESS_POS_COUNTRY, PTEIDNG_FIELD_ADDRESS_LEN_COUNTRY,
+	 &APL_EidFile_Address::m_CountryCode},
+};
+
+const tCardFieldLayout<APL_EidFile_Address> APL_EidFile_Address::m_NationalLayout[] = {
+	{"districtCode", PTEIDNG_FIELD_ADDRESS_POS_DISTRICT, PTEIDNG_FIELD_ADDRESS_LEN_DISTRICT,
+	 &APL_EidFile_Address::m_DistrictCode},
+	{"district", PTEIDNG_FIELD_ADDRESS_POS_DISTRICT_DESCRIPTION, PTEIDNG_FIELD_ADDRESS_LEN_DISTRICT_DESCRIPTION,
+	 &APL_EidFile_Address::m_DistrictDescription},
+	{"municipalityCode", PTEIDNG_FIELD_ADDRESS_POS_MUNICIPALITY, PTEIDNG_FIELD_ADDRESS_LEN_MUNICIPALITY,
+	 &APL_EidFile_Address::m_MunicipalityCode},
+	{"municipality", PTEIDNG_FIELD_ADDRESS_POS_MUNICIPALITY_DESCRIPTION,
+	 PTEIDNG_FIELD_ADDRESS_LEN_MUNICIPALITY_DESCRIPTION, &APL_EidFile_Address::m_MunicipalityDescription},
+	{"parishCode", PTEIDNG_FIELD_ADDRESS_POS_CIVILPARISH, PTEIDNG_FIELD_ADDRESS_LEN_CIVILPARISH,
+	 &APL_EidFile_Address::m_CivilParishCode},
+	{"parish", PTEIDNG_FIELD_ADDRESS_POS_CIVILPARISH_DESCRIPTION, PTEIDNG_FIELD_ADDRESS_LEN_CIVILPARISH_DESCRIPTION,
+	 &APL_EidFile_Address::m_CivilParishDescription},
+	{"abbrStreetType", PTEIDNG_FIELD_ADDRESS_POS_ABBR_STREET_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_ABBR_STREET_TYPE,
+	 &APL_EidFile_Address::m_AbbrStreetType},
+	{"streetType", PTEIDNG_FIELD_ADDRESS_POS_STREET_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_STREET_TYPE,
+	 &APL_EidFile_Address::m_StreetType},
+	{"streetName", PTEIDNG_FIELD_ADDRESS_POS_STREETNAME, PTEIDNG_FIELD_ADDRESS_LEN_STREETNAME,
+	 &APL_EidFile_Address::m_StreetName},
+	{"abbrBuildingType", PTEIDNG_FIELD_ADDRESS_POS_ABBR_BUILDING_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_ABBR_BUILDING_TYPE,
+	 &APL_EidFile_Address::m_AbbrBuildingType},
+	{"buildingType", PTEIDNG_FIELD_ADDRESS_POS_BUILDING_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_BUILDING_TYPE,
+	 &APL_EidFile_Address::m_BuildingType},
+	{"doorNo", PTEIDNG_FIELD_ADDRESS_POS_DOORNO, PTEIDNG_FIELD_ADDRESS_LEN_DOORNO, &APL_EidFile_Address::m_DoorNo},
+	{"floor", PTEIDNG_FIELD_ADDRESS_POS_FLOOR, PTEIDNG_FIELD_ADDRESS_LEN_FLOOR, &APL_EidFile_Address::m_Floor},
+	{"side", PTEIDNG_FIELD_ADDRESS_POS_SIDE, PTEIDNG_FIELD_ADDRESS_LEN_SIDE, &APL_EidFile_Address::m_Side},
+	{"place", PTEIDNG_FIELD_ADDRESS_POS_PLACE, PTEIDNG_FIELD_ADDRESS_LEN_PLACE, &APL_EidFile_Address::m_Place},
+	{"locality", PTEIDNG_FIELD_ADDRESS_POS_LOCALITY, PTEIDNG_FIELD_ADDRESS_LEN_LOCALITY,
+	 &APL_EidFile_Address::m_Locality},
+	{"zip4", PTEIDNG_FIELD_ADDRESS_POS_ZIP4, PTEIDNG_FIELD_ADDRESS_LEN_ZIP4, &APL_EidFile_Address::m_Zip4},
+	{"zip3", PTEIDNG_FIELD_ADDRESS_POS_ZIP3, PTEIDNG_FIELD_ADDRESS_LEN_ZIP3, &APL_EidFile_Address::m_Zip3},
+	{"postalLocality", PTEIDNG_FIELD_ADDRESS_POS_POSTALLOCALITY, PTEIDNG_FIELD_ADDRESS_LEN_POSTALLOCALITY,
+	 &APL_EidFile_Address::m_PostalLocality},
+	{"generatedAddressCode", PTEIDNG_FIELD_ADDRESS_POS_GENADDRESS_NUM, PTEIDNG_FIELD_ADDRESS_LEN_GENADDRESS_NUM,
+	 &APL_EidFile_Address::m_Generated_Address_Code},
+};
+
+const tCardFieldLayout<APL_EidFile_Address> APL_EidFile_Address::m_ForeignLayout[] = {
+	{"foreignCountry", PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_COUNTRY_DESCRIPTION,
+	 PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_COUNTRY_DESCRIPTION, &APL_EidFile_Address::m_Foreign_Country},
+	{"foreignAddress", PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_ADDRESS, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_ADDRESS,
+	 &APL_EidFile_Address::m_Foreign_Generic_Address},
+	{"foreignCity", PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_CITY, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_CITY,
+	 &APL_EidFile_Address::m_Foreign_City},
+	{"foreignRegion", PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_REGION, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_REGION,
+	 &APL_EidFile_Address::m_Foreign_Region},
+	{"foreignLocality", PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_LOCALITY, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_LOCALITY,
+	 &APL_EidFile_Address::m_Foreign_Locality},
+	{"foreignPostalCode", PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_POSTAL_CODE, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_POSTAL_CODE,
+	 &APL_EidFile_Address::m_Foreign_Postal_Code},
+	{"generatedAddressCode", PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_GENADDRESS_NUM,
+	 PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_GENADDRESS_NUM, &APL_EidFile_Address::m_Generated_Address_Code},
+};
 APL_EidFile_Address::APL_EidFile_Address(APL_EIDCard *card) : APL_CardFile(card, PTEID_FILE_ADDRESS, NULL) {}
 
 APL_EidFile_Address::~APL_EidFile_Address() {}
@@ -1067,17 +1104,8 @@ void APL_EidFile_Address::MapFieldsInternal() {
 	if (m_mappedFields) // have we mapped the fields yet?
 		return;
 
-	CByteArray pteidngAddressBuffer;
-
-	// Address Type
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_TYPE);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_AddressType.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Country code
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_COUNTRY, PTEIDNG_FIELD_ADDRESS_LEN_COUNTRY);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_CountryCode.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
+	// Address Type and Country code
+	mapCardFields(this, m_data, m_CommonLayout);
 
 	if (m_AddressType == m_FOREIGN)
 		ForeignerAddressFields();
@@ -1226,165 +1254,19 @@ void APL_EidFile_Address::EmptyFields() {
 	m_SODCheck = false;
 }
 
-void APL_EidFile_Address::AddressFields() {
-	CByteArray pteidngAddressBuffer;
-
-	// District Code
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_DISTRICT, PTEIDNG_FIELD_ADDRESS_LEN_DISTRICT);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_DistrictCode.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// District Description
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_DISTRICT_DESCRIPTION, PTEIDNG_FIELD_ADDRESS_LEN_DISTRICT_DESCRIPTION);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_DistrictDescription.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Municipality Code
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_MUNICIPALITY, PTEIDNG_FIELD_ADDRESS_LEN_MUNICIPALITY);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_MunicipalityCode.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Municipality Description
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_MUNICIPALITY_DESCRIPTION,
-										   PTEIDNG_FIELD_ADDRESS_LEN_MUNICIPALITY_DESCRIPTION);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_MunicipalityDescription.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// CivilParish Code
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_CIVILPARISH, PTEIDNG_FIELD_ADDRESS_LEN_CIVILPARISH);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_CivilParishCode.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// CivilParish Description
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_CIVILPARISH_DESCRIPTION,
-										   PTEIDNG_FIELD_ADDRESS_LEN_CIVILPARISH_DESCRIPTION);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_CivilParishDescription.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Abbreviated Street Type
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_ABBR_STREET_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_ABBR_STREET_TYPE);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_AbbrStreetType.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Street Type
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_STREET_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_STREET_TYPE);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_StreetType.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Street Name
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_STREETNAME, PTEIDNG_FIELD_ADDRESS_LEN_STREETNAME);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_StreetName.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Abbreviated Building Type
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_ABBR_BUILDING_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_ABBR_BUILDING_TYPE);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_AbbrBuildingType.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Building Type
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_BUILDING_TYPE, PTEIDNG_FIELD_ADDRESS_LEN_BUILDING_TYPE);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_BuildingType.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// DoorNo
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_DOORNO, PTEIDNG_FIELD_ADDRESS_LEN_DOORNO);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_DoorNo.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Floor
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_FLOOR, PTEIDNG_FIELD_ADDRESS_LEN_FLOOR);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Floor.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Side
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_SIDE, PTEIDNG_FIELD_ADDRESS_LEN_SIDE);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Side.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Place
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_PLACE, PTEIDNG_FIELD_ADDRESS_LEN_PLACE);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Place.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Locality
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_LOCALITY, PTEIDNG_FIELD_ADDRESS_LEN_LOCALITY);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Locality.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Zip4
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_ZIP4, PTEIDNG_FIELD_ADDRESS_LEN_ZIP4);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Zip4.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Zip3
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_ZIP3, PTEIDNG_FIELD_ADDRESS_LEN_ZIP3);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Zip3.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Postal Locality
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_POSTALLOCALITY, PTEIDNG_FIELD_ADDRESS_LEN_POSTALLOCALITY);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_PostalLocality.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Generated Address Code
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_ADDRESS_POS_GENADDRESS_NUM, PTEIDNG_FIELD_ADDRESS_LEN_GENADDRESS_NUM);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Generated_Address_Code.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-}
-
-void APL_EidFile_Address::ForeignerAddressFields() {
-	CByteArray pteidngAddressBuffer;
-
-	// Foreign Country
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_COUNTRY_DESCRIPTION,
-										   PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_COUNTRY_DESCRIPTION);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Foreign_Country.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Foreign Generic Address
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_ADDRESS, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_ADDRESS);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Foreign_Generic_Address.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Foreign City
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_CITY, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_CITY);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Foreign_City.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Foreign Region
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_REGION, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_REGION);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Foreign_Region.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Foreign Locality
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_LOCALITY, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_LOCALITY);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Foreign_Locality.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Foreign Postal Code
-	pteidngAddressBuffer =
-		m_data.GetBytes(PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_POSTAL_CODE, PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_POSTAL_CODE);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Foreign_Postal_Code.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
-
-	// Foreign Generated Address Code
-	pteidngAddressBuffer = m_data.GetBytes(PTEIDNG_FIELD_FOREIGN_ADDRESS_POS_GENADDRESS_NUM,
-										   PTEIDNG_FIELD_FOREIGN_ADDRESS_LEN_GENADDRESS_NUM);
-	pteidngAddressBuffer.TrimRight('\0');
-	m_Generated_Address_Code.assign((char *)(pteidngAddressBuffer.GetBytes()), pteidngAddressBuffer.Size());
+void APL_EidFile_Address::AddressFields() { mapCardFields(this, m_data, m_NationalLayout); }
+
+void APL_EidFile_Address::ForeignerAddressFields() { mapCardFields(this, m_data, m_ForeignLayout); }
+
+void APL_EidFile_Address::getFields(std::vector<tCardFieldView> &fields) {
+	if (!ShowData())
+		return;
+
+	getCardFields(this, m_CommonLayout, fields);
+	if (m_AddressType == m_FOREIGN)
+		getCardFields(this, m_ForeignLayout, fields);
+	else
+		getCardFields(this, m_NationalLayout, fields);
 }
 
 bool APL_EidFile_Address::MapFields() {
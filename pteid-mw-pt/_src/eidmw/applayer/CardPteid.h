@@ -42,6 +42,18 @@ namespace eIDMW {
 
 class APL_EIDCard;
 
+/* Fixed-size field of the PTEID-ng ID and Address files, at the positions defined in CardPteidDef.h,
+   and the member it is mapped to */
+template <class T> struct tCardFieldLayout {
+	const char *name;
+	unsigned long pos;
+	unsigned long len;
+	std::string T::*member;
+};
+
+/* View of the field [pos, pos + len[ of data without its NUL padding */
+std::string_view cardFieldView(const CByteArray &data, unsigned long pos, unsigned long len);
+
 /******************************************************************************/ /**
   * Class that represent the file containing Trace informations on a PTEID card
   *
@@ -147,6 +159,8 @@ public:
 
 	virtual const char *getDocumentPAN(); /**< Return field DocumentPAN */
 	virtual PhotoPteid *getPhotoObj();	  /**< Return object Photo */
+
+	void getFields(std::vector<tCardFieldView> &fields); /**< Views of all the text fields */
 protected:
 	/**
 	  * Constructor
@@ -178,6 +192,8 @@ private:
 	virtual void PackPublicKeyData(CByteArray &cb);
 	virtual void PackPictureData(CByteArray &cb);
 
+	static const tCardFieldLayout<APL_EidFile_ID> m_FieldLayout[]; /**< Text fields of the IAS 0.7/1.01 ID file */
+
 	/**
 	  * Empty all fields
 	  */
@@ -375,6 +391,8 @@ public:
 
 	void doSODCheck(bool check);
 
+	void getFields(std::vector<tCardFieldView> &fields); /**< Views of the text fields of this address type */
+
 protected:
 	/**
 	  * Constructor
@@ -446,6 +464,10 @@ private:
 	static const std::string m_NATIONAL; /**< portuguese addresses 'N' in the address type field*/
 	static const std::string m_FOREIGN;	 /**< foreign addresses have 'I' in the address type field*/
 
+	static const tCardFieldLayout<APL_EidFile_Address> m_CommonLayout[];   /**< Fields of every address type */
+	static const tCardFieldLayout<APL_EidFile_Address> m_NationalLayout[]; /**< Fields of portuguese addresses */
+	static const tCardFieldLayout<APL_EidFile_Address> m_ForeignLayout[];  /**< Fields of foreign addresses */
+
 	friend APL_EidFile_Address *APL_EIDCard::getFileAddress(); /**< This method must access protected constructor */
 };
 
@@ -179,6 +179,21 @@ std::string urlEncode(const std::string &path) {
 	return dst.str();
 }
 
+std::string urlDecode(const std::string &uri) {
+	std::string dst;
+	dst.reserve(uri.size());
+	for (size_t i = 0; i < uri.size(); i++) {
+		if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) &&
+			isxdigit((unsigned char)uri[i + 2])) {
+			dst += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+			i += 2;
+		} else {
+			dst += uri[i];
+		}
+	}
+	return dst;
+}
+
 void replace_lastdot_inplace(char *str_in) {
 	// We can only search forward because memrchr and strrchr
 	// are not available on Windows *sigh*
@@ -77,6 +77,7 @@ int Truncate(const char *path);
 void latin1_to_utf8(unsigned char *in, unsigned char *out);
 
 std::string urlEncode(const std::string &path);
+std::string urlDecode(const std::string &uri);
 
 void replace_lastdot_inplace(char *in);
 
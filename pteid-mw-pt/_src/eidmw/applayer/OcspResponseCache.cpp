@@ -0,0 +1,307 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#include "OcspResponseCache.h"
+
+#include "APLReader.h"
+#include "cryptoFwkPteid.h"
+#include "MWException.h"
+#include "Log.h"
+#include "Thread.h"
+
+#include <openssl/ocsp.h>
+
+#include <vector>
+
+namespace eIDMW {
+
+class OcspRefreshThread : public CThread {
+public:
+	OcspRefreshThread(const std::shared_ptr<APL_OcspResponseCache::tSharedState> &state) : m_state(state) {}
+
+	void Run() { APL_OcspResponseCache::refreshLoop(this, *m_state); }
+
+private:
+	std::shared_ptr<APL_OcspResponseCache::tSharedState> m_state;
+};
+
+/* Refresh threads of destroyed caches that were still fetching a response */
+static std::vector<OcspRefreshThread *> s_detachedThreads;
+static CMutex s_detachedMutex;
+
+APL_OcspResponseCache::APL_OcspResponseCache(long maxAge, long refresh)
+	: m_state(new tSharedState), m_thread(NULL), m_threadFailed(false) {
+	m_state->maxAge = maxAge;
+	m_state->refresh = refresh;
+	m_state->closed = false;
+	m_state->threadBusy = false;
+	m_state->hits = 0;
+	m_state->misses = 0;
+}
+
+APL_OcspResponseCache::~APL_OcspResponseCache() {
+	bool threadBusy = false;
+	{
+		CAutoMutex autoMutex(&m_state->mutex);
+		m_state->closed = true;
+		threadBusy = m_state->threadBusy;
+		MWLOG(LEV_DEBUG, MOD_APL, "APL_OcspResponseCache: %lu hits, %lu misses", m_state->hits, m_state->misses);
+	}
+
+	if (m_thread) {
+		m_thread->RequestStop();
+		if (threadBusy) {
+			// Don't hold the card teardown until the OCSP request times out
+			CAutoMutex autoMutex(&s_detachedMutex);
+			s_detachedThreads.push_back(m_thread);
+		} else {
+			// Idle, it ends after its current sleep
+			m_thread->WaitTillStopped(10);
+			delete m_thread;
+		}
+		m_thread = NULL;
+	}
+
+	deleteStoppedThreads();
+}
+
+void APL_OcspResponseCache::waitDetachedThreads() {
+	CAutoMutex autoMutex(&s_detachedMutex);
+	for (OcspRefreshThread *thread : s_detachedThreads) {
+		// At most the OCSP connection timeout, the thread ends after the fetch in progress
+		thread->WaitTillStopped(10);
+		delete thread;
+	}
+	s_detachedThreads.clear();
+}
+
+void APL_OcspResponseCache::deleteStoppedThreads() {
+	CAutoMutex autoMutex(&s_detachedMutex);
+	for (size_t i = 0; i < s_detachedThreads.size();) {
+		if (s_detachedThreads[i]->IsRunning()) {
+			i++;
+		} else {
+			delete s_detachedThreads[i];
+			s_detachedThreads.erase(s_detachedThreads.begin() + i);
+		}
+	}
+}
+
+void APL_OcspResponseCache::track(const CByteArray &cert, const CByteArray &issuer) {
+	std::string key((const char *)cert.GetBytes(), cert.Size());
+
+	CAutoMutex autoMutex(&m_state->mutex);
+	time_t now = time(NULL);
+	auto it = m_state->entries.find(key);
+	if (it != m_state->entries.end()) {
+		it->second.lastUsed = now;
+		return;
+	}
+
+	tCacheEntry &entry = m_state->entries[key];
+	entry.cert = cert;
+	entry.issuer = issuer;
+	entry.expiry = 0;
+	entry.refreshAt = now;
+	entry.lastUsed = now;
+	entry.fetching = false;
+	entry.failed = false;
+	entry.fetches = 0;
+
+	if (!m_thread && !m_threadFailed) {
+		m_thread = new OcspRefreshThread(m_state);
+		if (m_thread->Start() != 0) {
+			MWLOG(LEV_WARN, MOD_APL, "APL_OcspResponseCache: failed to start thread, fetching responses on demand");
+			delete m_thread;
+			m_thread = NULL;
+			m_threadFailed = true;
+		}
+	}
+}
+
+bool APL_OcspResponseCache::getResponse(const CByteArray &cert, CByteArray &response) {
+	std::string key((const char *)cert.GetBytes(), cert.Size());
+	tSharedState &state = *m_state;
+	unsigned long fetches = 0;
+	bool fetchNow = false;
+
+	{
+		CAutoMutex autoMutex(&state.mutex);
+		auto it = state.entries.find(key);
+		if (it == state.entries.end())
+			return false;
+
+		tCacheEntry &entry = it->second;
+		time_t now = time(NULL);
+		entry.lastUsed = now;
+		if (now < entry.expiry) {
+			response = entry.response;
+			state.hits++;
+			return true;
+		}
+
+		if (!entry.fetching) {
+			// Don't retry a failed fetch before OCSP_CACHE_RETRY_DELAY, the caller makes its own request
+			if (entry.failed && entry.refreshAt > now) {
+				state.misses++;
+				return false;
+			}
+			entry.refreshAt = now;
+			if (!m_thread) {
+				entry.fetching = true;
+				fetchNow = true;
+			}
+		}
+		fetches = entry.fetches;
+	}
+
+	if (fetchNow) {
+		fetch(state, key);
+	} else {
+		// Past the timeout the caller makes its own request, the fetch in progress still updates the entry
+		time_t deadline = time(NULL) + OCSP_CACHE_WAIT_TIMEOUT;
+		while (true) {
+			{
+				CAutoMutex autoMutex(&state.mutex);
+				if (state.entries[key].fetches != fetches)
+					break;
+				if (time(NULL) >= deadline) {
+					MWLOG(LEV_WARN, MOD_APL, "APL_OcspResponseCache: timeout waiting for the fetch in progress");
+					state.misses++;
+					return false;
+				}
+			}
+			CThread::SleepMillisecs(10);
+		}
+	}
+
+	CAutoMutex autoMutex(&state.mutex);
+	tCacheEntry &entry = state.entries[key];
+	if (time(NULL) < entry.expiry) {
+		response = entry.response;
+		state.hits++;
+		return true;
+	}
+	state.misses++;
+	return false;
+}
+
+unsigned long APL_OcspResponseCache::getHits() {
+	CAutoMutex autoMutex(&m_state->mutex);
+	return m_state->hits;
+}
+
+unsigned long APL_OcspResponseCache::getMisses() {
+	CAutoMutex autoMutex(&m_state->mutex);
+	return m_state->misses;
+}
+
+bool APL_OcspResponseCache::isDue(const tSharedState &state, const tCacheEntry &entry, time_t now) {
+	return !entry.fetching && now >= entry.refreshAt && now - entry.lastUsed < state.maxAge;
+}
+
+void APL_OcspResponseCache::refreshLoop(OcspRefreshThread *thread, tSharedState &state) {
+	while (!thread->m_bStopRequest) {
+		std::string due;
+		{
+			CAutoMutex autoMutex(&state.mutex);
+			if (state.closed)
+				break;
+
+			time_t now = time(NULL);
+			for (auto &it : state.entries) {
+				if (isDue(state, it.second, now)) {
+					it.second.fetching = true;
+					due = it.first;
+					break;
+				}
+			}
+			state.threadBusy = !due.empty();
+		}
+
+		if (due.empty()) {
+			CThread::SleepMillisecs(100);
+		} else {
+			fetch(state, due);
+			CAutoMutex autoMutex(&state.mutex);
+			state.threadBusy = false;
+		}
+	}
+}
+
+/* Fetch the response of an entry already marked as fetching */
+void APL_OcspResponseCache::fetch(tSharedState &state, const std::string &key) {
+	CByteArray cert;
+	CByteArray issuer;
+	{
+		CAutoMutex autoMutex(&state.mutex);
+		cert = state.entries[key].cert;
+		issuer = state.entries[key].issuer;
+	}
+
+	CByteArray response;
+	FWK_CertifStatus status = FWK_CERTIF_STATUS_ERROR;
+	try {
+		// Not verified here: the callers verify the cached response in their own thread before using it
+		status = AppLayer.getCryptoFwk()->GetOCSPResponse(cert, issuer, &response, false);
+	} catch (CMWException &e) {
+		status = FWK_CERTIF_STATUS_ERROR;
+	}
+
+	time_t expiry = 0;
+	bool good = status == FWK_CERTIF_STATUS_VALID && getExpiry(state.maxAge, response, expiry);
+
+	CAutoMutex autoMutex(&state.mutex);
+	tCacheEntry &entry = state.entries[key];
+	time_t now = time(NULL);
+	if (good) {
+		entry.response = response;
+		entry.expiry = expiry;
+		entry.refreshAt = expiry - state.refresh > now + OCSP_CACHE_RETRY_DELAY ? expiry - state.refresh
+																				: now + OCSP_CACHE_RETRY_DELAY;
+		MWLOG(LEV_DEBUG, MOD_APL, "APL_OcspResponseCache: response fresh for %ld s", (long)(expiry - now));
+	} else {
+		MWLOG(LEV_WARN, MOD_APL, "APL_OcspResponseCache: no fresh good response, OCSP status: %d", status);
+		entry.refreshAt = now + OCSP_CACHE_RETRY_DELAY;
+	}
+	entry.failed = !good;
+	entry.fetching = false;
+	entry.fetches++;
+}
+
+/* Time until which response is fresh, if it has a good status */
+bool APL_OcspResponseCache::getExpiry(long maxAge, const CByteArray &response, time_t &expiry) {
+	const unsigned char *p = response.GetBytes();
+	OCSP_RESPONSE *ocsp_response = d2i_OCSP_RESPONSE(NULL, &p, response.Size());
+	OCSP_BASICRESP *basic = ocsp_response ? OCSP_response_get1_basic(ocsp_response) : NULL;
+	ASN1_GENERALIZEDTIME *this_update = NULL;
+	ASN1_GENERALIZEDTIME *next_update = NULL;
+	int status = -1;
+	if (basic && OCSP_resp_count(basic) > 0)
+		status = OCSP_single_get0_status(OCSP_resp_get0(basic, 0), NULL, NULL, &this_update, &next_update);
+
+	bool ok = false;
+	int days = 0, secs = 0;
+	if (status == V_OCSP_CERTSTATUS_GOOD && this_update && ASN1_TIME_diff(&days, &secs, NULL, this_update)) {
+		time_t now = time(NULL);
+		expiry = now + (time_t)days * 24 * 3600 + secs + maxAge;
+		if (next_update && ASN1_TIME_diff(&days, &secs, NULL, next_update)) {
+			time_t next = now + (time_t)days * 24 * 3600 + secs;
+			if (next < expiry)
+				expiry = next;
+		}
+		ok = expiry > now;
+	}
+
+	if (basic)
+		OCSP_BASICRESP_free(basic);
+	if (ocsp_response)
+		OCSP_RESPONSE_free(ocsp_response);
+
+	return ok;
+}
+
+} // namespace eIDMW
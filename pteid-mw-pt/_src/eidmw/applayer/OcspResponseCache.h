@@ -0,0 +1,105 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#ifndef __OCSP_RESPONSE_CACHE_H__
+#define __OCSP_RESPONSE_CACHE_H__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <time.h>
+
+#include "ByteArray.h"
+#include "Mutex.h"
+
+/* Seconds to wait before fetching again a response that failed */
+#define OCSP_CACHE_RETRY_DELAY 60
+/* Seconds getResponse() waits for a fetch in progress before the caller fetches the response itself */
+#define OCSP_CACHE_WAIT_TIMEOUT 10
+
+namespace eIDMW {
+
+class OcspRefreshThread;
+
+/*
+ * In-memory cache of the OCSP responses of the certificates of one card, owned by APL_SmartCard.
+ *
+ * The responses added to LTV signatures made with the card are always about the same few certificates, the
+ * signature certificate and its sub-CA, so they are fetched ahead of time by a background thread and fetched
+ * again before they expire: a batch of LTV signatures embeds the same response without going to the network.
+ *
+ * A response is fresh until thisUpdate + max_age, or its nextUpdate if that comes first, and it's fetched again
+ * refresh seconds before that (both from the "certificatevalidation" section of the configuration). Only good
+ * responses are kept, for any other status the callers fetch the response themselves. A certificate that isn't
+ * used for max_age seconds is no longer refreshed, the next getResponse() fetches it again.
+ *
+ * The entries are shared with the refresh thread, which can outlive the cache: the destructor doesn't wait for a
+ * fetch in progress, the thread ends once it's done and is deleted by a later cache or by waitDetachedThreads().
+ */
+class APL_OcspResponseCache {
+public:
+	APL_OcspResponseCache(long maxAge, long refresh);
+	~APL_OcspResponseCache();
+
+	/* Keep a fresh response for cert, the first one is fetched in the background */
+	void track(const CByteArray &cert, const CByteArray &issuer);
+
+	/* Fresh good response for a tracked cert, waiting for the fetch in progress if there's one. The response isn't
+	   verified, that's left to the caller (APL_CryptoFwk::VerifyOCSPResponse()) */
+	bool getResponse(const CByteArray &cert, CByteArray &response);
+
+	unsigned long getHits();
+	unsigned long getMisses();
+
+	/* Wait for the refresh threads left running by destroyed caches. Called by CAppLayer once the cards are
+	   released, before the crypto framework they fetch the responses with is deleted */
+	static void waitDetachedThreads();
+
+private:
+	struct tCacheEntry {
+		CByteArray cert;
+		CByteArray issuer;
+		CByteArray response;
+		time_t expiry;	  /* The response is fresh until then */
+		time_t refreshAt; /* Next fetch, when the certificate is still being used */
+		time_t lastUsed;
+		bool fetching;
+		bool failed;		   /* The last fetch gave no fresh good response */
+		unsigned long fetches; /* Completed fetches, to wait for the one in progress */
+	};
+
+	struct tSharedState {
+		long maxAge;
+		long refresh;
+		std::map<std::string, tCacheEntry> entries;
+		bool closed;	  /* The cache was destroyed, the refresh thread must end */
+		bool threadBusy; /* The refresh thread is fetching a response */
+		unsigned long hits;
+		unsigned long misses;
+		CMutex mutex;
+	};
+
+	APL_OcspResponseCache(const APL_OcspResponseCache &);
+	APL_OcspResponseCache &operator=(const APL_OcspResponseCache &);
+
+	static bool isDue(const tSharedState &state, const tCacheEntry &entry, time_t now);
+	/* Called by OcspRefreshThread: fetch the entries that are due until the cache is destroyed */
+	static void refreshLoop(OcspRefreshThread *thread, tSharedState &state);
+	static void fetch(tSharedState &state, const std::string &key);
+	static bool getExpiry(long maxAge, const CByteArray &response, time_t &expiry);
+	/* Delete the refresh threads left running by destroyed caches that have ended since */
+	static void deleteStoppedThreads();
+
+	std::shared_ptr<tSharedState> m_state;
+	OcspRefreshThread *m_thread;
+	bool m_threadFailed;
+
+	friend class OcspRefreshThread;
+};
+
+} // namespace eIDMW
+
+#endif // __OCSP_RESPONSE_CACHE_H__
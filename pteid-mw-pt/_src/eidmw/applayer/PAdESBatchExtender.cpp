@@ -0,0 +1,165 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#include "PAdESBatchExtender.h"
+
+#include "PDFSignature.h"
+#include "ValidationDataCache.h"
+#include "MiscUtil.h"
+#include "MWException.h"
+#include "eidErrors.h"
+#include "Thread.h"
+#include "Log.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace eIDMW {
+
+class PAdESBatchWorker : public CThread {
+public:
+	PAdESBatchWorker(PAdESBatchExtender *batch) : m_batch(batch) {}
+
+	void Run() {
+		size_t index;
+		while (m_batch->nextDocument(index))
+			m_batch->extendDocument(index);
+	}
+
+private:
+	PAdESBatchExtender *m_batch;
+};
+
+PAdESBatchExtender::PAdESBatchExtender(APL_SignatureLevel level, unsigned int workers)
+	: m_level(level), m_workers(workers > 0 ? workers : 1), m_cache(NULL), m_nextDocument(0), m_report() {
+	if (level != LEVEL_LT && level != LEVEL_LTV)
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_RANGE);
+}
+
+PAdESBatchExtender::~PAdESBatchExtender() { delete m_cache; }
+
+void PAdESBatchExtender::addFile(const char *path) { m_inputFiles.push_back(path); }
+
+size_t PAdESBatchExtender::addDirectory(const char *dir) {
+	size_t count = m_inputFiles.size();
+	bool bStopRequest = false;
+
+	scanDir(dir, "", "", bStopRequest, this, &PAdESBatchExtender::foundFile);
+
+	return m_inputFiles.size() - count;
+}
+
+void PAdESBatchExtender::foundFile(const char *dir, const char * /*subDir*/, const char *file, void *param) {
+	PAdESBatchExtender *batch = static_cast<PAdESBatchExtender *>(param);
+
+	std::string name = file;
+	std::string ext = name.size() > 4 ? name.substr(name.size() - 4) : "";
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	if (ext != ".pdf")
+		return;
+
+	std::string path = dir;
+#ifdef WIN32
+	path += "\\";
+#else
+	path += "/";
+#endif
+	path += name;
+	batch->m_inputFiles.push_back(path);
+}
+
+void PAdESBatchExtender::setOutputDirectory(const char *output_dir) { m_outputDir = output_dir ? output_dir : ""; }
+
+void PAdESBatchExtender::setCacheDirectory(const char *cache_dir) {
+	m_cacheDir = cache_dir ? cache_dir : "";
+	delete m_cache;
+	m_cache = NULL;
+}
+
+bool PAdESBatchExtender::nextDocument(size_t &index) {
+	CAutoMutex autoMutex(&m_mutex);
+
+	if (m_nextDocument >= m_inputFiles.size())
+		return false;
+
+	index = m_nextDocument++;
+	return true;
+}
+
+void PAdESBatchExtender::extendDocument(size_t index) {
+	const std::string &input = m_inputFiles[index];
+	bool success = false;
+
+	try {
+		PDFSignature pdf(input.c_str());
+		success = pdf.extendSignatureLevel(m_level, m_outputFiles[index].c_str(), m_cache);
+	} catch (CMWException &e) {
+		MWLOG(LEV_ERROR, MOD_APL, "PAdESBatchExtender: %s failed with error 0x%08lx", input.c_str(), e.GetError());
+	}
+
+	if (!success) {
+		CAutoMutex autoMutex(&m_mutex);
+		m_failedFiles.push_back(input);
+	}
+}
+
+size_t PAdESBatchExtender::extend() {
+	if (m_cache == NULL)
+		m_cache = new APL_ValidationDataCache(m_cacheDir.c_str());
+
+	unsigned long initialHits = m_cache->getHits();
+	unsigned long initialMisses = m_cache->getMisses();
+
+	m_outputFiles = m_inputFiles;
+	if (!m_outputDir.empty()) {
+		std::vector<std::string *> outputFiles;
+		for (std::string &output : m_outputFiles)
+			outputFiles.push_back(&output);
+		CPathUtil::generate_unique_filenames(m_outputDir.c_str(), outputFiles);
+	}
+
+	m_failedFiles.clear();
+	m_nextDocument = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	// The calling thread is one of the workers
+	size_t threadCount = std::min<size_t>(m_workers, m_inputFiles.size());
+	std::vector<PAdESBatchWorker *> workers;
+	for (size_t i = 1; i < threadCount; i++) {
+		PAdESBatchWorker *worker = new PAdESBatchWorker(this);
+		workers.push_back(worker);
+		if (worker->Start() != 0) {
+			MWLOG(LEV_WARN, MOD_APL, "PAdESBatchExtender: failed to start worker thread");
+			break;
+		}
+	}
+
+	PAdESBatchWorker(this).Run();
+
+	for (PAdESBatchWorker *worker : workers) {
+		worker->WaitTillStopped(50);
+		delete worker;
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	m_report.documents = m_inputFiles.size();
+	m_report.failed = m_failedFiles.size();
+	m_report.elapsedSeconds = elapsed.count();
+	m_report.documentsPerSecond = elapsed.count() > 0 ? m_report.documents / elapsed.count() : 0;
+	m_report.cacheHits = m_cache->getHits() - initialHits;
+	m_report.cacheMisses = m_cache->getMisses() - initialMisses;
+
+	MWLOG(LEV_INFO, MOD_APL,
+		  "PAdESBatchExtender: %lu documents (%lu failed) in %.1f s, %.2f documents/s, "
+		  "validation data cache %lu hits, %lu misses",
+		  (unsigned long)m_report.documents, (unsigned long)m_report.failed, m_report.elapsedSeconds,
+		  m_report.documentsPerSecond, m_report.cacheHits, m_report.cacheMisses);
+
+	return m_report.failed;
+}
+
+} // namespace eIDMW
@@ -0,0 +1,88 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#ifndef __PADES_BATCH_EXTENDER_H
+#define __PADES_BATCH_EXTENDER_H
+
+#include <string>
+#include <vector>
+
+#include "Export.h"
+#include "Mutex.h"
+#include "APLCard.h"
+
+#define PADES_BATCH_DEFAULT_WORKERS 4
+
+namespace eIDMW {
+
+class APL_ValidationDataCache;
+
+/* Counters of the last PAdESBatchExtender::extend() run */
+struct PAdESBatchReport {
+	size_t documents;
+	size_t failed;
+	double elapsedSeconds;
+	double documentsPerSecond;
+	unsigned long cacheHits;
+	unsigned long cacheMisses;
+};
+
+/* PAdESBatchExtender upgrades the signatures of many already signed PDF documents to PAdES-LT or PAdES-LTA.
+   The documents are processed by a pool of worker threads which share one APL_ValidationDataCache, so an OCSP
+   response or CRL is only fetched once while it is still fresh, for the whole batch and for later batches.
+*/
+class PAdESBatchExtender {
+public:
+	/* level must be LEVEL_LT or LEVEL_LTV (PAdES-LTA) */
+	EIDMW_APL_API PAdESBatchExtender(APL_SignatureLevel level, unsigned int workers = PADES_BATCH_DEFAULT_WORKERS);
+	EIDMW_APL_API ~PAdESBatchExtender();
+
+	EIDMW_APL_API void addFile(const char *path);
+
+	/* Add the PDF files found in dir and its subdirectories. Returns the number of files added */
+	EIDMW_APL_API size_t addDirectory(const char *dir);
+
+	/* Write the upgraded documents to output_dir instead of overwriting the input files */
+	EIDMW_APL_API void setOutputDirectory(const char *output_dir);
+
+	/* Directory of the OCSP/CRL cache, by default the "ltv" subdirectory of the pteid cache directory */
+	EIDMW_APL_API void setCacheDirectory(const char *cache_dir);
+
+	/* Upgrade every document added so far. Returns the number of documents that failed */
+	EIDMW_APL_API size_t extend();
+
+	EIDMW_APL_API const PAdESBatchReport &getReport() const { return m_report; }
+	EIDMW_APL_API const std::vector<std::string> &getFailedFiles() const { return m_failedFiles; }
+
+private:
+	PAdESBatchExtender(const PAdESBatchExtender &);
+	PAdESBatchExtender &operator=(const PAdESBatchExtender &);
+
+	static void foundFile(const char *dir, const char *subDir, const char *file, void *param);
+
+	/* Called by the workers: take the next document to process */
+	bool nextDocument(size_t &index);
+	void extendDocument(size_t index);
+
+	APL_SignatureLevel m_level;
+	unsigned int m_workers;
+	std::string m_outputDir;
+	std::string m_cacheDir;
+	APL_ValidationDataCache *m_cache;
+
+	std::vector<std::string> m_inputFiles;
+	std::vector<std::string> m_outputFiles;
+	size_t m_nextDocument;
+	std::vector<std::string> m_failedFiles;
+	PAdESBatchReport m_report;
+	CMutex m_mutex;
+
+	friend class PAdESBatchWorker;
+};
+
+} // namespace eIDMW
+
+#endif
@@ -19,17 +19,28 @@
 #include "MiscUtil.h"
 #include "sign-pkcs7.h"
 #include "PKIFetcher.h"
+#include "SharedCertStore.h"
+#include "ValidationDataCache.h"
+#include "OcspResponseCache.h"
+#include "Thread.h"
 #include "poppler/PDFDoc.h"
 
 #include <openssl/pkcs7.h>
 #include <openssl/x509.h>
 #include <openssl/ocsp.h>
 #include <cassert>
+#include <chrono>
+#include <map>
+#include <memory>
+
+/* Maximum number of OCSP and CRL requests in flight while collecting the revocation data of a document */
+#define REVOCATION_FETCH_PARALLEL_REQUESTS 8
 
 namespace eIDMW {
 PAdESExtender::PAdESExtender(PDFSignature *signedPdfDoc) {
 	m_signedPdfDoc = signedPdfDoc;
 	m_calledFromLtaMethod = false;
+	m_validationDataCache = NULL;
 }
 
     bool PAdESExtender::addT()
@@ -131,13 +142,7 @@ bool PAdESExtender::addOCSPCertToValidationData(CByteArray &ocsp_response_ba, CB
 }
 
 unsigned long PAdESExtender::getCertUniqueId(const unsigned char *data, int dataSize) {
-	X509 *pX509 = NULL;
-	pX509 = d2i_X509(&pX509, &data, dataSize);
-	long cert_unique_id = X509_issuer_and_serial_hash(pX509);
-
-	X509_free(pX509);
-
-	return cert_unique_id;
+	return APL_SharedCertStore::instance().getCertificate(CByteArray(data, dataSize))->getUniqueId();
 }
 
 ValidationDataElement *PAdESExtender::addValidationElement(ValidationDataElement &elem) {
@@ -181,17 +186,278 @@ void PAdESExtender::removeValidationElement(ValidationDataElement *elem) {
 	}
 }
 
-bool PAdESExtender::addCRLRevocationInfo(CByteArray &cert, std::unordered_set<std::string> vri_keys) {
-	CByteArray crl;
+/* One OCSP or CRL request of collectRevocationData(), run in its own thread */
+class RevocationFetchThread : public CThread {
+public:
+	/* OCSP request for cert */
+	RevocationFetchThread(const CByteArray &cert, const CByteArray &issuer)
+		: m_isOcsp(true), m_cert(cert), m_issuer(issuer), m_status(FWK_CERTIF_STATUS_UNCHECK), m_elapsedMs(0),
+		  m_fromCache(false) {}
+
+	/* CRL download from a distribution point */
+	RevocationFetchThread(const std::string &url)
+		: m_isOcsp(false), m_url(url), m_status(FWK_CERTIF_STATUS_UNCHECK), m_elapsedMs(0), m_fromCache(false) {}
+
+	void Run() {
+		auto start = std::chrono::steady_clock::now();
+		try {
+			if (m_isOcsp) {
+				m_status = AppLayer.getCryptoFwk()->GetOCSPResponse(m_cert, m_issuer, &m_response, false);
+			} else {
+				PKIFetcher crlFetcher;
+				m_response = crlFetcher.fetch_PKI_file(m_url.c_str());
+			}
+		} catch (CMWException &e) {
+			m_status = FWK_CERTIF_STATUS_ERROR;
+			m_response.ClearContents();
+		}
+		m_elapsedMs =
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool m_isOcsp;
+	CByteArray m_cert;
+	CByteArray m_issuer;
+	std::string m_url;
+
+	FWK_CertifStatus m_status;
+	CByteArray m_response;
+	long long m_elapsedMs;
+	bool m_fromCache; // m_response was found in the validation data cache and the thread is never started
+};
+
+/* Run the requests with at most REVOCATION_FETCH_PARALLEL_REQUESTS of them in flight and wait for all to finish */
+static void runRevocationFetches(const std::vector<RevocationFetchThread *> &fetches) {
+	size_t started = 0;
+	while (true) {
+		unsigned int running = 0;
+		for (size_t i = 0; i < started; i++) {
+			if (fetches[i]->IsRunning())
+				running++;
+		}
+
+		if (started < fetches.size() && fetches[started]->m_fromCache) {
+			started++;
+		} else if (started < fetches.size() && running < REVOCATION_FETCH_PARALLEL_REQUESTS) {
+			if (fetches[started]->Start() != 0) {
+				MWLOG(LEV_WARN, MOD_APL, "%s: failed to start thread, fetching revocation data synchronously",
+					  __FUNCTION__);
+				fetches[started]->Run();
+			}
+			started++;
+		} else if (running > 0) {
+			CThread::SleepMillisecs(10);
+		} else {
+			break;
+		}
+	}
+
+	for (RevocationFetchThread *fetch : fetches)
+		fetch->WaitTillStopped(10);
+}
+
+/* Fetch latency of one document, logged when addLT() finishes collecting revocation data */
+static void logRevocationFetchReport(const std::vector<RevocationFetchThread *> &fetches, size_t signerCerts,
+									 long long wallMs) {
+	size_t ocspCount = 0, crlCount = 0, failed = 0, cached = 0;
+	long long totalMs = 0;
+	RevocationFetchThread *slowest = NULL;
+
+	for (RevocationFetchThread *fetch : fetches) {
+		if (fetch->m_fromCache) {
+			cached++;
+			continue;
+		}
+
+		fetch->m_isOcsp ? ocspCount++ : crlCount++;
+		totalMs += fetch->m_elapsedMs;
+		if (fetch->m_response.Size() == 0)
+			failed++;
+		if (slowest == NULL || fetch->m_elapsedMs > slowest->m_elapsedMs)
+			slowest = fetch;
+
+		if (fetch->m_isOcsp)
+			MWLOG(LEV_DEBUG, MOD_APL, "Revocation fetch: OCSP for cert issued by %s took %lld ms",
+				  certificate_issuer_serial_from_der(fetch->m_cert).c_str(), fetch->m_elapsedMs);
+		else
+			MWLOG(LEV_DEBUG, MOD_APL, "Revocation fetch: CRL %s took %lld ms", fetch->m_url.c_str(),
+				  fetch->m_elapsedMs);
+	}
+
+	MWLOG(LEV_INFO, MOD_APL,
+		  "Revocation fetch report: %lu signer certificates, %lu OCSP and %lu CRL requests (%lu failed), "
+		  "%lu found in cache, sum of latencies %lld ms, slowest %lld ms, elapsed %lld ms",
+		  (unsigned long)signerCerts, (unsigned long)ocspCount, (unsigned long)crlCount, (unsigned long)failed,
+		  (unsigned long)cached, totalMs, slowest ? slowest->m_elapsedMs : 0LL, wallMs);
+}
+
+/* CRL download shared by every certificate with the same distribution point */
+struct CrlFetchTarget {
+	std::unique_ptr<RevocationFetchThread> fetch;
+	std::unordered_set<std::string> vri_keys;
+	bool required = false; // A signer certificate has no other revocation data
+};
+
+bool PAdESExtender::collectRevocationData(const std::vector<size_t> &signerCerts_idx) {
 	APL_CryptoFwkPteid *cryptoFwk = AppLayer.getCryptoFwk();
-	if (cryptoFwk->GetCrlData(cert, crl)) {
-		ValidationDataElement crlElem(crl.GetBytes(), crl.Size(), ValidationDataElement::CRL, vri_keys);
-		addValidationElement(crlElem);
+	auto start = std::chrono::steady_clock::now();
+
+	// The responses for the certificates of the signing card are usually fetched ahead of time
+	APL_SmartCard *card = dynamic_cast<APL_SmartCard *>(m_signedPdfDoc->m_card);
+	APL_OcspResponseCache *cardOcspCache = card ? card->getOcspResponseCache() : NULL;
+
+	/* Signer certificates are unique by (issuer, serial) in m_validationData so each one gets a single OCSP request.
+	   Find the issuers first: the OCSP requests are only started once m_validationData is not changing anymore. */
+	std::vector<std::unique_ptr<RevocationFetchThread>> ocspFetches(signerCerts_idx.size());
+	for (size_t i = 0; i < signerCerts_idx.size(); i++) {
+		ValidationDataElement *vd_elem = m_validationData[signerCerts_idx[i]];
+		assert(vd_elem->getSize() <= ULONG_MAX);
+		CByteArray signer_cert(vd_elem->getData(), (unsigned long)vd_elem->getSize());
+		CByteArray issuerCertDataByteArray;
+		bool foundIssuer = false;
+
+		MWLOG(LEV_DEBUG, MOD_APL, "%s: adding revocation info for cert issued by: %s", __FUNCTION__,
+			  certificate_issuer_serial_from_der(signer_cert).c_str());
 
+		// Find issuer for each signing cert
+		for (size_t j = 0; j < m_validationData.size(); j++) {
+			if (m_validationData[j]->getType() != ValidationDataElement::CERT)
+				continue;
+
+			size_t issuerLen = m_validationData[j]->getSize();
+			issuerCertDataByteArray.ClearContents();
+			assert(issuerLen <= ULONG_MAX);
+			issuerCertDataByteArray.Append(m_validationData[j]->getData(), (unsigned long)issuerLen);
+
+			if (cryptoFwk->isIssuer(signer_cert, issuerCertDataByteArray)) {
+				foundIssuer = true;
+				break;
+			}
+		}
+
+		/* Searching in eidstore may be useful to support more CA certificates in PADES-LT other than CC and CMD */
+		if (!foundIssuer) {
+			// Try to find issuer in eidstore certificates
+			foundIssuer = findIssuerInEidStore(cryptoFwk, signer_cert, issuerCertDataByteArray);
+			if (foundIssuer) {
+				ValidationDataElement vde(issuerCertDataByteArray.GetBytes(), issuerCertDataByteArray.Size(),
+										  ValidationDataElement::CERT, vd_elem->getVriHashKeys());
+				addValidationElement(vde);
+			}
+		}
+
+		if (foundIssuer) {
+			RevocationFetchThread *fetch = new RevocationFetchThread(signer_cert, issuerCertDataByteArray);
+			if ((cardOcspCache && cardOcspCache->getResponse(signer_cert, fetch->m_response)) ||
+				(m_validationDataCache && m_validationDataCache->getOcspResponse(signer_cert, fetch->m_response))) {
+				fetch->m_status = FWK_CERTIF_STATUS_VALID;
+				fetch->m_fromCache = true;
+			}
+			ocspFetches[i].reset(fetch);
+		} else {
+			MWLOG(LEV_WARN, MOD_APL,
+				  "%s: Couldn't find issuer for signing cert. Revocation info is going to be fetched from CRL",
+				  __FUNCTION__);
+		}
+	}
+
+	std::vector<RevocationFetchThread *> allFetches;
+	for (const auto &fetch : ocspFetches) {
+		if (fetch)
+			allFetches.push_back(fetch.get());
+	}
+	runRevocationFetches(allFetches);
+
+	/* CRLs are requested once per distribution point, with the VRI keys of every certificate that needs them */
+	std::map<std::string, CrlFetchTarget> crlFetches;
+	auto requestCrl = [&](const CByteArray &cert, const std::unordered_set<std::string> &vri_keys, bool required) {
+		std::string url;
+		if (!cryptoFwk->GetCDPUrl(cert, url, NID_crl_distribution_points)) {
+			MWLOG(LEV_ERROR, MOD_APL, "Couldn't parse CRL URL from certificate");
+			return false;
+		}
+
+		CrlFetchTarget &target = crlFetches[url];
+		if (!target.fetch) {
+			target.fetch.reset(new RevocationFetchThread(url));
+			if (m_validationDataCache && m_validationDataCache->getCrl(url, target.fetch->m_response))
+				target.fetch->m_fromCache = true;
+		}
+		target.vri_keys.insert(vri_keys.begin(), vri_keys.end());
+		target.required = target.required || required;
 		return true;
+	};
+
+	bool success = true;
+	for (size_t i = 0; i < signerCerts_idx.size() && success; i++) {
+		ValidationDataElement *vd_elem = m_validationData[signerCerts_idx[i]];
+		RevocationFetchThread *ocsp = ocspFetches[i].get();
+		FWK_CertifStatus status = ocsp ? ocsp->m_status : FWK_CERTIF_STATUS_UNCHECK;
+
+		if (status == FWK_CERTIF_STATUS_VALID) {
+			if (m_validationDataCache && !ocsp->m_fromCache)
+				m_validationDataCache->storeOcspResponse(ocsp->m_cert, ocsp->m_response);
+
+			CByteArray ocsp_responder_cert;
+			bool ocsp_check_revocation = addOCSPCertToValidationData(ocsp->m_response, ocsp_responder_cert);
+
+			ValidationDataElement ocspResponseElem(ocsp->m_response.GetBytes(), ocsp->m_response.Size(),
+												   ValidationDataElement::OCSP, vd_elem->getVriHashKeys());
+			addValidationElement(ocspResponseElem);
+
+			if (ocsp_check_revocation) {
+				requestCrl(ocsp_responder_cert, vd_elem->getVriHashKeys(), false);
+			}
+		}
+		if (status == FWK_CERTIF_STATUS_REVOKED || status == FWK_CERTIF_STATUS_SUSPENDED) {
+			MWLOG(LEV_ERROR, MOD_APL, "%s: OCSP validation: revoked certificate", __FUNCTION__);
+			success = false;
+		} else if (status == FWK_CERTIF_STATUS_UNKNOWN) {
+			MWLOG(LEV_WARN, MOD_APL,
+				  "%s: OCSP server returned unknown status so it's either a server error or the request is buggy or "
+				  "uses unsupported algorithm/feature",
+				  __FUNCTION__);
+			success = false;
+		} else if (!ocsp || status == FWK_CERTIF_STATUS_ERROR || status == FWK_CERTIF_STATUS_CONNECT) {
+			/* Use CRL if there is no OCSP response or we couldn't find the issuer (it should never happen with CC or
+			 * CMD signatures) */
+			CByteArray signer_cert(vd_elem->getData(), (unsigned long)vd_elem->getSize());
+			success = requestCrl(signer_cert, vd_elem->getVriHashKeys(), true);
+		}
+	}
+
+	if (success) {
+		std::vector<RevocationFetchThread *> crlThreads;
+		for (const auto &crlFetch : crlFetches)
+			crlThreads.push_back(crlFetch.second.fetch.get());
+		runRevocationFetches(crlThreads);
+		allFetches.insert(allFetches.end(), crlThreads.begin(), crlThreads.end());
+
+		for (auto &crlFetch : crlFetches) {
+			CByteArray &crl = crlFetch.second.fetch->m_response;
+			if (crl.Size() == 0) {
+				MWLOG(LEV_ERROR, MOD_APL,
+					  "Network error fetching CRL from %s or empty response. Revocation info is incomplete!",
+					  crlFetch.first.c_str());
+				if (crlFetch.second.required)
+					success = false;
+				continue;
+			}
+
+			if (m_validationDataCache && !crlFetch.second.fetch->m_fromCache)
+				m_validationDataCache->storeCrl(crlFetch.first, crl);
+
+			ValidationDataElement crlElem(crl.GetBytes(), crl.Size(), ValidationDataElement::CRL,
+										  crlFetch.second.vri_keys);
+			addValidationElement(crlElem);
+		}
 	}
 
-	return false;
+	long long wallMs =
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	logRevocationFetchReport(allFetches, signerCerts_idx.size(), wallMs);
+
+	return success;
 }
 
 bool isSignerCertificate(X509 *cert) {
@@ -220,10 +486,6 @@ bool PAdESExtender::addLT() {
 	// TODO: verify if T first. Extend if not
 	bool success = true;
 
-        CByteArray issuerCertDataByteArray;
-        size_t issuerLen;
-        FWK_CertifStatus status = FWK_CERTIF_STATUS_UNCHECK;
-
 	PDFDoc *doc = m_signedPdfDoc->m_doc;
 	APL_CryptoFwkPteid *cryptoFwk = AppLayer.getCryptoFwk();
 
@@ -322,90 +584,10 @@ bool PAdESExtender::addLT() {
 	}
 
 	// Add revocation info for all signer certificates preferably using OCSP
-	for (auto signer_cert_idx : signerCerts_idx) {
-		status = FWK_CERTIF_STATUS_UNCHECK;
-		CByteArray ocsp_response;
-		bool ocsp_check_revocation = false;
-		bool foundIssuer = false;
-		ValidationDataElement *vd_elem = m_validationData[signer_cert_idx];
-		assert(vd_elem->getSize() <= ULONG_MAX);
-		CByteArray signer_cert(vd_elem->getData(), (unsigned long) vd_elem->getSize());
-		// Replaced full subject by "issuer - serial" for privacy reasons
-		// MWLOG(LEV_DEBUG, MOD_APL, "%s: adding revocation info for certificate: %s", __FUNCTION__,
-		// certificate_subject_from_der(signer_cert));
-
-		MWLOG(LEV_DEBUG, MOD_APL, "%s: adding revocation info for cert issued by: %s", __FUNCTION__,
-			  certificate_issuer_serial_from_der(signer_cert).c_str());
-
-		// Find issuer for each signing cert
-		for (size_t j = 0; j < m_validationData.size(); j++) {
-			if (m_validationData[j]->getType() != ValidationDataElement::CERT)
-				continue;
-
-			issuerLen = m_validationData[j]->getSize();
-			issuerCertDataByteArray.ClearContents();
-			assert(issuerLen <= ULONG_MAX);
-			issuerCertDataByteArray.Append(m_validationData[j]->getData(), (unsigned long) issuerLen);
-
-			if (cryptoFwk->isIssuer(signer_cert, issuerCertDataByteArray)) {
-				foundIssuer = true;
-				break;
-			}
-		}
-
-		/* Searching in eidstore may be useful to support more CA certificates in PADES-LT other than CC and CMD */
-		if (!foundIssuer) {
-			// Try to find issuer in eidstore certificates
-			foundIssuer = findIssuerInEidStore(cryptoFwk, signer_cert, issuerCertDataByteArray);
-			if (foundIssuer) {
-				ValidationDataElement vde(issuerCertDataByteArray.GetBytes(), issuerCertDataByteArray.Size(),
-										  ValidationDataElement::CERT, vd_elem->getVriHashKeys());
-				addValidationElement(vde);
-			}
-		}
-
-		if (foundIssuer) {
-			status = cryptoFwk->GetOCSPResponse(signer_cert, issuerCertDataByteArray, &ocsp_response, false);
-
-		} else {
-			MWLOG(LEV_WARN, MOD_APL,
-				  "%s: Couldn't find issuer for signing cert. Revocation info is going to be fetched from CRL",
-				  __FUNCTION__);
-		}
-
-		if (status == FWK_CERTIF_STATUS_VALID) {
-			CByteArray ocsp_responder_cert;
-			ocsp_check_revocation = addOCSPCertToValidationData(ocsp_response, ocsp_responder_cert);
-
-			ValidationDataElement ocspResponseElem(ocsp_response.GetBytes(), ocsp_response.Size(),
-												   ValidationDataElement::OCSP, vd_elem->getVriHashKeys());
-			addValidationElement(ocspResponseElem);
-
-			if (ocsp_check_revocation) {
-				addCRLRevocationInfo(ocsp_responder_cert, vd_elem->getVriHashKeys());
-			}
-		}
-		if (status == FWK_CERTIF_STATUS_REVOKED || status == FWK_CERTIF_STATUS_SUSPENDED) {
-			MWLOG(LEV_ERROR, MOD_APL, "%s: OCSP validation: revoked certificate", __FUNCTION__);
-			success = false;
-			goto cleanup;
-		} else if (status == FWK_CERTIF_STATUS_UNKNOWN) {
-			MWLOG(LEV_WARN, MOD_APL,
-				  "%s: OCSP server returned unknown status so it's either a server error or the request is buggy or "
-				  "uses unsupported algorithm/feature",
-				  __FUNCTION__);
-			success = false;
-			goto cleanup;
-		} else if (!foundIssuer || status == FWK_CERTIF_STATUS_ERROR || status == FWK_CERTIF_STATUS_CONNECT) {
-			/* Use CRL if there is no OCSP response or we couldn't find the issuer (it should never happen with CC or
-			 * CMD signatures) */
-			success = addCRLRevocationInfo(signer_cert, vd_elem->getVriHashKeys());
-			if (!success) {
-				goto cleanup;
-			}
-		}
-
-	} // End of outer loop
+	if (!collectRevocationData(signerCerts_idx)) {
+		success = false;
+		goto cleanup;
+	}
 
 	/* Remove from m_validationData the certs already present in document DSS. */
 	{
@@ -21,6 +21,8 @@ class ValidationDataElement;
 
 namespace eIDMW {
 
+class APL_ValidationDataCache;
+
 /* PAdESExtender allows to extend the level of an existing PAdES-B or PAdES-T signed document.
    This can be done in a incremental way without breaking the existing signature.
    Revocation information and related certificates are added to the /DSS dictionary in Catalog object
@@ -34,6 +36,9 @@ public:
 	EIDMW_APL_API bool addLT();
 	EIDMW_APL_API bool addLTA();
 
+	/* Reuse OCSP responses and CRLs from cache, and store the ones fetched, while adding LT validation data */
+	void setValidationDataCache(APL_ValidationDataCache *cache) { m_validationDataCache = cache; }
+
 private:
 	/* addValidationElement method takes a VDE and adds a dynamically allocated copy of it to m_validationData, if not
 	already present. It returns a pointer to the element in m_validationData */
@@ -44,7 +49,9 @@ private:
 
 	bool findIssuerInEidStore(APL_CryptoFwkPteid *cryptoFwk, CByteArray &certif_ba, CByteArray &issuer_ba);
 	bool addOCSPCertToValidationData(CByteArray &ocsp_response_ba, CByteArray &out_ocsp_cert);
-	bool addCRLRevocationInfo(CByteArray &cert, std::unordered_set<std::string> vri_keys);
+	/* Fetch OCSP responses or CRLs for the signer certificates at the given m_validationData indexes, in parallel,
+	   and add them to m_validationData. Returns false if a certificate is revoked or has no revocation data */
+	bool collectRevocationData(const std::vector<size_t> &signerCerts_idx);
 	unsigned long getCertUniqueId(const unsigned char *data, int dataSize);
 
 	PDFSignature *m_signedPdfDoc;
@@ -53,6 +60,7 @@ private:
 		m_certsInDoc; // used to avoid adding repeated certificates
 
 	bool m_calledFromLtaMethod;
+	APL_ValidationDataCache *m_validationDataCache;
 };
 } // namespace eIDMW
 #endif
\ No newline at end of file
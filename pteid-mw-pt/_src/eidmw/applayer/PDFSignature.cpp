@@ -30,6 +30,7 @@
 #include <string>
 #include <regex>
 #include <algorithm>
+#include <chrono>
 #include <cstdio>
 
 // For the setSSO calls
@@ -105,6 +106,10 @@ PDFSignature::~PDFSignature() {
 		free(my_custom_image.img_data);
 	}
 
+	discardPendingTimestamps();
+
+	delete m_pkcs7Template;
+
 	if (m_doc != NULL)
 		delete m_doc;
 }
@@ -129,8 +134,11 @@ void PDFSignature::resetMembers() {
 	m_card = NULL;
 	m_signerInfo = NULL;
 	m_pkcs7 = NULL;
+	m_pkcs7Template = NULL;
 	m_outputName = NULL;
 	m_signStarted = false;
+	m_tsaBatch = NULL;
+	m_batchIndex = 0;
 	m_isExternalCertificate = false;
 	m_isCC = true;
 }
@@ -442,6 +450,11 @@ PDFSignature *PDFSignature::getSpecialCopy(size_t batch_index) {
 int PDFSignature::signFiles(const char *location, const char *reason, const char *outfile_path, bool isCardSign) {
 	int rc = 0;
 
+	// The OCSP responses of the card certificates are fetched while the documents are signed
+	APL_SmartCard *card = isCardSign ? dynamic_cast<APL_SmartCard *>(m_card) : NULL;
+	if (card && (m_level == LEVEL_LT || m_level == LEVEL_LTV))
+		card->prefetchOcspResponses();
+
 	if (!m_batch_mode) {
 		rc = signSingleFile(location, reason, outfile_path, isCardSign);
 	}
@@ -450,6 +463,36 @@ int PDFSignature::signFiles(const char *location, const char *reason, const char
 		bool throwTimestampError = false;
 		bool throwLTVError = false;
 		bool cachedPin = false;
+
+		// Card signatures are closed when their timestamp arrives, see deferSignClose()
+		TSABatchClient tsaBatch(TSA_BATCH_PARALLEL_REQUESTS);
+		struct TSABatchReset {
+			PDFSignature *sig;
+			~TSABatchReset() { sig->m_tsaBatch = NULL; }
+		} tsaBatchReset = {this};
+		if (m_level != LEVEL_BASIC && !m_isExternalCertificate)
+			m_tsaBatch = &tsaBatch;
+
+		auto handleSignError = [&](CMWException &e, unsigned int index) {
+			if (e.GetError() != EIDMW_TIMESTAMP_ERROR && e.GetError() != EIDMW_LTV_ERROR) {
+				m_card->getCalReader()->setSSO(false);
+				finishAllPendingTimestamps();
+				throw CBatchSignFailedException(e.GetError(), index);
+			}
+
+			// Enable PIN cache
+			if (!cachedPin) {
+				cachedPin = true;
+				m_card->getCalReader()->setSSO(true);
+			}
+			m_level = LEVEL_BASIC; // Disable timestamp for the next files
+
+			if (e.GetError() == EIDMW_TIMESTAMP_ERROR)
+				throwTimestampError = true;
+			else
+				throwLTVError = true;
+		};
+
 		for (unsigned int i = 0; i < m_files_to_sign.size(); i++) {
 			try {
 				char *current_file = m_files_to_sign.at(i).first;
@@ -469,6 +512,7 @@ int PDFSignature::signFiles(const char *location, const char *reason, const char
 					m_page = m_doc->getNumPages();
 				}
 
+				m_batchIndex = i;
 				rc += signSingleFile(location, reason, f.c_str(), isCardSign);
 
 				// Enable PIN cache
@@ -477,22 +521,18 @@ int PDFSignature::signFiles(const char *location, const char *reason, const char
 					m_card->getCalReader()->setSSO(true);
 				}
 			} catch (CMWException e) {
-				if (e.GetError() != EIDMW_TIMESTAMP_ERROR && e.GetError() != EIDMW_LTV_ERROR) {
-					m_card->getCalReader()->setSSO(false);
-					throw CBatchSignFailedException(e.GetError(), i);
-				}
+				handleSignError(e, i);
+			}
 
-				// Enable PIN cache
-				if (!cachedPin) {
-					cachedPin = true;
-					m_card->getCalReader()->setSSO(true);
+			// Only wait for the oldest timestamp when the maximum of parallel requests is reached
+			while (m_pendingTimestamps.size() >= TSA_BATCH_PARALLEL_REQUESTS ||
+				   (i + 1 == m_files_to_sign.size() && !m_pendingTimestamps.empty())) {
+				unsigned int pendingIndex = 0;
+				try {
+					rc += finishPendingTimestamp(pendingIndex);
+				} catch (CMWException e) {
+					handleSignError(e, pendingIndex);
 				}
-				m_level = LEVEL_BASIC; // Disable timestamp for the next files
-
-				if (e.GetError() == EIDMW_TIMESTAMP_ERROR)
-					throwTimestampError = true;
-				else
-					throwLTVError = true;
 			}
 		}
 		m_card->getCalReader()->setSSO(false);
@@ -707,7 +747,11 @@ int PDFSignature::signSingleFile(const char *location, const char *reason, const
 							  isCC(), showDate, m_small_signature);
 	}
 
+	auto serializeStart = std::chrono::steady_clock::now();
 	unsigned long len = doc->getSigByteArray(&to_sign);
+	std::chrono::duration<double, std::milli> serializeTime = std::chrono::steady_clock::now() - serializeStart;
+	MWLOG(LEV_DEBUG, MOD_APL, "%s: serialized %lu bytes to sign in %.1f ms", __FUNCTION__, len,
+		  serializeTime.count());
 
 	if (len == 0) {
 		MWLOG(LEV_ERROR, MOD_APL, "%s: getSigByteArray failed! Invalid signature_offset.", __FUNCTION__);
@@ -743,12 +787,92 @@ int PDFSignature::signSingleFile(const char *location, const char *reason, const
 
 		/* Get card signature from card */
 		CByteArray signature = PteidSign(m_card, m_hash);
-		rc = signClose(signature);
+		if (m_tsaBatch && m_level != LEVEL_BASIC)
+			rc = deferSignClose(signature);
+		else
+			rc = signClose(signature);
 	}
 
 	return rc;
 }
 
+/* Start the timestamp request of the signature and keep the document open until finishPendingTimestamp() */
+int PDFSignature::deferSignClose(CByteArray &signature) {
+	unsigned char digest[SHA256_LEN];
+	SHA256_Wrapper(signature.GetBytes(), signature.Size(), digest);
+
+	PendingTimestamp pending;
+	pending.doc = m_doc;
+	pending.pkcs7 = m_pkcs7;
+	pending.signerInfo = m_signerInfo;
+	pending.outputName = m_outputName;
+	pending.level = m_level;
+	pending.signature = signature;
+	pending.fileIndex = m_batchIndex;
+	pending.requestId = m_tsaBatch->submit(digest, SHA256_LEN);
+	m_pendingTimestamps.push_back(pending);
+
+	m_doc = NULL;
+	m_pkcs7 = NULL;
+	m_signerInfo = NULL;
+	m_outputName = NULL;
+	m_signStarted = false;
+
+	return 0;
+}
+
+/* Close the oldest pending signature with its timestamp response */
+int PDFSignature::finishPendingTimestamp(unsigned int &fileIndex) {
+	PendingTimestamp pending = m_pendingTimestamps.front();
+	m_pendingTimestamps.pop_front();
+	fileIndex = pending.fileIndex;
+
+	CByteArray ts_response = m_tsaBatch->getResponse(pending.requestId);
+
+	APL_SignatureLevel batchLevel = m_level;
+	m_doc = pending.doc;
+	m_pkcs7 = pending.pkcs7;
+	m_signerInfo = pending.signerInfo;
+	m_outputName = pending.outputName;
+	m_level = pending.level;
+	m_signStarted = true;
+
+	int rc = 0;
+	try {
+		rc = signClose(pending.signature, &ts_response);
+	} catch (...) {
+		m_level = batchLevel;
+		throw;
+	}
+	m_level = batchLevel;
+
+	return rc;
+}
+
+/* The card already signed the pending documents: save them before a batch failure is reported, without their
+   timestamp if it doesn't arrive */
+void PDFSignature::finishAllPendingTimestamps() {
+	while (!m_pendingTimestamps.empty()) {
+		unsigned int fileIndex = 0;
+		try {
+			finishPendingTimestamp(fileIndex);
+		} catch (CMWException &e) {
+			MWLOG(LEV_ERROR, MOD_APL, "Failed to close the pending signature of file index %u: 0x%08lx", fileIndex,
+				  e.GetError());
+		}
+	}
+}
+
+void PDFSignature::discardPendingTimestamps() {
+	for (PendingTimestamp &pending : m_pendingTimestamps) {
+		delete pending.doc;
+		delete pending.outputName;
+		if (pending.pkcs7)
+			PKCS7_free(pending.pkcs7);
+	}
+	m_pendingTimestamps.clear();
+}
+
 bool PDFSignature::isCC() { return m_isCC; }
 
 void PDFSignature::setIsCC(bool in_IsCC) { m_isCC = in_IsCC; }
@@ -785,14 +909,20 @@ void PDFSignature::computeHash(unsigned char *data, unsigned long dataLen, CByte
 	/* Calculate hash */
 	m_pkcs7 = PKCS7_new();
 
-	bool timestamp = (m_level == LEVEL_TIMESTAMP || m_level == LEVEL_LT || m_level == LEVEL_LTV);
+	// Only the message digest changes between the documents of a batch
+	APL_Card *card = isCardSign ? m_card : NULL;
+	if (m_pkcs7Template == NULL || !m_pkcs7Template->matches(certificate, certificate_cas, card)) {
+		delete m_pkcs7Template;
+		m_pkcs7Template = new PKCS7Template(certificate, certificate_cas, card);
+	}
 
-	CByteArray in_hash = computeHash_pkcs7(data, dataLen, certificate, certificate_cas, timestamp, m_pkcs7,
-										   &m_signerInfo, isCardSign ? m_card : NULL);
+	CByteArray in_hash = computeHash_pkcs7(data, dataLen, *m_pkcs7Template, m_pkcs7, &m_signerInfo);
 	setHash(in_hash);
 }
 
-int PDFSignature::signClose(CByteArray signature) {
+int PDFSignature::signClose(CByteArray signature) { return signClose(signature, NULL); }
+
+int PDFSignature::signClose(CByteArray signature, const CByteArray *ts_response) {
 
 	if (!m_signStarted) {
 		MWLOG(LEV_DEBUG, MOD_APL, "signClose: Signature not started");
@@ -812,7 +942,7 @@ int PDFSignature::signClose(CByteArray signature) {
 	bool timestamp = (m_level == LEVEL_TIMESTAMP || m_level == LEVEL_LT || m_level == LEVEL_LTV);
 
 	int return_code = getSignedData_pkcs7((unsigned char *)signature.GetBytes(), signature.Size(), m_signerInfo,
-										  timestamp, m_pkcs7, &signature_contents);
+										  timestamp, m_pkcs7, &signature_contents, ts_response);
 
 	// Don't report "unknown error" exception in the case of timestamp error
 	if (return_code > 1)
@@ -851,6 +981,7 @@ int PDFSignature::signClose(CByteArray signature) {
 }
 
 void PDFSignature::save() {
+	auto start = std::chrono::steady_clock::now();
 	PDFWriteMode pdfWriteMode = writeForceIncremental;
 	// Create and save PDF to temp file to allow overwrite of original file
 	std::string utf8_outname(m_outputName->getCString());
@@ -942,6 +1073,9 @@ void PDFSignature::save() {
 
 	handleError(tmp_ret);
 	handleError(final_ret);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	MWLOG(LEV_DEBUG, MOD_APL, "%s: signed document written in %.1f ms", __FUNCTION__, elapsed.count());
 }
 
 bool PDFSignature::addLtv() {
@@ -953,4 +1087,37 @@ bool PDFSignature::addLtv() {
 	}
 	return false;
 }
+
+bool PDFSignature::extendSignatureLevel(APL_SignatureLevel level, const char *outfile_path,
+										APL_ValidationDataCache *cache) {
+	if (level != LEVEL_LT && level != LEVEL_LTV)
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_RANGE);
+
+	if (m_doc == NULL || !m_doc->isOk()) {
+		MWLOG(LEV_ERROR, MOD_APL, "%s: Failed to parse PDF! Error code: %d", __FUNCTION__,
+			  m_doc ? m_doc->getErrorCode() : -1);
+		throw CMWEXCEPTION(EIDMW_FILE_NOT_OPENED);
+	}
+
+	m_level = level;
+	delete m_outputName;
+	m_outputName = new GooString(outfile_path);
+
+	PAdESExtender padesExtender(this);
+	padesExtender.setValidationDataCache(cache);
+
+	bool success = false;
+	try {
+		success = level == LEVEL_LT ? padesExtender.addLT() : padesExtender.addLTA();
+	} catch (...) {
+		delete m_outputName;
+		m_outputName = NULL;
+		throw;
+	}
+
+	delete m_outputName;
+	m_outputName = NULL;
+
+	return success;
+}
 } // namespace eIDMW
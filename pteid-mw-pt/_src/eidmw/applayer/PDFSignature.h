@@ -15,6 +15,7 @@
 
 #include "Export.h"
 #include <vector>
+#include <deque>
 #include <utility>
 
 #include "ByteArray.h"
@@ -32,6 +33,9 @@
 
 #define BIGGER(a, b) ((a) > (b) ? (a) : (b))
 
+/* Maximum number of timestamp requests in flight while batch signing */
+#define TSA_BATCH_PARALLEL_REQUESTS 4
+
 class PDFRectangle;
 class PDFDoc;
 class GooString;
@@ -39,6 +43,9 @@ class GooString;
 namespace eIDMW {
 
 class CReader;
+class TSABatchClient;
+class PKCS7Template;
+class APL_ValidationDataCache;
 
 typedef struct {
 	unsigned char *img_data;
@@ -47,6 +54,9 @@ typedef struct {
 	int img_width;
 } Pixmap;
 
+// Open a PDF document from a UTF-8 path (long and non-ASCII paths included on Windows)
+PDFDoc *makePDFDoc(const char *utf8Filepath);
+
 class PDFSignature {
 public:
 	/* The no-argument constructor is the one we should use for signatures in batch mode */
@@ -118,6 +128,11 @@ public:
 
 	EIDMW_APL_API bool addLtv();
 
+	/* Upgrade the existing signatures of the document to PAdES-LT (LEVEL_LT) or PAdES-LTA (LEVEL_LTV) writing the
+	   result to outfile_path, which may be the input file itself. Used by PAdESBatchExtender */
+	EIDMW_APL_API bool extendSignatureLevel(APL_SignatureLevel level, const char *outfile_path,
+											APL_ValidationDataCache *cache = NULL);
+
 private:
 	void parseCitizenDataFromCert(CByteArray &certData);
 	CByteArray getCitizenCertificate();
@@ -125,9 +140,27 @@ private:
 	PDFRectangle computeSigLocationFromSector(double, double, int);
 	PDFRectangle computeSigLocationFromSectorLandscape(double, double, int);
 	int signSingleFile(const char *location, const char *reason, const char *outfile_path, bool isCardSign);
+	int signClose(CByteArray signature, const CByteArray *ts_response);
 	void save();
 	void resetMembers();
 
+	/* Batch signatures waiting for their timestamp: the timestamp request of one document runs while the
+	   next ones are signed by the card */
+	struct PendingTimestamp {
+		PDFDoc *doc;
+		PKCS7 *pkcs7;
+		PKCS7_SIGNER_INFO *signerInfo;
+		GooString *outputName;
+		APL_SignatureLevel level;
+		CByteArray signature;
+		size_t requestId;
+		unsigned int fileIndex;
+	};
+	int deferSignClose(CByteArray &signature);
+	int finishPendingTimestamp(unsigned int &fileIndex);
+	void finishAllPendingTimestamps();
+	void discardPendingTimestamps();
+
 	/* Certificate Data*/
 	CByteArray m_certificate;
 
@@ -156,6 +189,8 @@ private:
 	Pixmap my_custom_image;
 
 	PKCS7 *m_pkcs7;
+	/* Shared by the signatures of a batch, see computeHash() */
+	PKCS7Template *m_pkcs7Template;
 	CByteArray m_externCertificate;
 	std::vector<CByteArray> m_ca_certificates;
 
@@ -163,6 +198,9 @@ private:
 	PKCS7_SIGNER_INFO *m_signerInfo;
 	GooString *m_outputName;
 	bool m_signStarted;
+	TSABatchClient *m_tsaBatch;
+	std::deque<PendingTimestamp> m_pendingTimestamps;
+	unsigned int m_batchIndex;
 	bool m_isExternalCertificate;
 	bool m_isCC;
 
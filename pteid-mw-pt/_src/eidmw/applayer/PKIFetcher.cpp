@@ -15,6 +15,7 @@
 #include "MiscUtil.h"
 #include "Util.h"
 #include "Log.h"
+#include "Mutex.h"
 
 #ifdef WIN32
 #include <wincrypt.h>
@@ -22,11 +23,10 @@
 
 namespace eIDMW {
 
-CByteArray PKIFetcher::received_data = CByteArray();
-
 size_t PKIFetcher::curl_write_data(char *ptr, size_t size, size_t nmemb, void *stream) {
 	size_t realsize = size * nmemb;
-	received_data.SafeAppend((const unsigned char *)ptr, realsize);
+	PKIFetcher *fetcher = static_cast<PKIFetcher *>(stream);
+	fetcher->m_received_data.SafeAppend((const unsigned char *)ptr, realsize);
 
 	return realsize;
 }
@@ -72,16 +72,23 @@ CByteArray PKIFetcher::fetch_PKI_file(const char *url) {
 
 	if (strlen(url) == 0 || strstr(url, "http") != url) {
 		fprintf(stderr, "Invalid URL for fetch_PKI_file()\n");
-		return received_data;
+		return CByteArray();
 	}
 
 	MWLOG(LEV_DEBUG, MOD_APL, "Downloading PKI file: %s", url);
 
-	// Make sure the static array receiving the network reply
-	//  is zero'd out before each request
-	received_data.Chop(received_data.Size());
+	m_received_data.ClearContents();
 
-	curl_global_init(CURL_GLOBAL_NOTHING);
+	// curl_global_init() is not thread-safe in older libcurl versions
+	{
+		static CMutex global_init_mutex;
+		static bool global_init_done = false;
+		CAutoMutex autoMutex(&global_init_mutex);
+		if (!global_init_done) {
+			curl_global_init(CURL_GLOBAL_NOTHING);
+			global_init_done = true;
+		}
+	}
 
 	curl = curl_easy_init();
 
@@ -124,6 +131,7 @@ CByteArray PKIFetcher::fetch_PKI_file(const char *url) {
 	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error_buf);
 
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &curl_write_data);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
 
 	/* Perform the request, res will get the return code */
 	res = curl_easy_perform(curl);
@@ -142,8 +150,9 @@ CByteArray PKIFetcher::fetch_PKI_file(const char *url) {
 	}
 
 	curl_slist_free_all(headers);
+	curl_easy_cleanup(curl);
 
-	return received_data;
+	return m_received_data;
 }
 #endif
 
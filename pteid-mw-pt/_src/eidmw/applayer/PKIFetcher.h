@@ -15,7 +15,8 @@ public:
 
 private:
 	static size_t curl_write_data(char *, size_t, size_t, void *);
-	static CByteArray received_data;
+	// Per instance so that several fetchers can run in parallel threads
+	CByteArray m_received_data;
 };
 
 } // namespace eIDMW
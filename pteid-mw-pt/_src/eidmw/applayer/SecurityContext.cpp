@@ -22,6 +22,9 @@
 #include <openssl/bn.h>
 
 #include "APLCard.h"
+#include "APLCardPteid.h"
+#include "CardPteid.h"
+#include "Reader.h"
 #include "SecurityContext.h"
 #include "Log.h"
 #include "eidErrors.h"
@@ -38,11 +41,17 @@ namespace eIDMW {
 #define PRND2_SIZE 106
 #define SESSION_KEY_SIZE 16
 
+static const unsigned char ADDRESS_FILE_PATH[] = {0x3F, 0x00, 0x5F, 0x00, 0xEF, 0x05};
+
 SecurityContext::SecurityContext(APL_Card *card) {
 	m_card = card;
+	m_ssc = 0;
+	m_authenticated = false;
 	mutual_authentication = new MutualAuthentication(card);
 }
 
+SecurityContext::~SecurityContext() { delete mutual_authentication; }
+
 void SecurityContext::deriveSessionKeys() {
 	unsigned char sha1_digest[20];
 	unsigned char mac_key[SESSION_KEY_SIZE];
@@ -810,21 +819,98 @@ bool SecurityContext::verifySignedChallenge(CByteArray signed_challenge) {
 	bool resp = mutual_authentication->verifySignedChallenge(externalAuthInput);
 	resp = internalAuthenticate();
 
+	// Keys and SSC are kept for the lifetime of this object so that further reads reuse the same secure channel
+	m_authenticated = resp;
+	m_readFiles.clear();
+
 	return resp;
 }
 
+/*
+	The address file is cached under a name derived from the SOD address hash:
+	this must be computed before the secure channel is established because reading the SOD
+	may need plaintext APDUs
+*/
+std::string SecurityContext::getAddressCacheName() {
+	APL_EIDCard *eid_card = dynamic_cast<APL_EIDCard *>(m_card);
+	if (eid_card == NULL)
+		return "";
+
+	try {
+		const CByteArray &address_hash = eid_card->getFileSod()->getAddressHash();
+		if (address_hash.Size() == 0)
+			return "";
+
+		return "SMADDR_" + address_hash.ToString(false, true);
+	} catch (CMWException &e) {
+		MWLOG(LEV_WARN, MOD_APL, "SecurityContext: failed to get SOD address hash, address will not be cached. Error: %08x",
+			  e.GetError());
+		return "";
+	}
+}
+
+CByteArray SecurityContext::returnFileData(const CByteArray &fileContents, unsigned long bytesToRead) {
+	if (bytesToRead >= fileContents.Size())
+		return fileContents;
+
+	return fileContents.GetBytes(0, bytesToRead);
+}
+
 CByteArray SecurityContext::readFile(unsigned char *file, int filelen, unsigned long bytesToRead) {
+	std::string csPath = CByteArray(file, filelen).ToString(false, true);
+	bool isAddressFile =
+		filelen == sizeof(ADDRESS_FILE_PATH) && memcmp(file, ADDRESS_FILE_PATH, sizeof(ADDRESS_FILE_PATH)) == 0;
+
+	// Both caches stand for a read through an authenticated secure messaging session, which is what allows access
+	// to the file in the first place
+	bool useCache = m_authenticated;
+	std::map<std::string, CByteArray>::iterator it = useCache ? m_readFiles.find(csPath) : m_readFiles.end();
+	if (it != m_readFiles.end()) {
+		MWLOG(LEV_DEBUG, MOD_APL, "SecurityContext::readFile: file %s already read in this session", csPath.c_str());
+		return returnFileData(it->second, bytesToRead);
+	}
+
+	if (useCache && isAddressFile && !m_addressCacheName.empty()) {
+		bool bFound = false;
+		CByteArray cachedAddress = m_card->getCalReader()->GetCachedData(m_addressCacheName, bFound);
+		if (bFound) {
+			MWLOG(LEV_DEBUG, MOD_APL, "SecurityContext::readFile: address file read from cache");
+			m_readFiles[csPath] = cachedAddress;
+			return returnFileData(cachedAddress, bytesToRead);
+		}
+	}
+
 	unsigned int fileSize = 0;
-	for (int i = 0; i != filelen / 2; i++) {
-		CByteArray fileToSelect(file + i * 2, 2);
-		selectFile(fileToSelect, &fileSize);
+	CByteArray fileContents;
+	try {
+		for (int i = 0; i != filelen / 2; i++) {
+			CByteArray fileToSelect(file + i * 2, 2);
+			selectFile(fileToSelect, &fileSize);
+		}
+
+		MWLOG(LEV_DEBUG, MOD_APL, L"SecurityContext::readFile: parsed file length=%d", fileSize);
+		fileContents = readBinary(bytesToRead, fileSize);
+	} catch (CMWException &e) {
+		// A MAC failure or a card reset means that the session keys and SSC are no longer in sync with the card
+		if (e.GetError() == EIDMW_ERR_CVC_GENERIC_ERROR)
+			m_authenticated = false;
+		throw;
+	}
+
+	// Only complete files read after the authentication succeeded are kept
+	if (useCache && m_authenticated && bytesToRead >= fileSize) {
+		m_readFiles[csPath] = fileContents;
+		if (isAddressFile && !m_addressCacheName.empty())
+			m_card->getCalReader()->StoreCachedData(m_addressCacheName, fileContents);
 	}
 
-	MWLOG(LEV_DEBUG, MOD_APL, L"SecurityContext::readFile: parsed file length=%d", fileSize);
-	return readBinary(bytesToRead, fileSize);
+	return fileContents;
 }
 
 bool SecurityContext::verifyCVCCertificate(CByteArray ifd_cvc) {
+	m_authenticated = false;
+	m_addressCacheName = getAddressCacheName();
+
 	initMuthualAuthProcess();
 	m_ifd_cvc = ifd_cvc;
 
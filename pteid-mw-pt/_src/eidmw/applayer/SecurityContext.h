@@ -2,6 +2,8 @@
 #define __SECURITYCONTEXT_H__
 
 #include <cstdint>
+#include <map>
+#include <string>
 #include "ByteArray.h"
 #include "APLCard.h"
 #include "Export.h"
@@ -31,6 +33,10 @@ public:
 
 	EIDMW_APL_API bool writeFile(char *fileID, CByteArray file_content, unsigned int offset);
 
+	/* True while the secure channel established by verifySignedChallenge() can still be used */
+	EIDMW_APL_API bool isAuthenticated() const { return m_authenticated; }
+	EIDMW_APL_API APL_Card *getCard() const { return m_card; }
+
 private:
 	void initMuthualAuthProcess();
 	bool internalAuthenticate();
@@ -42,6 +48,8 @@ private:
 	CByteArray readBinary(unsigned long bytesToRead, unsigned int fileSize);
 
 	void computeInitialSSC();
+	std::string getAddressCacheName();
+	CByteArray returnFileData(const CByteArray &fileContents, unsigned long bytesToRead);
 
 	APL_Card *m_card;
 
@@ -67,6 +75,14 @@ private:
 
 	// Value extracted from ifd_cvc certificate
 	CByteArray m_snIFD;
+
+	bool m_authenticated;
+
+	// Name of the address file entry in the card cache, derived from the SOD address hash
+	std::string m_addressCacheName;
+
+	// Complete files already read in this secure session, indexed by path
+	std::map<std::string, CByteArray> m_readFiles;
 };
 
 } // namespace eIDMW
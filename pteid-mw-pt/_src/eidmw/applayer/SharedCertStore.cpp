@@ -0,0 +1,191 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#include "SharedCertStore.h"
+
+#include "MWException.h"
+#include "eidErrors.h"
+#include "Log.h"
+#include "Util.h"
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* Expired weak references are only swept once the maps grow past this many entries */
+#define SHARED_STORE_MIN_WATERMARK 64
+
+namespace eIDMW {
+
+APL_SharedCert::APL_SharedCert(const CByteArray &der, const CByteArray &hash) : m_data(der), m_hash(hash) {
+	const unsigned char *p = m_data.GetBytes();
+	m_x509 = d2i_X509(NULL, &p, m_data.Size());
+	m_uniqueId = m_x509 ? X509_issuer_and_serial_hash(m_x509) : 0;
+}
+
+APL_SharedCert::~APL_SharedCert() {
+	if (m_x509)
+		X509_free(m_x509);
+}
+
+unsigned long APL_SharedCert::getUniqueId() const {
+	if (m_x509 == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+
+	return m_uniqueId;
+}
+
+APL_SharedCrl::APL_SharedCrl(const CByteArray &der, const CByteArray &hash) : m_data(der), m_hash(hash) {
+	const unsigned char *p = m_data.GetBytes();
+	m_crl = d2i_X509_CRL(NULL, &p, m_data.Size());
+}
+
+APL_SharedCrl::~APL_SharedCrl() {
+	if (m_crl)
+		X509_CRL_free(m_crl);
+}
+
+APL_SharedCertStore::APL_SharedCertStore()
+	: m_certsWatermark(SHARED_STORE_MIN_WATERMARK), m_crlsWatermark(SHARED_STORE_MIN_WATERMARK), m_scanTarget(NULL) {}
+
+APL_SharedCertStore &APL_SharedCertStore::instance() {
+	static APL_SharedCertStore store;
+	return store;
+}
+
+bool APL_SharedCertStore::computeHash(const CByteArray &der, CByteArray &hash) {
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int md_len = 0;
+
+	if (EVP_Digest(der.GetBytes(), der.Size(), md, &md_len, EVP_sha256(), NULL) != 1)
+		return false;
+
+	hash = CByteArray(md, md_len);
+	return true;
+}
+
+template <typename T>
+std::shared_ptr<T> APL_SharedCertStore::lookup(std::unordered_map<std::string, std::weak_ptr<T>> &entries,
+											   size_t &watermark, const CByteArray &der) {
+	CByteArray hash;
+	if (!computeHash(der, hash))
+		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+
+	std::string key((const char *)hash.GetBytes(), hash.Size());
+
+	CAutoMutex autoMutex(&m_mutex);
+
+	auto it = entries.find(key);
+	if (it != entries.end()) {
+		std::shared_ptr<T> existing = it->second.lock();
+		if (existing)
+			return existing;
+	}
+
+	std::shared_ptr<T> entry = std::make_shared<T>(der, hash);
+	entries[key] = entry;
+
+	if (entries.size() > watermark) {
+		for (auto sweep = entries.begin(); sweep != entries.end();) {
+			if (sweep->second.expired())
+				sweep = entries.erase(sweep);
+			else
+				++sweep;
+		}
+		watermark = std::max<size_t>(SHARED_STORE_MIN_WATERMARK, entries.size() * 2);
+	}
+
+	return entry;
+}
+
+tSharedCert APL_SharedCertStore::getCertificate(const CByteArray &der) {
+	return lookup(m_certs, m_certsWatermark, der);
+}
+
+tSharedCrl APL_SharedCertStore::getCrl(const CByteArray &der) { return lookup(m_crls, m_crlsWatermark, der); }
+
+std::vector<tSharedCert> APL_SharedCertStore::getDirectoryCertificates(const std::string &dir, const char *subDir,
+																		const char *ext) {
+	struct stat buffer;
+	time_t mtime = 0;
+	if (stat(dir.c_str(), &buffer) == 0)
+		mtime = buffer.st_mtime;
+
+	std::string key = dir + '|' + ext;
+
+	CAutoMutex autoMutex(&m_mutex);
+
+	auto it = m_directories.find(key);
+	if (it != m_directories.end() && it->second.mtime == mtime)
+		return it->second.certs;
+
+	tDirectoryEntry &entry = m_directories[key];
+	entry.mtime = mtime;
+	entry.certs.clear();
+
+	bool bStopRequest = false;
+	m_scanTarget = &entry.certs;
+	scanDir(dir.c_str(), subDir, ext, bStopRequest, this, &APL_SharedCertStore::foundCertificate);
+	m_scanTarget = NULL;
+
+	MWLOG(LEV_DEBUG, MOD_APL, "APL_SharedCertStore: loaded %lu certificates from %s",
+		  (unsigned long)entry.certs.size(), dir.c_str());
+
+	return entry.certs;
+}
+
+void APL_SharedCertStore::foundCertificate(const char *dir, const char *subDir, const char *file, void *param) {
+	APL_SharedCertStore *store = static_cast<APL_SharedCertStore *>(param);
+	std::string path = dir;
+	FILE *stream = NULL;
+	long size;
+
+#ifdef WIN32
+	path += "\\"; // Quick Fix for a messy situation with the certificates subdir
+#endif
+	path += subDir;
+#ifdef WIN32
+	path += (strlen(subDir) != 0 ? "\\" : "");
+#else
+	path += (strlen(subDir) != 0 ? "/" : "");
+#endif
+	path += file;
+
+	if (fopen_s(&stream, path.c_str(), "rb") != 0 || stream == NULL)
+		goto err;
+
+	if (fseek(stream, 0L, SEEK_END) || (size = ftell(stream)) <= 0 || fseek(stream, 0L, SEEK_SET))
+		goto err;
+
+	{
+		std::vector<unsigned char> buf(size);
+		if (fread(buf.data(), 1, size, stream) != (size_t)size)
+			goto err;
+		fclose(stream);
+
+		tSharedCert cert = store->getCertificate(CByteArray(buf.data(), size));
+		if (cert->getX509() == NULL) {
+			MWLOG(LEV_DEBUG, MOD_APL, "APL_SharedCertStore: ignoring invalid certificate %s", path.c_str());
+			return;
+		}
+		store->m_scanTarget->push_back(cert);
+		return;
+	}
+
+err:
+	if (stream)
+		fclose(stream);
+
+	MWLOG(LEV_DEBUG, MOD_APL, L"APL_SharedCertStore::foundCertificate: problem with file %ls ",
+		  utilStringWiden(path).c_str());
+}
+
+} // namespace eIDMW
@@ -0,0 +1,125 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#ifndef __SHARED_CERT_STORE_H__
+#define __SHARED_CERT_STORE_H__
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <map>
+
+#include <openssl/x509.h>
+
+#include "ByteArray.h"
+#include "Mutex.h"
+
+namespace eIDMW {
+
+/*
+ * Immutable certificate shared by every user of the same DER encoding.
+ * The X509 object is decoded once, when the entry is created, and freed with the last reference.
+ */
+class APL_SharedCert {
+public:
+	APL_SharedCert(const CByteArray &der, const CByteArray &hash);
+	~APL_SharedCert();
+
+	const CByteArray &getData() const { return m_data; }
+
+	/* SHA-256 of the DER encoding */
+	const CByteArray &getHash() const { return m_hash; }
+
+	/* Decoded certificate, NULL if the DER could not be parsed. Owned by this object */
+	X509 *getX509() const { return m_x509; }
+
+	/* Hash of issuer and serial number as returned by APL_CryptoFwk::GetCertUniqueID() */
+	unsigned long getUniqueId() const;
+
+private:
+	APL_SharedCert(const APL_SharedCert &);
+	APL_SharedCert &operator=(const APL_SharedCert &);
+
+	CByteArray m_data;
+	CByteArray m_hash;
+	X509 *m_x509;
+	unsigned long m_uniqueId;
+};
+
+/* Same as APL_SharedCert for CRLs */
+class APL_SharedCrl {
+public:
+	APL_SharedCrl(const CByteArray &der, const CByteArray &hash);
+	~APL_SharedCrl();
+
+	const CByteArray &getData() const { return m_data; }
+	const CByteArray &getHash() const { return m_hash; }
+
+	/* Decoded CRL, NULL if the DER could not be parsed. Owned by this object */
+	X509_CRL *getX509Crl() const { return m_crl; }
+
+private:
+	APL_SharedCrl(const APL_SharedCrl &);
+	APL_SharedCrl &operator=(const APL_SharedCrl &);
+
+	CByteArray m_data;
+	CByteArray m_hash;
+	X509_CRL *m_crl;
+};
+
+typedef std::shared_ptr<APL_SharedCert> tSharedCert;
+typedef std::shared_ptr<APL_SharedCrl> tSharedCrl;
+
+/*
+ * Process-wide content-addressed store of certificates and CRLs.
+ *
+ * Entries are keyed by the SHA-256 of their DER encoding and reference counted: the store only keeps
+ * weak references so an entry lives as long as some APL_Certifs, CRL cache or signature still uses it.
+ * The certificate directories are the exception: their contents are kept alive and only read again
+ * from disk when the directory modification time changes.
+ */
+class APL_SharedCertStore {
+public:
+	static APL_SharedCertStore &instance();
+
+	tSharedCert getCertificate(const CByteArray &der);
+	tSharedCrl getCrl(const CByteArray &der);
+
+	/* Certificates found by scanDir() in dir with the given extension */
+	std::vector<tSharedCert> getDirectoryCertificates(const std::string &dir, const char *subDir, const char *ext);
+
+private:
+	struct tDirectoryEntry {
+		time_t mtime;
+		std::vector<tSharedCert> certs;
+	};
+
+	APL_SharedCertStore();
+	APL_SharedCertStore(const APL_SharedCertStore &);
+	APL_SharedCertStore &operator=(const APL_SharedCertStore &);
+
+	static void foundCertificate(const char *dir, const char *subDir, const char *file, void *param);
+	static bool computeHash(const CByteArray &der, CByteArray &hash);
+
+	template <typename T>
+	std::shared_ptr<T> lookup(std::unordered_map<std::string, std::weak_ptr<T>> &entries, size_t &watermark,
+							  const CByteArray &der);
+
+	std::unordered_map<std::string, std::weak_ptr<APL_SharedCert>> m_certs;
+	std::unordered_map<std::string, std::weak_ptr<APL_SharedCrl>> m_crls;
+	size_t m_certsWatermark;
+	size_t m_crlsWatermark;
+
+	std::map<std::string, tDirectoryEntry> m_directories;
+	std::vector<tSharedCert> *m_scanTarget; // Only valid inside getDirectoryCertificates()
+
+	CMutex m_mutex;
+};
+
+} // namespace eIDMW
+
+#endif // __SHARED_CERT_STORE_H__
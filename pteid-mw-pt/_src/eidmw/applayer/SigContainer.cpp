@@ -24,6 +24,7 @@
 #include "MiscUtil.h"
 #include "Util.h"
 #include "XercesUtils.h"
+#include "ZipAppender.h"
 
 #ifdef WIN32
 #define NL "\r\n"
@@ -37,6 +38,10 @@ static const char *SIG_INTERNAL_PATH = "META-INF/signatures001.xml";
 static const char *MIMETYPE_ASIC_S = "application/vnd.etsi.asic-s+zip";
 static const char *MIMETYPE_ASIC_E = "application/vnd.etsi.asic-e+zip";
 
+/* Input files from this size on are stored uncompressed: deflating them would take much longer than signing and
+   the documents that get this big (scans, videos, archives) are usually compressed already */
+#define ASIC_STORE_MIN_SIZE (64 * 1024 * 1024)
+
 static const char *README =
 	"############################################################" NL "LEIA-ME" NL "" NL
 	"Este ficheiro zip contém informação assinada com a(s) respectiva(s) assinatura(s) em META-INF/signatures*.xml" NL
@@ -232,6 +237,8 @@ void SigContainer::createASiC(CByteArray &sig, const char **paths, unsigned int
 	int status;
 	zip_int64_t file_index;
 	zip_t *asic = NULL;
+	// A recovery file left for the replaced container would otherwise be applied to the new one
+	ZipAppender::recoverIfNeeded(output_file);
 	if ((asic = zip_open(output_file, ZIP_CREATE | ZIP_TRUNCATE, &status)) == NULL) {
 		zip_error_t error;
 		zip_error_init_with_code(&error, status);
@@ -269,6 +276,13 @@ void SigContainer::createASiC(CByteArray &sig, const char **paths, unsigned int
 			throw CMWEXCEPTION(EIDMW_XADES_UNKNOWN_ERROR);
 		}
 		addEntryExtendedTimestamp(asic, file_index, paths[i]);
+
+		zip_stat_t file_stat;
+		zip_stat_init(&file_stat);
+		if (zip_stat_index(asic, file_index, 0, &file_stat) == 0 && (file_stat.valid & ZIP_STAT_SIZE) &&
+			file_stat.size >= ASIC_STORE_MIN_SIZE && zip_set_file_compression(asic, file_index, ZIP_CM_STORE, 0) < 0) {
+			MWLOG(LEV_WARN, MOD_APL, "Failed to set store compression method for %s", zip_entry_name);
+		}
 	}
 
 	// add signature file
@@ -325,6 +339,7 @@ static bool check_mimetype(zip_t *container) {
 
 static bool isASiC(const char *path, bool write_mode, zip_t **out_container) {
 	int status;
+	ZipAppender::recoverIfNeeded(path);
 	if ((*out_container = zip_open(path, write_mode ? 0 : ZIP_RDONLY, &status)) == NULL) {
 		zip_error_t error;
 		zip_error_init_with_code(&error, status);
@@ -431,35 +446,43 @@ void SigContainer::extract(const char *filename, const char *out_dir) {
 	zip_close(container);
 }
 
-const char *SigContainer::getNextSignatureFileName() {
-	zip_t *container;
-	if (!isASiC(m_path.c_str(), false, &container) || container == NULL) {
+/* First free name of the form META-INF/signatures002.xml, META-INF/signatures003.xml, ... */
+template <typename Exists> static std::string nextSignatureFileName(Exists exists) {
+	const size_t LENGTH = 35;
+	char path[LENGTH];
+	unsigned int count = 1;
+	do {
+		snprintf(path, LENGTH, "META-INF/signatures%03d.xml", count++);
+	} while (exists(path));
+
+	return path;
+}
+
+/*
+ * The signature is appended after the entries of the container, rewriting only its central directory: co-signing
+ * a large container would otherwise copy all of it to a temporary file. Its name is chosen while the appender holds
+ * the lock on the container, so concurrent co-signers don't pick the same one
+ */
+void SigContainer::addSignature(const CByteArray &signature) {
+	if (!isValidASiC(m_path.c_str())) {
 		MWLOG(LEV_ERROR, MOD_APL,
-			  "SigContainer::getNextSignatureFileName() %s,"
+			  "SigContainer::addSignature(): %s"
 			  " is not an ASiC container",
 			  m_path.c_str());
 		throw CMWEXCEPTION(EIDMW_XADES_INVALID_ASIC_ERROR);
 	}
 
-	unsigned int count = 1;
-	const size_t LENGTH = 35;
-	const char *format = "META-INF/signatures%03d.xml";
-	char *path = (char *)calloc(LENGTH, sizeof(char));
-	do {
-		snprintf(path, LENGTH, format, count++);
-	} while (zip_name_locate(container, path, 0) != -1);
-
-	if (zip_close(container) < 0) {
-		MWLOG(LEV_ERROR, MOD_APL, "zip_close() failed with error msg: %s",
-			  zip_error_strerror(zip_get_error(container)));
-		free(container);
-		throw CMWEXCEPTION(EIDMW_XADES_UNKNOWN_ERROR);
+	ZipAppender appender;
+	if (appender.open(m_path.c_str())) {
+		std::string signatureFilename =
+			nextSignatureFileName([&appender](const char *name) { return appender.hasEntry(name); });
+		// signature contains a NULL-terminated string
+		appender.addEntry(signatureFilename.c_str(), signature.GetBytes(), signature.Size() - 1);
+		appender.commit();
+		return;
 	}
 
-	return path;
-}
-
-void SigContainer::addSignature(const char *signatureFilename, const CByteArray &signature) {
+	MWLOG(LEV_DEBUG, MOD_APL, "SigContainer::addSignature(): rewriting %s with libzip", m_path.c_str());
 	zip_t *container;
 	if (!isASiC(m_path.c_str(), true, &container) || container == NULL) {
 		MWLOG(LEV_ERROR, MOD_APL,
@@ -468,9 +491,11 @@ void SigContainer::addSignature(const char *signatureFilename, const CByteArray
 			  m_path.c_str());
 		throw CMWEXCEPTION(EIDMW_XADES_INVALID_ASIC_ERROR);
 	}
+	std::string signatureFilename =
+		nextSignatureFileName([container](const char *name) { return zip_name_locate(container, name, 0) != -1; });
 	// signature contains a NULL-terminated string
 	zip_source_t *source = zip_source_buffer(container, signature.GetBytes(), signature.Size() - 1, 0);
-	if (source == NULL || zip_file_add(container, signatureFilename, source, ZIP_FL_ENC_GUESS) < 0) {
+	if (source == NULL || zip_file_add(container, signatureFilename.c_str(), source, ZIP_FL_ENC_GUESS) < 0) {
 		zip_source_free(source);
 		MWLOG(LEV_ERROR, MOD_APL, L"Failed to add signature to zip container");
 		throw CMWEXCEPTION(EIDMW_XADES_UNKNOWN_ERROR);
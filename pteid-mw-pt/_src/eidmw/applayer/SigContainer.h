@@ -43,12 +43,10 @@ public:
 	EIDMW_APL_API static bool isValidASiC(const char *filename);
 
 	/*
-	 * Return the filename of an eventual new signature xml file for this container
+	 * Add the signature xml file to this container with the next free filename
 	 * ex: signatures002.xml, signatures003.xml
 	 */
-	const char *getNextSignatureFileName();
-
-	void addSignature(const char *signatureFilename, const CByteArray &signature);
+	void addSignature(const CByteArray &signature);
 
 private:
 	std::string m_path;
@@ -0,0 +1,838 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#include "SignatureVerifier.h"
+
+#include "APLCertif.h"
+#include "APLCard.h"
+#include "cryptoFwkPteid.h"
+#include "PDFSignature.h"
+#include "SigContainer.h"
+#include "XadesSignature.h"
+#include "MiscUtil.h"
+#include "MWException.h"
+#include "eidErrors.h"
+#include "Thread.h"
+#include "Log.h"
+#include "Util.h"
+
+#include "poppler/PDFDoc.h"
+#include "poppler/Stream.h"
+#include "poppler/XRef.h"
+
+#include <openssl/cms.h>
+#include <openssl/evp.h>
+#include <openssl/ts.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace eIDMW {
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+class SignatureVerifyWorker : public CThread {
+public:
+	SignatureVerifyWorker(SignatureVerifier *verifier) : m_verifier(verifier) {}
+
+	void Run() {
+		size_t index;
+		while (m_verifier->nextDocument(index))
+			m_verifier->verifyDocument(index);
+	}
+
+private:
+	SignatureVerifier *m_verifier;
+};
+
+static std::string asn1TimeToString(const ASN1_TIME *time) {
+	struct tm tm_time;
+	if (time == NULL || ASN1_TIME_to_tm(time, &tm_time) != 1)
+		return std::string();
+
+	char buffer[32];
+	strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm_time);
+	return buffer;
+}
+
+static std::string getCommonName(X509 *cert) {
+	char cn[256] = {0};
+	if (X509_NAME_get_text_by_NID(X509_get_subject_name(cert), NID_commonName, cn, sizeof(cn)) < 0)
+		return std::string();
+	return cn;
+}
+
+static CByteArray x509ToDer(X509 *cert) {
+	unsigned char *der = NULL;
+	int len = i2d_X509(cert, &der);
+	if (len <= 0)
+		return CByteArray();
+
+	CByteArray data(der, len);
+	OPENSSL_free(der);
+	return data;
+}
+
+/* Hash the two intervals of a PDF ByteRange reading the file in fixed size chunks */
+static bool hashByteRange(FILE *fp, const int byteRange[4], const EVP_MD *md, CByteArray &hash) {
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+	EVP_DigestInit_ex(mdctx, md, NULL);
+
+	const size_t BUFSIZE = 64 * 1024;
+	std::vector<unsigned char> buffer(BUFSIZE);
+	bool ok = true;
+	for (int i = 0; i < 4 && ok; i += 2) {
+		if (fseek(fp, byteRange[i], SEEK_SET) != 0) {
+			ok = false;
+			break;
+		}
+
+		size_t remaining = (size_t)byteRange[i + 1];
+		while (remaining > 0) {
+			size_t read = fread(&buffer[0], 1, std::min(BUFSIZE, remaining), fp);
+			if (read == 0) {
+				ok = false;
+				break;
+			}
+			EVP_DigestUpdate(mdctx, &buffer[0], read);
+			remaining -= read;
+		}
+	}
+
+	unsigned char md_value[EVP_MAX_MD_SIZE];
+	unsigned int md_len = 0;
+	EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+	EVP_MD_CTX_free(mdctx);
+
+	if (ok)
+		hash = CByteArray(md_value, md_len);
+	return ok;
+}
+
+static bool asn1TimeToTime(const ASN1_TIME *asn1Time, time_t &result) {
+	int days = 0, secs = 0;
+	if (asn1Time == NULL || ASN1_TIME_diff(&days, &secs, NULL, asn1Time) != 1)
+		return false;
+
+	result = time(NULL) + (time_t)days * 24 * 3600 + secs;
+	return true;
+}
+
+static X509 *derToX509(const CByteArray &der) {
+	const unsigned char *p = der.GetBytes();
+	return d2i_X509(NULL, &p, der.Size());
+}
+
+static int hexValue(unsigned char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* The ByteRange must cover the whole revision of the signature except its /Contents: it starts at offset 0, the
+   gap between the two intervals is exactly the hex string of contents and the second interval ends right after
+   the %%EOF marker of the revision */
+static bool checkByteRangeCoverage(FILE *fp, const int byteRange[4], const unsigned char *contents, int length) {
+	if (byteRange[0] != 0 || byteRange[1] <= 0 || byteRange[3] < 0 ||
+		(long long)byteRange[2] - byteRange[1] != 2LL * length + 2)
+		return false;
+
+	std::vector<unsigned char> gap((size_t)(byteRange[2] - byteRange[1]));
+	if (fseek(fp, byteRange[1], SEEK_SET) != 0 || fread(&gap[0], 1, gap.size(), fp) != gap.size())
+		return false;
+	if (gap.front() != '<' || gap.back() != '>')
+		return false;
+	for (int i = 0; i < length; i++) {
+		int high = hexValue(gap[1 + 2 * i]);
+		int low = hexValue(gap[2 + 2 * i]);
+		if (high < 0 || low < 0 || ((high << 4) | low) != contents[i])
+			return false;
+	}
+
+	// "%%EOF" optionally followed by an end-of-line
+	long long end = (long long)byteRange[2] + byteRange[3];
+	unsigned char tail[7];
+	size_t tailLen = (size_t)std::min<long long>(end, sizeof(tail));
+	if (fseek(fp, (long)(end - tailLen), SEEK_SET) != 0 || fread(tail, 1, tailLen, fp) != tailLen)
+		return false;
+	if (tailLen > 0 && tail[tailLen - 1] == '\n')
+		tailLen--;
+	if (tailLen > 0 && tail[tailLen - 1] == '\r')
+		tailLen--;
+	return tailLen >= 5 && memcmp(tail + tailLen - 5, "%%EOF", 5) == 0;
+}
+
+/* Compare two objects without following their references */
+static bool objectsEqual(Object *a, Object *b) {
+	if (a->getType() != b->getType())
+		return false;
+
+	bool equal = true;
+	Object itemA, itemB;
+	switch (a->getType()) {
+	case objBool:
+		return a->getBool() == b->getBool();
+	case objInt:
+		return a->getInt() == b->getInt();
+	case objReal:
+		return a->getReal() == b->getReal();
+	case objString:
+		return a->getString()->cmp(b->getString()) == 0;
+	case objName:
+		return strcmp(a->getName(), b->getName()) == 0;
+	case objNull:
+		return true;
+	case objRef:
+		return a->getRefNum() == b->getRefNum() && a->getRefGen() == b->getRefGen();
+	case objArray:
+		if (a->arrayGetLength() != b->arrayGetLength())
+			return false;
+		for (int i = 0; i < a->arrayGetLength() && equal; i++) {
+			equal = objectsEqual(a->arrayGetNF(i, &itemA), b->arrayGetNF(i, &itemB));
+			itemA.free();
+			itemB.free();
+		}
+		return equal;
+	case objDict:
+		if (a->dictGetLength() != b->dictGetLength())
+			return false;
+		for (int i = 0; i < a->dictGetLength() && equal; i++) {
+			equal = objectsEqual(a->dictGetValNF(i, &itemA), b->dictLookupNF(a->dictGetKey(i), &itemB));
+			itemA.free();
+			itemB.free();
+		}
+		return equal;
+	default:
+		// Streams are only compared by reference
+		return false;
+	}
+}
+
+static bool isXRefEntryInUse(XRefEntry *entry) {
+	return entry->type == xrefEntryUncompressed || entry->type == xrefEntryCompressed;
+}
+
+/* The catalog of the update may only add or replace its /DSS entry */
+static bool isCatalogDSSUpdate(Object *catalog, Object *signedCatalog) {
+	if (!catalog->isDict() || !signedCatalog->isDict())
+		return false;
+
+	int keys = 0;
+	bool equal = true;
+	for (int i = 0; i < catalog->dictGetLength() && equal; i++) {
+		if (strcmp(catalog->dictGetKey(i), "DSS") == 0)
+			continue;
+		keys++;
+		Object value, signedValue;
+		equal = objectsEqual(catalog->dictGetValNF(i, &value), signedCatalog->dictLookupNF(catalog->dictGetKey(i),
+																							&signedValue));
+		value.free();
+		signedValue.free();
+	}
+
+	Object signedDSS;
+	int signedKeys = signedCatalog->dictGetLength();
+	if (!signedCatalog->dictLookupNF("DSS", &signedDSS)->isNull())
+		signedKeys--;
+	signedDSS.free();
+
+	return equal && keys == signedKeys;
+}
+
+/* The incremental updates after the last signature, which ends at signedEnd, may only add validation data (PAdES-LT):
+   new objects, and a catalog that only adds its /DSS entry, so that the new objects are only reachable from the DSS.
+   The document info dictionary may also be updated. Anything else isn't covered by any signature */
+static bool isValidationDataUpdate(PDFDoc *doc, FILE *fp, long long signedEnd) {
+	int c;
+	if (fseek(fp, (long)signedEnd, SEEK_SET) != 0)
+		return false;
+	while ((c = fgetc(fp)) != EOF && isspace(c))
+		;
+	if (c == EOF)
+		return true;
+
+	// The revision covered by the last signature, read as a document of its own
+	Object streamDict;
+	streamDict.initNull();
+	PDFDoc signedDoc(new FileStream(fp, 0, gTrue, (Guint)signedEnd, &streamDict));
+	if (!signedDoc.isOk())
+		return false;
+
+	XRef *xref = doc->getXRef();
+	XRef *signedXRef = signedDoc.getXRef();
+	if (xref->getRootNum() != signedXRef->getRootNum() || xref->getRootGen() != signedXRef->getRootGen())
+		return false;
+
+	Object info;
+	int infoNum = xref->getTrailerDict()->dictLookupNF("Info", &info)->isRef() ? info.getRefNum() : -1;
+	info.free();
+
+	for (int i = 0; i < xref->getNumObjects(); i++) {
+		XRefEntry *entry = xref->getEntry(i, gFalse);
+		XRefEntry *signedEntry = i < signedXRef->getNumObjects() ? signedXRef->getEntry(i, gFalse) : NULL;
+		bool existed = signedEntry != NULL && isXRefEntryInUse(signedEntry);
+
+		bool changed = !existed || !isXRefEntryInUse(entry) || entry->type != signedEntry->type ||
+					   entry->offset != signedEntry->offset || entry->gen != signedEntry->gen;
+		// An object in an object stream changes with its stream
+		if (!changed && entry->type == xrefEntryCompressed) {
+			int streamNum = (int)entry->offset;
+			changed = streamNum >= signedXRef->getNumObjects() ||
+					  xref->getEntry(streamNum, gFalse)->offset != signedXRef->getEntry(streamNum, gFalse)->offset;
+		}
+
+		if (!changed || i == infoNum)
+			continue;
+		if (!existed) {
+			// A new object, the only unchanged object that can reference it is the catalog through /DSS
+			continue;
+		}
+		if (i != xref->getRootNum()) {
+			MWLOG(LEV_WARN, MOD_APL, "SignatureVerifier: object %d changed after the last signature", i);
+			return false;
+		}
+
+		Object catalog, signedCatalog;
+		bool ok = isCatalogDSSUpdate(xref->fetch(i, entry->gen, &catalog),
+									 signedXRef->fetch(i, signedEntry->gen, &signedCatalog));
+		catalog.free();
+		signedCatalog.free();
+		if (!ok) {
+			MWLOG(LEV_WARN, MOD_APL, "SignatureVerifier: catalog changed after the last signature");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool digestMatches(const ASN1_OCTET_STRING *expected, const CByteArray &hash) {
+	return expected != NULL && (unsigned long)ASN1_STRING_length(expected) == hash.Size() &&
+		   memcmp(ASN1_STRING_get0_data(expected), hash.GetBytes(), hash.Size()) == 0;
+}
+
+/* Verify the signature timestamp of si (its timeStampToken unsigned attribute): the message imprint must be the hash
+   of the signature value and the TSA signature must match. The chain of tsaCert is left to the caller */
+static bool verifySignatureTimestamp(CMS_SignerInfo *si, time_t &genTime, CByteArray &tsaCert,
+									 std::vector<CByteArray> &tsaCertificates) {
+	int attrIdx = CMS_unsigned_get_attr_by_NID(si, NID_id_smime_aa_timeStampToken, -1);
+	if (attrIdx < 0)
+		return false;
+
+	ASN1_TYPE *token = X509_ATTRIBUTE_get0_type(CMS_unsigned_get_attr(si, attrIdx), 0);
+	if (token == NULL || token->type != V_ASN1_SEQUENCE)
+		return false;
+
+	const unsigned char *p = ASN1_STRING_get0_data(token->value.sequence);
+	CMS_ContentInfo *cms = d2i_CMS_ContentInfo(NULL, &p, ASN1_STRING_length(token->value.sequence));
+	STACK_OF(CMS_SignerInfo) *signers = cms ? CMS_get0_SignerInfos(cms) : NULL;
+	ASN1_OCTET_STRING **content = cms ? CMS_get0_content(cms) : NULL;
+	TS_TST_INFO *tstInfo = NULL;
+	if (content && *content && OBJ_obj2nid(CMS_get0_eContentType(cms)) == NID_id_smime_ct_TSTInfo) {
+		const unsigned char *tstData = ASN1_STRING_get0_data(*content);
+		tstInfo = d2i_TS_TST_INFO(NULL, &tstData, ASN1_STRING_length(*content));
+	}
+
+	bool ok = false;
+	if (tstInfo && signers && sk_CMS_SignerInfo_num(signers) == 1) {
+		CMS_SignerInfo *tsaSi = sk_CMS_SignerInfo_value(signers, 0);
+		CMS_set1_signers_certs(cms, NULL, 0);
+		X509 *tsa = NULL;
+		X509_ALGOR *digestAlg = NULL;
+		CMS_SignerInfo_get0_algs(tsaSi, NULL, &tsa, &digestAlg, NULL);
+		const ASN1_OBJECT *digestObj = NULL;
+		X509_ALGOR_get0(&digestObj, NULL, NULL, digestAlg);
+		const EVP_MD *md = digestObj ? EVP_get_digestbyobj(digestObj) : NULL;
+
+		TS_MSG_IMPRINT *imprint = TS_TST_INFO_get_msg_imprint(tstInfo);
+		const ASN1_OBJECT *imprintObj = NULL;
+		X509_ALGOR_get0(&imprintObj, NULL, NULL, TS_MSG_IMPRINT_get_algo(imprint));
+		const EVP_MD *imprintMd = imprintObj ? EVP_get_digestbyobj(imprintObj) : NULL;
+
+		ASN1_OCTET_STRING *signatureValue = CMS_SignerInfo_get0_signature(si);
+		ASN1_OCTET_STRING *messageDigest = (ASN1_OCTET_STRING *)CMS_signed_get0_data_by_OBJ(
+			tsaSi, OBJ_nid2obj(NID_pkcs9_messageDigest), -3, V_ASN1_OCTET_STRING);
+		unsigned char hash[EVP_MAX_MD_SIZE];
+		unsigned int hashLen = 0;
+
+		ok = tsa != NULL && md != NULL && imprintMd != NULL &&
+			 EVP_Digest(ASN1_STRING_get0_data(signatureValue), ASN1_STRING_length(signatureValue), hash, &hashLen,
+						imprintMd, NULL) &&
+			 digestMatches(TS_MSG_IMPRINT_get_msg(imprint), CByteArray(hash, hashLen)) &&
+			 EVP_Digest(ASN1_STRING_get0_data(*content), ASN1_STRING_length(*content), hash, &hashLen, md, NULL) &&
+			 digestMatches(messageDigest, CByteArray(hash, hashLen)) && CMS_SignerInfo_verify(tsaSi) == 1 &&
+			 asn1TimeToTime(TS_TST_INFO_get_time(tstInfo), genTime);
+
+		if (ok) {
+			tsaCert = x509ToDer(tsa);
+			STACK_OF(X509) *certs = CMS_get1_certs(cms);
+			for (int i = 0; certs && i < sk_X509_num(certs); i++)
+				tsaCertificates.push_back(x509ToDer(sk_X509_value(certs, i)));
+			sk_X509_pop_free(certs, X509_free);
+		}
+	}
+
+	if (!ok)
+		MWLOG(LEV_WARN, MOD_APL, "SignatureVerifier: ignoring a signature timestamp that doesn't verify");
+
+	TS_TST_INFO_free(tstInfo);
+	CMS_ContentInfo_free(cms);
+	return ok;
+}
+
+SignatureVerifier::SignatureVerifier(bool checkRevocation, unsigned int workers)
+	: m_checkRevocation(checkRevocation), m_workers(workers > 0 ? workers : 1), m_nextDocument(0),
+	  m_elapsedSeconds(0) {}
+
+void SignatureVerifier::addFile(const char *path) { m_inputFiles.push_back(path); }
+
+size_t SignatureVerifier::addDirectory(const char *dir) {
+	size_t count = m_inputFiles.size();
+	bool bStopRequest = false;
+
+	scanDir(dir, "", "", bStopRequest, this, &SignatureVerifier::foundFile);
+
+	return m_inputFiles.size() - count;
+}
+
+void SignatureVerifier::foundFile(const char *dir, const char * /*subDir*/, const char *file, void *param) {
+	SignatureVerifier *verifier = static_cast<SignatureVerifier *>(param);
+
+	std::string name = file;
+	size_t dot = name.rfind('.');
+	std::string ext = dot != std::string::npos ? name.substr(dot) : "";
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	if (ext != ".pdf" && ext != ".asice" && ext != ".sce")
+		return;
+
+	std::string path = dir;
+#ifdef WIN32
+	path += "\\";
+#else
+	path += "/";
+#endif
+	path += name;
+	verifier->m_inputFiles.push_back(path);
+}
+
+void SignatureVerifier::verifyPDF(DocumentVerifyReport &report, std::vector<tPdfSignatureInfo> &infos) {
+	Clock::time_point start = Clock::now();
+
+	std::unique_ptr<PDFDoc> doc(makePDFDoc(report.path.c_str()));
+	if (!doc->isOk()) {
+		MWLOG(LEV_ERROR, MOD_APL, "SignatureVerifier: failed to load PDF %s", report.path.c_str());
+		throw CMWEXCEPTION(EIDMW_PDF_INVALID_ERROR);
+	}
+
+#ifdef WIN32
+	FILE *fp = _wfopen(utilStringWiden(report.path).c_str(), L"rb");
+#else
+	FILE *fp = fopen(report.path.c_str(), "rb");
+#endif
+	if (fp == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_FILE_IO_ERROR);
+
+	int fieldCount = doc->getNumFields();
+	report.parseMs += elapsedMs(start);
+
+	for (int idx = 0; idx < fieldCount; idx++) {
+		start = Clock::now();
+
+		// getSignatureByteRange() also skips the fields that are not signed signature fields
+		int byteRange[4];
+		if (!doc->getSignatureByteRange(idx, byteRange))
+			continue;
+
+		unsigned char *contents = NULL;
+		int length = doc->getSignatureContents(&contents, idx);
+		if (length <= 0)
+			continue;
+
+		bool byteRangeOk = checkByteRangeCoverage(fp, byteRange, contents, length);
+		if (!byteRangeOk)
+			MWLOG(LEV_ERROR, MOD_APL, "SignatureVerifier: ByteRange of signature %d in %s doesn't cover its revision",
+				  idx, report.path.c_str());
+
+		const unsigned char *p = contents;
+		CMS_ContentInfo *cms = d2i_CMS_ContentInfo(NULL, &p, length);
+		free(contents);
+
+		report.signatures.push_back(SignatureVerifyResult());
+		SignatureVerifyResult &result = report.signatures.back();
+		infos.push_back(tPdfSignatureInfo());
+		tPdfSignatureInfo &info = infos.back();
+		info.signedEnd = (long long)byteRange[2] + byteRange[3];
+		info.gapStart = byteRange[1];
+
+		STACK_OF(CMS_SignerInfo) *signers = cms ? CMS_get0_SignerInfos(cms) : NULL;
+		if (signers == NULL || sk_CMS_SignerInfo_num(signers) != 1) {
+			MWLOG(LEV_ERROR, MOD_APL, "SignatureVerifier: malformed signature %d in %s", idx, report.path.c_str());
+			CMS_ContentInfo_free(cms);
+			report.parseMs += elapsedMs(start);
+			continue;
+		}
+
+		CMS_set1_signers_certs(cms, NULL, 0);
+		STACK_OF(X509) *certs = CMS_get1_certs(cms);
+		for (int i = 0; certs && i < sk_X509_num(certs); i++)
+			result.certificates.push_back(x509ToDer(sk_X509_value(certs, i)));
+		sk_X509_pop_free(certs, X509_free);
+
+		CMS_SignerInfo *si = sk_CMS_SignerInfo_value(signers, 0);
+		X509 *signer = NULL;
+		X509_ALGOR *digestAlg = NULL;
+		CMS_SignerInfo_get0_algs(si, NULL, &signer, &digestAlg, NULL);
+
+		const ASN1_OBJECT *digestObj = NULL;
+		X509_ALGOR_get0(&digestObj, NULL, NULL, digestAlg);
+		const EVP_MD *md = digestObj ? EVP_get_digestbyobj(digestObj) : NULL;
+
+		ASN1_OCTET_STRING *messageDigest = (ASN1_OCTET_STRING *)CMS_signed_get0_data_by_OBJ(
+			si, OBJ_nid2obj(NID_pkcs9_messageDigest), -3, V_ASN1_OCTET_STRING);
+		if (signer == NULL || md == NULL || messageDigest == NULL) {
+			MWLOG(LEV_ERROR, MOD_APL, "SignatureVerifier: unsupported signature %d in %s", idx, report.path.c_str());
+			CMS_ContentInfo_free(cms);
+			report.parseMs += elapsedMs(start);
+			continue;
+		}
+
+		result.signerCert = x509ToDer(signer);
+		result.signerName = getCommonName(signer);
+		result.isTimestamp = OBJ_obj2nid(CMS_get0_eContentType(cms)) == NID_id_smime_ct_TSTInfo;
+		report.parseMs += elapsedMs(start);
+
+		start = Clock::now();
+		bool digestOk = false;
+		if (!byteRangeOk) {
+			// Content outside the signed ranges would be reported as signed
+		} else if (result.isTimestamp) {
+			/* Document timestamp: the ByteRange is hashed into the TSTInfo message imprint and the signed
+			   attributes cover the TSTInfo itself */
+			ASN1_OCTET_STRING **content = CMS_get0_content(cms);
+			TS_TST_INFO *tstInfo = NULL;
+			if (content && *content) {
+				const unsigned char *tstData = ASN1_STRING_get0_data(*content);
+				tstInfo = d2i_TS_TST_INFO(NULL, &tstData, ASN1_STRING_length(*content));
+			}
+
+			if (tstInfo) {
+				TS_MSG_IMPRINT *imprint = TS_TST_INFO_get_msg_imprint(tstInfo);
+				const ASN1_OBJECT *imprintObj = NULL;
+				X509_ALGOR_get0(&imprintObj, NULL, NULL, TS_MSG_IMPRINT_get_algo(imprint));
+				const EVP_MD *imprintMd = imprintObj ? EVP_get_digestbyobj(imprintObj) : NULL;
+				CByteArray documentHash;
+				unsigned char contentHash[EVP_MAX_MD_SIZE];
+				unsigned int contentHashLen = 0;
+
+				digestOk = imprintMd != NULL && hashByteRange(fp, byteRange, imprintMd, documentHash) &&
+						   digestMatches(TS_MSG_IMPRINT_get_msg(imprint), documentHash) &&
+						   EVP_Digest(ASN1_STRING_get0_data(*content), ASN1_STRING_length(*content), contentHash,
+									  &contentHashLen, md, NULL) &&
+						   digestMatches(messageDigest, CByteArray(contentHash, contentHashLen));
+
+				result.signingTime = asn1TimeToString(TS_TST_INFO_get_time(tstInfo));
+				if (!asn1TimeToTime(TS_TST_INFO_get_time(tstInfo), info.genTime))
+					digestOk = false;
+				TS_TST_INFO_free(tstInfo);
+			}
+		} else {
+			CByteArray documentHash;
+			digestOk = hashByteRange(fp, byteRange, md, documentHash) && digestMatches(messageDigest, documentHash);
+
+			int timeIdx = CMS_signed_get_attr_by_NID(si, NID_pkcs9_signingTime, -1);
+			if (timeIdx >= 0) {
+				ASN1_TYPE *time = X509_ATTRIBUTE_get0_type(CMS_signed_get_attr(si, timeIdx), 0);
+				if (time && (time->type == V_ASN1_UTCTIME || time->type == V_ASN1_GENERALIZEDTIME))
+					result.signingTime = asn1TimeToString(time->value.asn1_string);
+			}
+
+			if (digestOk && !verifySignatureTimestamp(si, info.genTime, info.tsaCert, info.tsaCertificates))
+				info.genTime = 0;
+		}
+		report.hashMs += elapsedMs(start);
+
+		start = Clock::now();
+		if (!digestOk)
+			result.status = SIGVERIFY_INVALID_DIGEST;
+		else if (CMS_SignerInfo_verify(si) != 1)
+			result.status = SIGVERIFY_INVALID_SIGNATURE;
+		else
+			result.status = SIGVERIFY_VALID;
+		report.signatureMs += elapsedMs(start);
+
+		CMS_ContentInfo_free(cms);
+	}
+
+	long long signedEnd = 0;
+	for (const tPdfSignatureInfo &info : infos)
+		signedEnd = std::max(signedEnd, info.signedEnd);
+	if (signedEnd > 0 && !isValidationDataUpdate(doc.get(), fp, signedEnd)) {
+		MWLOG(LEV_ERROR, MOD_APL, "SignatureVerifier: %s was changed after its last signature", report.path.c_str());
+		report.uncoveredChanges = true;
+	}
+
+	fclose(fp);
+}
+
+bool SignatureVerifier::verifyChain(const CByteArray &signerCert, const std::vector<CByteArray> &intermediates,
+									const std::vector<CByteArray> &roots, time_t checkTime) {
+	X509 *signer = derToX509(signerCert);
+	X509_STORE *trusted = X509_STORE_new();
+	STACK_OF(X509) *untrusted = sk_X509_new_null();
+	X509_STORE_CTX *ctx = X509_STORE_CTX_new();
+
+	for (const CByteArray &root : roots) {
+		X509 *cert = derToX509(root);
+		if (cert) {
+			X509_STORE_add_cert(trusted, cert);
+			X509_free(cert);
+		}
+	}
+	for (const CByteArray &intermediate : intermediates) {
+		X509 *cert = derToX509(intermediate);
+		if (cert)
+			sk_X509_push(untrusted, cert);
+	}
+
+	bool ok = false;
+	if (signer && trusted && untrusted && ctx && X509_STORE_CTX_init(ctx, trusted, signer, untrusted) == 1) {
+		/* Every certificate of the chain must be valid at checkTime and every issuer must be a CA allowed to sign
+		   certificates (basicConstraints and keyUsage), which X509_verify_cert() checks on each hop */
+		X509_VERIFY_PARAM_set_time(X509_STORE_CTX_get0_param(ctx), checkTime);
+		ok = X509_verify_cert(ctx) == 1;
+		if (!ok)
+			MWLOG(LEV_WARN, MOD_APL, "SignatureVerifier: signer certificate chain not trusted: %s",
+				  X509_verify_cert_error_string(X509_STORE_CTX_get_error(ctx)));
+	}
+
+	// The signer itself must be an end-entity certificate for signatures
+	if (ok) {
+		uint32_t keyUsage = X509_get_key_usage(signer);
+		ok = X509_check_ca(signer) == 0 && (keyUsage & (KU_DIGITAL_SIGNATURE | KU_NON_REPUDIATION)) != 0;
+		if (!ok)
+			MWLOG(LEV_WARN, MOD_APL, "SignatureVerifier: signer certificate is not a signature certificate");
+	}
+
+	X509_STORE_CTX_free(ctx);
+	sk_X509_pop_free(untrusted, X509_free);
+	X509_STORE_free(trusted);
+	X509_free(signer);
+
+	return ok;
+}
+
+/* Only the roots of our certificate store are trust anchors. Its other certificates and the ones embedded in the
+   signature are candidate intermediates */
+void SignatureVerifier::getTrustAnchors(APL_Certifs &store, const std::vector<CByteArray> &embedded,
+										std::vector<CByteArray> &roots, std::vector<CByteArray> &intermediates) {
+	intermediates = embedded;
+	for (unsigned long i = 0; i < store.countAll(); i++) {
+		APL_Certif *cert = store.getCert(i);
+		if (!cert->isRoot())
+			intermediates.push_back(cert->getData());
+		else if (!cert->isTest())
+			roots.push_back(cert->getData());
+	}
+}
+
+void SignatureVerifier::verifySigner(APL_Certifs &store, SignatureVerifyResult &result, time_t proofTime) {
+	APL_CryptoFwkPteid *cryptoFwk = AppLayer.getCryptoFwk();
+
+	std::vector<CByteArray> roots;
+	std::vector<CByteArray> intermediates;
+	getTrustAnchors(store, result.certificates, roots, intermediates);
+
+	if (!verifyChain(result.signerCert, intermediates, roots, proofTime != 0 ? proofTime : time(NULL))) {
+		result.status = SIGVERIFY_UNTRUSTED_CHAIN;
+		return;
+	}
+
+	if (!m_checkRevocation)
+		return;
+
+	// The store needs the intermediates to find the OCSP/CRL issuer of the signer
+	for (const CByteArray &cert : result.certificates) {
+		if (!cryptoFwk->isSelfIssuer(cert))
+			store.addCert(cert, APL_CERTIF_TYPE_UNKNOWN, false);
+	}
+	APL_Certif *signer = store.addCert(result.signerCert, APL_CERTIF_TYPE_UNKNOWN, false);
+
+	switch (signer->getStatus()) {
+	case APL_CERTIF_STATUS_VALID:
+	case APL_CERTIF_STATUS_VALID_CRL:
+	case APL_CERTIF_STATUS_VALID_OCSP:
+		break;
+	case APL_CERTIF_STATUS_EXPIRED:
+		// An expired signer certificate doesn't invalidate a signature a timestamp proves was made while it was valid
+		if (proofTime == 0)
+			result.status = SIGVERIFY_UNTRUSTED_CHAIN;
+		break;
+	case APL_CERTIF_STATUS_REVOKED:
+	case APL_CERTIF_STATUS_SUSPENDED:
+		result.status = SIGVERIFY_REVOKED;
+		break;
+	default:
+		result.status = SIGVERIFY_REVOCATION_UNKNOWN;
+		break;
+	}
+}
+
+DocumentVerifyReport SignatureVerifier::verify(const char *path) {
+	DocumentVerifyReport report;
+	report.path = path;
+	Clock::time_point start = Clock::now();
+
+	try {
+		std::string ext = report.path.size() > 4 ? report.path.substr(report.path.size() - 4) : "";
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		std::vector<tPdfSignatureInfo> infos;
+		if (ext != ".pdf" && SigContainer::isValidASiC(path))
+			XadesSignature::verifyASiC(path, report);
+		else
+			verifyPDF(report, infos);
+
+		Clock::time_point certStart = Clock::now();
+		APL_Certifs store;
+		time_t now = time(NULL);
+
+		/* Latest revisions first: a valid document timestamp proves that the signatures and timestamps of the
+		   revisions it covers existed at its time. The XAdES timestamps of ASiC containers aren't used yet */
+		std::vector<size_t> order(report.signatures.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		if (!infos.empty())
+			std::sort(order.begin(), order.end(),
+					  [&infos](size_t a, size_t b) { return infos[a].signedEnd > infos[b].signedEnd; });
+
+		std::vector<const tPdfSignatureInfo *> validTimestamps;
+		for (size_t i : order) {
+			SignatureVerifyResult &result = report.signatures[i];
+			if (result.status != SIGVERIFY_VALID)
+				continue;
+
+			time_t proofTime = 0;
+			if (!infos.empty()) {
+				const tPdfSignatureInfo &info = infos[i];
+				for (const tPdfSignatureInfo *timestamp : validTimestamps) {
+					if (timestamp->gapStart >= info.signedEnd && (proofTime == 0 || timestamp->genTime < proofTime))
+						proofTime = timestamp->genTime;
+				}
+
+				// The TSA certificate of the signature timestamp must be valid now or when a document timestamp
+				// covered it
+				std::vector<CByteArray> roots;
+				std::vector<CByteArray> intermediates;
+				getTrustAnchors(store, info.tsaCertificates, roots, intermediates);
+				if (info.genTime != 0 && !result.isTimestamp && (proofTime == 0 || info.genTime < proofTime) &&
+					verifyChain(info.tsaCert, intermediates, roots, proofTime != 0 ? proofTime : now))
+					proofTime = info.genTime;
+			}
+
+			verifySigner(store, result, proofTime);
+			if (result.isTimestamp && result.status == SIGVERIFY_VALID)
+				validTimestamps.push_back(&infos[i]);
+		}
+		report.certificateMs = elapsedMs(certStart);
+	} catch (CMWException &e) {
+		MWLOG(LEV_ERROR, MOD_APL, "SignatureVerifier: %s failed with error 0x%08lx", path, e.GetError());
+		report.error = e.GetError();
+	}
+
+	report.valid = report.error == 0 && !report.signatures.empty() && report.unsignedFiles.empty() &&
+				   !report.uncoveredChanges &&
+				   std::all_of(report.signatures.begin(), report.signatures.end(),
+							   [](const SignatureVerifyResult &result) { return result.status == SIGVERIFY_VALID; });
+	report.totalMs = elapsedMs(start);
+
+	return report;
+}
+
+bool SignatureVerifier::nextDocument(size_t &index) {
+	CAutoMutex autoMutex(&m_mutex);
+
+	if (m_nextDocument >= m_inputFiles.size())
+		return false;
+
+	index = m_nextDocument++;
+	return true;
+}
+
+void SignatureVerifier::verifyDocument(size_t index) {
+	// Each worker writes to its own preallocated slot so the reports don't need locking
+	m_reports[index] = verify(m_inputFiles[index].c_str());
+
+	if (m_callback) {
+		CAutoMutex autoMutex(&m_callbackMutex);
+		m_callback(index, m_reports[index]);
+	}
+}
+
+size_t SignatureVerifier::verifyAll() { return verifyAll(nullptr); }
+
+size_t SignatureVerifier::verifyAll(std::function<void(size_t index, const DocumentVerifyReport &report)> callback) {
+	m_callback = callback;
+	m_reports.clear();
+	m_reports.resize(m_inputFiles.size());
+	m_nextDocument = 0;
+	Clock::time_point start = Clock::now();
+
+	// The calling thread is one of the workers
+	size_t threadCount = std::min<size_t>(m_workers, m_inputFiles.size());
+	std::vector<SignatureVerifyWorker *> workers;
+	for (size_t i = 1; i < threadCount; i++) {
+		SignatureVerifyWorker *worker = new SignatureVerifyWorker(this);
+		workers.push_back(worker);
+		if (worker->Start() != 0) {
+			MWLOG(LEV_WARN, MOD_APL, "SignatureVerifier: failed to start worker thread");
+			break;
+		}
+	}
+
+	SignatureVerifyWorker(this).Run();
+
+	for (SignatureVerifyWorker *worker : workers) {
+		worker->WaitTillStopped(50);
+		delete worker;
+	}
+	m_callback = nullptr;
+
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+	m_elapsedSeconds = elapsed.count();
+
+	size_t invalid = 0;
+	double hashMs = 0, signatureMs = 0, certificateMs = 0;
+	for (const DocumentVerifyReport &report : m_reports) {
+		invalid += report.valid ? 0 : 1;
+		hashMs += report.hashMs;
+		signatureMs += report.signatureMs;
+		certificateMs += report.certificateMs;
+	}
+
+	MWLOG(LEV_INFO, MOD_APL,
+		  "SignatureVerifier: %lu documents (%lu not valid) in %.1f s, %.2f documents/s, "
+		  "hashing %.0f ms, signatures %.0f ms, certificates %.0f ms",
+		  (unsigned long)m_reports.size(), (unsigned long)invalid, m_elapsedSeconds,
+		  m_elapsedSeconds > 0 ? m_reports.size() / m_elapsedSeconds : 0, hashMs, signatureMs, certificateMs);
+
+	return invalid;
+}
+
+} // namespace eIDMW
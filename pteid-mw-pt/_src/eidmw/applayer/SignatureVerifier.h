@@ -0,0 +1,143 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#ifndef __SIGNATURE_VERIFIER_H
+#define __SIGNATURE_VERIFIER_H
+
+#include <functional>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#include "Export.h"
+#include "ByteArray.h"
+#include "Mutex.h"
+
+#define SIGNATURE_VERIFY_DEFAULT_WORKERS 4
+
+namespace eIDMW {
+
+class APL_Certifs;
+
+enum APL_SignatureVerifyStatus {
+	SIGVERIFY_VALID,			  /**< Digest and signature match and the signer certificate chains to a trusted root */
+	SIGVERIFY_INVALID_DIGEST,	  /**< The signed data was modified after signing or isn't all covered by it */
+	SIGVERIFY_INVALID_SIGNATURE,  /**< The signature value doesn't match the signer certificate */
+	SIGVERIFY_UNTRUSTED_CHAIN,	  /**< The signer certificate doesn't chain to a trusted root */
+	SIGVERIFY_REVOKED,			  /**< The signer certificate is revoked or suspended */
+	SIGVERIFY_REVOCATION_UNKNOWN, /**< The OCSP/CRL status of the signer certificate couldn't be obtained */
+	SIGVERIFY_ERROR				  /**< Malformed or unsupported signature */
+};
+
+/* Result of one signature, or document timestamp, of a document */
+struct SignatureVerifyResult {
+	APL_SignatureVerifyStatus status = SIGVERIFY_ERROR;
+	bool isTimestamp = false; /**< PDF document timestamp (ETSI.RFC3161) */
+	std::string signerName;
+	std::string signingTime; /**< Claimed signing time or timestamp time, empty if absent */
+	CByteArray signerCert;
+	std::vector<CByteArray> certificates; /**< Certificates embedded in the signature, used to build the chain */
+};
+
+/* Result of one document. The timings are the time spent in each verification stage, in milliseconds */
+struct DocumentVerifyReport {
+	std::string path;
+	bool valid = false; /**< The document has signatures, all of them are SIGVERIFY_VALID and they cover all of it */
+	unsigned long error = 0; /**< Error code if the document couldn't be read */
+	std::vector<SignatureVerifyResult> signatures;
+	std::vector<std::string> unsignedFiles; /**< Files of an ASiC container not referenced by any valid digest */
+	bool uncoveredChanges = false; /**< A PDF revision after the last signature changes more than its DSS */
+
+	double parseMs = 0;		  /**< Loading the document and extracting the signatures */
+	double hashMs = 0;		  /**< Hashing the signed byte ranges or referenced files */
+	double signatureMs = 0;	  /**< Verifying the CMS or XMLDSig signature values */
+	double certificateMs = 0; /**< Building the signer chain and checking revocation */
+	double totalMs = 0;
+};
+
+/* SignatureVerifier verifies PAdES signatures of PDF documents and XAdES signatures of ASiC-E containers.
+   The signed data is hashed by streaming each ByteRange or referenced file, without loading it in memory.
+   Revocation checking of the signer certificates is optional and goes through the certificate status cache.
+
+   The signer certificate chain is validated at the time of a verified timestamp that proves the signature existed:
+   its own signature timestamp or a later document timestamp covering it. Without one it's validated at the current
+   time, as the claimed signing time can be set to anything by the signer. An expired signer certificate is only
+   accepted when such a timestamp exists.
+
+   Documents can be verified one at a time with verify() or added to a batch that is processed by a pool of
+   worker threads, either collecting all the reports (verifyAll()) or delivering each one as soon as it's ready.
+*/
+class SignatureVerifier {
+public:
+	EIDMW_APL_API SignatureVerifier(bool checkRevocation = false,
+									unsigned int workers = SIGNATURE_VERIFY_DEFAULT_WORKERS);
+
+	/* Verify a single PDF or ASiC document in the calling thread */
+	EIDMW_APL_API DocumentVerifyReport verify(const char *path);
+
+	EIDMW_APL_API void addFile(const char *path);
+
+	/* Add the PDF and ASiC files found in dir and its subdirectories. Returns the number of files added */
+	EIDMW_APL_API size_t addDirectory(const char *dir);
+
+	/* Verify every document added so far. Returns the number of documents that are not valid */
+	EIDMW_APL_API size_t verifyAll();
+
+	/* Streaming variant: callback is called once for each document, as soon as it's verified, from the worker
+	   threads but never concurrently. The reports are also available from getReports() afterwards */
+	EIDMW_APL_API size_t verifyAll(std::function<void(size_t index, const DocumentVerifyReport &report)> callback);
+
+	/* Reports of the last verifyAll(), in the order the documents were added */
+	EIDMW_APL_API const std::vector<DocumentVerifyReport> &getReports() const { return m_reports; }
+	EIDMW_APL_API double getElapsedSeconds() const { return m_elapsedSeconds; }
+
+	/* Check that signerCert is a signature certificate that chains to one of roots through CA certificates taken
+	   from intermediates, all of them valid at checkTime */
+	EIDMW_APL_API static bool verifyChain(const CByteArray &signerCert, const std::vector<CByteArray> &intermediates,
+										  const std::vector<CByteArray> &roots, time_t checkTime);
+
+private:
+	SignatureVerifier(const SignatureVerifier &);
+	SignatureVerifier &operator=(const SignatureVerifier &);
+
+	/* Where a PDF signature is in its document and the timestamp that proves when it existed, if any */
+	struct tPdfSignatureInfo {
+		long long signedEnd = 0; /* End of the second ByteRange interval */
+		long long gapStart = 0;	 /* Start of the /Contents of the signature */
+		time_t genTime = 0;		 /* Time of the document timestamp or of the signature timestamp, 0 if none */
+		CByteArray tsaCert;		 /* Signer of the signature timestamp, its chain isn't verified yet */
+		std::vector<CByteArray> tsaCertificates;
+	};
+
+	static void foundFile(const char *dir, const char *subDir, const char *file, void *param);
+
+	void verifyPDF(DocumentVerifyReport &report, std::vector<tPdfSignatureInfo> &infos);
+	/* The chain is validated at proofTime, or at the current time if it's 0 */
+	void verifySigner(APL_Certifs &store, SignatureVerifyResult &result, time_t proofTime);
+	static void getTrustAnchors(APL_Certifs &store, const std::vector<CByteArray> &embedded,
+								std::vector<CByteArray> &roots, std::vector<CByteArray> &intermediates);
+
+	/* Called by the workers: take the next document to process */
+	bool nextDocument(size_t &index);
+	void verifyDocument(size_t index);
+
+	bool m_checkRevocation;
+	unsigned int m_workers;
+
+	std::vector<std::string> m_inputFiles;
+	std::vector<DocumentVerifyReport> m_reports;
+	size_t m_nextDocument;
+	double m_elapsedSeconds;
+	std::function<void(size_t, const DocumentVerifyReport &)> m_callback;
+	CMutex m_mutex;
+	CMutex m_callbackMutex;
+
+	friend class SignatureVerifyWorker;
+};
+
+} // namespace eIDMW
+
+#endif
@@ -19,6 +19,7 @@
 #include "CurlUtil.h"
 #include "Util.h"
 #include "Log.h"
+#include "Thread.h"
 #include "TSAClient.h"
 
 namespace eIDMW {
@@ -26,50 +27,80 @@ namespace eIDMW {
 #define SHA1_LEN 20
 #define SHA256_LEN 32
 #define TS_REQUEST_SHA1_LEN 43
-#define TS_REQUEST_SHA256_LEN 59
 #define SHA1_OFFSET 20
 #define SHA256_OFFSET 24
 
+/* Idle connections kept open to the TSA */
+#define MAX_IDLE_CURL_HANDLES 8
+
 /* ASN1 "templates" for timestamp requests of SHA-1 and SHA-256 hashes  */
 
-static unsigned char timestamp_asn1_request[TS_REQUEST_SHA1_LEN] = {
+static const unsigned char timestamp_asn1_request[TS_REQUEST_SHA1_LEN] = {
 	0x30, 0x29, 0x02, 0x01, 0x01, 0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e, 0x03, 0x02,
 	0x1a, 0x05, 0x00, 0x04, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0xff};
 
-static unsigned char timestamp_asn1_sha256[TS_REQUEST_SHA256_LEN] = {
+static const unsigned char timestamp_asn1_sha256[TS_REQUEST_SHA256_LEN] = {
 	0x30, 0x39, 0x02, 0x01, 0x01, 0x30, 0x31, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
 	0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0xFF};
 
+static CMutex idle_handles_mutex;
+static std::vector<void *> idle_handles;
+
 TSAClient::TSAClient() {}
 
-CByteArray TSAClient::received_data = CByteArray();
+void *TSAClient::acquireHandle() {
+	{
+		CAutoMutex autoMutex(&idle_handles_mutex);
+		if (!idle_handles.empty()) {
+			CURL *curl = idle_handles.back();
+			idle_handles.pop_back();
+			// Reset the options but keep the open connections and DNS cache
+			curl_easy_reset(curl);
+			return curl;
+		}
+	}
+
+	return curl_easy_init();
+}
+
+void TSAClient::releaseHandle(void *curl) {
+	CAutoMutex autoMutex(&idle_handles_mutex);
+	if (idle_handles.size() < MAX_IDLE_CURL_HANDLES)
+		idle_handles.push_back(curl);
+	else
+		curl_easy_cleanup(curl);
+}
 
 size_t TSAClient::curl_write_data(char *ptr, size_t size, size_t nmemb, void *stream) {
 	size_t realsize = size * nmemb;
-	received_data.SafeAppend((const unsigned char *)ptr, realsize);
+	TSAClient *client = static_cast<TSAClient *>(stream);
+	client->m_received_data.SafeAppend((const unsigned char *)ptr, realsize);
 
 	return realsize;
 }
 
-CByteArray TSAClient::getResponse() { return received_data; }
+CByteArray TSAClient::getResponse() { return m_received_data; }
 
-/* Fill the template with the supplied hash */
-void TSAClient::generate_asn1_request_struct(const unsigned char *hash, bool is_sha256) {
-	int hash_length = SHA1_LEN;
-	int hash_offset = SHA1_OFFSET;
+/* Fill the request buffer with the template and the supplied hash, returns the request length */
+unsigned int TSAClient::generate_asn1_request_struct(const unsigned char *hash, bool is_sha256) {
+	unsigned int hash_length = SHA1_LEN;
+	unsigned int hash_offset = SHA1_OFFSET;
+	unsigned int request_length = sizeof(timestamp_asn1_request);
 
-	unsigned char *ts_request_buffer = timestamp_asn1_request;
+	memcpy(m_request, timestamp_asn1_request, sizeof(timestamp_asn1_request));
 	if (is_sha256) {
 		hash_length = SHA256_LEN;
 		hash_offset = SHA256_OFFSET;
-		ts_request_buffer = timestamp_asn1_sha256;
+		request_length = sizeof(timestamp_asn1_sha256);
+		memcpy(m_request, timestamp_asn1_sha256, sizeof(timestamp_asn1_sha256));
 	}
 
-	for (unsigned int i = 0; i != hash_length; i++)
-		ts_request_buffer[hash_offset + i] = hash[i];
+	memcpy(m_request + hash_offset, hash, hash_length);
+
+	return request_length;
 }
 
 void TSAClient::timestamp_data(const unsigned char *input, unsigned int data_len) {
@@ -77,28 +108,20 @@ void TSAClient::timestamp_data(const unsigned char *input, unsigned int data_len
 	CURL *curl;
 	CURLcode res;
 	char error_buf[CURL_ERROR_SIZE];
-	unsigned char *ts_request = timestamp_asn1_request;
-	size_t post_size = sizeof(timestamp_asn1_request);
+	size_t post_size;
 
-	// Make sure the static array receiving the network reply
+	// Make sure the array receiving the network reply
 	//  is zero'd out before each request
-	received_data.Chop(received_data.Size());
+	m_received_data.Chop(m_received_data.Size());
 
 	// Get Timestamping server URL from config
 	APL_Config tsa_url(CConfig::EIDMW_CONFIG_PARAM_XSIGN_TSAURL);
 	const char *TSA_URL = tsa_url.getString();
 
 	MWLOG(LEV_DEBUG, MOD_APL, "Requesting timestamp with TSA url: %s", TSA_URL);
-	if (data_len == SHA256_LEN) {
-		generate_asn1_request_struct(input, true);
-		ts_request = timestamp_asn1_sha256;
-		post_size = sizeof(timestamp_asn1_sha256);
+	post_size = generate_asn1_request_struct(input, data_len == SHA256_LEN);
 
-	} else {
-		generate_asn1_request_struct(input, false);
-	}
-
-	curl = curl_easy_init();
+	curl = acquireHandle();
 
 	if (curl) {
 
@@ -114,11 +137,12 @@ void TSAClient::timestamp_data(const unsigned char *input, unsigned int data_len
 		curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
 
 		/* Now specify the POST data */
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, ts_request);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, m_request);
 
 		curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error_buf);
 
 		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &TSAClient::curl_write_data);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
 
 		applyProxyConfigToCurl(curl, TSA_URL);
 
@@ -140,9 +164,78 @@ void TSAClient::timestamp_data(const unsigned char *input, unsigned int data_len
 
 		curl_slist_free_all(headers);
 
-		/* always cleanup */
-		curl_easy_cleanup(curl);
+		/* Keep the connection open for the next request */
+		releaseHandle(curl);
+	}
+}
+
+/* One timestamp request running in the background */
+class TSARequestThread : public CThread {
+public:
+	TSARequestThread(const unsigned char *digest, unsigned int digest_len) : m_digest(digest, digest_len) {}
+
+	void Run() {
+		TSAClient tsa;
+		tsa.timestamp_data(m_digest.GetBytes(), m_digest.Size());
+		m_response = tsa.getResponse();
+	}
+
+	CByteArray m_digest;
+	CByteArray m_response;
+	bool m_collected = false;
+};
+
+TSABatchClient::TSABatchClient(unsigned int maxParallel) : m_maxParallel(maxParallel > 0 ? maxParallel : 1) {}
+
+TSABatchClient::~TSABatchClient() {
+	for (TSARequestThread *request : m_requests) {
+		request->WaitTillStopped(10);
+		delete request;
+	}
+}
+
+unsigned int TSABatchClient::runningCount() {
+	unsigned int count = 0;
+	for (TSARequestThread *request : m_requests) {
+		if (!request->m_collected && request->IsRunning())
+			count++;
+	}
+	return count;
+}
+
+size_t TSABatchClient::submit(const unsigned char *digest, unsigned int digest_len) {
+	while (runningCount() >= m_maxParallel)
+		CThread::SleepMillisecs(10);
+
+	TSARequestThread *request = new TSARequestThread(digest, digest_len);
+	m_requests.push_back(request);
+
+	if (request->Start() != 0) {
+		MWLOG(LEV_WARN, MOD_APL, "TSABatchClient: failed to start thread, requesting timestamp synchronously");
+		request->Run();
+	}
+
+	return m_requests.size() - 1;
+}
+
+CByteArray TSABatchClient::getResponse(size_t requestId) {
+	if (requestId >= m_requests.size())
+		return CByteArray();
+
+	TSARequestThread *request = m_requests[requestId];
+	request->WaitTillStopped(10);
+	request->m_collected = true;
+
+	return request->m_response;
+}
+
+size_t TSABatchClient::pendingCount() {
+	size_t count = 0;
+	for (TSARequestThread *request : m_requests) {
+		if (!request->m_collected)
+			count++;
 	}
+	return count;
 }
 
 } // namespace eIDMW
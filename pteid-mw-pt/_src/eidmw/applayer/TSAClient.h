@@ -6,9 +6,17 @@
 
 ****************************************************************************-*/
 
+#ifndef __TSACLIENT_H__
+#define __TSACLIENT_H__
+
 #include "ByteArray.h"
+#include "Mutex.h"
+#include <vector>
 
 namespace eIDMW {
+
+#define TS_REQUEST_SHA256_LEN 59
+
 class TSAClient {
 public:
 	TSAClient();
@@ -17,8 +25,47 @@ public:
 
 private:
 	static size_t curl_write_data(char *, size_t, size_t, void *);
-	void generate_asn1_request_struct(const unsigned char *, bool);
-	static CByteArray received_data;
+	unsigned int generate_asn1_request_struct(const unsigned char *, bool);
+
+	/* cURL easy handles are pooled so that consecutive requests to the TSA reuse the same connection */
+	static void *acquireHandle();
+	static void releaseHandle(void *curl);
+
+	CByteArray m_received_data;
+	unsigned char m_request[TS_REQUEST_SHA256_LEN];
+};
+
+class TSARequestThread;
+
+/*
+ * Timestamp requests for a batch of signatures: up to maxParallel requests are in flight at the same time
+ * while the caller goes on signing the next documents.
+ */
+class TSABatchClient {
+public:
+	TSABatchClient(unsigned int maxParallel);
+	~TSABatchClient();
+
+	/* Start the timestamp request of a digest, blocking while maxParallel requests are pending.
+	   Returns the id to pass to getResponse() */
+	size_t submit(const unsigned char *digest, unsigned int digest_len);
+
+	/* Wait for the request to finish, an empty array means the timestamp failed */
+	CByteArray getResponse(size_t requestId);
+
+	/* Number of requests not yet collected with getResponse() */
+	size_t pendingCount();
+
+private:
+	TSABatchClient(const TSABatchClient &);
+	TSABatchClient &operator=(const TSABatchClient &);
+
+	unsigned int runningCount();
+
+	unsigned int m_maxParallel;
+	std::vector<TSARequestThread *> m_requests;
 };
 
 } // namespace eIDMW
+
+#endif // __TSACLIENT_H__
@@ -0,0 +1,229 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#include "ValidationDataCache.h"
+
+#include "APLConfig.h"
+#include "MiscUtil.h"
+#include "MWException.h"
+#include "Log.h"
+#include "Util.h"
+
+#include <openssl/evp.h>
+#include <openssl/ocsp.h>
+#include <openssl/x509.h>
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+/* CRLs can take several MB each */
+#define VALIDATION_CACHE_MAX_ENTRIES 64
+
+namespace eIDMW {
+
+APL_ValidationDataCache::APL_ValidationDataCache(const char *dir) : m_hits(0), m_misses(0) {
+	if (dir != NULL && strlen(dir) > 0) {
+		m_dir = dir;
+	} else {
+		APL_Config cacheDir(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PTEID_CACHEDIR);
+		m_dir = cacheDir.getString();
+#ifdef WIN32
+		m_dir += "\\ltv";
+#else
+		m_dir += "/ltv";
+#endif
+	}
+
+	try {
+		CPathUtil::checkDir(m_dir.c_str());
+	} catch (CMWException &e) {
+		MWLOG(LEV_WARN, MOD_APL, "APL_ValidationDataCache: can't use directory %s, caching in memory only",
+			  m_dir.c_str());
+		m_dir.clear();
+	}
+}
+
+std::string APL_ValidationDataCache::getFilePath(const std::string &key, bool isOcsp) {
+	if (m_dir.empty())
+		return std::string();
+
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int md_len = 0;
+	EVP_Digest(key.c_str(), key.size(), md, &md_len, EVP_sha256(), NULL);
+
+	char *hex = bin2AsciiHex(md, md_len);
+	std::string path = m_dir;
+#ifdef WIN32
+	path += "\\";
+#else
+	path += "/";
+#endif
+	path += hex;
+	path += isOcsp ? ".ocsp" : ".crl";
+	delete[] hex;
+
+	return path;
+}
+
+bool APL_ValidationDataCache::getNextUpdate(const CByteArray &data, bool isOcsp, time_t &nextUpdate) {
+	const unsigned char *p = data.GetBytes();
+	const ASN1_TIME *next = NULL;
+	OCSP_RESPONSE *response = NULL;
+	OCSP_BASICRESP *basic = NULL;
+	X509_CRL *crl = NULL;
+
+	if (isOcsp) {
+		response = d2i_OCSP_RESPONSE(NULL, &p, data.Size());
+		if (response)
+			basic = OCSP_response_get1_basic(response);
+		if (basic && OCSP_resp_count(basic) > 0) {
+			ASN1_GENERALIZEDTIME *single_next = NULL;
+			OCSP_single_get0_status(OCSP_resp_get0(basic, 0), NULL, NULL, NULL, &single_next);
+			next = single_next;
+		}
+	} else {
+		crl = d2i_X509_CRL(NULL, &p, data.Size());
+		if (crl)
+			next = X509_CRL_get0_nextUpdate(crl);
+	}
+
+	int days = 0, secs = 0;
+	bool ok = next != NULL && ASN1_TIME_diff(&days, &secs, NULL, next);
+	if (ok)
+		nextUpdate = time(NULL) + (time_t)days * 24 * 3600 + secs;
+
+	if (basic)
+		OCSP_BASICRESP_free(basic);
+	if (response)
+		OCSP_RESPONSE_free(response);
+	if (crl)
+		X509_CRL_free(crl);
+
+	return ok;
+}
+
+bool APL_ValidationDataCache::get(const std::string &key, bool isOcsp, CByteArray &data) {
+	CAutoMutex autoMutex(&m_mutex);
+
+	time_t now = time(NULL);
+	auto it = m_entries.find(key);
+	if (it != m_entries.end()) {
+		if (it->second.nextUpdate > now) {
+			data = it->second.data;
+			m_hits++;
+			return true;
+		}
+		m_entries.erase(it);
+	}
+
+	std::string path = getFilePath(key, isOcsp);
+	FILE *f = NULL;
+	if (!path.empty() && fopen_s(&f, path.c_str(), "rb") == 0 && f != NULL) {
+		CByteArray fileData;
+		unsigned char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+			fileData.Append(buffer, (unsigned long)read);
+		fclose(f);
+
+		tCacheEntry entry;
+		if (getNextUpdate(fileData, isOcsp, entry.nextUpdate) && entry.nextUpdate > now) {
+			entry.data = fileData;
+			insertEntry(key, entry);
+			data = fileData;
+			m_hits++;
+			return true;
+		}
+
+		MWLOG(LEV_DEBUG, MOD_APL, "APL_ValidationDataCache: removing expired entry %s", path.c_str());
+		remove(path.c_str());
+	}
+
+	m_misses++;
+	return false;
+}
+
+void APL_ValidationDataCache::insertEntry(const std::string &key, const tCacheEntry &entry) {
+	if (m_entries.find(key) == m_entries.end() && m_entries.size() >= VALIDATION_CACHE_MAX_ENTRIES) {
+		// Expired entries go first, they're at the smallest nextUpdate
+		auto oldest = m_entries.begin();
+		for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+			if (it->second.nextUpdate < oldest->second.nextUpdate)
+				oldest = it;
+		}
+		m_entries.erase(oldest);
+	}
+	m_entries[key] = entry;
+}
+
+void APL_ValidationDataCache::store(const std::string &key, bool isOcsp, const CByteArray &data) {
+	tCacheEntry entry;
+	if (!getNextUpdate(data, isOcsp, entry.nextUpdate) || entry.nextUpdate <= time(NULL))
+		return;
+	entry.data = data;
+
+	CAutoMutex autoMutex(&m_mutex);
+	insertEntry(key, entry);
+
+	std::string path = getFilePath(key, isOcsp);
+	if (path.empty())
+		return;
+
+	std::string tmpPath = path + ".tmp" + std::to_string(getpid());
+	FILE *f = NULL;
+	if (fopen_s(&f, tmpPath.c_str(), "wb") != 0 || f == NULL) {
+		MWLOG(LEV_WARN, MOD_APL, "APL_ValidationDataCache: failed to write %s", tmpPath.c_str());
+		return;
+	}
+
+	bool written = fwrite(data.GetBytes(), 1, data.Size(), f) == data.Size();
+	written = fclose(f) == 0 && written;
+
+#ifdef WIN32
+	written = written && MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	written = written && rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+	if (!written) {
+		MWLOG(LEV_WARN, MOD_APL, "APL_ValidationDataCache: failed to write %s", path.c_str());
+		remove(tmpPath.c_str());
+	}
+}
+
+bool APL_ValidationDataCache::getOcspResponse(const CByteArray &cert, CByteArray &response) {
+	return get("ocsp:" + std::string((const char *)cert.GetBytes(), cert.Size()), true, response);
+}
+
+void APL_ValidationDataCache::storeOcspResponse(const CByteArray &cert, const CByteArray &response) {
+	store("ocsp:" + std::string((const char *)cert.GetBytes(), cert.Size()), true, response);
+}
+
+bool APL_ValidationDataCache::getCrl(const std::string &url, CByteArray &crl) { return get("crl:" + url, false, crl); }
+
+void APL_ValidationDataCache::storeCrl(const std::string &url, const CByteArray &crl) {
+	store("crl:" + url, false, crl);
+}
+
+unsigned long APL_ValidationDataCache::getHits() {
+	CAutoMutex autoMutex(&m_mutex);
+	return m_hits;
+}
+
+unsigned long APL_ValidationDataCache::getMisses() {
+	CAutoMutex autoMutex(&m_mutex);
+	return m_misses;
+}
+
+} // namespace eIDMW
@@ -0,0 +1,72 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#ifndef __VALIDATION_DATA_CACHE_H__
+#define __VALIDATION_DATA_CACHE_H__
+
+#include <map>
+#include <string>
+#include <time.h>
+
+#include "Export.h"
+#include "ByteArray.h"
+#include "Mutex.h"
+
+namespace eIDMW {
+
+/*
+ * On-disk cache of the OCSP responses and CRLs added to the DSS of PAdES-LT/LTA documents.
+ *
+ * OCSP responses are keyed by the certificate they refer to and CRLs by their distribution point URL.
+ * An entry is only returned until the nextUpdate time of the response or CRL, which is read from the
+ * cached DER itself, so responses without nextUpdate are never stored.
+ * The same directory can be shared by concurrent PAdESExtender instances and by several processes:
+ * files are written to a temporary name and renamed into place.
+ * At most VALIDATION_CACHE_MAX_ENTRIES entries are kept in memory, the one closest to its nextUpdate is evicted
+ * first, the disk files are kept until they expire.
+ */
+class APL_ValidationDataCache {
+public:
+	/* An empty dir selects the "ltv" subdirectory of the pteid cache directory */
+	EIDMW_APL_API APL_ValidationDataCache(const char *dir = "");
+
+	bool getOcspResponse(const CByteArray &cert, CByteArray &response);
+	/* Only responses with a good status should be stored */
+	void storeOcspResponse(const CByteArray &cert, const CByteArray &response);
+
+	bool getCrl(const std::string &url, CByteArray &crl);
+	void storeCrl(const std::string &url, const CByteArray &crl);
+
+	EIDMW_APL_API unsigned long getHits();
+	EIDMW_APL_API unsigned long getMisses();
+
+private:
+	struct tCacheEntry {
+		CByteArray data;
+		time_t nextUpdate;
+	};
+
+	APL_ValidationDataCache(const APL_ValidationDataCache &);
+	APL_ValidationDataCache &operator=(const APL_ValidationDataCache &);
+
+	bool get(const std::string &key, bool isOcsp, CByteArray &data);
+	/* Called with m_mutex held */
+	void insertEntry(const std::string &key, const tCacheEntry &entry);
+	void store(const std::string &key, bool isOcsp, const CByteArray &data);
+	std::string getFilePath(const std::string &key, bool isOcsp);
+
+	static bool getNextUpdate(const CByteArray &data, bool isOcsp, time_t &nextUpdate);
+
+	std::string m_dir;
+	std::map<std::string, tCacheEntry> m_entries;
+	unsigned long m_hits;
+	unsigned long m_misses;
+	CMutex m_mutex;
+};
+
+} // namespace eIDMW
+
+#endif // __VALIDATION_DATA_CACHE_H__
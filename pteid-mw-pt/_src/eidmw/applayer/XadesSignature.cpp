@@ -21,6 +21,8 @@
 #include <fstream>
 #include <cstdio>
 #include <memory>
+#include <chrono>
+#include <set>
 
 #include "XadesSignature.h"
 
@@ -33,12 +35,17 @@
 #include "cryptoFwkPteid.h"
 #include "eidErrors.h"
 #include "Log.h"
+#include "MappedFile.h"
 #include "MiscUtil.h"
+#include "Mutex.h"
 #include "MWException.h"
+#include "SharedCertStore.h"
 #include "SigContainer.h"
+#include "SignatureVerifier.h"
 #include "sign-pkcs7.h"
 #include "Util.h"
 #include "XercesUtils.h"
+#include "ZipAppender.h"
 
 // for Timestamping
 #include "TSAClient.h"
@@ -54,6 +61,8 @@
 #include <xercesc/dom/DOM.hpp>
 #include <xercesc/parsers/XercesDOMParser.hpp>
 #include <xercesc/util/XMLException.hpp>
+#include <xercesc/util/SecurityManager.hpp>
+#include <xercesc/sax/SAXParseException.hpp>
 #include <xercesc/util/XMLUri.hpp>
 #include <xercesc/util/Janitor.hpp>
 
@@ -202,6 +211,32 @@ static CByteArray hashFile(const char *filename, EVP_MD_CTX *digest_state) {
 		return CByteArray();
 	}
 
+	OpenSSL_add_all_digests();
+
+	unsigned char md_value[EVP_MAX_MD_SIZE];
+	unsigned int md_len;
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+	EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
+
+	// Regular files are hashed straight from a memory mapping, other files with buffered reads
+	CMappedFile mappedFile;
+#ifdef WIN32
+	bool mapped = mappedFile.Map(utf16FileName.c_str());
+#else
+	bool mapped = mappedFile.Map(filename);
+#endif
+	if (mapped) {
+		EVP_DigestUpdate(mdctx, mappedFile.GetData(), mappedFile.GetSize());
+		if (digest_state) {
+			EVP_DigestUpdate(digest_state, mappedFile.GetData(), mappedFile.GetSize());
+		}
+		mappedFile.Unmap();
+
+		EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+		EVP_MD_CTX_free(mdctx);
+		return CByteArray(md_value, SHA256_LEN);
+	}
+
 #ifdef WIN32
 	FILE *fp = _wfopen(utf16FileName.c_str(), L"rb");
 #else
@@ -209,14 +244,10 @@ static CByteArray hashFile(const char *filename, EVP_MD_CTX *digest_state) {
 #endif
 	if (!fp) {
 		MWLOG(LEV_ERROR, MOD_APL, L"XadesSignature::hashFile: Error opening file");
+		EVP_MD_CTX_free(mdctx);
 		return CByteArray();
 	}
 
-	OpenSSL_add_all_digests();
-
-	EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
-	EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
-
 	const int BUFSIZE = 4 * 1024;
 	char buffer[BUFSIZE];
 	do {
@@ -233,8 +264,6 @@ static CByteArray hashFile(const char *filename, EVP_MD_CTX *digest_state) {
 
 	fclose(fp);
 
-	unsigned char md_value[EVP_MAX_MD_SIZE];
-	unsigned int md_len;
 	EVP_DigestFinal_ex(mdctx, md_value, &md_len);
 	EVP_MD_CTX_free(mdctx);
 
@@ -331,7 +360,9 @@ static void appendCertRef(XERCES_CPP_NAMESPACE::DOMDocument *doc, APL_Certif *ce
 
 	CByteArray certDataBa;
 	cert->getFormattedData(certDataBa);
-	SHA256_Wrapper(certDataBa.GetBytes(), certDataBa.Size(), cert_digest);
+	// The shared store is keyed by the SHA-256 of the DER so the digest and decoded certificate come for free
+	tSharedCert sharedCert = APL_SharedCertStore::instance().getCertificate(certDataBa);
+	memcpy(cert_digest, sharedCert->getHash().GetBytes(), SHA256_LEN);
 
 	makeQName(str, prefix, "Cert");
 	DOMNode *n_Cert = CREATE_DOM_NODE makeQName(str, prefix, "CertDigest");
@@ -347,8 +378,7 @@ static void appendCertRef(XERCES_CPP_NAMESPACE::DOMDocument *doc, APL_Certif *ce
 	DOMNode *n_CertSerialNumber = CREATE_DSIG_NODE;
 
 	// Add SigningCertificate Element containing digest, serial and issuer
-	const unsigned char *pcertData = certDataBa.GetBytes();
-	X509 *x509Cert = d2i_X509(NULL, &pcertData, certDataBa.Size());
+	X509 *x509Cert = sharedCert->getX509();
 	if (x509Cert == NULL) {
 		MWLOG(LEV_ERROR, MOD_APL, L"appendCertRef() Error decoding certificate data");
 		return;
@@ -356,7 +386,6 @@ static void appendCertRef(XERCES_CPP_NAMESPACE::DOMDocument *doc, APL_Certif *ce
 
 	std::string issuer = x509NameToString(X509_get_issuer_name(x509Cert));
 	std::string serial = x509GetSerialAsString(x509Cert);
-	X509_free(x509Cert);
 
 	XMLCh *CertDigest = EncodeToBase64XMLCh(cert_digest, SHA256_LEN);
 
@@ -831,6 +860,10 @@ CByteArray &XadesSignature::sign(const char **paths, unsigned int pathCount, zip
 	if (m_doLTV) {
 		digest_state = EVP_MD_CTX_new();
 		EVP_DigestInit_ex(digest_state, EVP_sha256(), NULL);
+
+		// The OCSP responses of the card certificates are fetched while the files are signed
+		if (m_pcard)
+			static_cast<APL_SmartCard *>(m_pcard)->prefetchOcspResponses();
 	}
 
 	std::basic_string<XMLCh> signature_id = generateNodeID();
@@ -1024,6 +1057,7 @@ void XadesSignature::signASiC(const char *path) {
 		paths.push_back(s.c_str());
 	}
 
+	ZipAppender::recoverIfNeeded(path);
 	if ((container = zip_open(path, ZIP_CHECKCONS | ZIP_RDONLY, &status)) == NULL) {
 		MWLOG(LEV_ERROR, MOD_APL, "zip_open() failed with error code: %d", status);
 		throw CMWEXCEPTION(EIDMW_PERMISSION_DENIED);
@@ -1034,22 +1068,277 @@ void XadesSignature::signASiC(const char *path) {
 	CByteArray &sigXml = sign(&paths[0], (unsigned int) paths.size(), container);
 	terminateXMLUtils();
 
-	const char *uniqueFileName = NULL;
-	if ((uniqueFileName = asic.getNextSignatureFileName()) == NULL) {
-		MWLOG(LEV_ERROR, MOD_APL, "signASiC(): failed to generate new filename for signature xml");
-		free(container);
-		throw CMWEXCEPTION(EIDMW_XADES_UNKNOWN_ERROR);
-	}
-
 	if (zip_close(container) < 0) {
 		MWLOG(LEV_ERROR, MOD_APL, "signASiC(): zip_close() failed with error msg: %s",
 			  zip_error_strerror(zip_get_error(container)));
 		free(container);
-		free((char *)uniqueFileName);
 		throw CMWEXCEPTION(EIDMW_PERMISSION_DENIED);
 	}
 
-	asic.addSignature(uniqueFileName, sigXml);
+	asic.addSignature(sigXml);
+}
+
+static bool readFileInContainer(zip_t *container, zip_uint64_t index, CByteArray &data) {
+	zip_file_t *zf;
+	if ((zf = zip_fopen_index(container, index, 0)) == NULL) {
+		MWLOG(LEV_ERROR, MOD_APL, "XadesSignature::readFileInContainer: zip_fopen_index() failed");
+		return false;
+	}
+
+	const int BUFSIZE = 4 * 1024;
+	unsigned char buffer[BUFSIZE];
+	zip_int64_t read = 0;
+	while ((read = zip_fread(zf, buffer, BUFSIZE)) > 0)
+		data.Append(buffer, (unsigned long)read);
+	zip_fclose(zf);
+
+	return read == 0;
+}
+
+static bool isSHA256Reference(DSIGReference *ref) {
+#if _XSEC_VERSION_FULL >= 20000L
+	return XMLString::equals(ref->getAlgorithmURI(), DSIGConstants::s_unicodeStrURISHA256);
+#else
+	return ref->getHashMethod() == HASH_SHA256;
+#endif
+}
+
+static std::string getSigningTime(DOMElement *sigNode) {
+	XMLCh *ns = XMLString::transcode(XADES_NAMESPACE);
+	XMLCh *tagname = XMLString::transcode("SigningTime");
+	DOMNodeList *nodes = sigNode->getElementsByTagNameNS(ns, tagname);
+	XMLString::release(&ns);
+	XMLString::release(&tagname);
+
+	std::string signingTime;
+	if (nodes->getLength() > 0) {
+		char *text = XMLString::transcode(nodes->item(0)->getTextContent());
+		signingTime = text;
+		XMLString::release(&text);
+	}
+	return signingTime;
+}
+
+/* Verify one ds:Signature element: SignatureValue against each of the KeyInfo certificates, the
+   same-document references through xml-security-c and the references to the container files by
+   streaming them out of the zip. The container files whose digest matched are added to signedFiles */
+static void verifyXadesSignature(XSECProvider &prov, DOMDocument *doc, DOMElement *sigNode, zip_t *container,
+								 SignatureVerifyResult &result, DocumentVerifyReport &report,
+								 std::set<std::string> &signedFiles) {
+	auto start = std::chrono::steady_clock::now();
+	auto elapsedMs = [&start]() {
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		start = std::chrono::steady_clock::now();
+		return ms;
+	};
+
+	DSIGSignature *sig = prov.newSignatureFromDOM(doc, sigNode);
+	try {
+		sig->setIdByAttributeName(true);
+		sig->registerIdAttributeName(s_Id);
+		sig->load();
+
+		std::vector<X509 *> keyInfoCerts;
+		DSIGKeyInfoList *keyInfoList = sig->getKeyInfoList();
+		for (size_t i = 0; keyInfoList && i < keyInfoList->getSize(); i++) {
+			DSIGKeyInfo *keyInfo = keyInfoList->item(i);
+			if (keyInfo->getKeyInfoType() != DSIGKeyInfo::KEYINFO_X509)
+				continue;
+
+			DSIGKeyInfoX509 *keyInfoX509 = static_cast<DSIGKeyInfoX509 *>(keyInfo);
+			for (int j = 0; j < keyInfoX509->getCertificateListSize(); j++) {
+				OpenSSLCryptoX509 *x509 = static_cast<OpenSSLCryptoX509 *>(keyInfoX509->getCertificateCryptoItem(j));
+				if (x509 == NULL || x509->getOpenSSLX509() == NULL)
+					continue;
+
+				X509 *cert = x509->getOpenSSLX509();
+				unsigned char *der = NULL;
+				int len = i2d_X509(cert, &der);
+				if (len > 0) {
+					result.certificates.push_back(CByteArray(der, len));
+					keyInfoCerts.push_back(cert);
+				}
+				OPENSSL_free(der);
+			}
+		}
+		report.parseMs += elapsedMs();
+
+		bool digestOk = true;
+		DSIGReferenceList *refs = sig->getReferenceList();
+		for (size_t i = 0; refs && i < refs->getSize() && digestOk; i++) {
+			DSIGReference *ref = refs->item(i);
+			char *uri = XMLString::transcode(ref->getURI());
+			std::string uriStr = uri ? uri : "";
+			XMLString::release(&uri);
+
+			if (!uriStr.empty() && uriStr[0] == '#') {
+				digestOk = ref->checkHash();
+				continue;
+			}
+
+			if (!isSHA256Reference(ref)) {
+				MWLOG(LEV_ERROR, MOD_APL, "XadesSignature::verifyASiC: unsupported digest algorithm for %s",
+					  uriStr.c_str());
+				digestOk = false;
+				continue;
+			}
+
+			XMLByte expected[SHA256_LEN];
+			std::string fileName = urlDecode(uriStr);
+			CByteArray fileHash = hashFileInContainer(container, fileName.c_str(), NULL);
+			digestOk = fileHash.Size() == SHA256_LEN && ref->readHash(expected, SHA256_LEN) == SHA256_LEN &&
+					   memcmp(expected, fileHash.GetBytes(), SHA256_LEN) == 0;
+			if (digestOk)
+				signedFiles.insert(fileName);
+		}
+		report.hashMs += elapsedMs();
+
+		X509 *signer = NULL;
+		for (size_t i = 0; i < keyInfoCerts.size() && signer == NULL; i++) {
+			OpenSSLCryptoX509 x509(keyInfoCerts[i]);
+			sig->setSigningKey(x509.clonePublicKey());
+			try {
+				if (sig->verifySignatureOnly())
+					signer = keyInfoCerts[i];
+			} catch (XSECException &) {
+				// Key of a different type than the SignatureMethod, try the next certificate
+			} catch (XSECCryptoException &) {
+			}
+		}
+		report.signatureMs += elapsedMs();
+
+		if (signer) {
+			unsigned char *der = NULL;
+			int len = i2d_X509(signer, &der);
+			result.signerCert = CByteArray(der, len > 0 ? len : 0);
+			OPENSSL_free(der);
+
+			char cn[256] = {0};
+			X509_NAME_get_text_by_NID(X509_get_subject_name(signer), NID_commonName, cn, sizeof(cn));
+			result.signerName = cn;
+		}
+		result.signingTime = getSigningTime(sigNode);
+
+		if (!digestOk)
+			result.status = SIGVERIFY_INVALID_DIGEST;
+		else if (signer == NULL)
+			result.status = SIGVERIFY_INVALID_SIGNATURE;
+		else
+			result.status = SIGVERIFY_VALID;
+	} catch (XSECException &e) {
+		MWLOG(LEV_ERROR, MOD_APL, L"XadesSignature::verifyASiC: error loading signature. Message: %s", e.getMsg());
+		result.status = SIGVERIFY_ERROR;
+	} catch (XSECCryptoException &e) {
+		MWLOG(LEV_ERROR, MOD_APL, L"XadesSignature::verifyASiC: error in XSec Crypto Functions. Message: %s",
+			  e.getMsg());
+		result.status = SIGVERIFY_ERROR;
+	}
+
+	prov.releaseSignature(sig);
+}
+
+/* Xerces and xml-security-c initialisation is process-wide, so concurrent verifications are serialised */
+static CMutex s_verifyMutex;
+
+void XadesSignature::verifyASiC(const char *path, DocumentVerifyReport &report) {
+	auto start = std::chrono::steady_clock::now();
+	int status = 0;
+	zip_t *container = NULL;
+	ZipAppender::recoverIfNeeded(path);
+	if ((container = zip_open(path, ZIP_RDONLY, &status)) == NULL) {
+		MWLOG(LEV_ERROR, MOD_APL, "verifyASiC(): zip_open() failed with error code: %d", status);
+		throw CMWEXCEPTION(EIDMW_XADES_INVALID_ASIC_ERROR);
+	}
+
+	std::vector<zip_uint64_t> signatureFiles;
+	std::vector<std::string> dataFiles;
+	zip_int64_t entries = zip_get_num_entries(container, 0);
+	for (zip_int64_t i = 0; i < entries; i++) {
+		const char *name = zip_get_name(container, i, 0);
+		if (name == NULL)
+			continue;
+		size_t len = strlen(name);
+		if (strncmp(name, "META-INF/", 9) == 0) {
+			if (strstr(name, "signature") != NULL && len > 4 && strcmp(name + len - 4, ".xml") == 0)
+				signatureFiles.push_back(i);
+		} else if (strcmp(name, "mimetype") != 0 && len > 0 && name[len - 1] != '/') {
+			dataFiles.push_back(name);
+		}
+	}
+	report.parseMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	CAutoMutex autoMutex(&s_verifyMutex);
+	initXMLUtils();
+
+	std::set<std::string> signedFiles;
+	for (zip_uint64_t index : signatureFiles) {
+		start = std::chrono::steady_clock::now();
+
+		CByteArray xml;
+		if (!readFileInContainer(container, index, xml)) {
+			report.signatures.push_back(SignatureVerifyResult());
+			continue;
+		}
+
+		// The signature files come from untrusted documents: no DTDs, external entities or entity expansion bombs
+		SecurityManager securityManager;
+		XercesDOMParser parser;
+		parser.setDoNamespaces(true);
+		parser.setCreateEntityReferenceNodes(false);
+		parser.setValidationScheme(XercesDOMParser::Val_Never);
+		parser.setLoadExternalDTD(false);
+#if _XERCES_VERSION >= 30200
+		parser.setDisableDefaultEntityResolution(true);
+#endif
+		parser.setSecurityManager(&securityManager);
+		MemBufInputSource source((const XMLByte *)xml.GetBytes(), xml.Size(), "signature");
+		bool parsed = true;
+		try {
+			parser.parse(source);
+			parsed = parser.getErrorCount() == 0;
+		} catch (const XMLException &) {
+			parsed = false;
+		} catch (const SAXException &) {
+			parsed = false;
+		} catch (const DOMException &) {
+			parsed = false;
+		}
+		if (!parsed || parser.getDocument() == NULL) {
+			MWLOG(LEV_ERROR, MOD_APL, "verifyASiC(): failed to parse %s", zip_get_name(container, index, 0));
+			report.signatures.push_back(SignatureVerifyResult());
+			continue;
+		}
+
+		DOMDocument *doc = parser.getDocument();
+		XMLCh *ns = XMLString::transcode(DSIG_NAMESPACE);
+		XMLCh *tagname = XMLString::transcode("Signature");
+		DOMNodeList *sigNodes = doc->getElementsByTagNameNS(ns, tagname);
+		XMLString::release(&ns);
+		XMLString::release(&tagname);
+		report.parseMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (sigNodes == NULL || sigNodes->getLength() == 0) {
+			report.signatures.push_back(SignatureVerifyResult());
+			continue;
+		}
+
+		XSECProvider prov;
+		for (XMLSize_t i = 0; i < sigNodes->getLength(); i++) {
+			report.signatures.push_back(SignatureVerifyResult());
+			verifyXadesSignature(prov, doc, static_cast<DOMElement *>(sigNodes->item(i)), container,
+								 report.signatures.back(), report, signedFiles);
+		}
+	}
+
+	for (const std::string &name : dataFiles) {
+		if (signedFiles.count(name) == 0) {
+			MWLOG(LEV_ERROR, MOD_APL, "verifyASiC(): %s is not signed by any signature", name.c_str());
+			report.unsignedFiles.push_back(name);
+		}
+	}
+
+	terminateXMLUtils();
+	zip_discard(container);
 }
 
 } // namespace eIDMW
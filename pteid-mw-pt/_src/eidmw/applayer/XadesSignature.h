@@ -24,6 +24,7 @@ namespace eIDMW {
 class CByteArray;
 class APL_Card;
 class APL_Certifs;
+struct DocumentVerifyReport;
 
 class XadesSignature {
 public:
@@ -34,6 +35,10 @@ public:
 	EIDMW_APL_API CByteArray &signXades(const char **paths, unsigned int pathCount);
 	EIDMW_APL_API void signASiC(const char *path);
 
+	/* Verify the XAdES signatures of an ASiC-E container, appending one SignatureVerifyResult per signature.
+	   The signer chain is not checked here, see SignatureVerifier */
+	EIDMW_APL_API static void verifyASiC(const char *path, DocumentVerifyReport &report);
+
 	void enableTimestamp() { m_doTimestamp = true; };
 	void enableLongTermValidation() { m_doLTV = true; };
 
@@ -0,0 +1,566 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#include "ZipAppender.h"
+
+#include "eidErrors.h"
+#include "Log.h"
+#include "MWException.h"
+#include "Util.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace eIDMW {
+
+#define ZIP_LOCAL_HEADER_SIGNATURE 0x04034b50
+#define ZIP_CENTRAL_HEADER_SIGNATURE 0x02014b50
+#define ZIP_EOCD_SIGNATURE 0x06054b50
+#define ZIP64_EOCD_SIGNATURE 0x06064b50
+#define ZIP64_LOCATOR_SIGNATURE 0x07064b50
+
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_EOCD_SIZE 22
+#define ZIP64_EOCD_SIZE 56
+#define ZIP64_LOCATOR_SIZE 20
+
+#define ZIP_VERSION_DEFLATE 20
+#define ZIP_VERSION_ZIP64 45
+#define ZIP_MADE_BY_UNIX 0x0300 /* libzip also writes its entries as made on UNIX, on every platform */
+#define ZIP_FLAG_UTF8 0x0800
+#define ZIP_METHOD_STORE 0
+#define ZIP_METHOD_DEFLATE 8
+
+/* Central directories bigger than this are left to libzip, they are only ever a few KB in ASiC containers */
+#define ZIP_APPEND_MAX_CENTRAL_DIRECTORY (64 * 1024 * 1024)
+
+/* Recovery file: magic, offset of the original tail, original file size, then the tail */
+#define ZIP_RECOVERY_SUFFIX ".append-recovery"
+#define ZIP_RECOVERY_MAGIC "PTEIDZAR"
+#define ZIP_RECOVERY_HEADER_SIZE 24
+
+static unsigned int get16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+
+static unsigned long get32(const unsigned char *p) { return get16(p) | ((unsigned long)get16(p + 2) << 16); }
+
+static unsigned long long get64(const unsigned char *p) {
+	return get32(p) | ((unsigned long long)get32(p + 4) << 32);
+}
+
+static void put16(std::vector<unsigned char> &v, unsigned int i) {
+	v.push_back((unsigned char)(i & 0xff));
+	v.push_back((unsigned char)((i >> 8) & 0xff));
+}
+
+static void put32(std::vector<unsigned char> &v, unsigned long i) {
+	put16(v, i & 0xffff);
+	put16(v, (i >> 16) & 0xffff);
+}
+
+static void put64(std::vector<unsigned char> &v, unsigned long long i) {
+	put32(v, (unsigned long)(i & 0xffffffff));
+	put32(v, (unsigned long)(i >> 32));
+}
+
+static bool seekFile(FILE *f, long long offset, int whence) {
+#ifdef WIN32
+	return _fseeki64(f, offset, whence) == 0;
+#else
+	return fseeko(f, (off_t)offset, whence) == 0;
+#endif
+}
+
+static bool readAt(FILE *f, unsigned long long offset, unsigned char *buffer, size_t len) {
+	return seekFile(f, (long long)offset, SEEK_SET) && fread(buffer, 1, len, f) == len;
+}
+
+static FILE *openFile(const std::string &path, const char *mode) {
+#ifdef WIN32
+	return _wfopen(utilStringWiden(path).c_str(), utilStringWiden(mode).c_str());
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+
+static bool syncFile(FILE *f) {
+	if (fflush(f) != 0)
+		return false;
+#ifdef WIN32
+	return _commit(_fileno(f)) == 0;
+#else
+	return fsync(fileno(f)) == 0;
+#endif
+}
+
+static void dosDateTime(unsigned int &dosDate, unsigned int &dosTime) {
+	time_t rawtime = time(NULL);
+	struct tm timeinfo;
+#ifdef WIN32
+	localtime_s(&timeinfo, &rawtime);
+#else
+	localtime_r(&rawtime, &timeinfo);
+#endif
+
+	dosDate = ((timeinfo.tm_year - 80) << 9) | ((timeinfo.tm_mon + 1) << 5) | timeinfo.tm_mday;
+	dosTime = (timeinfo.tm_hour << 11) | (timeinfo.tm_min << 5) | (timeinfo.tm_sec / 2);
+}
+
+ZipAppender::ZipAppender()
+	: m_file(NULL), m_fileSize(0), m_cdOffset(0), m_cdSize(0), m_entries(0), m_zip64(false), m_writeOffset(0),
+	  m_modified(false) {}
+
+ZipAppender::~ZipAppender() {
+	if (m_file == NULL)
+		return;
+
+	try {
+		rollback();
+	} catch (CMWException &) {
+	}
+}
+
+bool ZipAppender::open(const char *path) {
+	m_path = path;
+	m_recoveryPath = m_path + ZIP_RECOVERY_SUFFIX;
+	m_file = openFile(m_path, "r+b");
+	if (m_file == NULL) {
+		MWLOG(LEV_DEBUG, MOD_APL, "ZipAppender: failed to open %s errno: %d", path, errno);
+		return false;
+	}
+
+	if (!lock() || !recover()) {
+		fclose(m_file);
+		m_file = NULL;
+		return false;
+	}
+
+	long long fileSize = -1;
+	if (seekFile(m_file, 0, SEEK_END)) {
+#ifdef WIN32
+		fileSize = _ftelli64(m_file);
+#else
+		fileSize = ftello(m_file);
+#endif
+	}
+	m_fileSize = fileSize < 0 ? 0 : (unsigned long long)fileSize;
+
+	if (fileSize < 0 || !readEndOfCentralDirectory() || !readCentralDirectory()) {
+		MWLOG(LEV_DEBUG, MOD_APL, "ZipAppender: can't append to %s", path);
+		fclose(m_file);
+		m_file = NULL;
+		return false;
+	}
+
+	m_writeOffset = m_cdOffset;
+	return true;
+}
+
+bool ZipAppender::recoverIfNeeded(const char *path) {
+	std::string recoveryPath = std::string(path) + ZIP_RECOVERY_SUFFIX;
+	FILE *f = openFile(recoveryPath, "rb");
+	if (f == NULL)
+		return true;
+	fclose(f);
+
+	// An appender holding the lock removes the recovery file when it's done
+	ZipAppender appender;
+	appender.m_path = path;
+	appender.m_recoveryPath = recoveryPath;
+	appender.m_file = openFile(appender.m_path, "r+b");
+	if (appender.m_file == NULL) {
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: failed to open %s for recovery errno: %d", path, errno);
+		return false;
+	}
+
+	bool recovered = appender.lock() && appender.recover();
+	fclose(appender.m_file);
+	appender.m_file = NULL;
+	return recovered;
+}
+
+/* Exclusive lock on the whole file, waiting if another process holds it */
+bool ZipAppender::lock() {
+#ifdef WIN32
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	bool locked = LockFileEx((HANDLE)_get_osfhandle(_fileno(m_file)), LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD,
+							 &overlapped) != 0;
+#else
+	struct flock fl;
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = 0;
+	fl.l_len = 0; /* to EOF */
+	bool locked = fcntl(fileno(m_file), F_SETLKW, &fl) != -1;
+#endif
+	if (!locked)
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: failed to lock %s errno: %d", m_path.c_str(), errno);
+	return locked;
+}
+
+/* Write back the original tail saved by an appender that didn't finish. Returns false if there's a recovery file
+   that can't be applied, the zip file is then left alone */
+bool ZipAppender::recover() {
+	FILE *f = openFile(m_recoveryPath, "rb");
+	if (f == NULL)
+		return true;
+
+	unsigned char header[ZIP_RECOVERY_HEADER_SIZE];
+	std::vector<unsigned char> tail;
+	bool ok = fread(header, 1, sizeof(header), f) == sizeof(header) &&
+			  memcmp(header, ZIP_RECOVERY_MAGIC, 8) == 0;
+	unsigned long long offset = ok ? get64(header + 8) : 0;
+	unsigned long long fileSize = ok ? get64(header + 16) : 0;
+	if (ok && offset <= fileSize && fileSize - offset <= ZIP_APPEND_MAX_CENTRAL_DIRECTORY) {
+		tail.resize((size_t)(fileSize - offset));
+		ok = fread(tail.data(), 1, tail.size(), f) == tail.size() && fgetc(f) == EOF;
+	} else {
+		ok = false;
+	}
+	fclose(f);
+
+	if (!ok) {
+		// Crashed while saving it, before the zip file was written to
+		MWLOG(LEV_WARN, MOD_APL, "ZipAppender: discarding incomplete recovery file of %s", m_path.c_str());
+		return remove(m_recoveryPath.c_str()) == 0;
+	}
+
+	MWLOG(LEV_WARN, MOD_APL, "ZipAppender: restoring %s from an interrupted append", m_path.c_str());
+	// The recovery file being applied must not be replaced by write()
+	m_modified = true;
+	try {
+		write(offset, tail.data(), tail.size());
+		truncate(fileSize);
+		sync();
+		m_modified = false;
+		removeRecoveryCopy();
+	} catch (CMWException &) {
+		m_modified = false;
+		return false;
+	}
+	return true;
+}
+
+void ZipAppender::saveRecoveryCopy() {
+	std::vector<unsigned char> header(ZIP_RECOVERY_MAGIC, ZIP_RECOVERY_MAGIC + 8);
+	put64(header, m_cdOffset);
+	put64(header, m_fileSize);
+
+	FILE *f = openFile(m_recoveryPath, "wb");
+	bool ok = f != NULL && fwrite(header.data(), 1, header.size(), f) == header.size() &&
+			  fwrite(m_originalTail.data(), 1, m_originalTail.size(), f) == m_originalTail.size() && syncFile(f);
+	if (f != NULL && fclose(f) != 0)
+		ok = false;
+	if (!ok) {
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: failed to write %s errno: %d", m_recoveryPath.c_str(), errno);
+		remove(m_recoveryPath.c_str());
+		throw CMWEXCEPTION(EIDMW_ERR_FILE_IO_ERROR);
+	}
+}
+
+void ZipAppender::removeRecoveryCopy() {
+	if (remove(m_recoveryPath.c_str()) != 0)
+		MWLOG(LEV_WARN, MOD_APL, "ZipAppender: failed to remove %s errno: %d", m_recoveryPath.c_str(), errno);
+}
+
+bool ZipAppender::readEndOfCentralDirectory() {
+	if (m_fileSize < ZIP_EOCD_SIZE)
+		return false;
+
+	size_t tailSize = (size_t)std::min<unsigned long long>(m_fileSize, ZIP_EOCD_SIZE + 0xffff);
+	unsigned long long tailOffset = m_fileSize - tailSize;
+	std::vector<unsigned char> tail(tailSize);
+	if (!readAt(m_file, tailOffset, tail.data(), tailSize))
+		return false;
+
+	// The record is the last one whose comment ends exactly at the end of the file
+	size_t pos = tailSize - ZIP_EOCD_SIZE;
+	while (get32(&tail[pos]) != ZIP_EOCD_SIGNATURE || pos + ZIP_EOCD_SIZE + get16(&tail[pos + 20]) != tailSize) {
+		if (pos == 0)
+			return false;
+		pos--;
+	}
+
+	const unsigned char *eocd = &tail[pos];
+	// Multi-disk archives
+	if (get16(eocd + 4) != 0 || get16(eocd + 6) != 0 || get16(eocd + 8) != get16(eocd + 10))
+		return false;
+
+	m_entries = get16(eocd + 10);
+	m_cdSize = get32(eocd + 12);
+	m_cdOffset = get32(eocd + 16);
+	m_comment.assign(eocd + ZIP_EOCD_SIZE, eocd + ZIP_EOCD_SIZE + get16(eocd + 20));
+
+	unsigned long long eocdOffset = tailOffset + pos;
+	unsigned long long cdEnd = eocdOffset;
+
+	unsigned char locator[ZIP64_LOCATOR_SIZE];
+	if (eocdOffset >= ZIP64_LOCATOR_SIZE &&
+		readAt(m_file, eocdOffset - ZIP64_LOCATOR_SIZE, locator, ZIP64_LOCATOR_SIZE) &&
+		get32(locator) == ZIP64_LOCATOR_SIGNATURE) {
+		unsigned long long zip64Offset = get64(locator + 8);
+		unsigned char record[ZIP64_EOCD_SIZE];
+		if (get32(locator + 4) != 0 || get32(locator + 16) != 1 ||
+			zip64Offset + ZIP64_EOCD_SIZE > eocdOffset - ZIP64_LOCATOR_SIZE ||
+			!readAt(m_file, zip64Offset, record, ZIP64_EOCD_SIZE) || get32(record) != ZIP64_EOCD_SIGNATURE)
+			return false;
+		if (get32(record + 16) != 0 || get32(record + 20) != 0 || get64(record + 24) != get64(record + 32))
+			return false;
+
+		m_entries = get64(record + 32);
+		m_cdSize = get64(record + 40);
+		m_cdOffset = get64(record + 48);
+		cdEnd = zip64Offset;
+		m_zip64 = true;
+	}
+
+	// Data before the first entry, as in self-extracting archives, would shift every offset
+	return m_cdOffset <= cdEnd && cdEnd - m_cdOffset == m_cdSize;
+}
+
+bool ZipAppender::readCentralDirectory() {
+	if (m_cdSize > ZIP_APPEND_MAX_CENTRAL_DIRECTORY || m_fileSize - m_cdOffset > ZIP_APPEND_MAX_CENTRAL_DIRECTORY)
+		return false;
+
+	m_originalTail.resize((size_t)(m_fileSize - m_cdOffset));
+	if (!readAt(m_file, m_cdOffset, m_originalTail.data(), m_originalTail.size()))
+		return false;
+	m_centralDirectory.assign(m_originalTail.begin(), m_originalTail.begin() + (size_t)m_cdSize);
+
+	const std::vector<unsigned char> &cd = m_centralDirectory;
+	size_t pos = 0;
+	for (unsigned long long i = 0; i < m_entries; i++) {
+		if (pos + ZIP_CENTRAL_HEADER_SIZE > cd.size() || get32(&cd[pos]) != ZIP_CENTRAL_HEADER_SIGNATURE)
+			return false;
+
+		size_t nameLen = get16(&cd[pos + 28]);
+		size_t entrySize = ZIP_CENTRAL_HEADER_SIZE + nameLen + get16(&cd[pos + 30]) + get16(&cd[pos + 32]);
+		if (pos + entrySize > cd.size())
+			return false;
+
+		m_names.insert(std::string((const char *)&cd[pos + ZIP_CENTRAL_HEADER_SIZE], nameLen));
+		pos += entrySize;
+	}
+
+	return pos == cd.size();
+}
+
+bool ZipAppender::hasEntry(const char *name) const { return m_names.find(name) != m_names.end(); }
+
+void ZipAppender::addEntry(const char *name, const unsigned char *data, size_t len) {
+	size_t nameLen = strlen(name);
+	if (m_file == NULL || nameLen == 0 || nameLen > 0xffff || len >= 0xffffffff || hasEntry(name)) {
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: can't add entry %s", name);
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_BAD);
+	}
+
+	unsigned long crc = crc32(crc32(0L, Z_NULL, 0), data, (uInt)len);
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	std::vector<unsigned char> compressed;
+	bool deflated = false;
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+		compressed.resize(deflateBound(&zs, (uLong)len));
+		zs.next_in = (Bytef *)data;
+		zs.avail_in = (uInt)len;
+		zs.next_out = compressed.data();
+		zs.avail_out = (uInt)compressed.size();
+		deflated = deflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out < len;
+		deflateEnd(&zs);
+	}
+	const unsigned char *entryData = deflated ? compressed.data() : data;
+	size_t entrySize = deflated ? (size_t)zs.total_out : len;
+	unsigned int method = deflated ? ZIP_METHOD_DEFLATE : ZIP_METHOD_STORE;
+
+	unsigned int flags = 0;
+	for (size_t i = 0; i < nameLen; i++) {
+		if ((unsigned char)name[i] >= 0x80)
+			flags = ZIP_FLAG_UTF8;
+	}
+
+	unsigned int dosDate, dosTime;
+	dosDateTime(dosDate, dosTime);
+
+	std::vector<unsigned char> header;
+	put32(header, ZIP_LOCAL_HEADER_SIGNATURE);
+	put16(header, ZIP_VERSION_DEFLATE);
+	put16(header, flags);
+	put16(header, method);
+	put16(header, dosTime);
+	put16(header, dosDate);
+	put32(header, crc);
+	put32(header, (unsigned long)entrySize);
+	put32(header, (unsigned long)len);
+	put16(header, (unsigned int)nameLen);
+	put16(header, 0);
+	header.insert(header.end(), name, name + nameLen);
+
+	unsigned long long localOffset = m_writeOffset;
+	try {
+		write(localOffset, header.data(), header.size());
+		write(localOffset + header.size(), entryData, entrySize);
+	} catch (CMWException &) {
+		rollback();
+		throw;
+	}
+	m_writeOffset = localOffset + header.size() + entrySize;
+
+	// Offsets past 4 GB go in a ZIP64 extra field
+	bool zip64Offset = localOffset >= 0xffffffff;
+	std::vector<unsigned char> &cd = m_centralDirectory;
+	put32(cd, ZIP_CENTRAL_HEADER_SIGNATURE);
+	put16(cd, ZIP_MADE_BY_UNIX | (zip64Offset ? ZIP_VERSION_ZIP64 : ZIP_VERSION_DEFLATE));
+	put16(cd, zip64Offset ? ZIP_VERSION_ZIP64 : ZIP_VERSION_DEFLATE);
+	put16(cd, flags);
+	put16(cd, method);
+	put16(cd, dosTime);
+	put16(cd, dosDate);
+	put32(cd, crc);
+	put32(cd, (unsigned long)entrySize);
+	put32(cd, (unsigned long)len);
+	put16(cd, (unsigned int)nameLen);
+	put16(cd, zip64Offset ? 12 : 0);
+	put16(cd, 0); /* comment length */
+	put16(cd, 0); /* disk number */
+	put16(cd, 0); /* internal attributes */
+	put32(cd, 0100644UL << 16); /* regular file, rw-r--r-- */
+	put32(cd, zip64Offset ? 0xffffffff : (unsigned long)localOffset);
+	cd.insert(cd.end(), name, name + nameLen);
+	if (zip64Offset) {
+		put16(cd, 0x0001);
+		put16(cd, 8);
+		put64(cd, localOffset);
+	}
+
+	m_entries++;
+	m_names.insert(name);
+}
+
+void ZipAppender::commit() {
+	if (m_file == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_BAD);
+
+	unsigned long long cdOffset = m_writeOffset;
+	unsigned long long cdSize = m_centralDirectory.size();
+
+	std::vector<unsigned char> end;
+	if (m_zip64 || m_entries >= 0xffff || cdOffset >= 0xffffffff || cdSize >= 0xffffffff) {
+		unsigned long long zip64Offset = cdOffset + cdSize;
+		put32(end, ZIP64_EOCD_SIGNATURE);
+		put64(end, ZIP64_EOCD_SIZE - 12);
+		put16(end, ZIP_MADE_BY_UNIX | ZIP_VERSION_ZIP64);
+		put16(end, ZIP_VERSION_ZIP64);
+		put32(end, 0);
+		put32(end, 0);
+		put64(end, m_entries);
+		put64(end, m_entries);
+		put64(end, cdSize);
+		put64(end, cdOffset);
+
+		put32(end, ZIP64_LOCATOR_SIGNATURE);
+		put32(end, 0);
+		put64(end, zip64Offset);
+		put32(end, 1);
+	}
+
+	put32(end, ZIP_EOCD_SIGNATURE);
+	put16(end, 0);
+	put16(end, 0);
+	put16(end, (unsigned int)std::min<unsigned long long>(m_entries, 0xffff));
+	put16(end, (unsigned int)std::min<unsigned long long>(m_entries, 0xffff));
+	put32(end, (unsigned long)std::min<unsigned long long>(cdSize, 0xffffffff));
+	put32(end, (unsigned long)std::min<unsigned long long>(cdOffset, 0xffffffff));
+	put16(end, (unsigned int)m_comment.size());
+	end.insert(end.end(), m_comment.begin(), m_comment.end());
+
+	try {
+		write(cdOffset, m_centralDirectory.data(), m_centralDirectory.size());
+		write(cdOffset + cdSize, end.data(), end.size());
+		sync();
+	} catch (CMWException &) {
+		rollback();
+		throw;
+	}
+	removeRecoveryCopy();
+	m_modified = false;
+
+	int ret = fclose(m_file);
+	m_file = NULL;
+	if (ret != 0) {
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: failed to close %s errno: %d", m_path.c_str(), errno);
+		throw CMWEXCEPTION(EIDMW_ERR_FILE_IO_ERROR);
+	}
+}
+
+void ZipAppender::write(unsigned long long offset, const unsigned char *data, size_t len) {
+	if (!m_modified) {
+		saveRecoveryCopy();
+		m_modified = true;
+	}
+	if (!seekFile(m_file, (long long)offset, SEEK_SET) || fwrite(data, 1, len, m_file) != len) {
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: failed to write to %s errno: %d", m_path.c_str(), errno);
+		throw CMWEXCEPTION(EIDMW_ERR_FILE_IO_ERROR);
+	}
+}
+
+void ZipAppender::truncate(unsigned long long size) {
+	if (fflush(m_file) != 0)
+		throw CMWEXCEPTION(EIDMW_ERR_FILE_IO_ERROR);
+#ifdef WIN32
+	bool ok = _chsize_s(_fileno(m_file), (long long)size) == 0;
+#else
+	bool ok = ftruncate(fileno(m_file), (off_t)size) == 0;
+#endif
+	if (!ok) {
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: failed to truncate %s errno: %d", m_path.c_str(), errno);
+		throw CMWEXCEPTION(EIDMW_ERR_FILE_IO_ERROR);
+	}
+}
+
+void ZipAppender::sync() {
+	if (!syncFile(m_file)) {
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: failed to sync %s errno: %d", m_path.c_str(), errno);
+		throw CMWEXCEPTION(EIDMW_ERR_FILE_IO_ERROR);
+	}
+}
+
+/* Put back the original central directory and end records over whatever was written, and close the file. If that
+   fails the recovery file is kept for the next open() */
+void ZipAppender::rollback() {
+	FILE *file = m_file;
+	bool restored = true;
+	if (m_modified) {
+		try {
+			write(m_cdOffset, m_originalTail.data(), m_originalTail.size());
+			truncate(m_fileSize);
+			sync();
+			removeRecoveryCopy();
+		} catch (CMWException &) {
+			restored = false;
+		}
+	}
+
+	m_file = NULL;
+	m_modified = false;
+	if (fclose(file) != 0 || !restored)
+		MWLOG(LEV_ERROR, MOD_APL, "ZipAppender: failed to restore %s, the zip file may be damaged", m_path.c_str());
+}
+
+} // namespace eIDMW
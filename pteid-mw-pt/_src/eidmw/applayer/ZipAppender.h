@@ -0,0 +1,87 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+#ifndef __ZIP_APPENDER_H
+#define __ZIP_APPENDER_H
+
+#include <stdio.h>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace eIDMW {
+
+/*
+ * ZipAppender adds entries to an existing zip file in place. The new entries are written where the central
+ * directory starts and the central directory is written again after them, so the data of the existing entries
+ * is never read, copied or recompressed and the cost of adding an entry doesn't depend on the size of the file.
+ *
+ * open() returns false for the files it can't append to (multi-disk archives, data before the first entry,
+ * I/O errors) and the caller should fall back to rewriting the file with libzip. The file is locked for writing
+ * until it's closed. Until commit() succeeds the original end of the file is kept in memory and it's written back
+ * if anything fails, or if the appender is destroyed without committing. Before the first write it's also saved
+ * and synced to a recovery file next to the zip file, removed once the new end records are synced, so that
+ * open() can repair a file left half written by a crash. Code that opens the zip file with libzip calls
+ * recoverIfNeeded() first.
+ */
+class ZipAppender {
+public:
+	ZipAppender();
+	~ZipAppender();
+
+	bool open(const char *path);
+
+	/* Repair the file if an appender was interrupted, waiting for one still running. Returns false if it needed
+	   recovery and that failed */
+	static bool recoverIfNeeded(const char *path);
+
+	bool hasEntry(const char *name) const;
+
+	/* Add an entry from memory, deflated unless it doesn't get smaller */
+	void addEntry(const char *name, const unsigned char *data, size_t len);
+
+	/* Write the central directory and close the file */
+	void commit();
+
+private:
+	ZipAppender(const ZipAppender &);
+	ZipAppender &operator=(const ZipAppender &);
+
+	bool readEndOfCentralDirectory();
+	bool readCentralDirectory();
+
+	bool lock();
+	bool recover();
+	void saveRecoveryCopy();
+	void removeRecoveryCopy();
+
+	void write(unsigned long long offset, const unsigned char *data, size_t len);
+	void truncate(unsigned long long size);
+	void sync();
+	void rollback();
+
+	FILE *m_file;
+	std::string m_path;
+	std::string m_recoveryPath;
+	unsigned long long m_fileSize;
+
+	unsigned long long m_cdOffset; /* Where the central directory started, the new entries are written from here */
+	unsigned long long m_cdSize;
+	unsigned long long m_entries;
+	bool m_zip64;
+	std::vector<unsigned char> m_comment;
+
+	std::vector<unsigned char> m_centralDirectory; /* Existing entries followed by the new ones */
+	std::vector<unsigned char> m_originalTail;	   /* Bytes from m_cdOffset to the end of the original file */
+	std::set<std::string> m_names;
+
+	unsigned long long m_writeOffset;
+	bool m_modified;
+};
+
+} // namespace eIDMW
+
+#endif
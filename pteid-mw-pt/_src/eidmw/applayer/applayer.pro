@@ -94,8 +94,10 @@ HEADERS += \
 	APLCardPteid.h   \
 	PhotoPteid.h \
 	SecurityContext.h  \
+	SharedCertStore.h \
 	APLPublicKey.h \
 	SigContainer.h \
+	ZipAppender.h \
 	XadesSignature.h \
 	TSAClient.h \
 	SODParser.h \ 
@@ -103,6 +105,10 @@ HEADERS += \
 	SSLConnection.h \
 	PNGConverter.h \
 	PAdESExtender.h \
+	PAdESBatchExtender.h \
+	SignatureVerifier.h \
+	ValidationDataCache.h \
+	OcspResponseCache.h \
 	J2KHelper.h \
 	PDFSignature.h \
 	CurlUtil.h \
@@ -126,6 +132,7 @@ SOURCES += \
 	PhotoPteid.cpp \
 	APLPublicKey.cpp \
 	SigContainer.cpp \
+	ZipAppender.cpp \
 	XadesSignature.cpp \
 	RemoteAddress.cpp  \
 	RemoteAddressRequest.cpp \
@@ -133,11 +140,16 @@ SOURCES += \
 	SSLConnection.cpp \
 	TSAClient.cpp \
 	SecurityContext.cpp \
+	SharedCertStore.cpp \
 	sign-pkcs7.cpp \
 	cJSON.c \
 	PKIFetcher.cpp \
 	PDFSignature.cpp \
 	PAdESExtender.cpp \
+	PAdESBatchExtender.cpp \
+	SignatureVerifier.cpp \
+	ValidationDataCache.cpp \
+	OcspResponseCache.cpp \
 	MutualAuthentication.cpp \
 	PNGConverter.cpp \
 	J2KHelper.cpp \
@@ -34,6 +34,7 @@
 #include "APLConfig.h"
 #include "APLCardPteid.h"
 #include "PKIFetcher.h"
+#include "SharedCertStore.h"
 
 #include "MiscUtil.h"
 #include "Thread.h"
@@ -61,28 +62,18 @@ namespace eIDMW {
 /* **********************************
 *** Internal class CrlMemoryCache ***
 ********************************** */
+/* Keeps the most recently used CRLs of APL_SharedCertStore alive so that they are not decoded again */
 class CrlMemoryCache {
 
 private:
 	class CrlMemoryElement {
 	public:
-		CrlMemoryElement() {
-			m_baHash = NULL;
-			m_crl = NULL;
-			m_timeStamp.clear();
-		}
+		CrlMemoryElement() { m_timeStamp.clear(); }
 
 		~CrlMemoryElement() { clear(); }
 
 		void clear() {
-			if (m_baHash) {
-				delete m_baHash;
-				m_baHash = NULL;
-			}
-			if (m_crl) {
-				X509_CRL_free(m_crl);
-				m_crl = NULL;
-			}
+			m_crl.reset();
 			m_timeStamp.clear();
 		}
 
@@ -95,30 +86,25 @@ private:
 			return false;
 		}
 
-		bool checkHash(const CByteArray &hash, std::string &timeStamp, bool &bTSChanged) {
+		bool checkCrl(const tSharedCrl &crl, std::string &timeStamp, bool &bTSChanged) {
 			bTSChanged = getOlderTS(timeStamp);
-			if (m_baHash)
-				return m_baHash->Equals(hash);
-			else
-				return false;
+			return m_crl == crl;
 		}
 
 		X509_CRL *getCrl() {
 			CTimestampUtil::getTimestamp(m_timeStamp, 0, "%Y%m%dT%H%M%S" /*YYYYMMDDThhmmss*/);
-			return m_crl;
+			return m_crl->getX509Crl();
 		}
 
-		void setCrl(X509_CRL *crl, const CByteArray &hash) {
+		void setCrl(const tSharedCrl &crl) {
 			clear();
 
-			m_baHash = new CByteArray(hash);
 			m_crl = crl;
 			CTimestampUtil::getTimestamp(m_timeStamp, 0, "%Y%m%dT%H%M%S" /*YYYYMMDDThhmmss*/);
 		}
 
 	private:
-		CByteArray *m_baHash;
-		X509_CRL *m_crl;
+		tSharedCrl m_crl;
 		std::string m_timeStamp;
 	};
 
@@ -134,17 +120,19 @@ public:
 		MWLOG(LEV_INFO, MOD_SSL, L" ---> CrlMemoryCache deleted");
 	}
 
-	X509_CRL *getX509CRL(const CByteArray &crl, const CByteArray &hash) {
+	X509_CRL *getX509CRL(const CByteArray &crl) {
 		int i;
 		bool bTSChanged = false;
 		int iOlder = 0;
 		std::string timeStamp;
-		X509_CRL *pX509CRL = NULL;
+
+		tSharedCrl sharedCrl = APL_SharedCertStore::instance().getCrl(crl);
 
 		// Check if already in the array
-		MWLOG(LEV_DEBUG, MOD_SSL, L"Check for element in CrlMemoryCache hash=%ls", hash.ToWString().c_str());
+		MWLOG(LEV_DEBUG, MOD_SSL, L"Check for element in CrlMemoryCache hash=%ls",
+			  sharedCrl->getHash().ToWString().c_str());
 		for (i = 0; i < CRL_MEMORY_CACHE_SIZE; i++) {
-			if (m_CrlMemoryArray[i].checkHash(hash, timeStamp, bTSChanged)) {
+			if (m_CrlMemoryArray[i].checkCrl(sharedCrl, timeStamp, bTSChanged)) {
 				MWLOG(LEV_DEBUG, MOD_SSL, L" ---> Element found index= %ld", i);
 				return m_CrlMemoryArray[i].getCrl();
 			}
@@ -161,16 +149,10 @@ public:
 		}
 		MWLOG(LEV_DEBUG, MOD_SSL, L" ---> Index found = %ld", iOlder);
 
-		const unsigned char *pTempBuffer = crl.GetBytes();
-
-		pX509CRL = d2i_X509_CRL(&pX509CRL, &pTempBuffer, crl.Size());
-
-		MWLOG(LEV_DEBUG, MOD_SSL, L" ---> OpenSSL structure created");
-
-		m_CrlMemoryArray[iOlder].setCrl(pX509CRL, hash);
+		m_CrlMemoryArray[iOlder].setCrl(sharedCrl);
 		MWLOG(LEV_DEBUG, MOD_SSL, L" ---> Element added");
 
-		return pX509CRL;
+		return sharedCrl->getX509Crl();
 	}
 
 private:
@@ -206,23 +188,8 @@ bool d2i_X509_Wrapper(X509 **pX509, const unsigned char *pucContent, int iConten
 }
 
 unsigned long APL_CryptoFwk::GetCertUniqueID(const CByteArray &cert) {
-	const unsigned char *pucCert = NULL;
-	X509 *pX509 = NULL;
-
-	// Convert cert into pX509
-	pucCert = cert.GetBytes();
-	if (!d2i_X509_Wrapper(&pX509, pucCert, cert.Size()))
-		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
-
-	// The unique ID is made with a hash of issuer and serial
-
-	unsigned long ret;
-	ret = X509_issuer_and_serial_hash(pX509);
-
-	// Free openSSL object
-	X509_free(pX509);
-
-	return ret;
+	// The unique ID is made with a hash of issuer and serial, computed once per shared certificate
+	return APL_SharedCertStore::instance().getCertificate(cert)->getUniqueId();
 }
 
 ASN1_INTEGER *APL_CryptoFwk::getCertSerialNumber(const CByteArray &cert) {
@@ -310,14 +277,15 @@ bool APL_CryptoFwk::VerifyCrlDateValidity(const X509_CRL *pX509_Crl) {
 }
 
 bool APL_CryptoFwk::isSelfIssuer(const CByteArray &cert) {
-	bool bOk = false;
-	const unsigned char *pucCert = NULL;
-	X509 *pX509 = NULL;
+	tSharedCert sharedCert = APL_SharedCertStore::instance().getCertificate(cert);
 
-	// Convert cert into pX509
-	pucCert = cert.GetBytes();
+	return isSelfIssuer(sharedCert->getX509());
+}
 
-	if (!d2i_X509_Wrapper(&pX509, pucCert, cert.Size()))
+bool APL_CryptoFwk::isSelfIssuer(X509 *pX509) {
+	bool bOk = false;
+
+	if (pX509 == NULL)
 		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
 
 	// FIRST CHECK IF THE ISUER NAME IS THE SAME AS THE OWNER (SUBJECT)
@@ -326,26 +294,21 @@ bool APL_CryptoFwk::isSelfIssuer(const CByteArray &cert) {
 		bOk = VerifyCertSignature(pX509, pX509);
 	}
 
-	// Free openSSL object
-	X509_free(pX509);
-
 	return bOk;
 }
 
 bool APL_CryptoFwk::isCrlValid(const CByteArray &crl, const CByteArray &issuer) {
 	bool bOk = false;
-	const unsigned char *pucIssuer = NULL;
 	X509_CRL *pX509_Crl = NULL;
-	X509 *pX509_Issuer = NULL;
 
 	// Convert crl into pX509_Crl
 	if (NULL == (pX509_Crl = getX509CRL(crl)))
 		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
 
-	// Convert issuer into pX509_Issuer
-	pucIssuer = issuer.GetBytes();
+	tSharedCert sharedIssuer = APL_SharedCertStore::instance().getCertificate(issuer);
+	X509 *pX509_Issuer = sharedIssuer->getX509();
 
-	if (!d2i_X509_Wrapper(&pX509_Issuer, pucIssuer, issuer.Size()))
+	if (pX509_Issuer == NULL)
 		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
 
 	bOk = isCrlIssuer(pX509_Crl, pX509_Issuer);
@@ -353,35 +316,25 @@ bool APL_CryptoFwk::isCrlValid(const CByteArray &crl, const CByteArray &issuer)
 	if (bOk)
 		bOk = VerifyCrlDateValidity(pX509_Crl);
 
-	// Free openSSL object
-	if (pX509_Issuer)
-		X509_free(pX509_Issuer);
-
 	return bOk;
 }
 
 bool APL_CryptoFwk::isCrlIssuer(const CByteArray &crl, const CByteArray &issuer) {
 	bool bOk = false;
-	const unsigned char *pucIssuer = NULL;
 	X509_CRL *pX509_Crl = NULL;
-	X509 *pX509_Issuer = NULL;
 
 	// Convert crl into pX509_Crl
 	if (NULL == (pX509_Crl = getX509CRL(crl)))
 		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
 
-	// Convert issuer into pX509_Issuer
-	pucIssuer = issuer.GetBytes();
+	tSharedCert sharedIssuer = APL_SharedCertStore::instance().getCertificate(issuer);
+	X509 *pX509_Issuer = sharedIssuer->getX509();
 
-	if (!d2i_X509_Wrapper(&pX509_Issuer, pucIssuer, issuer.Size()))
+	if (pX509_Issuer == NULL)
 		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
 
 	bOk = isCrlIssuer(pX509_Crl, pX509_Issuer);
 
-	// Free openSSL object
-	if (pX509_Issuer)
-		X509_free(pX509_Issuer);
-
 	return bOk;
 }
 
@@ -402,22 +355,17 @@ bool APL_CryptoFwk::isCrlIssuer(X509_CRL *pX509_Crl, X509 *pX509_Issuer) {
 }
 
 bool APL_CryptoFwk::isIssuer(const CByteArray &cert, const CByteArray &issuer) {
-	bool bOk = false;
-	const unsigned char *pucCert = NULL;
-	const unsigned char *pucIssuer = NULL;
-	X509 *pX509_Cert = NULL;
-	X509 *pX509_Issuer = NULL;
+	APL_SharedCertStore &sharedStore = APL_SharedCertStore::instance();
+	tSharedCert sharedCert = sharedStore.getCertificate(cert);
+	tSharedCert sharedIssuer = sharedStore.getCertificate(issuer);
 
-	// Convert cert into pX509_Cert
-	pucCert = cert.GetBytes();
-
-	if (!d2i_X509_Wrapper(&pX509_Cert, pucCert, cert.Size()))
-		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+	return isIssuer(sharedCert->getX509(), sharedIssuer->getX509());
+}
 
-	// Convert issuer into pX509_Issuer
-	pucIssuer = issuer.GetBytes();
+bool APL_CryptoFwk::isIssuer(X509 *pX509_Cert, X509 *pX509_Issuer) {
+	bool bOk = false;
 
-	if (!d2i_X509_Wrapper(&pX509_Issuer, pucIssuer, issuer.Size()))
+	if (pX509_Cert == NULL || pX509_Issuer == NULL)
 		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
 
 	// FIRST CHECK IF THE ISUER NAME IS THE SAME AS THE OWNER (SUBJECT)
@@ -426,10 +374,6 @@ bool APL_CryptoFwk::isIssuer(const CByteArray &cert, const CByteArray &issuer) {
 		bOk = VerifyCertSignature(pX509_Cert, pX509_Issuer);
 	}
 
-	// Free openSSL object
-	X509_free(pX509_Cert);
-	X509_free(pX509_Issuer);
-
 	return bOk;
 }
 
@@ -673,6 +617,78 @@ cleanup:
 	return eStatus;
 }
 
+FWK_CertifStatus APL_CryptoFwk::VerifyOCSPResponse(const CByteArray &cert, const CByteArray &issuer,
+												   const CByteArray &response) {
+	const unsigned char *pucCert = cert.GetBytes();
+	const unsigned char *pucIssuer = issuer.GetBytes();
+	const unsigned char *pucResponse = response.GetBytes();
+	X509 *pX509_Cert = NULL;
+	X509 *pX509_Issuer = NULL;
+	OCSP_RESPONSE *pOcspResponse = NULL;
+	OCSP_BASICRESP *pBasic = NULL;
+	OCSP_CERTID *pCertID = NULL;
+	X509_STORE *store = NULL;
+	STACK_OF(X509) *intermediate_certs = NULL;
+	ASN1_GENERALIZEDTIME *thisUpdate = NULL;
+	ASN1_GENERALIZEDTIME *nextUpdate = NULL;
+	int iStatus = -1;
+	int iReason = -1;
+	FWK_CertifStatus eStatus = FWK_CERTIF_STATUS_ERROR;
+
+	if (!d2i_X509_Wrapper(&pX509_Cert, pucCert, cert.Size()) ||
+		!d2i_X509_Wrapper(&pX509_Issuer, pucIssuer, issuer.Size()))
+		goto cleanup;
+
+	pOcspResponse = d2i_OCSP_RESPONSE(NULL, &pucResponse, response.Size());
+	if (!pOcspResponse || OCSP_response_status(pOcspResponse) != OCSP_RESPONSE_STATUS_SUCCESSFUL ||
+		!(pBasic = OCSP_response_get1_basic(pOcspResponse)))
+		goto cleanup;
+
+	store = X509_STORE_new();
+	loadCertificatesToOcspStore(store);
+	intermediate_certs = sk_X509_new_null();
+	sk_X509_push(intermediate_certs, pX509_Issuer);
+
+	// Same flags as GetOCSPResponse()
+	if (OCSP_basic_verify(pBasic, intermediate_certs, store, OCSP_NOCHECKS) <= 0) {
+		MWLOG(LEV_ERROR, MOD_APL, "VerifyOCSPResponse: failed to validate OCSP_BASICRESP object! openssl error: %s",
+			  ERR_error_string(ERR_get_error(), NULL));
+		goto cleanup;
+	}
+
+	pCertID = OCSP_cert_to_id(EVP_sha1(), pX509_Cert, pX509_Issuer);
+	if (!pCertID || !OCSP_resp_find_status(pBasic, pCertID, &iStatus, &iReason, NULL, &thisUpdate, &nextUpdate) ||
+		!OCSP_check_validity(thisUpdate, nextUpdate, 300, -1))
+		goto cleanup;
+
+	if (iStatus == V_OCSP_CERTSTATUS_GOOD)
+		eStatus = FWK_CERTIF_STATUS_VALID;
+	else if (iReason == OCSP_REVOKED_STATUS_CERTIFICATEHOLD)
+		eStatus = FWK_CERTIF_STATUS_SUSPENDED;
+	else if (iStatus == V_OCSP_CERTSTATUS_REVOKED)
+		eStatus = FWK_CERTIF_STATUS_REVOKED;
+	else
+		eStatus = FWK_CERTIF_STATUS_UNKNOWN;
+
+cleanup:
+	if (pCertID)
+		OCSP_CERTID_free(pCertID);
+	if (intermediate_certs)
+		sk_X509_free(intermediate_certs);
+	if (store)
+		X509_STORE_free(store);
+	if (pBasic)
+		OCSP_BASICRESP_free(pBasic);
+	if (pOcspResponse)
+		OCSP_RESPONSE_free(pOcspResponse);
+	if (pX509_Cert)
+		X509_free(pX509_Cert);
+	if (pX509_Issuer)
+		X509_free(pX509_Issuer);
+
+	return eStatus;
+}
+
 inline int getSocketError() {
 #ifdef _WIN32
 	return WSAGetLastError();
@@ -1403,12 +1419,7 @@ bool APL_CryptoFwk::getCrlInfo(const CByteArray &crl, tCrlInfo &info, const char
 	return bDownload;
 }
 
-X509_CRL *APL_CryptoFwk::getX509CRL(const CByteArray &crl) {
-	CByteArray baHash;
-	GetHash(crl, EVP_sha1(), &baHash);
-
-	return m_CrlMemoryCache->getX509CRL(crl, baHash);
-}
+X509_CRL *APL_CryptoFwk::getX509CRL(const CByteArray &crl) { return m_CrlMemoryCache->getX509CRL(crl); }
 
 void loadWindowsRootCertificates(X509_STORE *store) {
 #ifdef WIN32
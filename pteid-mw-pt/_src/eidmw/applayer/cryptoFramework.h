@@ -147,6 +147,7 @@ public:
 	  * - Then verify the signature (must be self-signed)
 	  */
 	EIDMW_APL_API bool isSelfIssuer(const CByteArray &cert);
+	bool isSelfIssuer(X509 *pX509);
 
 	/**
 	  * Check if the certificate (cert) has the issuer (issuer)
@@ -155,6 +156,7 @@ public:
 	  * - Then verify the signature
 	  */
 	bool isIssuer(const CByteArray &cert, const CByteArray &issuer);
+	bool isIssuer(X509 *pX509_Cert, X509 *pX509_Issuer);
 
 	/**
 	  * Check if the crl has the issuer (issuer)
@@ -163,6 +165,13 @@ public:
 	  * - Then verify the signature
 	  */
 	bool isCrlIssuer(const CByteArray &crl, const CByteArray &issuer);
+	bool isCrlIssuer(X509_CRL *pX509_Crl, X509 *pX509_issuer);
+
+	/**
+	  * Convert the bytearray into X509_CRL
+	  * The X509_CRL object is owned by the CRL memory cache and MUST NOT be destroyed by the caller
+	  */
+	X509_CRL *getX509CRL(const CByteArray &crl);
 
 	/**
 	  * Check if the crl is valid
@@ -221,6 +230,13 @@ public:
 	FWK_CertifStatus GetOCSPResponse(const CByteArray &cert, const CByteArray &issuer, CByteArray *response,
 									 bool verifyResponse = true);
 
+	/**
+	  * Verify an OCSP response obtained earlier, like GetOCSPResponse() does for a new one: the responder
+	  * signature against the OCSP store and the issuer, the validity period and the status of cert
+	  * @return The status, FWK_CERTIF_STATUS_ERROR if the response doesn't verify
+	  */
+	FWK_CertifStatus VerifyOCSPResponse(const CByteArray &cert, const CByteArray &issuer, const CByteArray &response);
+
 	/**
 	  * Send a OCSP request and get the response
 	  * If issuer is not NULL, the verification of the response is done
@@ -416,12 +432,6 @@ protected:
 	  */
 	void UtcTimeToString(const ASN1_UTCTIME *asn1Time, struct tm &timeinfo);
 
-	/**
-	  * Convert the bytearray into X509_CRL
-	  * Create the X509_CRL object that MUST BE destroyed by the caller
-	  */
-	X509_CRL *getX509CRL(const CByteArray &crl);
-
 	/**
 	  * Verify the validity date of the certificate
 	  */
@@ -432,14 +442,6 @@ protected:
 	  */
 	bool VerifyCrlDateValidity(const X509_CRL *pX509_Crl);
 
-	/**
-	  * Check if the crl has the issuer (issuer)
-	  * 
-	  * - First check if issuer name correspond
-	  * - Then verify the signature
-	  */
-	bool isCrlIssuer(X509_CRL *pX509_Crl, X509 *pX509_issuer);
-
 	APL_SmartCard *m_card = NULL;
 
 	std::string m_proxy_host; /**< proxy host */
@@ -223,19 +223,6 @@ unsigned int SHA1_Wrapper(unsigned char *data, unsigned long data_len, unsigned
 	return md_len;
 }
 
-void add_certificate(PKCS7 *p7, const CByteArray &cert) {
-	const unsigned char *cert_data = cert.GetBytes();
-	X509 *x509 = d2i_X509(NULL, &cert_data, cert.Size());
-	if (x509 == NULL)
-		goto err;
-
-	PKCS7_add_certificate(p7, x509);
-
-	return;
-err:
-	MWLOG(LEV_ERROR, MOD_APL, L"Failed to add certificate from ByteArray");
-}
-
 void add_certificate(PKCS7 *p7, unsigned char *cert_data, unsigned int data_size) {
 
 	X509 *x509 = d2i_X509(NULL, (const unsigned char **)&cert_data, data_size);
@@ -339,7 +326,7 @@ int append_tsp_token(PKCS7_SIGNER_INFO *sinfo, unsigned char *token, int token_l
 	return 0;
 }
 
-int ESS_SIGNING_CERT_V2_add(PKCS7_SIGNER_INFO *si, ESS_SIGNING_CERT_V2 *sc) {
+ASN1_STRING *ESS_SIGNING_CERT_V2_encode(ESS_SIGNING_CERT_V2 *sc) {
 	ASN1_STRING *seq = NULL;
 	unsigned char *p, *pp = NULL;
 	int len = i2d_ESS_SIGNING_CERT_V2(sc, NULL);
@@ -359,16 +346,20 @@ int ESS_SIGNING_CERT_V2_add(PKCS7_SIGNER_INFO *si, ESS_SIGNING_CERT_V2 *sc) {
 	OPENSSL_free(pp);
 	pp = NULL;
 
-	return PKCS7_add_signed_attribute(si, NID_id_smime_aa_signingCertificateV2, V_ASN1_SEQUENCE, seq);
+	return seq;
 err:
 	ASN1_STRING_free(seq);
 	OPENSSL_free(pp);
-	return 0;
+	return NULL;
 }
 
-void add_signingCertificate(PKCS7_SIGNER_INFO *signer_info, X509 *signing_cert) {
+/*
+ * Value of the signing-certificate v2 attribute, added according to the
+ * PAdES specification ETSI TS 103 172 v2.1.1 - section 6.3.1
+ */
+ASN1_STRING *encode_signingCertificate(X509 *signing_cert) {
 
-	int ret = 0;
+	ASN1_STRING *seq = NULL;
 
 	ESS_SIGNING_CERT_V2 *sc = NULL;
 	const int issuer_needed = 1;
@@ -380,19 +371,20 @@ void add_signingCertificate(PKCS7_SIGNER_INFO *signer_info, X509 *signing_cert)
 		goto err;
 	}
 
-	ret = ESS_SIGNING_CERT_V2_add(signer_info, sc);
-	MWLOG(LEV_DEBUG, MOD_APL, "ESS_SIGNING_CERT_V2_add() returned %d", ret);
+	seq = ESS_SIGNING_CERT_V2_encode(sc);
+	ESS_SIGNING_CERT_V2_free(sc);
 
-	if (!ret)
+	if (seq == NULL)
 		goto err;
 
-	return;
+	return seq;
 
 err:
 	MWLOG(LEV_ERROR, MOD_APL, L"Failed to add SigningCertificateV2 attribute.");
+	return NULL;
 }
 
-void addCardCertificateChain(PKCS7 *p7, APL_Card *card) {
+void getCardCertificateChain(APL_Card *card, std::vector<CByteArray> &chain) {
 
 	APL_SmartCard *eid_card = static_cast<APL_SmartCard *>(card);
 	APL_Certifs *certs = eid_card->getCertificates();
@@ -405,37 +397,83 @@ void addCardCertificateChain(PKCS7 *p7, APL_Card *card) {
 		issuer = certif->getIssuer();
 
 		if (issuer == NULL) {
-			MWLOG(LEV_ERROR, MOD_APL, "addCardCertificateChain() Couldn't find issuer for cert: %s",
+			MWLOG(LEV_ERROR, MOD_APL, "getCardCertificateChain() Couldn't find issuer for cert: %s",
 				  certif->getOwnerName());
 			break;
 		}
 
-		MWLOG(LEV_DEBUG, MOD_APL, "signPKCS7: addCardCertificateChain: Loading cert: %s", issuer->getOwnerName());
-		add_certificate(p7, certif->getData());
+		MWLOG(LEV_DEBUG, MOD_APL, "signPKCS7: getCardCertificateChain: Loading cert: %s", issuer->getOwnerName());
+		chain.push_back(certif->getData());
 		certif = issuer;
 	}
 }
 
-void addExternalCertificateChain(PKCS7 *p7, std::vector<CByteArray> ca_certificates) {
+PKCS7Template::PKCS7Template(const CByteArray &certificate, const std::vector<CByteArray> &ca_certificates,
+							 APL_Card *card)
+	: m_certificate(certificate), m_ca_certificates(ca_certificates), m_card(card), m_signer_cert(NULL),
+	  m_signing_cert_v2(NULL) {
+
+	X509 *x509 = DER_to_X509(m_certificate.GetBytes(), m_certificate.Size());
+	if (NULL == x509) {
+		MWLOG(LEV_ERROR, MOD_APL, "PKCS7Template - Error decoding certificate data!");
+		return;
+	}
+
+	std::vector<CByteArray> chain;
+	if (card != NULL && card->getType() != APL_CARDTYPE_PTEID_IAS5) {
+		getCardCertificateChain(card, chain);
+	} else {
+		// For non-card signatures we need to add the supplied CA certificates
+		chain = ca_certificates;
+	}
+
+	for (const CByteArray &cert : chain) {
+		const unsigned char *cert_data = cert.GetBytes();
+		X509 *ca_cert = d2i_X509(NULL, &cert_data, cert.Size());
+		if (ca_cert == NULL) {
+			MWLOG(LEV_ERROR, MOD_APL, L"Failed to add certificate from ByteArray");
+			continue;
+		}
+		m_chain.push_back(ca_cert);
+	}
+
+	m_signing_cert_v2 = encode_signingCertificate(x509);
+	m_signer_cert = x509;
+}
+
+PKCS7Template::~PKCS7Template() {
+	X509_free(m_signer_cert);
+	for (X509 *cert : m_chain)
+		X509_free(cert);
+	ASN1_STRING_free(m_signing_cert_v2);
+}
+
+bool PKCS7Template::matches(const CByteArray &certificate, const std::vector<CByteArray> &ca_certificates,
+							APL_Card *card) const {
+	if (card != m_card || !certificate.Equals(m_certificate) || ca_certificates.size() != m_ca_certificates.size())
+		return false;
 
-	for (int i = 0; i != ca_certificates.size(); i++)
-		add_certificate(p7, ca_certificates.at(i));
+	for (size_t i = 0; i < ca_certificates.size(); i++) {
+		if (!ca_certificates[i].Equals(m_ca_certificates[i]))
+			return false;
+	}
+	return true;
 }
 
 /*  *********************************************************
  ***          computeHash_pkcs7()                    ***
  ********************************************************* */
-CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, CByteArray certificate,
-							 std::vector<CByteArray> &ca_certificates, bool timestamp, PKCS7 *p7,
-							 PKCS7_SIGNER_INFO **out_signer_info, APL_Card *card) {
+CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, const PKCS7Template &pkcs7_template,
+							 PKCS7 *p7, PKCS7_SIGNER_INFO **out_signer_info) {
 	CByteArray outHash;
 	bool isError = false;
 	unsigned char *attr_buf = NULL;
 	int auth_attr_len = 0;
-	unsigned char *attr_digest = NULL;
-	unsigned char *out = NULL;
+	unsigned char attr_digest[SHA256_LEN];
+	unsigned char out[SHA256_LEN];
 	PKCS7_SIGNER_INFO *signer_info = NULL;
-	X509 *x509 = NULL;
+	ASN1_STRING *signing_cert_v2 = NULL;
+	X509 *x509 = pkcs7_template.m_signer_cert;
 
 	// Function pointer to the correct hash function
 	HashFunc hash_fn = &SHA256_Wrapper;
@@ -464,29 +502,12 @@ CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, CByteAr
 		goto err_hashCalculate;
 	}
 
-	x509 = DER_to_X509(certificate.GetBytes(), certificate.Size());
-	if (NULL == x509) {
+	if (!pkcs7_template.isValid()) {
 		MWLOG(LEV_ERROR, MOD_APL, "computeHash_pkcs7() - Error decoding certificate data!");
 		isError = true;
 		goto err_hashCalculate;
 	}
 
-	out = (unsigned char *)malloc(SHA256_LEN);
-	if (NULL == out) {
-		TRACE_ERR("Null out");
-
-		isError = true;
-		goto err_hashCalculate;
-	}
-
-	attr_digest = (unsigned char *)malloc(SHA256_LEN);
-	if (NULL == attr_digest) {
-		TRACE_ERR("Null attr_digest");
-		isError = true;
-
-		goto err_hashCalculate;
-	}
-
 	PKCS7_set_type(p7, NID_pkcs7_signed);
 
 	if (!PKCS7_content_new(p7, NID_pkcs7_data)) {
@@ -496,7 +517,7 @@ CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, CByteAr
 		goto err_hashCalculate;
 	}
 
-	signer_info = PKCS7_add_signature(p7, x509, X509_get_pubkey(x509), EVP_sha256());
+	signer_info = PKCS7_add_signature(p7, x509, X509_get0_pubkey(x509), EVP_sha256());
 
 	if (signer_info == NULL) {
 		TRACE_ERR("Null signer_info");
@@ -505,14 +526,10 @@ CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, CByteAr
 		goto err_hashCalculate;
 	}
 
+	// The certificates are shared with the template, PKCS7_add_certificate() only takes a reference
 	PKCS7_add_certificate(p7, x509);
-
-	if (card != NULL && card->getType() != APL_CARDTYPE_PTEID_IAS5) {
-		addCardCertificateChain(p7, card);
-	} else {
-		// For non-card signatures we need to add the supplied CA certificates
-		addExternalCertificateChain(p7, ca_certificates);
-	}
+	for (X509 *cert : pkcs7_template.m_chain)
+		PKCS7_add_certificate(p7, cert);
 
 	PKCS7_set_detached(p7, 1);
 
@@ -524,11 +541,13 @@ CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, CByteAr
 
 	PKCS7_add1_attrib_digest(signer_info, out, SHA256_LEN);
 
-	/*
-		Add signing-certificate v2 attribute according to the
-		PAdES specification ETSI TS 103 172 v2.1.1 - section 6.3.1
-	*/
-	add_signingCertificate(signer_info, x509);
+	if (pkcs7_template.m_signing_cert_v2 == NULL ||
+		(signing_cert_v2 = ASN1_STRING_dup(pkcs7_template.m_signing_cert_v2)) == NULL ||
+		!PKCS7_add_signed_attribute(signer_info, NID_id_smime_aa_signingCertificateV2, V_ASN1_SEQUENCE,
+									signing_cert_v2)) {
+		ASN1_STRING_free(signing_cert_v2);
+		MWLOG(LEV_ERROR, MOD_APL, L"Failed to add SigningCertificateV2 attribute.");
+	}
 
 	// if ( !timestamp ) add_signed_time( signer_info );
 
@@ -536,18 +555,12 @@ CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, CByteAr
 
 	hash_fn((unsigned char *)attr_buf, auth_attr_len, attr_digest);
 	outHash = CByteArray((const unsigned char *)attr_digest, SHA256_LEN);
+	OPENSSL_free(attr_buf);
 
 	if (out_signer_info)
 		*out_signer_info = signer_info;
 
 err_hashCalculate:
-	if (x509 != NULL)
-		X509_free(x509);
-	if (attr_digest != NULL)
-		free(attr_digest);
-	if (out != NULL)
-		free(out);
-
 	if (isError) {
 		ERR_load_crypto_strings();
 		ERR_print_errors_fp(stderr);
@@ -556,11 +569,18 @@ err_hashCalculate:
 	return outHash;
 }
 
+CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, CByteArray certificate,
+							 std::vector<CByteArray> &ca_certificates, bool timestamp, PKCS7 *p7,
+							 PKCS7_SIGNER_INFO **out_signer_info, APL_Card *card) {
+	PKCS7Template pkcs7_template(certificate, ca_certificates, card);
+	return computeHash_pkcs7(data, dataLen, pkcs7_template, p7, out_signer_info);
+}
+
 /*  *********************************************************
  ***          getSignedData_pkcs7()                    ***
  ********************************************************* */
 int getSignedData_pkcs7(unsigned char *signature, unsigned int signatureLen, PKCS7_SIGNER_INFO *signer_info,
-						bool timestamp, PKCS7 *p7, const char **signature_contents) {
+						bool timestamp, PKCS7 *p7, const char **signature_contents, const CByteArray *ts_response) {
 	int return_code = 0;
 	unsigned char *timestamp_token = NULL;
 	int tsp_token_len = 0;
@@ -588,10 +608,21 @@ int getSignedData_pkcs7(unsigned char *signature, unsigned int signatureLen, PKC
 	}
 
 	// Manually fill-in the signedData structure
-	signer_info->enc_digest = ASN1_OCTET_STRING_new();
+	if (signer_info->enc_digest == NULL)
+		signer_info->enc_digest = ASN1_OCTET_STRING_new();
 	ASN1_OCTET_STRING_set(signer_info->enc_digest, signature, signatureLen);
 
-	if (timestamp) {
+	if (timestamp && ts_response) {
+		tsresp = *ts_response;
+
+		if (tsresp.Size() == 0) {
+			MWLOG(LEV_ERROR, MOD_APL, L"getSignedData_pkcs7: Timestamp Error - response is empty");
+			return_code = 1;
+		} else {
+			timestamp_token = tsresp.GetBytes();
+			tsp_token_len = tsresp.Size();
+		}
+	} else if (timestamp) {
 		TSAClient tsp;
 		unsigned char *digest_tp = (unsigned char *)malloc(SHA256_LEN);
 		if (NULL == digest_tp) {
@@ -21,14 +21,56 @@ namespace eIDMW {
  */
 CByteArray PteidSign(APL_Card *card, CByteArray &to_sign);
 
-// ca_certificates vector should be empty for card signatures because they are retrieved from already loaded
-// APL_Certifs object
+/*
+ * The parts of the PKCS7 signatures of a signer that don't depend on the document: the decoded signer certificate
+ * and CA chain and the encoded signing-certificate-v2 attribute. A batch builds it once and computeHash_pkcs7()
+ * only adds the message digest of each document.
+ * It isn't modified after the constructor, so the signatures of several documents can be built in parallel threads.
+ */
+class PKCS7Template {
+public:
+	// ca_certificates vector should be empty for card signatures because they are retrieved from already loaded
+	// APL_Certifs object
+	PKCS7Template(const CByteArray &certificate, const std::vector<CByteArray> &ca_certificates, APL_Card *card);
+	~PKCS7Template();
+
+	bool isValid() const { return m_signer_cert != NULL; }
+
+	/* The template was built for these certificates */
+	bool matches(const CByteArray &certificate, const std::vector<CByteArray> &ca_certificates, APL_Card *card) const;
+
+private:
+	PKCS7Template(const PKCS7Template &);
+	PKCS7Template &operator=(const PKCS7Template &);
+
+	CByteArray m_certificate;
+	std::vector<CByteArray> m_ca_certificates;
+	APL_Card *m_card;
+
+	X509 *m_signer_cert;
+	std::vector<X509 *> m_chain;
+	ASN1_STRING *m_signing_cert_v2;
+
+	friend CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen,
+										const PKCS7Template &pkcs7_template, PKCS7 *p7,
+										PKCS7_SIGNER_INFO **out_signer_info);
+};
+
+CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, const PKCS7Template &pkcs7_template,
+							 PKCS7 *p7, PKCS7_SIGNER_INFO **out_signer_info);
+
+/* Single signature: builds a template just for it */
 CByteArray computeHash_pkcs7(unsigned char *data, unsigned long dataLen, CByteArray certificate,
 							 std::vector<CByteArray> &ca_certificates, bool timestamp, PKCS7 *p7,
 							 PKCS7_SIGNER_INFO **out_signer_info, APL_Card *card);
 
+/*
+ * If ts_response is not NULL it is used as the reply of the timestamp request instead of contacting the TSA,
+ * this allows the timestamps of a batch to be requested in advance (see TSABatchClient)
+ */
 int getSignedData_pkcs7(unsigned char *signature, unsigned int signatureLen, PKCS7_SIGNER_INFO *signer_info,
-						bool timestamp, PKCS7 *p7, const char **signature_contents);
+						bool timestamp, PKCS7 *p7, const char **signature_contents,
+						const CByteArray *ts_response = NULL);
 
 bool getTokenFromTsResponse(unsigned char *tsResp, int tsRespLen, unsigned char **outToken, int *outTokenLen);
 } // namespace eIDMW
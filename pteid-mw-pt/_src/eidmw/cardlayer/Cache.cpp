@@ -26,7 +26,11 @@
 #include "Cache.h"
 #include "Util.h"
 #include "Config.h"
+#include "Log.h"
+#include "Mutex.h"
+#include "Thread.h"
 
+#include <unordered_map>
 #include <unordered_set>
 #include <algorithm>
 #include <sys/stat.h>
@@ -45,9 +49,10 @@ namespace eIDMW {
 #ifdef WIN32
 CHAR test;
 #endif
-#define MAX_CACHE_SIZE 65000
 
-///////////////// Header for the cache files on Disk /////////////////////
+#define IV_LENGTH 16
+
+///////////////// Header for the cache entries on Disk /////////////////////
 
 #define HEADER_VERSION 0x10
 #pragma pack(push, tCacheHeader, 1)
@@ -60,18 +65,431 @@ typedef struct {
 static void MakeHeader(tCacheHeader *header, const CByteArray oData);
 static bool CheckHeader(const unsigned char *pucData, unsigned long ulDataLen);
 
+///////////////// Single-file disk store /////////////////////
+
+/*
+ * All the cached card files of a user are kept in one append-only file in the cache dir:
+ *
+ *   tStoreHeader | record | record | ...
+ *   record = tStoreRecord | name | data
+ *
+ * For RECORD_DATA the data is IV || AES-128-CTR(tCacheHeader || file contents), encrypted
+ * with the key of the card it belongs to. Updates, deletions and "card used" marks are appended
+ * and an in-memory index maps each name to its latest record, so lookups don't touch
+ * the rest of the file. When records are superseded or cards are evicted, the live records
+ * are copied to a temporary file that atomically replaces the store; the random generation
+ * in the header tells other processes that they have to rebuild their index. Appending and
+ * compacting are done under a CCacheFileLock, so a compaction doesn't drop the records that
+ * another process appended after it built its index.
+ */
+#define STORE_FILENAME "pteid_cache.store"
+#define STORE_MAGIC "PTEIDCS"
+#define STORE_VERSION 0x01
+#define STORE_GENERATION_LEN 8
+// Don't compact for less than this amount of superseded data
+#define STORE_MIN_DEAD_BYTES (256 * 1024)
+
+#pragma pack(push, tStoreHeader, 1)
+typedef struct {
+	char magic[7];		   /* STORE_MAGIC without the terminating 0 */
+	unsigned char version; /* currently 0x01 */
+	unsigned char generation[STORE_GENERATION_LEN];
+} tStoreHeader;
+
+typedef struct {
+	unsigned char type; /* one of tStoreRecordType */
+	unsigned char rfu[3];
+	unsigned char nameLen[4];	/* big-endian */
+	unsigned char dataLen[4];	/* big-endian */
+	unsigned char timestamp[8]; /* big-endian, seconds since the epoch */
+} tStoreRecord;
+#pragma pack(pop, tStoreHeader)
+
+enum tStoreRecordType { RECORD_DATA = 1, RECORD_DELETE = 2, RECORD_CARD_USED = 3 };
+
+static void PutUInt(unsigned char *buf, unsigned long long value, size_t len) {
+	for (size_t i = 0; i < len; i++)
+		buf[i] = (unsigned char)(0xFF & (value >> (8 * (len - 1 - i))));
+}
+
+static unsigned long long GetUInt(const unsigned char *buf, size_t len) {
+	unsigned long long value = 0;
+	for (size_t i = 0; i < len; i++)
+		value = (value << 8) | buf[i];
+	return value;
+}
+
+class CCacheStore {
+public:
+	static CCacheStore &Instance() {
+		static CCacheStore store;
+		return store;
+	}
+
+	bool Get(const std::string &csName, CByteArray &oData);
+	void Put(const std::string &csName, const CByteArray &oData);
+	bool Delete(const std::string &csPrefix);
+	bool LimitCards(unsigned long ulMaxCards);
+
+private:
+	typedef struct {
+		long offset; /* offset of the record data */
+		unsigned long length;
+	} tStoreEntry;
+
+	CCacheStore() : m_scanned(0), m_liveBytes(0), m_deadBytes(0) {}
+
+	static std::string CardOf(const std::string &csName) { return csName.substr(0, csName.find("_")); }
+
+	std::string GetPath();
+	void ResetIndex();
+	bool Refresh();
+	bool Append(tStoreRecordType type, const std::string &csName, const CByteArray &oData, time_t timestamp);
+	bool Compact(const std::unordered_set<std::string> &evictedCards);
+
+	CMutex m_Mutex;
+	std::string m_csPath;
+	std::string m_generation;
+	std::unordered_map<std::string, tStoreEntry> m_index;
+	// Last time each card was used, for the LRU eviction
+	std::unordered_map<std::string, time_t> m_cardLastUse;
+	// Cards whose use was already recorded in the store by this process
+	std::unordered_set<std::string> m_cardsMarked;
+	long m_scanned;
+	unsigned long m_liveBytes;
+	unsigned long m_deadBytes;
+};
+
+std::string CCacheStore::GetPath() {
+	if (m_csPath.empty()) {
+		CCache::DeleteLegacyFiles();
+		m_csPath = CCache::GetCacheDir() + STORE_FILENAME;
+	}
+	return m_csPath;
+}
+
+void CCacheStore::ResetIndex() {
+	m_generation.clear();
+	m_index.clear();
+	m_cardLastUse.clear();
+	m_cardsMarked.clear();
+	m_scanned = 0;
+	m_liveBytes = 0;
+	m_deadBytes = 0;
+}
+
+/* Index the records appended since the last call, rebuilding the whole index if
+ * the store was replaced in the meantime. Returns false if there's no valid store */
+bool CCacheStore::Refresh() {
+	FILE *f = NULL;
+	int err = fopen_s(&f, GetPath().c_str(), "rb");
+	if (f == NULL || err != 0) {
+		ResetIndex();
+		return false;
+	}
+
+	tStoreHeader header;
+	if (fread(&header, 1, sizeof(header), f) != sizeof(header) ||
+		memcmp(header.magic, STORE_MAGIC, sizeof(header.magic)) != 0 || header.version != STORE_VERSION) {
+		fclose(f);
+		ResetIndex();
+		return false;
+	}
+
+	std::string generation((const char *)header.generation, STORE_GENERATION_LEN);
+	if (generation != m_generation) {
+		ResetIndex();
+		m_generation = generation;
+		m_scanned = sizeof(tStoreHeader);
+	}
+
+	fseek(f, 0, SEEK_END);
+	long fileSize = ftell(f);
+
+	std::vector<char> name;
+	while (m_scanned + (long)sizeof(tStoreRecord) <= fileSize) {
+		tStoreRecord record;
+		if (fseek(f, m_scanned, SEEK_SET) != 0 || fread(&record, 1, sizeof(record), f) != sizeof(record))
+			break;
+
+		unsigned long nameLen = (unsigned long)GetUInt(record.nameLen, sizeof(record.nameLen));
+		unsigned long dataLen = (unsigned long)GetUInt(record.dataLen, sizeof(record.dataLen));
+		long recordEnd = m_scanned + (long)(sizeof(tStoreRecord) + nameLen + dataLen);
+
+		// A record still being written by another process (or a partial write): retry on the next refresh
+		if (recordEnd > fileSize || recordEnd < m_scanned)
+			break;
+
+		name.resize(nameLen);
+		if (nameLen > 0 && fread(name.data(), 1, nameLen, f) != nameLen)
+			break;
+		std::string csName(name.begin(), name.end());
+		time_t timestamp = (time_t)GetUInt(record.timestamp, sizeof(record.timestamp));
+		unsigned long recordLen = (unsigned long)(recordEnd - m_scanned);
+
+		std::unordered_map<std::string, tStoreEntry>::iterator it = m_index.find(csName);
+		switch (record.type) {
+		case RECORD_DATA:
+			if (it != m_index.end()) {
+				m_liveBytes -= it->second.length;
+				m_deadBytes += it->second.length;
+			}
+			m_index[csName] = {m_scanned + (long)(sizeof(tStoreRecord) + nameLen), dataLen};
+			m_liveBytes += dataLen;
+			m_deadBytes += recordLen - dataLen;
+			if (timestamp > m_cardLastUse[CardOf(csName)])
+				m_cardLastUse[CardOf(csName)] = timestamp;
+			break;
+		case RECORD_DELETE:
+			if (it != m_index.end()) {
+				m_liveBytes -= it->second.length;
+				m_deadBytes += it->second.length;
+				m_index.erase(it);
+			}
+			m_deadBytes += recordLen;
+			break;
+		case RECORD_CARD_USED:
+			if (timestamp > m_cardLastUse[csName])
+				m_cardLastUse[csName] = timestamp;
+			m_deadBytes += recordLen;
+			break;
+		default:
+			MWLOG(LEV_WARN, MOD_CAL, "Unknown record type 0x%02x in disk cache", record.type);
+			m_deadBytes += recordLen;
+		}
+
+		m_scanned = recordEnd;
+	}
+
+	fclose(f);
+	return true;
+}
+
+bool CCacheStore::Append(tStoreRecordType type, const std::string &csName, const CByteArray &oData, time_t timestamp) {
+	tStoreRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = (unsigned char)type;
+	PutUInt(record.nameLen, csName.size(), sizeof(record.nameLen));
+	PutUInt(record.dataLen, oData.Size(), sizeof(record.dataLen));
+	PutUInt(record.timestamp, (unsigned long long)timestamp, sizeof(record.timestamp));
+
+	// Build the complete record so that it's appended with a single write
+	CByteArray oRecord((const unsigned char *)&record, sizeof(record));
+	oRecord.Append((const unsigned char *)csName.c_str(), (unsigned long)csName.size());
+	oRecord.Append(oData);
+
+	FILE *f = NULL;
+	int err = fopen_s(&f, GetPath().c_str(), "ab");
+	if (f == NULL || err != 0) {
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to open disk cache %s for writing", GetPath().c_str());
+		return false;
+	}
+
+	bool bOK = fwrite(oRecord.GetBytes(), 1, oRecord.Size(), f) == oRecord.Size();
+	fclose(f);
+
+	return bOK;
+}
+
+/* Write the live records, except those of the evicted cards, to a new store that replaces the current one.
+   Called with the CCacheFileLock held and the index refreshed under it */
+bool CCacheStore::Compact(const std::unordered_set<std::string> &evictedCards) {
+	std::string csTempPath = CCacheFileLock::TempPath(GetPath());
+
+	FILE *fOut = NULL;
+	int err = fopen_s(&fOut, csTempPath.c_str(), "wb");
+	if (fOut == NULL || err != 0) {
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to create %s, disk cache not compacted", csTempPath.c_str());
+		return false;
+	}
+
+	tStoreHeader header;
+	memcpy(header.magic, STORE_MAGIC, sizeof(header.magic));
+	header.version = STORE_VERSION;
+	RAND_bytes(header.generation, STORE_GENERATION_LEN);
+	bool bOK = fwrite(&header, 1, sizeof(header), fOut) == sizeof(header);
+
+	FILE *fIn = NULL;
+	if (bOK && !m_index.empty())
+		fopen_s(&fIn, GetPath().c_str(), "rb");
+
+	// Copy the records in file order so the old store is read sequentially
+	std::vector<std::pair<std::string, tStoreEntry>> entries(m_index.begin(), m_index.end());
+	std::sort(entries.begin(), entries.end(),
+			  [](const std::pair<std::string, tStoreEntry> &a, const std::pair<std::string, tStoreEntry> &b) {
+				  return a.second.offset < b.second.offset;
+			  });
+
+	std::vector<unsigned char> data;
+	for (size_t i = 0; bOK && fIn != NULL && i < entries.size(); i++) {
+		const std::string &csName = entries[i].first;
+		const tStoreEntry &entry = entries[i].second;
+		if (evictedCards.find(CardOf(csName)) != evictedCards.end())
+			continue;
+
+		data.resize(entry.length);
+		if (fseek(fIn, entry.offset, SEEK_SET) != 0 || fread(data.data(), 1, entry.length, fIn) != entry.length)
+			continue;
+
+		tStoreRecord record;
+		memset(&record, 0, sizeof(record));
+		record.type = RECORD_DATA;
+		PutUInt(record.nameLen, csName.size(), sizeof(record.nameLen));
+		PutUInt(record.dataLen, entry.length, sizeof(record.dataLen));
+		PutUInt(record.timestamp, (unsigned long long)m_cardLastUse[CardOf(csName)], sizeof(record.timestamp));
+
+		bOK = fwrite(&record, 1, sizeof(record), fOut) == sizeof(record) &&
+			  fwrite(csName.c_str(), 1, csName.size(), fOut) == csName.size() &&
+			  fwrite(data.data(), 1, data.size(), fOut) == data.size();
+	}
+
+	if (fIn != NULL)
+		fclose(fIn);
+	bOK = fclose(fOut) == 0 && bOK;
+
+#ifdef WIN32
+	bOK = bOK && MoveFileExA(csTempPath.c_str(), GetPath().c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bOK = bOK && rename(csTempPath.c_str(), GetPath().c_str()) == 0;
+#endif
+	if (!bOK) {
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to compact the disk cache");
+		remove(csTempPath.c_str());
+	}
+
+	ResetIndex();
+	Refresh();
+
+	return bOK;
+}
+
+bool CCacheStore::Get(const std::string &csName, CByteArray &oData) {
+	CAutoMutex autoMutex(&m_Mutex);
+
+	if (!Refresh())
+		return false;
+
+	std::unordered_map<std::string, tStoreEntry>::iterator it = m_index.find(csName);
+	if (it == m_index.end())
+		return false;
+
+	FILE *f = NULL;
+	int err = fopen_s(&f, GetPath().c_str(), "rb");
+	if (f == NULL || err != 0)
+		return false;
+
+	std::vector<unsigned char> data(it->second.length);
+	bool bOK = fseek(f, it->second.offset, SEEK_SET) == 0 && fread(data.data(), 1, data.size(), f) == data.size();
+	fclose(f);
+	if (!bOK)
+		return false;
+
+	oData = CByteArray(data.data(), (unsigned long)data.size());
+
+	// Record the first use of each card in this process, this is what keeps it from being evicted
+	std::string csCard = CardOf(csName);
+	if (m_cardsMarked.find(csCard) == m_cardsMarked.end()) {
+		CCacheFileLock fileLock(GetPath());
+		if (fileLock.IsLocked() && Append(RECORD_CARD_USED, csCard, CByteArray(), time(NULL)))
+			m_cardsMarked.insert(csCard);
+	}
+
+	return true;
+}
+
+void CCacheStore::Put(const std::string &csName, const CByteArray &oData) {
+	CAutoMutex autoMutex(&m_Mutex);
+	CCacheFileLock fileLock(GetPath());
+	if (!fileLock.IsLocked())
+		return;
+
+	// Missing or unreadable store: start a new one
+	if (!Refresh() && !Compact(std::unordered_set<std::string>()))
+		return;
+
+	if (!Append(RECORD_DATA, csName, oData, time(NULL)))
+		return;
+
+	Refresh();
+	if (m_deadBytes > STORE_MIN_DEAD_BYTES && m_deadBytes > m_liveBytes)
+		Compact(std::unordered_set<std::string>());
+}
+
+bool CCacheStore::Delete(const std::string &csPrefix) {
+	CAutoMutex autoMutex(&m_Mutex);
+	CCacheFileLock fileLock(GetPath());
+	if (!fileLock.IsLocked())
+		throw CMWEXCEPTION(EIDMW_ERR_DELETE_CACHE);
+
+	if (csPrefix.empty()) {
+		bool bDeleted = remove(GetPath().c_str()) == 0;
+		ResetIndex();
+		return bDeleted;
+	}
+
+	if (!Refresh())
+		return false;
+
+	std::vector<std::string> toDelete;
+	for (std::unordered_map<std::string, tStoreEntry>::iterator it = m_index.begin(); it != m_index.end(); it++) {
+		if (it->first.compare(0, csPrefix.size(), csPrefix) == 0)
+			toDelete.push_back(it->first);
+	}
+
+	for (size_t i = 0; i < toDelete.size(); i++) {
+		if (!Append(RECORD_DELETE, toDelete[i], CByteArray(), time(NULL)))
+			throw CMWEXCEPTION(EIDMW_ERR_DELETE_CACHE);
+	}
+	Refresh();
+
+	return !toDelete.empty();
+}
+
+bool CCacheStore::LimitCards(unsigned long ulMaxCards) {
+	CAutoMutex autoMutex(&m_Mutex);
+	CCacheFileLock fileLock(GetPath());
+	if (!fileLock.IsLocked())
+		return false;
+
+	if (!Refresh())
+		return false;
+
+	std::unordered_map<std::string, time_t> cachedCards;
+	for (std::unordered_map<std::string, tStoreEntry>::iterator it = m_index.begin(); it != m_index.end(); it++) {
+		std::string csCard = CardOf(it->first);
+		cachedCards[csCard] = m_cardLastUse[csCard];
+	}
+
+	// We have less than the max amount of cached eIDs
+	if (cachedCards.size() <= ulMaxCards)
+		return false;
+
+	// Sort the cards from the most to the least recently used
+	std::vector<std::pair<std::string, time_t>> cards(cachedCards.begin(), cachedCards.end());
+	std::sort(cards.begin(), cards.end(),
+			  [](const std::pair<std::string, time_t> &a, const std::pair<std::string, time_t> &b) {
+				  return difftime(a.second, b.second) > 0;
+			  });
+
+	std::unordered_set<std::string> evictedCards;
+	for (size_t i = ulMaxCards; i < cards.size(); i++)
+		evictedCards.insert(cards[i].first);
+
+	return Compact(evictedCards);
+}
+
 //////////////////////////////////////////////////////////////////////////
 
-CCache::CCache(CContext *poContext) : m_poContext(poContext) { m_pucTemp = (unsigned char *)malloc(MAX_CACHE_SIZE); }
+CCache::CCache(CContext *poContext) : m_poContext(poContext) { m_cipherCtx = EVP_CIPHER_CTX_new(); }
 
 CCache::~CCache(void) {
-	if (m_pucTemp)
-		free(m_pucTemp);
+	if (m_cipherCtx)
+		EVP_CIPHER_CTX_free(m_cipherCtx);
 	m_MemCache.clear();
 }
 
 std::string CCache::GetSimpleName(const std::string &csSerialNr, const std::string &csPath) {
-	return csSerialNr + "_" + csPath + "." + ENCRYPTED_CACHE_EXT;
+	return csSerialNr + "_" + csPath;
 }
 
 CByteArray CCache::GetFile(const std::string &csName, bool &bFileFound, bool &bFromDisk, unsigned long ulOffset,
@@ -145,96 +563,70 @@ void CCache::setEncryptionKey(const CByteArray &newEncryptionKey) { encryptionKe
 
 unsigned int CCache::Encrypt(const unsigned char *plaintext, int plaintext_len, const unsigned char *key,
 							 const unsigned char *iv, unsigned char *ciphertext) {
-	EVP_CIPHER_CTX *ctx;
 	int len;
 	int ciphertext_len;
 
-	if (!(ctx = EVP_CIPHER_CTX_new()))
+	if (m_cipherCtx == NULL)
 		return 0;
 
-	if (1 != EVP_EncryptInit_ex(ctx, EVP_aes_128_ctr(), NULL, key, iv))
+	if (1 != EVP_EncryptInit_ex(m_cipherCtx, EVP_aes_128_ctr(), NULL, key, iv))
 		return 0;
 
-	if (1 != EVP_EncryptUpdate(ctx, ciphertext, &len, plaintext, plaintext_len))
+	if (1 != EVP_EncryptUpdate(m_cipherCtx, ciphertext, &len, plaintext, plaintext_len))
 		return 0;
 	ciphertext_len = len;
 
-	if (1 != EVP_EncryptFinal_ex(ctx, ciphertext + len, &len))
+	if (1 != EVP_EncryptFinal_ex(m_cipherCtx, ciphertext + len, &len))
 		return 0;
 	ciphertext_len += len;
 
-	EVP_CIPHER_CTX_free(ctx);
-
 	return ciphertext_len;
 }
 
 unsigned int CCache::Decrypt(const unsigned char *ciphertext, int ciphertext_len, const unsigned char *key,
 							 const unsigned char *iv, unsigned char *plaintext) {
-	EVP_CIPHER_CTX *ctx;
 	int len;
 	int plaintext_len;
 
-	if (!(ctx = EVP_CIPHER_CTX_new()))
+	if (m_cipherCtx == NULL)
 		return 0;
 
-	if (1 != EVP_DecryptInit_ex(ctx, EVP_aes_128_ctr(), NULL, key, iv))
+	if (1 != EVP_DecryptInit_ex(m_cipherCtx, EVP_aes_128_ctr(), NULL, key, iv))
 		return 0;
 
-	if (1 != EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ciphertext_len))
+	if (1 != EVP_DecryptUpdate(m_cipherCtx, plaintext, &len, ciphertext, ciphertext_len))
 		return 0;
 	plaintext_len = len;
 
-	if (1 != EVP_DecryptFinal_ex(ctx, plaintext + len, &len))
+	if (1 != EVP_DecryptFinal_ex(m_cipherCtx, plaintext + len, &len))
 		return 0;
 	plaintext_len += len;
 
-	EVP_CIPHER_CTX_free(ctx);
-
 	return plaintext_len;
 }
 
 CByteArray CCache::DiskGetFile(const std::string &csName) {
-	if (m_pucTemp == NULL)
-		throw CMWEXCEPTION(EIDMW_ERR_MEMORY);
-
 	// Invalid encryption key. We will not be able to decrypt the file
 	if (encryptionKey.Size() != ENCRYPTION_KEY_LENGTH)
 		return CByteArray();
 
-	if (m_csCacheDir == "")
-		m_csCacheDir = GetCacheDir();
-	std::string csFileName = m_csCacheDir + csName;
-
-	FILE *f = NULL;
-	int err = fopen_s(&f, csFileName.c_str(), "rb");
-	if (f == NULL || err != 0)
+	CByteArray oStored;
+	if (!CCacheStore::Instance().Get(csName, oStored) || oStored.Size() < IV_LENGTH + sizeof(tCacheHeader))
 		return CByteArray();
-	else {
-		// OpenSSL init
-		ERR_load_crypto_strings();
-		OpenSSL_add_all_algorithms();
-
-		unsigned char iv[16] = {0};
 
-		unsigned char ciphertext[MAX_CACHE_SIZE] = {0};
-		size_t cacheFileLen = fread(ciphertext, 1, MAX_CACHE_SIZE, f);
-		fclose(f);
-
-		// Get the IV from the stored cache
-		memcpy(iv, ciphertext, 16);
-
-		unsigned char plaintext[MAX_CACHE_SIZE] = {0};
-		assert(cacheFileLen - 16 <= INT_MAX);
-		unsigned int decryptLen = Decrypt(ciphertext + 16, (int) (cacheFileLen - 16), encryptionKey.GetBytes(), iv, plaintext);
-		if (decryptLen == 0)
-			return CByteArray();
+	// The IV is stored before the ciphertext
+	unsigned long ciphertextLen = oStored.Size() - IV_LENGTH;
+	std::vector<unsigned char> plaintext(ciphertextLen);
+	assert(ciphertextLen <= INT_MAX);
+	unsigned int decryptLen = Decrypt(oStored.GetBytes() + IV_LENGTH, (int)ciphertextLen, encryptionKey.GetBytes(),
+									  oStored.GetBytes(), plaintext.data());
+	if (decryptLen == 0)
+		return CByteArray();
 
-		memcpy(m_pucTemp, plaintext, decryptLen);
-		if (!CheckHeader(m_pucTemp, (unsigned long)decryptLen))
-			return CByteArray();
+	if (!CheckHeader(plaintext.data(), (unsigned long)decryptLen))
+		return CByteArray();
 
-		return CByteArray(m_pucTemp + sizeof(tCacheHeader), (unsigned long)(decryptLen - sizeof(tCacheHeader)));
-	}
+	return CByteArray(plaintext.data() + sizeof(tCacheHeader), (unsigned long)(decryptLen - sizeof(tCacheHeader)));
 }
 
 void CCache::DiskStoreFile(const std::string &csName, const CByteArray &oData) {
@@ -242,107 +634,44 @@ void CCache::DiskStoreFile(const std::string &csName, const CByteArray &oData) {
 	if (encryptionKey.Size() != ENCRYPTION_KEY_LENGTH)
 		return;
 
-	if (m_csCacheDir == "")
-		m_csCacheDir = GetCacheDir();
-	std::string csFileName = m_csCacheDir + csName;
-
 	tCacheHeader header;
 	MakeHeader(&header, oData);
 
-	FILE *f = NULL;
-	int err = fopen_s(&f, csFileName.c_str(), "wb");
-	if (f == NULL || err != 0)
-		; // TODO: log
-	else {
-		// OpenSSL init
-		ERR_load_crypto_strings();
-		OpenSSL_add_all_algorithms();
-
-		unsigned char iv[16] = {0};
-		RAND_bytes(iv, 16);
-
-		CByteArray plainData(reinterpret_cast<const unsigned char *>(&header), sizeof(tCacheHeader));
-		plainData.Append(oData);
-
-		unsigned char ciphertext[MAX_CACHE_SIZE + 16];
-		unsigned int length = Encrypt(plainData.GetBytes(), plainData.Size(), encryptionKey.GetBytes(), iv, ciphertext);
-		if (length == 0) {
-			fclose(f);
-			remove(csFileName.c_str()); // If Encrypt failed, no need to leave the file empty, just delete it
-			return;
-		}
+	unsigned char iv[IV_LENGTH] = {0};
+	RAND_bytes(iv, IV_LENGTH);
 
-		// Write the IV first
-		fwrite(iv, sizeof(unsigned char), 16, f);
-		fwrite(ciphertext, sizeof(unsigned char), length, f);
+	CByteArray plainData(reinterpret_cast<const unsigned char *>(&header), sizeof(tCacheHeader));
+	plainData.Append(oData);
 
-		fclose(f);
-	}
-}
+	// AES-CTR: the ciphertext has the same length as the plaintext
+	std::vector<unsigned char> ciphertext(plainData.Size() + IV_LENGTH);
+	unsigned int length =
+		Encrypt(plainData.GetBytes(), plainData.Size(), encryptionKey.GetBytes(), iv, ciphertext.data());
+	if (length == 0)
+		return;
 
-void CCache::DeleteNonEncryptedFiles() {
-	std::string cachePath = GetCacheDir();
-	bool stopRequest = false;
-	scanDir(cachePath.c_str(), "", CACHE_EXT, stopRequest, &stopRequest,
-			[&](const char *dir, const char *SubDir, const char *File, void *param) {
-				std::string fileFullPath = cachePath + File;
-				remove(fileFullPath.c_str());
-			});
+	CByteArray oStored(iv, IV_LENGTH);
+	oStored.Append(ciphertext.data(), length);
+
+	CCacheStore::Instance().Put(csName, oStored);
 }
 
-void CCache::CacheDirIterate(std::function<void(const char *FileName, const char *FullPath)> step) {
+void CCache::DeleteLegacyFiles() {
 	std::string cachePath = GetCacheDir();
 	bool stopRequest = false;
-	scanDir(cachePath.c_str(), "", ENCRYPTED_CACHE_EXT, stopRequest, &stopRequest,
-			[&](const char *dir, const char *SubDir, const char *File, void *param) {
-				std::string fileFullPath = cachePath + File;
-				step(File, fileFullPath.c_str());
-			});
-}
-
-// Windows specific
-#ifdef WIN32
-#define stat _stat
-#endif
-
-bool CCache::LimitDiskCacheFiles(unsigned long ulMaxCacheFIles) {
-	DeleteNonEncryptedFiles();
-
-	std::map<std::string, time_t> uniqueEIDs;
-
-	CacheDirIterate([&](const char *FileName, const char *FullPath) {
-		struct stat fileStats;
-		stat(FullPath, &fileStats);
-
-		std::string strFile = FileName;
-		strFile = strFile.substr(0, strFile.find("_"));
-
-		uniqueEIDs.insert(std::make_pair(strFile, fileStats.st_mtime));
-	});
-
-	// We have less than the max amount of cached files
-	if (uniqueEIDs.size() <= ulMaxCacheFIles)
-		return false;
-
-	// Returns the oldest. Used to sort the vector
-	auto older = [](const std::pair<std::string, time_t> &a, const std::pair<std::string, time_t> &b) {
-		return difftime(a.second, b.second) > 0;
+	auto deleteFile = [&](const char *dir, const char *SubDir, const char *File, void *param) {
+		std::string fileFullPath = cachePath + File;
+		remove(fileFullPath.c_str());
 	};
 
-	// Convert the map of unique EIDs-time of creation to a vector so we can easily sort by time of creation
-	std::vector<std::pair<std::string, time_t>> cachedEIDs(uniqueEIDs.begin(), uniqueEIDs.end());
-	std::sort(cachedEIDs.begin(), cachedEIDs.end(), older);
+	scanDir(cachePath.c_str(), "", CACHE_EXT, stopRequest, &stopRequest, deleteFile);
+	scanDir(cachePath.c_str(), "", ENCRYPTED_CACHE_EXT, stopRequest, &stopRequest, deleteFile);
+}
 
-	// Delete all files starting from _ulMaxCacheFiles_
-	std::for_each(cachedEIDs.begin() + ulMaxCacheFIles, cachedEIDs.end(), [&](const std::pair<std::string, time_t> &a) {
-		// If we have a file to delete, delete it
-		// It is important to check this, incase somehow oldestId is empty,
-		// and _Delete_ will just delete all files inside the cache directory
-		if (!a.first.empty())
-			Delete(a.first);
-	});
+bool CCache::Delete(const std::string &csName) { return CCacheStore::Instance().Delete(csName); }
 
-	return true;
+bool CCache::LimitDiskCacheFiles(unsigned long ulMaxCacheFiles) {
+	return CCacheStore::Instance().LimitCards(ulMaxCacheFiles);
 }
 
 //////////////////////// Platform-dependent code /////////////////////////
@@ -353,8 +682,6 @@ bool CCache::LimitDiskCacheFiles(unsigned long ulMaxCacheFIles) {
 #include <direct.h>
 #include <windows.h>
 
-// TODO: Implement CCache::GetCachedIdsCount() for Windows OS
-
 std::string CCache::GetCacheDir(bool bAddSlash) {
 	std::string csCacheDir;
 
@@ -393,39 +720,41 @@ std::string CCache::GetCacheDir(bool bAddSlash) {
 	return csCacheDir;
 }
 
-bool CCache::Delete(const std::string &csName) {
-	std::string strCacheDir = GetCacheDir();
-	std::string strSearchFor = strCacheDir + csName + "*." + ENCRYPTED_CACHE_EXT;
-	const char *csSearchFor = strSearchFor.c_str();
-
-	bool bDeleted = false; // wether or no we deleted something
-
-	bool bContinue = true; // continue as long as we deleted a file
-	while (bContinue) {
-		struct _finddata_t c_file;
-		intptr_t hFile = _findfirst(csSearchFor, &c_file);
-		if (hFile != -1) {
-			bool bOK = (0 != DeleteFileA((strCacheDir + c_file.name).c_str()));
-			_findclose(hFile);
-			if (bOK) {
-				bContinue = true;
-				bDeleted = true;
-			} else {
-				DWORD dwErr = GetLastError();
-				// TODO: log dwErr
-				throw CMWEXCEPTION(EIDMW_ERR_DELETE_CACHE);
-			}
-		} else
-			bContinue = false;
+CCacheFileLock::CCacheFileLock(const std::string &csPath) : m_bLocked(false) {
+	std::string csLockPath = csPath + ".lock";
+	HANDLE hFile = CreateFileA(csLockPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+							   NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	m_hFile = hFile;
+	if (hFile == INVALID_HANDLE_VALUE) {
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to open %s error: %lu", csLockPath.c_str(), GetLastError());
+		return;
 	}
 
-	return bDeleted;
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	m_bLocked = LockFileEx(hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) != 0;
+	if (!m_bLocked)
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to lock %s error: %lu", csLockPath.c_str(), GetLastError());
+}
+
+CCacheFileLock::~CCacheFileLock() {
+	HANDLE hFile = (HANDLE)m_hFile;
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+
+	if (m_bLocked) {
+		OVERLAPPED overlapped;
+		memset(&overlapped, 0, sizeof(overlapped));
+		UnlockFileEx(hFile, 0, 1, 0, &overlapped);
+	}
+	CloseHandle(hFile);
 }
 
 #else
 
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
-#include <dirent.h>
 
 std::string CCache::GetCacheDir(bool bAddSlash) {
 	std::string csCacheDir;
@@ -444,52 +773,36 @@ std::string CCache::GetCacheDir(bool bAddSlash) {
 	return csCacheDir;
 }
 
-bool CCache::Delete(const std::string &strName) {
-	std::string strCacheDirNoSlash = GetCacheDir(false);
-	const char *csCacheDirNoSlash = strCacheDirNoSlash.c_str();
-	std::string strCacheDir = strCacheDirNoSlash + "/";
-
-	const char *csName = strName.c_str();
-	size_t nameLen = strName.size();
-
-	bool bDeleteAll = strName == "";
-	bool bDeleted = false; // wether or no we deleted something
-
-	// We loop until all files are deleted
-	// The inner loops stops after it deleted 1 file,
-	// because continuing to list files of which
-	// one has just been deleted could cause troubles
-	bool bContinue = true;
-	while (bContinue) {
-		bContinue = false;
-		DIR *pDir = opendir(csCacheDirNoSlash);
-		if (pDir != NULL) {
-			struct dirent *pFile = readdir(pDir);
-			for (; pFile != NULL; pFile = readdir(pDir)) {
-				// Check if this file starts with 'csName'
-				if (strcmp(pFile->d_name, "..") != 0 && strcmp(pFile->d_name, ".") != 0 &&
-					(bDeleteAll || memcmp(pFile->d_name, csName, nameLen) == 0)) {
-					// Delete the file
-					std::string csPath = strCacheDir + pFile->d_name;
-					if (!unlink(csPath.c_str())) {
-						bContinue = true;
-						bDeleted = true;
-					} else {
-						// TODO: log
-						throw CMWEXCEPTION(EIDMW_ERR_DELETE_CACHE);
-					}
-					break;
-				}
-			}
-
-			closedir(pDir);
-		}
+CCacheFileLock::CCacheFileLock(const std::string &csPath) : m_bLocked(false) {
+	std::string csLockPath = csPath + ".lock";
+	m_fd = open(csLockPath.c_str(), O_RDWR | O_CREAT, 0600);
+	if (m_fd == -1) {
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to open %s errno: %d", csLockPath.c_str(), errno);
+		return;
 	}
 
-	return bDeleted;
+	struct flock fl;
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = 0;
+	fl.l_len = 0; /* to EOF */
+	m_bLocked = fcntl(m_fd, F_SETLKW, &fl) != -1; /* set the lock, waiting if necessary */
+	if (!m_bLocked)
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to lock %s errno: %d", csLockPath.c_str(), errno);
+}
+
+CCacheFileLock::~CCacheFileLock() {
+	// Closing the file releases the lock
+	if (m_fd != -1)
+		close(m_fd);
 }
 #endif
 
+std::string CCacheFileLock::TempPath(const std::string &csPath) {
+	return csPath + "." + std::to_string(CThread::getCurrentPid()) + ".tmp";
+}
+
 /////////////////////////  Disk cache header + CRC ////////////////////////
 
 /* CRC-32 checksum table, used in PNG, see http://www.w3.org/TR/PNG-CRCAppendix.html */
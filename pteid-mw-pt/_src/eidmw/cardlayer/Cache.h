@@ -31,17 +31,21 @@
 #include <map>
 #include <functional>
 
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
 namespace eIDMW {
 
 typedef std::map<std::string, CByteArray> tCacheMap;
 
+class CCacheStore;
+
 class EIDMW_CAL_API CCache {
 public:
 	CCache(CContext *poContext);
 	~CCache(void);
 
 	/**
-	 * Return the cache file name as a combination of the serialnr and path
+	 * Return the name of a cache entry as a combination of the serialnr and path
 	 */
 	static std::string GetSimpleName(const std::string &csSerialNr, const std::string &csPath);
 
@@ -77,20 +81,20 @@ public:
 	void StoreFileToMem(const std::string &csName, const CByteArray &oData, bool bIsFullFile);
 
 	/**
-	 * Delete all the Disk cache files starting with 'csName';
-	 * if csName = "" then delete all cache files
-	 * Since cache file names start with the card's serial number,
+	 * Delete all the Disk cache entries starting with 'csName';
+	 * if csName = "" then delete the whole disk cache
+	 * Since cache entry names start with the card's serial number,
 	 * specifying the serial number will cause all cache
-	 * files for that specific card to be deleted.
-	 * Returns true is something was returned, false otherwise.
+	 * entries for that specific card to be deleted.
+	 * Returns true is something was deleted, false otherwise.
 	 */
 	static bool Delete(const std::string &csName);
 
 	/**
-	 * Will try to limit the ammount of cached files on disk.
-	 * If the amount of already existing eIDs cached on disk
-	 * surpasses the amount passed through _ulMaxCacheFiles_,
-	 * the oldest eID files will be permanently deleted.
+	 * Will try to limit the ammount of eIDs cached on disk.
+	 * If the amount of eIDs cached on disk surpasses the
+	 * amount passed through _ulMaxCacheFiles_, the entries of the
+	 * least recently used eIDs will be permanently deleted.
 	 */
 	static bool LimitDiskCacheFiles(unsigned long ulMaxCacheFiles);
 
@@ -107,13 +111,12 @@ protected:
 	CByteArray DiskGetFile(const std::string &csName);
 	void DiskStoreFile(const std::string &csName, const CByteArray &oData);
 
-	static void DeleteNonEncryptedFiles();
+	// Remove the per-file caches written by previous versions
+	static void DeleteLegacyFiles();
 
 	static std::string GetCacheDir(bool bAddSlash = true);
 
-	static void CacheDirIterate(std::function<void(const char *FileName, const char *FullPath)> step);
-
-	// Cache encryption
+	// Cache encryption, the cipher context is reused by all operations of this instance
 	unsigned int Encrypt(const unsigned char *plaintext, int plaintext_len, const unsigned char *key,
 						 const unsigned char *iv, unsigned char *ciphertext);
 
@@ -124,9 +127,8 @@ protected:
 	static constexpr const char *CACHE_EXT = "bin";
 	static constexpr const char *ENCRYPTED_CACHE_EXT = "ebin";
 
-	unsigned char *m_pucTemp;
 	CContext *m_poContext;
-	std::string m_csCacheDir;
+	EVP_CIPHER_CTX *m_cipherCtx;
 	CByteArray encryptionKey = CByteArray(ENCRYPTION_KEY_LENGTH);
 
 #ifdef WIN32
@@ -138,6 +140,36 @@ protected:
 #ifdef WIN32
 #pragma warning(pop)
 #endif
+
+	friend class CCacheStore;
+	friend class CCardTypeTable;
+};
+
+/**
+ * Exclusive lock shared by all the processes that update a file of the cache dir, taken on a separate
+ * csPath + ".lock" file because the updated file is replaced by renaming a temporary file over it.
+ * The lock is held until the object is destroyed.
+ */
+class CCacheFileLock {
+public:
+	CCacheFileLock(const std::string &csPath);
+	~CCacheFileLock();
+
+	bool IsLocked() const { return m_bLocked; }
+
+	/* Name for the temporary file that replaces csPath, different in each process */
+	static std::string TempPath(const std::string &csPath);
+
+private:
+	CCacheFileLock(const CCacheFileLock &);
+	CCacheFileLock &operator=(const CCacheFileLock &);
+
+#ifdef WIN32
+	void *m_hFile;
+#else
+	int m_fd;
+#endif
+	bool m_bLocked;
 };
 
 } // namespace eIDMW
@@ -33,9 +33,17 @@ namespace eIDMW {
 
 CCard::CCard(SCARDHANDLE hCard, CContext *poContext, GenericPinpad *poPinpad)
 	: m_hCard(hCard), m_poContext(poContext), m_poPinpad(poPinpad), m_oCache(poContext), m_cardType(CARD_UNKNOWN),
-	  m_ulLockCount(0), m_bSerialNrString(false), cleartext_next(false), m_comm_protocol(NULL), m_askPinOnSign(true) {}
-
-CCard::~CCard(void) { Disconnect(DISCONNECT_RESET_CARD); }
+	  m_ulLockCount(0), m_bSerialNrString(false), cleartext_next(false), m_comm_protocol(NULL), m_askPinOnSign(true),
+	  m_bLoadPlan(false), m_ioStats(), m_selectedFileInfo(), m_bSignSession(false) {}
+
+CCard::~CCard(void) {
+	// The card reset clears the PINs verified by a sign session, but not the SSO flag of the context
+	if (m_bSignSession) {
+		m_bSignSession = false;
+		setSSO(false);
+	}
+	Disconnect(DISCONNECT_RESET_CARD);
+}
 
 void CCard::Disconnect(tDisconnectMode disconnectMode) {
 	if (m_hCard != 0) {
@@ -52,6 +60,10 @@ CByteArray CCard::GetIFDVersion() { return m_poContext->m_oPCSC.GetIFDVersion(m_
 bool CCard::Status() { return m_poContext->m_oPCSC.Status(m_hCard); }
 
 void CCard::setSSO(bool value) {
+	// SSO stays on until the end of the sign session, even if the signature code turns it off
+	if (!value && m_bSignSession)
+		return;
+
 	m_poContext->m_bSSO = value;
 	if (!value) {
 		// Zero-out currently stored PINs
@@ -83,6 +95,10 @@ std::string CCard::GetAppletVersion() { return ""; }
 void CCard::Lock() {
 	if (m_ulLockCount == 0) {
 		m_poContext->m_oPCSC.BeginTransaction(m_hCard);
+		m_ioStats.ulTransactions++;
+	} else if (m_ulLockCount == 1 && m_bLoadPlan) {
+		// Without the load plan this operation would have started its own transaction
+		m_ioStats.ulTransactionsSaved++;
 	}
 	m_ulLockCount++;
 }
@@ -92,11 +108,87 @@ void CCard::Unlock() {
 		MWLOG(LEV_ERROR, MOD_CAL, L"More Unlock()s then Lock()s called!!");
 	else {
 		m_ulLockCount--;
-		if (m_ulLockCount == 0)
+		if (m_ulLockCount == 0) {
+			// Other applications can select another file as soon as the transaction ends
+			ForgetSelectedFile();
+			ForgetSecurityEnv();
 			m_poContext->m_oPCSC.EndTransaction(m_hCard);
+		}
 	}
 }
 
+void CCard::BeginLoadPlan() {
+	if (m_bLoadPlan)
+		throw CMWEXCEPTION(EIDMW_ERR_BAD_TRANSACTION);
+
+	Lock();
+	m_bLoadPlan = true;
+}
+
+void CCard::EndLoadPlan() {
+	if (!m_bLoadPlan)
+		throw CMWEXCEPTION(EIDMW_ERR_BAD_TRANSACTION);
+
+	m_bLoadPlan = false;
+	Unlock();
+}
+
+bool CCard::IsFileSelected(const std::string &csPath, tFileInfo &fileInfo) {
+	if (m_ulLockCount == 0 || m_csSelectedFile.empty() || m_csSelectedFile != csPath)
+		return false;
+
+	fileInfo = m_selectedFileInfo;
+	m_ioStats.ulSelectsSkipped++;
+	return true;
+}
+
+void CCard::SetSelectedFile(const std::string &csPath, const tFileInfo &fileInfo) {
+	if (m_ulLockCount == 0)
+		return;
+
+	m_csSelectedFile = csPath;
+	m_selectedFileInfo = fileInfo;
+}
+
+void CCard::ForgetSelectedFile() { m_csSelectedFile.clear(); }
+
+void CCard::BeginSignSession() {
+	if (m_bSignSession)
+		throw CMWEXCEPTION(EIDMW_ERR_BAD_TRANSACTION);
+
+	Lock();
+	setSSO(true);
+	m_bSignSession = true;
+	m_signSessionPINs.clear();
+}
+
+void CCard::EndSignSession() {
+	if (!m_bSignSession)
+		throw CMWEXCEPTION(EIDMW_ERR_BAD_TRANSACTION);
+
+	m_bSignSession = false;
+	m_signSessionPINs.clear();
+	setSSO(false);
+	Unlock();
+}
+
+bool CCard::IsSecurityEnvSet(const CByteArray &oSecurityEnv) {
+	if (m_ulLockCount == 0 || m_oSecurityEnv.Size() == 0 || !m_oSecurityEnv.Equals(oSecurityEnv))
+		return false;
+
+	m_ioStats.ulSecurityEnvsSkipped++;
+	return true;
+}
+
+void CCard::SetSecurityEnvData(const CByteArray &oSecurityEnv) {
+	if (m_ulLockCount == 0)
+		return;
+
+	m_oSecurityEnv = oSecurityEnv;
+}
+
+void CCard::ForgetSecurityEnv() { m_oSecurityEnv.ClearContents(); }
+
 void CCard::ResetApplication() { throw CMWEXCEPTION(EIDMW_ERR_NOT_SUPPORTED); }
 
 // Not supported for Unknown cards, only implemented in subclasses
@@ -250,6 +342,16 @@ void CCard::WriteFile(const std::string &csPath, unsigned long ulOffset, const C
 		m_oCache.Delete(m_oCache.GetSimpleName(GetSerialNr(), csPath));
 }
 
+CByteArray CCard::GetCachedData(const std::string &csName, bool &bFound) {
+	bool bFromDisk = true;
+
+	return m_oCache.GetFile(m_oCache.GetSimpleName(GetSerialNr(), csName), bFound, bFromDisk);
+}
+
+void CCard::StoreCachedData(const std::string &csName, const CByteArray &oData) {
+	m_oCache.StoreFile(m_oCache.GetSimpleName(GetSerialNr(), csName), oData, true);
+}
+
 void CCard::WriteUncachedFile(const std::string &csPath, unsigned long ulOffset, const CByteArray &oData) {
 	throw CMWEXCEPTION(EIDMW_ERR_NOT_SUPPORTED);
 }
@@ -319,9 +421,18 @@ CByteArray CCard::SendAPDU(const CByteArray &oCmdAPDU) {
 	const void *protocol_struct = getProtocolStructure();
 	CByteArray oResp;
 
+	m_ioStats.ulAPDUs++;
+	if (oCmdAPDU.Size() > 1 && oCmdAPDU.GetByte(1) == 0xA4) {
+		// Selecting an application may also reset the current security environment
+		ForgetSelectedFile();
+		ForgetSecurityEnv();
+	}
+
 	oResp = handleSendAPDUSecurity(oCmdAPDU, m_hCard, lRetVal, protocol_struct);
 
 	if (lRetVal == SCARD_E_COMM_DATA_LOST || lRetVal == SCARD_E_NOT_TRANSACTED) {
+		ForgetSelectedFile();
+		ForgetSecurityEnv();
 		m_poContext->m_oPCSC.Recover(m_hCard, &m_ulLockCount);
 		// try again to select the applet
 		if (SelectApplet()) {
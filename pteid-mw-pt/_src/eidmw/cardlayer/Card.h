@@ -41,6 +41,7 @@
 #include "PaceAuthentication.h"
 
 #include <memory>
+#include <set>
 
 namespace eIDMW {
 class EIDMW_CAL_API CCard {
@@ -70,6 +71,19 @@ public:
 	virtual void Lock();
 	virtual void Unlock();
 
+	/** A load plan keeps the card locked, in a single PC/SC transaction, across several file reads so that
+	 * the application and file selected by one read are reused by the next. Load plans can't be nested */
+	virtual void BeginLoadPlan();
+	virtual void EndLoadPlan();
+	const tCardIOStats &GetIOStats() const { return m_ioStats; }
+
+	/** A sign session keeps the card locked across several signatures, with SSO on so that the signature PIN
+	 * is asked only once. Inside the session the security environment and the PIN verification state left by
+	 * one signature are reused by the next one, see CPteidCard::SignInternal(). Sign sessions can't be nested */
+	virtual void BeginSignSession();
+	virtual void EndSignSession();
+	bool IsSignSession() const { return m_bSignSession; }
+
 	virtual void ResetApplication();
 	virtual void SelectApplication(const CByteArray &oAID);
 	virtual void setSSO(bool value);
@@ -81,6 +95,11 @@ public:
 	virtual void WriteFile(const std::string &csPath, unsigned long ulOffset, const CByteArray &oData);
 	virtual tCacheInfo GetCacheInfo(const std::string &csPath);
 
+	/** Access the (encrypted) card cache for data that isn't obtained through ReadFile(),
+	 * e.g. files read under Secure Messaging. csName is prefixed with the card serial number */
+	CByteArray GetCachedData(const std::string &csName, bool &bFound);
+	void StoreCachedData(const std::string &csName, const CByteArray &oData);
+
 	virtual CByteArray ReadUncachedFile(const std::string &csPath, unsigned long ulOffset = 0,
 										unsigned long ulMaxLen = FULL_FILE) = 0;
 	virtual void WriteUncachedFile(const std::string &csPath, unsigned long ulOffset, const CByteArray &oData);
@@ -142,6 +161,17 @@ protected:
 	/** If ulExpected is provided and differs from the return code, an MWException is thrown */
 	virtual unsigned long getSW12(const CByteArray &oRespAPDU, unsigned long ulExpected = 0);
 
+	/** The EF selected by the last file read is only remembered while the card stays locked:
+	 * any SELECT command or the end of the transaction forgets it */
+	bool IsFileSelected(const std::string &csPath, tFileInfo &fileInfo);
+	void SetSelectedFile(const std::string &csPath, const tFileInfo &fileInfo);
+	void ForgetSelectedFile();
+
+	/** The MSE SET data of the last signature, only remembered while the card stays locked, like the selected EF */
+	bool IsSecurityEnvSet(const CByteArray &oSecurityEnv);
+	void SetSecurityEnvData(const CByteArray &oSecurityEnv);
+	void ForgetSecurityEnv();
+
 	CContext *m_poContext;
 	GenericPinpad *m_poPinpad;
 	CCache m_oCache;
@@ -159,6 +189,15 @@ protected:
 	const void *m_comm_protocol;
 	std::unique_ptr<PaceAuthentication> m_pace{};
 
+	bool m_bLoadPlan;
+	tCardIOStats m_ioStats;
+	std::string m_csSelectedFile;
+	tFileInfo m_selectedFileInfo;
+
+	bool m_bSignSession;
+	CByteArray m_oSecurityEnv;
+	std::set<unsigned long> m_signSessionPINs; // PIN references left verified by the signatures of the session
+
 private:
 	// No copies allowed
 	CCard(const CCard &oCard);
@@ -34,12 +34,80 @@
 #include "Cache.h"
 #include "Config.h"
 
+#include "CardTypeTable.h"
+
 #include "PteidCard.h"
 #include <vector>
 #include <string>
 
 namespace eIDMW {
 
+static bool SelectAppId(CContext *poContext, SCARDHANDLE hCard, const void *paramStructure, const unsigned char *oAID,
+						unsigned long size) {
+	long lRetVal = 0;
+	unsigned char tucSelectApp[] = {0x00, 0xA4, 0x04, 0x00};
+	CByteArray oCmd(12);
+	oCmd.Append(tucSelectApp, sizeof(tucSelectApp));
+	oCmd.Append((unsigned char)size);
+	oCmd.Append(oAID, size);
+
+	CByteArray oResp;
+	oResp = poContext->m_oPCSC.Transmit(hCard, oCmd, &lRetVal, paramStructure);
+	return (oResp.Size() == 2 && (oResp.GetByte(0) == 0x61 || oResp.GetByte(0) == 0x90));
+}
+
+/* Find out which PTEID applet a contact card has: 1 for IAS07 cards, whose applet is left selected, 3 for IAS5
+ * cards or 0 if none was found. Cards already seen in this reader are looked up in the card type table instead of
+ * probing their applets. bFromTable tells the caller to check the card it creates, see CheckKnownCard() */
+static int GetPteidAppletVersion(CContext *poContext, SCARDHANDLE hCard, DWORD protocol, const void *paramStructure,
+							const CByteArray &atr, const CByteArray &ifdVersion, bool &bFromTable) {
+	CCardTypeTable &table = CCardTypeTable::Instance();
+	tCardTypeInfo info;
+
+	bFromTable = false;
+	if (table.Lookup(atr, ifdVersion, info) && info.ulProtocol == protocol) {
+		// IAS5 cards select the eID application themselves when they read the serial number
+		if (info.ulVersion == 3) {
+			MWLOG(LEV_DEBUG, MOD_CAL, "Known IAS5 card, skipping the applet probe");
+			bFromTable = true;
+			return 3;
+		}
+		if (info.ulVersion == 1 && SelectAppId(poContext, hCard, paramStructure, PTEID_1_APPLET_AID,
+											   sizeof(PTEID_1_APPLET_AID))) {
+			MWLOG(LEV_DEBUG, MOD_CAL, "Known IAS07 card, skipping the applet probe");
+			bFromTable = true;
+			return 1;
+		}
+		MWLOG(LEV_INFO, MOD_CAL, "Card type table entry doesn't match the card, probing its applets");
+		table.Forget(atr, ifdVersion);
+	}
+
+	int appletVersion = 0;
+	if (SelectAppId(poContext, hCard, paramStructure, PTEID_1_APPLET_AID, sizeof(PTEID_1_APPLET_AID)))
+		appletVersion = 1;
+	else if (SelectAppId(poContext, hCard, paramStructure, PTEID_2_APPLET_NATIONAL_DATA,
+						 sizeof(PTEID_2_APPLET_NATIONAL_DATA)))
+		appletVersion = 3;
+
+	if (appletVersion > 0)
+		table.Learn(atr, ifdVersion, appletVersion, protocol);
+
+	return appletVersion;
+}
+
+/* A card created from a card type table entry that can't even read its serial number is not what the entry says:
+ * forget the entry so that the next connection probes the card */
+static void CheckKnownCard(CCard *poCard, const CByteArray &atr, const CByteArray &ifdVersion) {
+	try {
+		if (poCard != NULL && poCard->GetSerialNrBytes().Size() > 0)
+			return;
+	} catch (CMWException &e) {
+	}
+
+	MWLOG(LEV_WARN, MOD_CAL, "Card doesn't match its card type table entry");
+	CCardTypeTable::Instance().Forget(atr, ifdVersion);
+}
+
 CCard *CardConnect(SCARDHANDLE hCard, DWORD protocol, const std::string &csReader, CContext *poContext,
 				   GenericPinpad *poPinpad, bool &isContactLess) {
 	CCard *poCard = NULL;
@@ -66,32 +134,20 @@ CCard *CardConnect(SCARDHANDLE hCard, DWORD protocol, const std::string &csReade
 		else if (protocol == SCARD_PROTOCOL_T1)
 			paramStructure = SCARD_PCI_T1;
 
-		const auto selectAppId = [&](const unsigned char *oAID, unsigned long size) -> bool {
-			long lRetVal = 0;
-			unsigned char tucSelectApp[] = {0x00, 0xA4, 0x04, 0x00};
-			CByteArray oCmd(12);
-			oCmd.Append(tucSelectApp, sizeof(tucSelectApp));
-			oCmd.Append((unsigned char)size);
-			oCmd.Append(oAID, size);
-
-			CByteArray oResp;
-			oResp = poContext->m_oPCSC.Transmit(hCard, oCmd, &lRetVal, paramStructure);
-			return (oResp.Size() == 2 && (oResp.GetByte(0) == 0x61 || oResp.GetByte(0) == 0x90));
-		};
-
 		int appletVersion = 1;
 		if (!isContactLess) {
-			bool aidStatus = selectAppId(PTEID_1_APPLET_AID, sizeof(PTEID_1_APPLET_AID));
-			if (!aidStatus) {
-				bool nationalDataStatus =
-					selectAppId(PTEID_2_APPLET_NATIONAL_DATA, sizeof(PTEID_2_APPLET_NATIONAL_DATA));
-				if (nationalDataStatus)
-					appletVersion = 3;
-			}
+			CByteArray ifdVersion = poContext->m_oPCSC.GetIFDVersion(hCard);
+			bool bFromTable = false;
+			appletVersion =
+				GetPteidAppletVersion(poContext, hCard, protocol, paramStructure, atr, ifdVersion, bFromTable);
+			if (appletVersion == 0)
+				appletVersion = 1;
 
 			long cacheEnabled = CConfig::GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PTEID_CACHE_ENABLED);
 
 			poCard = PteidCardGetInstance(appletVersion, strReader, hCard, poContext, poPinpad, paramStructure);
+			if (bFromTable)
+				CheckKnownCard(poCard, atr, ifdVersion);
 			if (cacheEnabled)
 				poCard->InitEncryptionKey();
 		} else {
@@ -161,34 +217,18 @@ CCard *CardConnect(const std::string &csReader, CContext *poContext, GenericPinp
 
 			int appletVersion = 0;
 
-			const auto selectAppId = [&](const unsigned char *oAID, unsigned long size) -> bool {
-				long lRetVal = 0;
-				unsigned char tucSelectApp[] = {0x00, 0xA4, 0x04, 0x00};
-				CByteArray oCmd(12);
-				oCmd.Append(tucSelectApp, sizeof(tucSelectApp));
-				oCmd.Append((unsigned char)size);
-				oCmd.Append(oAID, size);
-
-				CByteArray oResp;
-				oResp = poContext->m_oPCSC.Transmit(hCard, oCmd, &lRetVal, param_structure);
-				return (oResp.Size() == 2 && (oResp.GetByte(0) == 0x61 || oResp.GetByte(0) == 0x90));
-			};
-
 			if (!isContactLess) {
-				bool aidStatus = selectAppId(PTEID_1_APPLET_AID, sizeof(PTEID_1_APPLET_AID));
-				if (aidStatus) {
-					appletVersion = 1;
-				} else {
-					bool nationalDataStatus =
-						selectAppId(PTEID_2_APPLET_NATIONAL_DATA, sizeof(PTEID_2_APPLET_NATIONAL_DATA));
-					if (nationalDataStatus)
-						appletVersion = 3;
-				}
+				CByteArray ifdVersion = poContext->m_oPCSC.GetIFDVersion(hCard);
+				bool bFromTable = false;
+				appletVersion =
+					GetPteidAppletVersion(poContext, hCard, ret.second, param_structure, atr, ifdVersion, bFromTable);
 				if (appletVersion > 0) {
 					long cacheEnabled = CConfig::GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PTEID_CACHE_ENABLED);
 
 					poCard =
 						PteidCardGetInstance(appletVersion, strReader, hCard, poContext, poPinpad, param_structure);
+					if (bFromTable)
+						CheckKnownCard(poCard, atr, ifdVersion);
 					if (cacheEnabled)
 						poCard->InitEncryptionKey();
 				}
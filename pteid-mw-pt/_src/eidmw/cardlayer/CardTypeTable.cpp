@@ -0,0 +1,152 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+#include "CardTypeTable.h"
+#include "Cache.h"
+#include "Log.h"
+#include "Util.h"
+
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+namespace eIDMW {
+
+/*
+ * One line per entry: ATR IFD-version version protocol applet-version
+ * The ATR and IFD version are in hex and a missing IFD or applet version is written as "-"
+ */
+#define CARD_TYPE_TABLE_FILENAME "pteid_cardtypes.txt"
+#define CARD_TYPE_TABLE_EMPTY "-"
+
+CCardTypeTable &CCardTypeTable::Instance() {
+	static CCardTypeTable table;
+	return table;
+}
+
+std::string CCardTypeTable::Key(const CByteArray &oATR, const CByteArray &oIFDVersion) {
+	std::string csIFD = oIFDVersion.Size() > 0 ? oIFDVersion.ToString(false) : CARD_TYPE_TABLE_EMPTY;
+	return oATR.ToString(false) + " " + csIFD;
+}
+
+std::string CCardTypeTable::GetPath() {
+	if (m_csPath.empty())
+		m_csPath = CCache::GetCacheDir() + CARD_TYPE_TABLE_FILENAME;
+	return m_csPath;
+}
+
+void CCardTypeTable::Load() {
+	m_table.clear();
+	m_bLoaded = true;
+
+	std::ifstream file(GetPath().c_str());
+	std::string csLine;
+	while (std::getline(file, csLine)) {
+		std::istringstream line(csLine);
+		std::string csATR, csIFD, csAppletVersion;
+		tCardTypeInfo info;
+		if (!(line >> csATR >> csIFD >> info.ulVersion >> info.ulProtocol >> csAppletVersion))
+			continue;
+
+		info.csAppletVersion = csAppletVersion == CARD_TYPE_TABLE_EMPTY ? "" : csAppletVersion;
+		m_table[csATR + " " + csIFD] = info;
+	}
+}
+
+void CCardTypeTable::Save() {
+	std::string csTempPath = CCacheFileLock::TempPath(GetPath());
+
+	FILE *f = NULL;
+	int err = fopen_s(&f, csTempPath.c_str(), "w");
+	if (f == NULL || err != 0) {
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to write the card type table");
+		return;
+	}
+
+	bool bOK = true;
+	for (const auto &entry : m_table) {
+		const tCardTypeInfo &info = entry.second;
+		std::string csAppletVersion = info.csAppletVersion.empty() ? CARD_TYPE_TABLE_EMPTY : info.csAppletVersion;
+		bOK = bOK && fprintf(f, "%s %lu %lu %s\n", entry.first.c_str(), info.ulVersion, info.ulProtocol,
+							 csAppletVersion.c_str()) > 0;
+	}
+	bOK = fclose(f) == 0 && bOK;
+
+#ifdef WIN32
+	bOK = bOK && MoveFileExA(csTempPath.c_str(), GetPath().c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bOK = bOK && rename(csTempPath.c_str(), GetPath().c_str()) == 0;
+#endif
+	if (!bOK) {
+		MWLOG(LEV_WARN, MOD_CAL, "Failed to write the card type table");
+		remove(csTempPath.c_str());
+	}
+}
+
+bool CCardTypeTable::Lookup(const CByteArray &oATR, const CByteArray &oIFDVersion, tCardTypeInfo &info) {
+	CAutoMutex autoMutex(&m_Mutex);
+
+	if (!m_bLoaded)
+		Load();
+
+	auto it = m_table.find(Key(oATR, oIFDVersion));
+	if (it == m_table.end())
+		return false;
+
+	info = it->second;
+	return true;
+}
+
+/* The entries are changed on top of a fresh copy of the file, loaded and saved under a CCacheFileLock, to keep
+   what other processes learned meanwhile */
+void CCardTypeTable::Learn(const CByteArray &oATR, const CByteArray &oIFDVersion, unsigned long ulVersion,
+						   unsigned long ulProtocol) {
+	CAutoMutex autoMutex(&m_Mutex);
+	CCacheFileLock fileLock(GetPath());
+	if (!fileLock.IsLocked())
+		return;
+
+	Load();
+	tCardTypeInfo &info = m_table[Key(oATR, oIFDVersion)];
+	if (info.ulVersion != ulVersion)
+		info.csAppletVersion.clear();
+	info.ulVersion = ulVersion;
+	info.ulProtocol = ulProtocol;
+	Save();
+}
+
+void CCardTypeTable::LearnAppletVersion(const CByteArray &oATR, const CByteArray &oIFDVersion,
+										const std::string &csAppletVersion) {
+	CAutoMutex autoMutex(&m_Mutex);
+
+	// Applet versions with spaces or NULs can't be stored, they are just asked to the card every time
+	if (csAppletVersion.empty() || csAppletVersion.find_first_of(std::string(" \t\r\n\0", 5)) != std::string::npos)
+		return;
+
+	CCacheFileLock fileLock(GetPath());
+	if (!fileLock.IsLocked())
+		return;
+
+	Load();
+	auto it = m_table.find(Key(oATR, oIFDVersion));
+	if (it == m_table.end() || it->second.csAppletVersion == csAppletVersion)
+		return;
+
+	it->second.csAppletVersion = csAppletVersion;
+	Save();
+}
+
+void CCardTypeTable::Forget(const CByteArray &oATR, const CByteArray &oIFDVersion) {
+	CAutoMutex autoMutex(&m_Mutex);
+	CCacheFileLock fileLock(GetPath());
+	if (!fileLock.IsLocked())
+		return;
+
+	Load();
+	if (m_table.erase(Key(oATR, oIFDVersion)) > 0)
+		Save();
+}
+
+} // namespace eIDMW
@@ -0,0 +1,58 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+#pragma once
+#ifndef __CARDTYPETABLE_H__
+#define __CARDTYPETABLE_H__
+
+#include "ByteArray.h"
+#include "Mutex.h"
+
+#include <map>
+#include <string>
+
+namespace eIDMW {
+
+/* What was learned about the cards with a given ATR in a given reader */
+typedef struct {
+	unsigned long ulVersion;	 /* applet version as passed to PteidCardGetInstance(): 1 (IAS07) or 3 (IAS5) */
+	unsigned long ulProtocol;	 /* SCARD_PROTOCOL_T0 or SCARD_PROTOCOL_T1 */
+	std::string csAppletVersion; /* CPteidCard::GetAppletVersion(), empty if it was never asked */
+} tCardTypeInfo;
+
+/**
+ * Table of the card types seen on this machine, keyed by ATR and IFD version, so that CardConnect() doesn't have
+ * to probe the card applets of a known card. The table is kept in a small text file in the cache directory.
+ * An entry is only a hint: the caller falls back to probing, and calls Forget(), if the card doesn't behave
+ * like the entry says.
+ */
+class CCardTypeTable {
+public:
+	static CCardTypeTable &Instance();
+
+	bool Lookup(const CByteArray &oATR, const CByteArray &oIFDVersion, tCardTypeInfo &info);
+	void Learn(const CByteArray &oATR, const CByteArray &oIFDVersion, unsigned long ulVersion,
+			   unsigned long ulProtocol);
+	void LearnAppletVersion(const CByteArray &oATR, const CByteArray &oIFDVersion, const std::string &csAppletVersion);
+	void Forget(const CByteArray &oATR, const CByteArray &oIFDVersion);
+
+private:
+	CCardTypeTable() : m_bLoaded(false) {}
+
+	static std::string Key(const CByteArray &oATR, const CByteArray &oIFDVersion);
+
+	std::string GetPath();
+	void Load();
+	void Save();
+
+	CMutex m_Mutex;
+	bool m_bLoaded;
+	std::string m_csPath;
+	std::map<std::string, tCardTypeInfo> m_table;
+};
+
+} // namespace eIDMW
+
+#endif
@@ -38,6 +38,17 @@ typedef struct {
 	unsigned long lWritePINRef; // 0 means 'no PIN needed' or 'unknown'
 } tFileInfo;
 
+/* Counters of the commands sent to a card, see CCard::BeginLoadPlan() and CCard::BeginSignSession() */
+typedef struct {
+	unsigned long ulAPDUs;				 // APDUs sent to the card
+	unsigned long ulSelectsSkipped;		 // SELECTs not sent because the file or application was already selected
+	unsigned long ulTransactions;		 // PC/SC transactions started
+	unsigned long ulTransactionsSaved;	 // Card operations that ran inside the transaction of a load plan
+	unsigned long ulSignatures;			 // Signatures computed by the card
+	unsigned long ulSecurityEnvsSkipped; // MSE SETs not sent because the same key and algorithm were already set
+	unsigned long ulPinVerifiesSkipped;	 // PIN VERIFYs not sent because the PIN was verified earlier in the session
+} tCardIOStats;
+
 const unsigned long MAX_APDU_READ_LEN = 256;
 const unsigned long MAX_APDU_WRITE_LEN = 255;
 // Max APDU size of the IAS applet
@@ -38,6 +38,7 @@
 #include "PCSC.h"
 #include "InternalConst.h"
 
+#include <chrono>
 #include <exception>
 #include <utility>
 
@@ -47,6 +48,9 @@ CPCSC::CPCSC() {
 	CConfig config;
 
 	m_ulCardTxDelay = config.GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_CARDTXDELAY);
+	m_bExclusive = config.GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_EXCLUSIVE_READER) != 0;
+	m_ulTransmitCount = 0;
+	m_ullTransmitMicros = 0;
 	m_hContext = 0;
 	m_iTimeoutCount = 0;
 	m_iListReadersCount = 0;
@@ -67,6 +71,14 @@ void CPCSC::EstablishContext() {
 }
 
 void CPCSC::ReleaseContext() {
+	if (m_ulTransmitCount > 0) {
+		MWLOG(LEV_INFO, MOD_CAL, L"    %lu APDUs, average APDU latency %.3f ms (%ls mode)",
+			  (unsigned long)m_ulTransmitCount, m_ullTransmitMicros / 1000.0 / m_ulTransmitCount,
+			  m_bExclusive ? L"exclusive" : L"shared");
+		m_ulTransmitCount = 0;
+		m_ullTransmitMicros = 0;
+	}
+
 	if (m_hContext != 0) {
 		SCardReleaseContext(m_hContext);
 		m_hContext = 0;
@@ -189,6 +201,9 @@ std::pair<SCARDHANDLE, DWORD> CPCSC::Connect(const std::string &csReader, unsign
 	DWORD dwActiveProtocol;
 	SCARDHANDLE hCard = 0;
 
+	if (m_bExclusive && ulShareMode == SCARD_SHARE_SHARED)
+		ulShareMode = SCARD_SHARE_EXCLUSIVE;
+
 	LONG lRet =
 		SCardConnect(m_hContext, csReader.c_str(), ulShareMode, ulPreferredProtocols, &hCard, &dwActiveProtocol);
 
@@ -299,7 +314,10 @@ CByteArray CPCSC::Transmit(SCARDHANDLE hCard, const CByteArray &inputAPDU, long
 	// It occurs with most readers (some more then others) and depends heavily
 	// on the type of card (e.g. nearly always with the test Kids card).
 	// It seems to be fixed when adding a delay before sending something to the card...
-	CThread::SleepMillisecs(m_ulCardTxDelay);
+	// In exclusive mode no other application can talk to the card in between, so the delay is skipped.
+	auto start = std::chrono::steady_clock::now();
+	if (!m_bExclusive)
+		CThread::SleepMillisecs(m_ulCardTxDelay);
 
 #ifdef __APPLE__
 	int iRetryCount = 0;
@@ -309,6 +327,9 @@ try_again:
 		SCardTransmit(hCard, pioSendPci, oCmdAPDU.GetBytes(), (DWORD)oCmdAPDU.Size(), NULL, tucRecv, &dwRecvLen);
 
 	*plRetVal = lRet;
+	m_ulTransmitCount++;
+	m_ullTransmitMicros +=
+		std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
 	if (SCARD_S_SUCCESS != lRet) {
 #ifdef __APPLE__
 		if (SCARD_E_SHARING_VIOLATION == lRet && iRetryCount < 3) {
@@ -349,13 +370,14 @@ void CPCSC::Recover(SCARDHANDLE hCard, unsigned long *pulLockCount) {
 		if (i != 0)
 			CThread::SleepMillisecs(100);
 
-		lRet = SCardReconnect(hCard, SCARD_SHARE_SHARED, SCARD_PROTOCOL_T0, SCARD_RESET_CARD, &ap);
+		lRet = SCardReconnect(hCard, m_bExclusive ? SCARD_SHARE_EXCLUSIVE : SCARD_SHARE_SHARED, SCARD_PROTOCOL_T0,
+							  SCARD_RESET_CARD, &ap);
 		if (lRet != SCARD_S_SUCCESS) {
 			MWLOG(LEV_DEBUG, MOD_CAL, L"        [%d] SCardReconnect errorcode: [0x%02X]", i, lRet);
 			continue;
 		}
 		// transaction is lost after an SCardReconnect()
-		if (*pulLockCount > 0) {
+		if (*pulLockCount > 0 && !m_bExclusive) {
 			lRet = SCardBeginTransaction(hCard);
 			if (lRet != SCARD_S_SUCCESS) {
 				MWLOG(LEV_DEBUG, MOD_CAL, L"        [%d] SCardBeginTransaction errorcode: [0x%02X]", i, lRet);
@@ -415,6 +437,9 @@ CByteArray CPCSC::Control(SCARDHANDLE hCard, unsigned long ulControl, const CByt
 }
 
 void CPCSC::BeginTransaction(SCARDHANDLE hCard) {
+	if (m_bExclusive)
+		return;
+
 	LONG lRet = SCardBeginTransaction(hCard);
 	MWLOG(LEV_DEBUG, MOD_CAL, L"    SCardBeginTransaction(0x%0x): 0x%0x", hCard, lRet);
 	if (SCARD_S_SUCCESS != lRet)
@@ -422,6 +447,9 @@ void CPCSC::BeginTransaction(SCARDHANDLE hCard) {
 }
 
 void CPCSC::EndTransaction(SCARDHANDLE hCard) {
+	if (m_bExclusive)
+		return;
+
 	LONG lRet = SCardEndTransaction(hCard, SCARD_LEAVE_CARD);
 	MWLOG(LEV_DEBUG, MOD_CAL, L"    SCardEndTransaction(0x%0x): 0x%0x", hCard, lRet);
 
@@ -34,6 +34,7 @@ Takes care of
 #include "CardLayerConst.h"
 #include "InternalConst.h"
 
+#include <atomic>
 #include <utility>
 
 #ifndef WIN32
@@ -123,6 +124,13 @@ public:
 	void BeginTransaction(SCARDHANDLE hCard);
 	void EndTransaction(SCARDHANDLE hCard);
 
+	/**
+	 * Exclusive reader mode (config "exclusive_reader"), for dedicated machines where this process owns the readers:
+	 * cards are connected with SCARD_SHARE_EXCLUSIVE, so transactions are not needed and are skipped, there's no
+	 * delay before each APDU and CReader relies on the reader event monitor to detect card removal.
+	 */
+	bool IsExclusive() const { return m_bExclusive; }
+
 	// unsigned long GetContext();
 	SCARDCONTEXT GetContext();
 
@@ -140,6 +148,12 @@ private:
 	int m_iListReadersCount;
 
 	unsigned long m_ulCardTxDelay; // delay before each transmission to a smartcard; in millie-seconds, default 1
+	bool m_bExclusive;
+
+	// Number of APDUs and their total latency, including the transmit delay, logged by ReleaseContext() to compare
+	// the shared and exclusive modes
+	std::atomic<unsigned long> m_ulTransmitCount;
+	std::atomic<unsigned long long> m_ullTransmitMicros;
 };
 
 } // namespace eIDMW
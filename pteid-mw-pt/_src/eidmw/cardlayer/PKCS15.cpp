@@ -25,6 +25,10 @@
 #include "PKCS15.h"
 #include "PKCS15Parser.h"
 #include "Card.h"
+#include "Config.h"
+#include "Log.h"
+
+#include <openssl/evp.h>
 
 namespace eIDMW {
 
@@ -50,7 +54,78 @@ std::string csPath;
 const std::string defaultEFTokenInfo = "3F004F005032";
 const std::string defaultEFODF = "3F004F005031";
 
-CPKCS15::CPKCS15(void) {}
+/*
+ * Cache entry with the parsed PKCS15 objects, all integers are 4 bytes big-endian and strings are length-prefixed:
+ *
+ *   magic "P15" | version | SHA-256(TokenInfo) | app path | serial | label | AODF, CDF, PrKDF and PuKDF paths
+ *   | pin count | tPin... | cert count | tCert... | key count | tPrivKey...
+ */
+#define P15_CACHE_NAME "pkcs15"
+#define P15_CACHE_MAGIC "P15"
+#define P15_CACHE_VERSION 0x01
+#define P15_CACHE_HASH_LEN 32
+
+static void PutLong(CByteArray &oData, unsigned long ulValue) {
+	for (int i = 3; i >= 0; i--)
+		oData.Append((unsigned char)(0xFF & (ulValue >> (8 * i))));
+}
+
+static void PutString(CByteArray &oData, const std::string &csValue) {
+	PutLong(oData, (unsigned long)csValue.size());
+	oData.Append(csValue);
+}
+
+/* Sequential reader of a cache entry, throws EIDMW_ERR_PARAM_RANGE if the entry is truncated */
+class CP15CacheReader {
+public:
+	CP15CacheReader(const CByteArray &oData) : m_oData(oData), m_ulPos(0) {}
+
+	unsigned long GetLong() {
+		Check(4);
+		unsigned long ulValue = 0;
+		for (int i = 0; i < 4; i++)
+			ulValue = (ulValue << 8) | m_oData.GetByte(m_ulPos++);
+		return ulValue;
+	}
+
+	std::string GetString() {
+		unsigned long ulLen = GetLong();
+		Check(ulLen);
+		std::string csValue((const char *)m_oData.GetBytes() + m_ulPos, ulLen);
+		m_ulPos += ulLen;
+		return csValue;
+	}
+
+	CByteArray GetBytes(unsigned long ulLen) {
+		Check(ulLen);
+		CByteArray oValue = m_oData.GetBytes(m_ulPos, ulLen);
+		m_ulPos += ulLen;
+		return oValue;
+	}
+
+	bool AtEnd() const { return m_ulPos == m_oData.Size(); }
+
+private:
+	void Check(unsigned long ulLen) {
+		if (ulLen > m_oData.Size() - m_ulPos)
+			throw CMWEXCEPTION(EIDMW_ERR_PARAM_RANGE);
+	}
+
+	const CByteArray &m_oData;
+	unsigned long m_ulPos;
+};
+
+static CByteArray TokenInfoHash(const CByteArray &oTokenInfo) {
+	unsigned char hash[EVP_MAX_MD_SIZE];
+	unsigned int hashLen = 0;
+
+	if (EVP_Digest(oTokenInfo.GetBytes(), oTokenInfo.Size(), hash, &hashLen, EVP_sha256(), NULL) != 1)
+		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+
+	return CByteArray(hash, hashLen);
+}
+
+CPKCS15::CPKCS15(void) : m_bCacheChecked(false) {}
 
 CPKCS15::CPKCS15(CContext *poContext) : m_poContext(poContext) { Clear(); }
 
@@ -77,6 +152,8 @@ void CPKCS15::Clear(CCard *poCard) {
 	m_xAODF.setDefault();
 	m_xCDF.setDefault();
 	m_xPrKDF.setDefault();
+
+	m_bCacheChecked = false;
 }
 
 void CPKCS15::SetCard(CCard *poCard) { m_poCard = poCard; }
@@ -238,6 +315,9 @@ void CPKCS15::ReadLevel2(tPKCSFileName name) {
 	tOdfInfo resultOdf;
 	tTokenInfo resultTokenInfo;
 
+	if (LoadCachedObjects())
+		return;
+
 	switch (name) {
 	case ODF:
 		ReadFile(&m_xODF, 1);
@@ -265,6 +345,8 @@ void CPKCS15::ReadLevel2(tPKCSFileName name) {
 }
 
 void CPKCS15::ReadLevel3(tPKCSFileName name) {
+	if (LoadCachedObjects())
+		return;
 
 	switch (name) {
 	case AODF:
@@ -322,4 +404,196 @@ void CPKCS15::ReadFile(tPKCSFile *pFile, int upperLevel) {
 	pFile->isRead = true;
 }
 
+/* The PKCS15 structure of a card never changes, so the parsed objects are stored in the card cache the first time
+ * they are read. On the next connections only TokenInfo is read, to check that the cached objects belong to the
+ * same card contents, and EF.DIR, ODF, AODF, CDF and PrKDF are neither read nor parsed again.
+ * IAS5 cards are not cached: their objects are hardcoded and only TokenInfo is read from the card.
+ * Returns true if all the objects are now loaded */
+bool CPKCS15::LoadCachedObjects() {
+	if (m_bCacheChecked)
+		return false;
+	m_bCacheChecked = true;
+
+	if (m_poCard == NULL || m_poCard->GetType() == CARD_PTEID_IAS5 ||
+		!CConfig::GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PTEID_CACHE_ENABLED))
+		return false;
+
+	try {
+		bool bFound = false;
+		CByteArray oCached = m_poCard->GetCachedData(P15_CACHE_NAME, bFound);
+		CByteArray oCachedHash;
+		if (bFound && DeserializeObjects(oCached, oCachedHash)) {
+			m_xTokenInfo.byteArray = m_poCard->ReadFile(m_xTokenInfo.path);
+			if (TokenInfoHash(m_xTokenInfo.byteArray).Equals(oCachedHash)) {
+				m_xDir.isRead = m_xTokenInfo.isRead = m_xODF.isRead = true;
+				m_xAODF.isRead = m_xCDF.isRead = m_xPrKDF.isRead = true;
+				MWLOG(LEV_DEBUG, MOD_CAL, "PKCS15 objects of card %s loaded from cache", m_csSerial.c_str());
+				return true;
+			}
+			MWLOG(LEV_INFO, MOD_CAL, "PKCS15 cache entry doesn't match TokenInfo, reading the card");
+		}
+
+		// Start from scratch as a stale entry already filled in the objects and paths
+		Clear(m_poCard);
+		m_bCacheChecked = true;
+
+		ReadLevel2(TOKENINFO);
+		ReadLevel3(AODF);
+		ReadLevel3(CDF);
+		ReadLevel3(PRKDF);
+
+		m_poCard->StoreCachedData(P15_CACHE_NAME, SerializeObjects());
+		return true;
+	} catch (CMWException &e) {
+		MWLOG(LEV_WARN, MOD_CAL, "PKCS15 cache not used: error 0x%08lx", e.GetError());
+		Clear(m_poCard);
+		m_bCacheChecked = true;
+		return false;
+	}
+}
+
+CByteArray CPKCS15::SerializeObjects() {
+	CByteArray oData;
+
+	oData.Append(std::string(P15_CACHE_MAGIC));
+	oData.Append((unsigned char)P15_CACHE_VERSION);
+	oData.Append(TokenInfoHash(m_xTokenInfo.byteArray));
+
+	PutString(oData, m_tDir.csAppPath);
+	PutString(oData, m_csSerial);
+	PutString(oData, m_csLabel);
+	PutString(oData, m_xAODF.path);
+	PutString(oData, m_xCDF.path);
+	PutString(oData, m_xPrKDF.path);
+	PutString(oData, m_xPuKDF.path);
+
+	PutLong(oData, (unsigned long)m_oPins.size());
+	for (const tPin &pin : m_oPins) {
+		oData.Append((unsigned char)pin.bValid);
+		PutString(oData, pin.csLabel);
+		PutLong(oData, pin.ulFlags);
+		PutLong(oData, pin.ulAuthID);
+		PutLong(oData, pin.ulUserConsent);
+		PutLong(oData, pin.ulID);
+		PutLong(oData, pin.ulPinFlags);
+		PutLong(oData, pin.ulPinType);
+		PutLong(oData, pin.ulMinLen);
+		PutLong(oData, pin.ulStoredLen);
+		PutLong(oData, pin.ulMaxLen);
+		PutLong(oData, pin.ulPinRef);
+		oData.Append(pin.ucPadChar);
+		PutLong(oData, (unsigned long)pin.encoding);
+		PutString(oData, pin.csLastChange);
+		PutString(oData, pin.csPath);
+	}
+
+	PutLong(oData, (unsigned long)m_oCertificates.size());
+	for (const tCert &cert : m_oCertificates) {
+		oData.Append((unsigned char)cert.bValid);
+		PutString(oData, cert.csLabel);
+		PutLong(oData, cert.ulFlags);
+		PutLong(oData, cert.ulAuthID);
+		PutLong(oData, cert.ulUserConsent);
+		PutLong(oData, cert.ulID);
+		oData.Append((unsigned char)cert.bAuthority);
+		oData.Append((unsigned char)cert.bImplicitTrust);
+		PutString(oData, cert.csPath);
+	}
+
+	PutLong(oData, (unsigned long)m_oPrKeys.size());
+	for (const tPrivKey &key : m_oPrKeys) {
+		oData.Append((unsigned char)key.bValid);
+		PutString(oData, key.csLabel);
+		PutLong(oData, key.ulFlags);
+		PutLong(oData, key.ulAuthID);
+		PutLong(oData, key.ulUserConsent);
+		PutLong(oData, key.ulID);
+		PutLong(oData, key.ulKeyUsageFlags);
+		PutLong(oData, key.ulKeyAccessFlags);
+		PutLong(oData, key.ulKeyRef);
+		PutString(oData, key.csPath);
+		PutLong(oData, key.ulKeyLenBytes);
+		oData.Append((unsigned char)key.bUsedInP11);
+	}
+
+	return oData;
+}
+
+/* Fill in the objects and file paths from a cache entry. Returns false if it's not a valid entry */
+bool CPKCS15::DeserializeObjects(const CByteArray &oData, CByteArray &oTokenInfoHash) {
+	CP15CacheReader reader(oData);
+
+	if (memcmp(reader.GetBytes(3).GetBytes(), P15_CACHE_MAGIC, 3) != 0 ||
+		reader.GetBytes(1).GetByte(0) != P15_CACHE_VERSION)
+		return false;
+	oTokenInfoHash = reader.GetBytes(P15_CACHE_HASH_LEN);
+
+	m_tDir.csAppPath = reader.GetString();
+	m_csSerial = reader.GetString();
+	m_csLabel = reader.GetString();
+	m_xAODF.path = reader.GetString();
+	m_xCDF.path = reader.GetString();
+	m_xPrKDF.path = reader.GetString();
+	m_xPuKDF.path = reader.GetString();
+	m_xTokenInfo.path = m_tDir.csAppPath + "5032";
+	m_xODF.path = m_tDir.csAppPath + "5031";
+
+	unsigned long ulCount = reader.GetLong();
+	for (unsigned long i = 0; i < ulCount; i++) {
+		tPin pin;
+		pin.bValid = reader.GetBytes(1).GetByte(0) != 0;
+		pin.csLabel = reader.GetString();
+		pin.ulFlags = reader.GetLong();
+		pin.ulAuthID = reader.GetLong();
+		pin.ulUserConsent = reader.GetLong();
+		pin.ulID = reader.GetLong();
+		pin.ulPinFlags = reader.GetLong();
+		pin.ulPinType = reader.GetLong();
+		pin.ulMinLen = reader.GetLong();
+		pin.ulStoredLen = reader.GetLong();
+		pin.ulMaxLen = reader.GetLong();
+		pin.ulPinRef = reader.GetLong();
+		pin.ucPadChar = reader.GetBytes(1).GetByte(0);
+		pin.encoding = (tPinEncoding)reader.GetLong();
+		pin.csLastChange = reader.GetString();
+		pin.csPath = reader.GetString();
+		m_oPins.push_back(pin);
+	}
+
+	ulCount = reader.GetLong();
+	for (unsigned long i = 0; i < ulCount; i++) {
+		tCert cert;
+		cert.bValid = reader.GetBytes(1).GetByte(0) != 0;
+		cert.csLabel = reader.GetString();
+		cert.ulFlags = reader.GetLong();
+		cert.ulAuthID = reader.GetLong();
+		cert.ulUserConsent = reader.GetLong();
+		cert.ulID = reader.GetLong();
+		cert.bAuthority = reader.GetBytes(1).GetByte(0) != 0;
+		cert.bImplicitTrust = reader.GetBytes(1).GetByte(0) != 0;
+		cert.csPath = reader.GetString();
+		m_oCertificates.push_back(cert);
+	}
+
+	ulCount = reader.GetLong();
+	for (unsigned long i = 0; i < ulCount; i++) {
+		tPrivKey key;
+		key.bValid = reader.GetBytes(1).GetByte(0) != 0;
+		key.csLabel = reader.GetString();
+		key.ulFlags = reader.GetLong();
+		key.ulAuthID = reader.GetLong();
+		key.ulUserConsent = reader.GetLong();
+		key.ulID = reader.GetLong();
+		key.ulKeyUsageFlags = reader.GetLong();
+		key.ulKeyAccessFlags = reader.GetLong();
+		key.ulKeyRef = reader.GetLong();
+		key.csPath = reader.GetString();
+		key.ulKeyLenBytes = reader.GetLong();
+		key.bUsedInP11 = reader.GetBytes(1).GetByte(0) != 0;
+		m_oPrKeys.push_back(key);
+	}
+
+	return reader.AtEnd();
+}
+
 } // namespace eIDMW
@@ -126,12 +126,19 @@ private:
 	tPKCSFile m_xPrKey;
 	tPKCSFile m_xCert;
 
+	// The parsed objects are kept in the card cache, see LoadCachedObjects()
+	bool m_bCacheChecked;
+
 	// read methods for level1 (dir file), level 2 (token info and odf) and level 3 (aodf,cdf and prkdf)
 	void ReadLevel1();
 	void ReadLevel2(tPKCSFileName name);
 	void ReadLevel3(tPKCSFileName name);
 
 	void ReadFile(tPKCSFile *pFile, int upperLevel);
+
+	bool LoadCachedObjects();
+	CByteArray SerializeObjects();
+	bool DeserializeObjects(const CByteArray &oData, CByteArray &oTokenInfoHash);
 };
 
 } // namespace eIDMW
@@ -55,6 +55,7 @@ void CPkiCard::SelectApplication(const CByteArray &oAID) {
 	CAutoLock autolock(this);
 
 	if (memcmp(oAID.GetBytes(), m_lastSelectedApplication.GetBytes(), sizeof(oAID.Size())) == 0) {
+		m_ioStats.ulSelectsSkipped++;
 		return;
 	}
 	// Select File command to select the Application by AID
@@ -71,9 +72,15 @@ CByteArray CPkiCard::ReadUncachedFile(const std::string &csPath, unsigned long u
 	// We use max_block_read_length as 223 because of a limit on SM layer
 	const int MAX_BLOCK_READ_LENGTH = m_pace.get() != NULL ? 223 : MAX_APDU_READ_LEN;
 
-	MWLOG(LEV_INFO, MOD_CAL, L"   SelectUncachedFile %ls", utilStringWiden(csPath).c_str());
-
-	tFileInfo fileInfo = SelectFile(csPath, true);
+	// Inside a load plan the file may still be selected from the previous read
+	tFileInfo fileInfo;
+	if (IsFileSelected(csPath, fileInfo)) {
+		MWLOG(LEV_DEBUG, MOD_CAL, L"   File %ls is already selected", utilStringWiden(csPath).c_str());
+	} else {
+		MWLOG(LEV_INFO, MOD_CAL, L"   SelectUncachedFile %ls", utilStringWiden(csPath).c_str());
+		fileInfo = SelectFile(csPath, true);
+		SetSelectedFile(csPath, fileInfo);
+	}
 	unsigned long realMaxLen = (std::min)(fileInfo.lFileLen, ulMaxLen);
 	unsigned long offsetByte = ulOffset;
 
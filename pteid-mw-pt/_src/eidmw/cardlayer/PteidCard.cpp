@@ -32,6 +32,7 @@
 #endif
 
 #include "PteidCard.h"
+#include "CardTypeTable.h"
 #include "Log.h"
 #include "Config.h"
 #include "CardLayer.h"
@@ -168,19 +169,55 @@ CByteArray CPteidCard::GetSerialNrBytes() {
 
 CByteArray CPteidCard::GetInfo() { return m_oCardData; }
 
+#define APPLET_VERSION_LEN 7
+
+/* Applet versions as returned by the IAS07 cards, e.g. "4.4.2.A", optionally prefixed with 'v' */
+static bool IsValidAppletVersion(const std::string &csVersion) {
+	if (csVersion.size() != APPLET_VERSION_LEN)
+		return false;
+
+	size_t major = csVersion[0] == 'v' ? 1 : 0;
+	if (!isdigit((unsigned char)csVersion[major]))
+		return false;
+
+	for (size_t i = major; i < csVersion.size(); i++) {
+		if (!isalnum((unsigned char)csVersion[i]) && csVersion[i] != '.')
+			return false;
+	}
+	return true;
+}
+
 std::string CPteidCard::GetAppletVersion() {
 	std::string applet_version;
-	const size_t VERSION_OFFSET = 3, VERSION_LEN = 7;
+	const size_t VERSION_OFFSET = 3, VERSION_LEN = APPLET_VERSION_LEN;
 	if (m_cardType == CARD_PTEID_IAS07) {
+		if (!m_csAppletVersion.empty())
+			return m_csAppletVersion;
+
+		// Cards with the same ATR have the same applet version, see CCardTypeTable
+		CByteArray atr = GetATR();
+		CByteArray ifdVersion = GetIFDVersion();
+		tCardTypeInfo info;
+		if (CCardTypeTable::Instance().Lookup(atr, ifdVersion, info) && !info.csAppletVersion.empty()) {
+			if (IsValidAppletVersion(info.csAppletVersion)) {
+				m_csAppletVersion = info.csAppletVersion;
+				return m_csAppletVersion;
+			}
+			MWLOG(LEV_WARN, MOD_CAL, "Ignoring invalid cached applet version, asking the card");
+		}
+
 		const unsigned char apdu_appletversion[] = {0x00, 0xCA, 0xDF, 0x30, 0x00};
 		CByteArray applet_version_ba(apdu_appletversion, sizeof(apdu_appletversion));
 		CByteArray resp = SendAPDU(applet_version_ba);
 		unsigned long ulSW12 = getSW12(resp);
 
-		if (ulSW12 == 0x9000) {
+		if (ulSW12 == 0x9000 && resp.Size() >= VERSION_OFFSET + VERSION_LEN + 2) {
 
 			const unsigned char *data = resp.GetBytes();
 			applet_version.append((const char *)data + VERSION_OFFSET, VERSION_LEN);
+			m_csAppletVersion = applet_version;
+			if (IsValidAppletVersion(applet_version))
+				CCardTypeTable::Instance().LearnAppletVersion(atr, ifdVersion, applet_version);
 		}
 	} else {
 		throw CMWEXCEPTION(EIDMW_ERR_NOT_SUPPORTED);
@@ -189,6 +226,16 @@ std::string CPteidCard::GetAppletVersion() {
 	return applet_version;
 }
 
+void CPteidCard::ForgetAppletVersion() {
+	if (m_cardType != CARD_PTEID_IAS07)
+		return;
+
+	MWLOG(LEV_WARN, MOD_CAL, "Signature algorithm rejected by the card, forgetting its applet version %s",
+		  m_csAppletVersion.c_str());
+	m_csAppletVersion.clear();
+	CCardTypeTable::Instance().Forget(GetATR(), GetIFDVersion());
+}
+
 unsigned long CPteidCard::PinStatus(const tPin &Pin) {
 	unsigned long ulSW12 = 0;
 
@@ -564,7 +611,10 @@ unsigned long CPteidCard::GetSupportedAlgorithms() {
 
 	if (m_cardType == CARD_PTEID_IAS07) {
 		std::string applet_version = GetAppletVersion();
-		char major_version = applet_version[0] == 'v' ? applet_version[1] : applet_version[0];
+		// Only the base algorithms if the card didn't return a valid version
+		char major_version = 0;
+		if (IsValidAppletVersion(applet_version))
+			major_version = applet_version[0] == 'v' ? applet_version[1] : applet_version[0];
 
 		ulAlgos |= SIGN_ALGO_RSA_PKCS | SIGN_ALGO_SHA1_RSA_PKCS | SIGN_ALGO_SHA256_RSA_PKCS;
 
@@ -583,6 +633,7 @@ unsigned long CPteidCard::GetSupportedAlgorithms() {
 void CPteidCard::SetSecurityEnv(const tPrivKey &key, unsigned long paddingType, unsigned long ulInputLen) {
 	CByteArray oDataias, oDatagem;
 	unsigned char ucAlgo = 0x02;
+	unsigned char ucP2 = 0xB6;
 	CByteArray oResp;
 
 	m_ucCLA = 0x00;
@@ -603,7 +654,6 @@ void CPteidCard::SetSecurityEnv(const tPrivKey &key, unsigned long paddingType,
 		oDatagem.Append(0x01);
 		assert(key.ulKeyRef <= UCHAR_MAX);
 		oDatagem.Append((unsigned char)key.ulKeyRef);
-		oResp = SendAPDU(0x22, 0x41, 0xB6, oDatagem);
 
 	} else if (m_cardType == CARD_PTEID_IAS07) {
 		oDatagem.Append(0x80);
@@ -627,7 +677,6 @@ void CPteidCard::SetSecurityEnv(const tPrivKey &key, unsigned long paddingType,
 		oDatagem.Append(0x01);
 		assert(key.ulKeyRef <= UCHAR_MAX);
 		oDatagem.Append((unsigned char)key.ulKeyRef);
-		oResp = SendAPDU(0x22, 0x41, 0xB6, oDatagem);
 	} else {
 		// Legacy IAS v1 cards
 		oDataias.Append(0x95);
@@ -641,12 +690,27 @@ void CPteidCard::SetSecurityEnv(const tPrivKey &key, unsigned long paddingType,
 		oDataias.Append(0x01);
 		oDataias.Append(0x02);
 
-		oResp = SendAPDU(0x22, 0x41, 0xA4, oDataias);
+		ucP2 = 0xA4;
+		oDatagem = oDataias;
 	}
 
-	unsigned long ulSW12 = getSW12(oResp);
+	// The security environment set for the previous signature is kept by the card while it stays locked
+	CByteArray oSecurityEnv(&ucP2, 1);
+	oSecurityEnv.Append(oDatagem);
+	if (IsSecurityEnvSet(oSecurityEnv))
+		return;
 
-	getSW12(oResp, 0x9000);
+	oResp = SendAPDU(0x22, 0x41, ucP2, oDatagem);
+
+	unsigned long ulSW12 = getSW12(oResp);
+	if (ulSW12 != 0x9000) {
+		// Wrong data or reference: the algorithm isn't supported by this card
+		if (ulSW12 == 0x6A80 || ulSW12 == 0x6A81 || ulSW12 == 0x6A86 || ulSW12 == 0x6A88)
+			ForgetAppletVersion();
+		MWLOG(LEV_WARN, MOD_CAL, L"Card returned SW12 = %04X, expected 9000", ulSW12);
+		throw CMWEXCEPTION(m_poContext->m_oPCSC.SW12ToErr(ulSW12));
+	}
+	SetSecurityEnvData(oSecurityEnv);
 }
 
 void KeepAliveThread::Run() {
@@ -663,45 +727,33 @@ void KeepAliveThread::Run() {
 	MWLOG(LEV_DEBUG, MOD_CAL, "Stopping KeepAliveThread");
 }
 
-CByteArray CPteidCard::SignInternal(const tPrivKey &key, unsigned long paddingType, const CByteArray &oData,
-									const tPin *pPin) {
-	CAutoLock autolock(this);
+void CPteidCard::VerifySignPin(const tPrivKey &key, const tPin &pin) {
 	bool bOK = false;
-	m_ucCLA = 0x00;
-
-	MWLOG(LEV_DEBUG, MOD_CAL, L"CPteidCard::SignInternal called with algoID=%04x and data length=%d", paddingType,
-		  oData.Size());
+	unsigned long ulRemaining = 0;
+	if (m_poContext->m_bSSO) {
+		std::string cached_pin = "";
+		if (m_verifiedPINs.find(pin.ulID) != m_verifiedPINs.end()) {
+			cached_pin = m_verifiedPINs[pin.ulID];
 
-	if (m_askPinOnSign) {
-		if (pPin != NULL) {
-			unsigned long ulRemaining = 0;
-			if (m_poContext->m_bSSO) {
-				std::string cached_pin = "";
-				if (m_verifiedPINs.find(pPin->ulID) != m_verifiedPINs.end()) {
-					cached_pin = m_verifiedPINs[pPin->ulID];
-
-					MWLOG(LEV_DEBUG, MOD_CAL, "Using cached pin for %s", pPin->csLabel.c_str());
-				}
-				bOK = PinCmd(PIN_OP_VERIFY, *pPin, cached_pin, "", ulRemaining, &key);
-			} else {
+			MWLOG(LEV_DEBUG, MOD_CAL, "Using cached pin for %s", pin.csLabel.c_str());
+		}
+		bOK = PinCmd(PIN_OP_VERIFY, pin, cached_pin, "", ulRemaining, &key);
+	} else {
 #ifdef WIN32
-				// Regularly call SCardStatus()
-				MWLOG(LEV_DEBUG, MOD_CAL,
-					  L"Starting KeepAliveThread to keep transaction while waiting for user PIN input");
-				eIDMW::KeepAliveThread keepAlive(&(m_poContext->m_oPCSC), m_hCard);
-				keepAlive.Start();
+		// Regularly call SCardStatus()
+		MWLOG(LEV_DEBUG, MOD_CAL, L"Starting KeepAliveThread to keep transaction while waiting for user PIN input");
+		eIDMW::KeepAliveThread keepAlive(&(m_poContext->m_oPCSC), m_hCard);
+		keepAlive.Start();
 #endif
 
-				bOK = PinCmd(PIN_OP_VERIFY, *pPin, "", "", ulRemaining, &key);
-			}
-
-			if (!bOK)
-				throw CMWEXCEPTION(ulRemaining == 0 ? EIDMW_ERR_PIN_BLOCKED : EIDMW_ERR_PIN_BAD);
-		}
+		bOK = PinCmd(PIN_OP_VERIFY, pin, "", "", ulRemaining, &key);
 	}
 
-	SetSecurityEnv(key, paddingType, oData.Size());
+	if (!bOK)
+		throw CMWEXCEPTION(ulRemaining == 0 ? EIDMW_ERR_PIN_BLOCKED : EIDMW_ERR_PIN_BAD);
+}
 
+CByteArray CPteidCard::ComputeSignature(const CByteArray &oData) {
 	CByteArray oData1;
 
 	oData1.Append(0x90); // SHA-1 Hash as Input
@@ -719,6 +771,7 @@ CByteArray CPteidCard::SignInternal(const tPrivKey &key, unsigned long paddingTy
 		unsigned long SW12 = getSW12(oResp1);
 		if (SW12 != 0x9000) {
 			if (SW12 == 0x6985) {
+				ForgetAppletVersion();
 				throw CMWEXCEPTION(EIDMW_ERR_ALGO_BAD);
 			} else {
 				throw CMWEXCEPTION(m_poContext->m_oPCSC.SW12ToErr(SW12));
@@ -745,7 +798,55 @@ CByteArray CPteidCard::SignInternal(const tPrivKey &key, unsigned long paddingTy
 	if (ulSW12 != 0x9000)
 		throw CMWEXCEPTION(m_poContext->m_oPCSC.SW12ToErr(ulSW12));
 
-	if (GetType() == CARD_PTEID_IAS5) {
+	return oResp;
+}
+
+CByteArray CPteidCard::SignInternal(const tPrivKey &key, unsigned long paddingType, const CByteArray &oData,
+									const tPin *pPin) {
+	CAutoLock autolock(this);
+	m_ucCLA = 0x00;
+
+	MWLOG(LEV_DEBUG, MOD_CAL, L"CPteidCard::SignInternal called with algoID=%04x and data length=%d", paddingType,
+		  oData.Size());
+
+	// Inside a sign session the PIN verified for a previous signature is still verified
+	bool bPinVerified = m_bSignSession && pPin != NULL && m_signSessionPINs.count(pPin->ulPinRef) > 0;
+
+	if (m_askPinOnSign && pPin != NULL) {
+		if (bPinVerified)
+			m_ioStats.ulPinVerifiesSkipped++;
+		else
+			VerifySignPin(key, *pPin);
+	}
+
+	unsigned long ulEnvsSkipped = m_ioStats.ulSecurityEnvsSkipped;
+	SetSecurityEnv(key, paddingType, oData.Size());
+	bool bEnvReused = m_ioStats.ulSecurityEnvsSkipped != ulEnvsSkipped;
+
+	CByteArray oResp;
+	try {
+		oResp = ComputeSignature(oData);
+	} catch (CMWException &e) {
+		long err = e.GetError();
+		bool bStateLost = err == EIDMW_ERR_NOT_AUTHENTICATED || err == EIDMW_ERR_ALGO_BAD ||
+						  err == EIDMW_ERR_CMD_NOT_ALLOWED || err == EIDMW_ERR_CARD;
+		if (!(bPinVerified || bEnvReused) || !bStateLost)
+			throw;
+
+		// The card didn't keep the state left by the previous signature: set it up again
+		MWLOG(LEV_INFO, MOD_CAL, L"Sign session: card state was reset (error 0x%08x), verifying PIN again", err);
+		ForgetSecurityEnv();
+		if (m_askPinOnSign && pPin != NULL)
+			VerifySignPin(key, *pPin);
+		SetSecurityEnv(key, paddingType, oData.Size());
+		oResp = ComputeSignature(oData);
+	}
+	m_ioStats.ulSignatures++;
+
+	if (m_bSignSession && pPin != NULL) {
+		// The PIN is left verified for the next signature, on IAS5 cards EndSignSession() resets it
+		m_signSessionPINs.insert(pPin->ulPinRef);
+	} else if (GetType() == CARD_PTEID_IAS5) {
 		CByteArray rapdu = SendAPDU(0x20, 0xFF, (unsigned char)pPin->ulPinRef, 0x00);
 		getSW12(rapdu, 0x9000);
 	}
@@ -756,6 +857,23 @@ CByteArray CPteidCard::SignInternal(const tPrivKey &key, unsigned long paddingTy
 	return oResp;
 }
 
+void CPteidCard::EndSignSession() {
+	if (m_bSignSession && GetType() == CARD_PTEID_IAS5) {
+		// Reset the verification status of the PINs that SignInternal() left verified
+		for (unsigned long ulPinRef : m_signSessionPINs) {
+			try {
+				CByteArray rapdu = SendAPDU(0x20, 0xFF, (unsigned char)ulPinRef, 0x00);
+				getSW12(rapdu, 0x9000);
+			} catch (CMWException &e) {
+				MWLOG(LEV_WARN, MOD_CAL, L"Failed to reset the status of PIN 0x%02x: error 0x%08x", ulPinRef,
+					  e.GetError());
+			}
+		}
+	}
+
+	CPkiCard::EndSignSession();
+}
+
 bool CPteidCard::ShouldSelectApplet(unsigned char ins, unsigned long ulSW12) {
 
 	if (m_selectAppletMode != TRY_SELECT_APPLET)
@@ -812,6 +930,7 @@ void CPteidCard::ResetApplication() { m_lastSelectedApplication.ClearContents();
 void CPteidCard::SelectApplication(const CByteArray &oAID) {
 	if (m_lastSelectedApplication.Size() > 0 && oAID.Size() > 0 &&
 		memcmp(oAID.GetBytes(), m_lastSelectedApplication.GetBytes(), oAID.Size()) == 0) {
+		m_ioStats.ulSelectsSkipped++;
 		return;
 	}
 
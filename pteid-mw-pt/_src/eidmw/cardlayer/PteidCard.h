@@ -85,6 +85,8 @@ public:
 
 	virtual unsigned long GetSupportedAlgorithms();
 
+	virtual void EndSignSession();
+
 protected:
 	virtual bool ShouldSelectApplet(unsigned char ins, unsigned long ulSW12);
 	virtual bool SelectApplet();
@@ -104,11 +106,17 @@ protected:
 	virtual void SetSecurityEnv(const tPrivKey &key, unsigned long paddingType, unsigned long ulInputLen);
 	virtual CByteArray SignInternal(const tPrivKey &key, unsigned long paddingType, const CByteArray &oData,
 									const tPin *pPin = NULL);
+	void VerifySignPin(const tPrivKey &key, const tPin &pin);
+	CByteArray ComputeSignature(const CByteArray &oData);
 
 	virtual tCacheInfo GetCacheInfo(const std::string &csPath);
 
+	/* The card rejected an algorithm that GetSupportedAlgorithms() derived from the applet version */
+	void ForgetAppletVersion();
+
 	CByteArray m_oCardData;
 	CByteArray m_oSerialNr;
+	std::string m_csAppletVersion;
 };
 
 } // namespace eIDMW
@@ -48,7 +48,7 @@ static const unsigned char SHA512_AID[] = {0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0
 										   0x65, 0x03, 0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40};
 
 CReader::CReader(const std::string &csReader, CContext *poContext)
-	: m_poCard(NULL), m_oPKCS15(poContext), m_isContactless(false) {
+	: m_poCard(NULL), m_oPKCS15(poContext), m_isContactless(false), m_ulEventMonitor(0), m_bCardEvent(true) {
 	m_csReader = csReader;
 	m_wsReader = utilStringWiden(csReader);
 	m_poContext = poContext;
@@ -58,6 +58,9 @@ CReader::CReader(const std::string &csReader, CContext *poContext)
 }
 
 CReader::~CReader(void) {
+	if (m_ulEventMonitor != 0)
+		StopEventCallback(m_ulEventMonitor);
+
 	if (m_poCard != NULL)
 		Disconnect(DISCONNECT_RESET_CARD);
 
@@ -86,6 +89,18 @@ void CReader::StopEventCallback(unsigned long ulHandle) {
 	MWLOG(LEV_INFO, MOD_CAL, L"    Stopped event callback thread %d", ulHandle);
 }
 
+void CReader::StartEventMonitor() {
+	if (m_ulEventMonitor == 0 && m_poContext->m_oPCSC.IsExclusive()) {
+		// The first check after connecting asks the card, until then the monitor may not have seen the reader yet
+		m_bCardEvent = true;
+		m_ulEventMonitor = SetEventCallback(&CReader::CardEventCallback, this);
+	}
+}
+
+void CReader::CardEventCallback(long /*lRet*/, unsigned long /*ulState*/, void *pvRef) {
+	static_cast<CReader *>(pvRef)->m_bCardEvent = true;
+}
+
 // Use for logging in Status()
 static const inline wchar_t *Status2String(tCardStatus status) {
 	switch (status) {
@@ -114,7 +129,17 @@ tCardStatus CReader::Status(bool bReconnect) {
 		} else
 			status = CARD_NOT_PRESENT;
 	} else {
-		bool bCardStillPresent = m_poCard->Status();
+		if (m_ulEventMonitor != 0 && m_poContext->m_oThreadPool.HasStopped(m_ulEventMonitor)) {
+			// Without the monitor a removal would go unnoticed: ask the card, the next Connect() starts a new one
+			MWLOG(LEV_WARN, MOD_CAL, L"    Event callback thread %d has stopped", m_ulEventMonitor);
+			StopEventCallback(m_ulEventMonitor);
+			m_ulEventMonitor = 0;
+		}
+
+		// In exclusive mode the card can only be gone if the event monitor saw the reader state change
+		bool bCardStillPresent = true;
+		if (m_ulEventMonitor == 0 || m_bCardEvent.exchange(false))
+			bCardStillPresent = m_poCard->Status();
 		if (bCardStillPresent) {
 			status = CARD_STILL_PRESENT;
 		} else {
@@ -227,6 +252,7 @@ bool CReader::Connect(SCARDHANDLE hCard, DWORD protocol) {
 			m_poCard->createPace();
 
 		m_oPKCS15.SetCard(m_poCard);
+		StartEventMonitor();
 		m_oPinpad->Init(m_poCard->m_hCard);
 		CConfig config;
 		long pinpadEnabled = config.GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PINPAD_ENABLED);
@@ -268,6 +294,7 @@ bool CReader::Connect() {
 			m_poCard->createPace();
 
 		m_oPKCS15.SetCard(m_poCard);
+		StartEventMonitor();
 		m_oPinpad->Init(m_poCard->m_hCard);
 		CConfig config;
 		long pinpadEnabled = config.GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PINPAD_ENABLED);
@@ -402,6 +429,43 @@ void CReader::Unlock() {
 	return m_poCard->Unlock();
 }
 
+void CReader::BeginLoadPlan() {
+	if (m_poCard == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
+
+	m_poCard->BeginLoadPlan();
+}
+
+void CReader::EndLoadPlan() {
+	if (m_poCard == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
+
+	m_poCard->EndLoadPlan();
+}
+
+tCardIOStats CReader::GetIOStats() {
+	if (m_poCard == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
+
+	return m_poCard->GetIOStats();
+}
+
+void CReader::BeginSignSession() {
+	if (m_poCard == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
+
+	m_poCard->BeginSignSession();
+}
+
+void CReader::EndSignSession() {
+	if (m_poCard == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
+
+	m_poCard->EndSignSession();
+}
+
+bool CReader::IsSignSession() { return m_poCard != NULL && m_poCard->IsSignSession(); }
+
 void CReader::SelectApplication(const CByteArray &oAID) {
 	if (m_poCard == NULL)
 		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
@@ -554,6 +618,20 @@ CByteArray CReader::Sign(const tPrivKey &key, unsigned long paddingType, const C
 		throw CMWEXCEPTION(EIDMW_ERR_CHECK);
 }
 
+CByteArray CReader::GetCachedData(const std::string &csName, bool &bFound) {
+	if (m_poCard == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
+
+	return m_poCard->GetCachedData(csName, bFound);
+}
+
+void CReader::StoreCachedData(const std::string &csName, const CByteArray &oData) {
+	if (m_poCard == NULL)
+		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
+
+	m_poCard->StoreCachedData(csName, oData);
+}
+
 CByteArray CReader::GetRandom(unsigned long ulLen) {
 	if (m_poCard == NULL)
 		throw CMWEXCEPTION(EIDMW_ERR_NO_CARD);
@@ -28,6 +28,8 @@
 #include "Pinpad.h"
 #include "Hash.h"
 
+#include <atomic>
+
 namespace eIDMW {
 
 class CCardLayer;
@@ -104,6 +106,18 @@ public:
 	void Lock();
 	void Unlock();
 
+	/* Keep the card locked across several reads, reusing the selected application and file.
+	 * See CCard::BeginLoadPlan() */
+	void BeginLoadPlan();
+	void EndLoadPlan();
+	tCardIOStats GetIOStats();
+
+	/* Keep the card locked and the signature PIN cached across several signatures.
+	 * See CCard::BeginSignSession() */
+	void BeginSignSession();
+	void EndSignSession();
+	bool IsSignSession();
+
 	void SelectApplication(const CByteArray &oAID);
 
 	bool isCardContactless() const;
@@ -123,6 +137,11 @@ public:
 	 * (in which case the currenlty selected file is written) */
 	void WriteFile(const std::string &csPath, unsigned long ulOffset, const CByteArray &oData);
 
+	/* Get/store data in the encrypted cache of the current card without going
+	 * through ReadFile(), for contents that can only be read under Secure Messaging */
+	CByteArray GetCachedData(const std::string &csName, bool &bFound);
+	void StoreCachedData(const std::string &csName, const CByteArray &oData);
+
 	/* Return the remaining PIN attempts;
 	 * returns PIN_STATUS_UNKNOWN if this info isn't available */
 	unsigned long PinStatus(const tPin &Pin);
@@ -187,6 +206,10 @@ private:
 
 	void readerDeviceInfo(SCARDHANDLE hCard, ReaderDeviceInfo *deviceInfo, int ioctl_get_features);
 
+	// Exclusive reader mode: an event callback thread watches the reader instead of asking the card status
+	void StartEventMonitor();
+	static void CardEventCallback(long lRet, unsigned long ulState, void *pvRef);
+
 	bool m_bIgnoreRemoval;
 	std::string m_csReader;
 	std::wstring m_wsReader;
@@ -194,6 +217,8 @@ private:
 	CPKCS15 m_oPKCS15;
 	CPinpad *m_oPinpad;
 	bool m_isContactless;
+	unsigned long m_ulEventMonitor; // Event callback handle of the exclusive reader mode, 0 if not started
+	std::atomic<bool> m_bCardEvent;
 
 	friend class CCardLayer; // calls the CReader constructor
 
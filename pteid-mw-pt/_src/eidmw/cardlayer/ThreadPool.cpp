@@ -102,8 +102,9 @@ void CThreadPool::RemoveThread(unsigned long ulHandle) {
 	CAutoMutex oAutoMutex(&m_mutex);
 
 	// Signal the EventCallbackThread to stop
-	CEventCallbackThread &oEventCallbackThread = m_pool[ulHandle];
-	oEventCallbackThread.Stop();
+	std::map<unsigned long, CEventCallbackThread>::iterator itThread = m_pool.find(ulHandle);
+	if (itThread != m_pool.end())
+		itThread->second.Stop();
 
 	/* Remove all EventCallbackThreads that have stopped,
 	 * this may not yet be the one that we just signalled
@@ -123,6 +124,14 @@ void CThreadPool::RemoveThread(unsigned long ulHandle) {
 	}
 }
 
+bool CThreadPool::HasStopped(unsigned long ulHandle) {
+	CAutoMutex oAutoMutex(&m_mutex);
+
+	// CThread::IsRunning() is already true between Start() and Run()
+	std::map<unsigned long, CEventCallbackThread>::iterator it = m_pool.find(ulHandle);
+	return it == m_pool.end() || !it->second.IsRunning();
+}
+
 void CThreadPool::FinishThreads() {
 	CAutoMutex oAutoMutex(&m_mutex);
 
@@ -69,6 +69,9 @@ public:
 
 	void RemoveThread(unsigned long ulHandle);
 
+	/** True if the thread has ended, e.g. on a PCSC error, or was already removed */
+	bool HasStopped(unsigned long ulHandle);
+
 	void FinishThreads();
 
 private:
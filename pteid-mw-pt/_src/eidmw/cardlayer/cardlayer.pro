@@ -50,6 +50,7 @@ HEADERS += \
            Cache.h \
            Card.h \
            CardFactory.h \
+           CardTypeTable.h \
            CardLayer.h \
            CardLayerConst.h \
            Context.h \
@@ -78,6 +79,7 @@ SOURCES += \
            Cache.cpp \
            Card.cpp \
            CardFactory.cpp \
+           CardTypeTable.cpp \
            CardLayer.cpp \
            CardReaderInfo.cpp \
            Context.cpp \
@@ -156,6 +156,10 @@ not exist.
 	L"card_transmit_delay" // number, delay while communicating with the smartcard, in mili-seconds, default 1 mSec
 #define EIDMW_CNF_GENERAL_CARDCONNDELAY                                                                                \
 	L"card_connect_delay" // number, delay before connecting to a smartcard, in mili-seconds, default 0 mSec
+#define EIDMW_CNF_GENERAL_EXCLUSIVE_READER                                                                             \
+	L"exclusive_reader" // number, 1 = this process owns the card readers (kiosk mode), default 0
+#define EIDMW_CNF_GENERAL_PKCS11_SIGN_SESSION                                                                          \
+	L"pkcs11_sign_session" // number, seconds a PKCS#11 sign session stays open after a signature, default 0 = off
 #define EIDMW_CNF_GENERAL_BUILDNBR L"build_number" // Number of the installed build
 #define EIDMW_CNF_GENERAL_SCAP_HOST L"scap_host"
 #define EIDMW_CNF_GENERAL_SCAP_PORT L"scap_port"
@@ -193,6 +197,10 @@ not exist.
 #define EIDMW_CNF_CERTVALID_ALLOWTESTC L"cert_allow_testcard" // number; 0=no, 1=yes
 #define EIDMW_CNF_CERTVALID_CRL L"cert_validation_crl"		  // number; 0=no, 1=optional, 2=always
 #define EIDMW_CNF_CERTVALID_OCSP L"cert_validation_ocsp"	  // number; 0=no, 1=optional, 2=always
+#define EIDMW_CNF_CERTVALID_OCSP_CACHE_MAXAGE                                                                          \
+	L"cert_ocsp_cache_max_age" // number, in seconds; how old a cached OCSP response of the card may be, 0=no cache
+#define EIDMW_CNF_CERTVALID_OCSP_CACHE_REFRESH                                                                         \
+	L"cert_ocsp_cache_refresh" // number, in seconds; a cached OCSP response is fetched again this long before expiring
 
 #define EIDMW_CNF_SECTION_CERTCACHE L"certificatecache" // section with the certificate cache parameters
 #define EIDMW_CNF_CERTCACHE_CACHEFILE                                                                                  \
@@ -226,6 +234,7 @@ not exist.
 #define EIDMW_CNF_GUITOOL_SHOWSTARTUPHELP L"not_show_startup_help"	// number; 0=no(default), 1=yes
 #define EIDMW_CNF_GUITOOL_SHOWTBAR L"show_toolbar"					// number; 0=no, 1=yes
 #define EIDMW_CNF_GUITOOL_VIRTUALKBD L"use_virtual_keypad"			// number; 0=no, 1=yes
+#define EIDMW_CNF_GUITOOL_DIALOGSERVER L"use_dialog_server"			// number; 0=no, 1=yes(default)
 #define EIDMW_CNF_GUITOOL_AUTOCARDREAD L"automatic_cardreading"		// number; 0=no, 1=yes(default)
 #define EIDMW_CNF_GUITOOL_CARDREADNUMB L"cardreader"				// number; -1(not specified), 0-10
 #define EIDMW_CNF_GUITOOL_REGCERTIF L"registrate_certificate"		// number; 0=no, 1=yes(default)
@@ -354,6 +363,8 @@ public:
 	static const struct Param_Str EIDMW_CONFIG_PARAM_GENERAL_LANGUAGE;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GENERAL_CARDTXDELAY;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GENERAL_CARDCONNDELAY;
+	static const struct Param_Num EIDMW_CONFIG_PARAM_GENERAL_EXCLUSIVE_READER;
+	static const struct Param_Num EIDMW_CONFIG_PARAM_GENERAL_PKCS11_SIGN_SESSION;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GENERAL_BUILDNBR;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GENERAL_PINPAD_ENABLED;
 	static const struct Param_Str EIDMW_CONFIG_PARAM_GENERAL_SCAP_HOST;
@@ -389,6 +400,8 @@ public:
 	static const struct Param_Num EIDMW_CONFIG_PARAM_CERTVALID_ALLOWTESTC;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_CERTVALID_CRL;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_CERTVALID_OCSP;
+	static const struct Param_Num EIDMW_CONFIG_PARAM_CERTVALID_OCSP_CACHE_MAXAGE;
+	static const struct Param_Num EIDMW_CONFIG_PARAM_CERTVALID_OCSP_CACHE_REFRESH;
 
 	// CERTIFICATE CACHE
 	static const struct Param_Str EIDMW_CONFIG_PARAM_CERTCACHE_CACHEFILE;
@@ -421,6 +434,7 @@ public:
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GUITOOL_SHOWSTARTUPHELP;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GUITOOL_SHOWTBAR;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GUITOOL_VIRTUALKBD;
+	static const struct Param_Num EIDMW_CONFIG_PARAM_GUITOOL_DIALOGSERVER;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GUITOOL_AUTOCARDREAD;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GUITOOL_CARDREADNUMB;
 	static const struct Param_Num EIDMW_CONFIG_PARAM_GUITOOL_REGCERTIF;
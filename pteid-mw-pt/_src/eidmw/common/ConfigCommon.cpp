@@ -80,6 +80,10 @@ const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GENERAL_CARDTXDELAY
 																				   EIDMW_CNF_GENERAL_CARDTXDELAY, 3};
 const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GENERAL_CARDCONNDELAY = {
 	EIDMW_CNF_SECTION_GENERAL, EIDMW_CNF_GENERAL_CARDCONNDELAY, 0};
+const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GENERAL_EXCLUSIVE_READER = {
+	EIDMW_CNF_SECTION_GENERAL, EIDMW_CNF_GENERAL_EXCLUSIVE_READER, 0};
+const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GENERAL_PKCS11_SIGN_SESSION = {
+	EIDMW_CNF_SECTION_GENERAL, EIDMW_CNF_GENERAL_PKCS11_SIGN_SESSION, 0};
 const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GENERAL_BUILDNBR = {EIDMW_CNF_SECTION_GENERAL,
 																				EIDMW_CNF_GENERAL_BUILDNBR, 0};
 const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GENERAL_PINPAD_ENABLED = {
@@ -118,6 +122,10 @@ const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_CERTVALID_CRL = {EID
 																			 EIDMW_CNF_CERTVALID_CRL, 0};
 const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_CERTVALID_OCSP = {EIDMW_CNF_SECTION_CERTVALID,
 																			  EIDMW_CNF_CERTVALID_OCSP, 0};
+const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_CERTVALID_OCSP_CACHE_MAXAGE = {
+	EIDMW_CNF_SECTION_CERTVALID, EIDMW_CNF_CERTVALID_OCSP_CACHE_MAXAGE, 3600};
+const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_CERTVALID_OCSP_CACHE_REFRESH = {
+	EIDMW_CNF_SECTION_CERTVALID, EIDMW_CNF_CERTVALID_OCSP_CACHE_REFRESH, 300};
 
 // CERTIFICATE CACHE
 const struct CConfig::Param_Str CConfig::EIDMW_CONFIG_PARAM_CERTCACHE_CACHEFILE = {
@@ -170,6 +178,8 @@ const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GUITOOL_SHOWTBAR = {
 																				EIDMW_CNF_GUITOOL_SHOWTBAR, 1};
 const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GUITOOL_VIRTUALKBD = {EIDMW_CNF_SECTION_GUITOOL,
 																				  EIDMW_CNF_GUITOOL_VIRTUALKBD, 0};
+const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GUITOOL_DIALOGSERVER = {EIDMW_CNF_SECTION_GUITOOL,
+																					EIDMW_CNF_GUITOOL_DIALOGSERVER, 1};
 const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GUITOOL_AUTOCARDREAD = {EIDMW_CNF_SECTION_GUITOOL,
 																					EIDMW_CNF_GUITOOL_AUTOCARDREAD, 1};
 const struct CConfig::Param_Num CConfig::EIDMW_CONFIG_PARAM_GUITOOL_CARDREADNUMB = {EIDMW_CNF_SECTION_GUITOOL,
@@ -20,12 +20,92 @@
 
 **************************************************************************** */
 #include "Hash.h"
+#include "Log.h"
 #include "MWException.h"
 #include "eidErrors.h"
 
+#include <openssl/evp.h>
+
 using namespace eIDMW;
 
-CHash::CHash() { m_bInitialized = false; }
+static const char *GetDigestName(tHashAlgo algo) {
+	switch (algo) {
+	case ALGO_SHA1:
+		return "SHA1";
+	case ALGO_SHA256:
+		return "SHA256";
+	case ALGO_SHA384:
+		return "SHA384";
+	case ALGO_SHA512:
+		return "SHA512";
+	default:
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_BAD);
+	}
+}
+
+static const EVP_MD *FetchDigest(tHashAlgo algo) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	// Fetched explicitly: an EVP_sha256() digest is looked up again in the provider on every EVP_DigestInit_ex()
+	const EVP_MD *md = EVP_MD_fetch(NULL, GetDigestName(algo), NULL);
+#else
+	const EVP_MD *md = EVP_get_digestbyname(GetDigestName(algo));
+#endif
+	if (md == NULL)
+		MWLOG(LEV_WARN, MOD_CAL, "CHash: %s is not available from OpenSSL, using libtomcrypt", GetDigestName(algo));
+	return md;
+}
+
+/* The digests are fetched once and kept for the lifetime of the process */
+static const EVP_MD *GetDigest(tHashAlgo algo) {
+	static const EVP_MD *const digests[] = {FetchDigest(ALGO_SHA1), FetchDigest(ALGO_SHA256), FetchDigest(ALGO_SHA384),
+											FetchDigest(ALGO_SHA512)};
+
+	switch (algo) {
+	case ALGO_SHA1:
+		return digests[0];
+	case ALGO_SHA256:
+		return digests[1];
+	case ALGO_SHA384:
+		return digests[2];
+	case ALGO_SHA512:
+		return digests[3];
+	default:
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_BAD);
+	}
+}
+
+CHash::CHash(tHashBackend backend) {
+	m_bInitialized = false;
+	m_Backend = backend;
+	m_ctx = NULL;
+}
+
+CHash::CHash(const CHash &oHash) : m_ctx(NULL) { *this = oHash; }
+
+CHash &CHash::operator=(const CHash &oHash) {
+	if (this == &oHash)
+		return *this;
+
+	m_md1 = oHash.m_md1;
+	m_md2 = oHash.m_md2;
+	m_Algo = oHash.m_Algo;
+	m_bInitialized = oHash.m_bInitialized;
+	m_Backend = oHash.m_Backend;
+
+	if (oHash.m_ctx != NULL) {
+		if (m_ctx == NULL && (m_ctx = EVP_MD_CTX_new()) == NULL)
+			throw CMWEXCEPTION(EIDMW_ERR_MEMORY);
+		if (EVP_MD_CTX_copy_ex(m_ctx, oHash.m_ctx) != 1)
+			throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+	} else if (m_ctx != NULL) {
+		EVP_MD_CTX_free(m_ctx);
+		m_ctx = NULL;
+	}
+
+	return *this;
+}
+
+CHash::~CHash() { EVP_MD_CTX_free(m_ctx); }
 
 unsigned long CHash::GetHashLength(tHashAlgo algo) {
 	switch (algo) {
@@ -50,7 +130,42 @@ CByteArray CHash::Hash(tHashAlgo algo, const CByteArray &data, unsigned long ulO
 	return GetHash();
 }
 
+/* OpenSSL has no public interface to its multi-lane SHA code, so the inputs go one after the other through a single
+   context, which saves allocating and initializing a context for each of them */
+std::vector<CByteArray> CHash::HashAll(tHashAlgo algo, const std::vector<CByteArray> &inputs, tHashBackend backend) {
+	std::vector<CByteArray> hashes;
+	hashes.reserve(inputs.size());
+
+	CHash oHash(backend);
+	for (size_t i = 0; i < inputs.size(); i++) {
+		oHash.Init(algo);
+		oHash.Update(inputs[i]);
+		hashes.push_back(oHash.GetHash());
+	}
+
+	return hashes;
+}
+
 void CHash::Init(tHashAlgo algo) {
+	const EVP_MD *md = m_Backend == HASH_BACKEND_OPENSSL ? GetDigest(algo) : NULL;
+	if (md != NULL) {
+		// The context is kept between hashes and only reinitialized here
+		if (m_ctx == NULL)
+			m_ctx = EVP_MD_CTX_new();
+		if (m_ctx != NULL && EVP_DigestInit_ex(m_ctx, md, NULL) == 1) {
+			m_Algo = algo;
+			m_bInitialized = true;
+			return;
+		}
+
+		MWLOG(LEV_WARN, MOD_CAL, "CHash: EVP_DigestInit_ex() failed, using libtomcrypt");
+		EVP_MD_CTX_free(m_ctx);
+		m_ctx = NULL;
+	} else if (m_ctx != NULL) {
+		EVP_MD_CTX_free(m_ctx);
+		m_ctx = NULL;
+	}
+
 	switch (algo) {
 	case ALGO_SHA1:
 		sha1_init(&m_md1);
@@ -78,25 +193,38 @@ void CHash::Update(const CByteArray &data, unsigned long ulOffset, unsigned long
 	if (!m_bInitialized)
 		throw CMWEXCEPTION(EIDMW_ERR_PARAM_BAD);
 
-	if (ulLen != 0) {
-		const unsigned char *pucData = data.GetBytes() + ulOffset;
-
-		switch (m_Algo) {
-		case ALGO_SHA1:
-			sha1_process(&m_md1, pucData, ulLen);
-			break;
-		case ALGO_SHA256:
-			sha256_process(&m_md1, pucData, ulLen);
-			break;
-		case ALGO_SHA384:
-			sha384_process(&m_md1, pucData, ulLen);
-			break;
-		case ALGO_SHA512:
-			sha512_process(&m_md1, pucData, ulLen);
-			break;
-		default:
-			throw CMWEXCEPTION(EIDMW_ERR_PARAM_BAD);
-		}
+	if (ulLen != 0)
+		Update(data.GetBytes() + ulOffset, ulLen);
+}
+
+void CHash::Update(const unsigned char *pucData, unsigned long ulLen) {
+	if (!m_bInitialized)
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_BAD);
+
+	if (ulLen == 0)
+		return;
+
+	if (m_ctx != NULL) {
+		if (EVP_DigestUpdate(m_ctx, pucData, ulLen) != 1)
+			throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+		return;
+	}
+
+	switch (m_Algo) {
+	case ALGO_SHA1:
+		sha1_process(&m_md1, pucData, ulLen);
+		break;
+	case ALGO_SHA256:
+		sha256_process(&m_md1, pucData, ulLen);
+		break;
+	case ALGO_SHA384:
+		sha384_process(&m_md1, pucData, ulLen);
+		break;
+	case ALGO_SHA512:
+		sha512_process(&m_md1, pucData, ulLen);
+		break;
+	default:
+		throw CMWEXCEPTION(EIDMW_ERR_PARAM_BAD);
 	}
 }
 
@@ -109,6 +237,12 @@ CByteArray CHash::GetHash() {
 	// hash result
 	unsigned char tucHash[64]; // make sure this is enough if other hashes are added!!!
 
+	if (m_ctx != NULL) {
+		if (EVP_DigestFinal_ex(m_ctx, tucHash, NULL) != 1)
+			throw CMWEXCEPTION(EIDMW_ERR_CHECK);
+		return CByteArray(tucHash, GetHashLength(m_Algo));
+	}
+
 	switch (m_Algo) {
 	case ALGO_SHA1:
 		sha1_done(&m_md1, tucHash);
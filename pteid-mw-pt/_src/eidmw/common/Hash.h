@@ -50,6 +50,10 @@
 #include "ByteArray.h"
 #include "libtomcrypt/tomcrypt_hash.h"
 
+#include <vector>
+
+struct evp_md_ctx_st;
+
 namespace eIDMW {
 
 enum tHashAlgo {
@@ -59,9 +63,17 @@ enum tHashAlgo {
 	ALGO_SHA512 = 5	 // 64-byte hash
 };
 
+enum tHashBackend {
+	HASH_BACKEND_OPENSSL, // OpenSSL EVP, which picks the SHA-NI/AVX2/ARMv8 code for the CPU it runs on
+	HASH_BACKEND_PORTABLE // the libtomcrypt C code, also used when OpenSSL can't provide the algorithm
+};
+
 class EIDMW_CMN_API CHash {
 public:
-	CHash();
+	CHash(tHashBackend backend = HASH_BACKEND_OPENSSL);
+	CHash(const CHash &oHash);
+	CHash &operator=(const CHash &oHash);
+	~CHash();
 
 	static unsigned long GetHashLength(tHashAlgo algo);
 
@@ -69,16 +81,26 @@ public:
 	CByteArray Hash(tHashAlgo algo, const CByteArray &data);
 	CByteArray Hash(tHashAlgo algo, const CByteArray &data, unsigned long ulOffset, unsigned long ulLen);
 
+	/* Several independent inputs at once, one hash per input in the same order */
+	static std::vector<CByteArray> HashAll(tHashAlgo algo, const std::vector<CByteArray> &inputs,
+										   tHashBackend backend = HASH_BACKEND_OPENSSL);
+
 	void Init(tHashAlgo algo);
 	void Update(const CByteArray &data);
 	void Update(const CByteArray &data, unsigned long ulOffset, unsigned long ulLen);
+	void Update(const unsigned char *pucData, unsigned long ulLen);
 	CByteArray GetHash();
 
+	/* The backend doing the hashing since the last Init() */
+	tHashBackend GetBackend() const { return m_ctx != NULL ? HASH_BACKEND_OPENSSL : HASH_BACKEND_PORTABLE; }
+
 private:
 	hash_state m_md1;
 	hash_state m_md2;
 	tHashAlgo m_Algo;
 	bool m_bInitialized;
+	tHashBackend m_Backend;
+	struct evp_md_ctx_st *m_ctx; // NULL when the libtomcrypt state m_md1 is used
 };
 
 } // namespace eIDMW
@@ -0,0 +1,128 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+#include "MappedFile.h"
+#include "Util.h"
+
+#include <stdint.h>
+
+#ifdef WIN32
+#include <Windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace eIDMW {
+
+CMappedFile::CMappedFile() : m_pData(NULL), m_ulSize(0) {}
+
+CMappedFile::~CMappedFile() { Unmap(); }
+
+#ifdef WIN32
+
+bool CMappedFile::Map(const char *csPath) { return Map(utilStringWiden(csPath).c_str()); }
+
+bool CMappedFile::Map(const wchar_t *wsPath) {
+	Unmap();
+
+	HANDLE hFile = CreateFileW(wsPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+							   FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool bMapped = MapHandle(hFile);
+	CloseHandle(hFile);
+	return bMapped;
+}
+
+bool CMappedFile::Map(FILE *pFile) {
+	Unmap();
+
+	HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(pFile));
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	return MapHandle(hFile);
+}
+
+bool CMappedFile::MapHandle(void *hFile) {
+	LARGE_INTEGER size;
+	if (GetFileType(hFile) != FILE_TYPE_DISK || !GetFileSizeEx(hFile, &size) || size.QuadPart == 0 ||
+		(unsigned long long)size.QuadPart > SIZE_MAX)
+		return false;
+
+	// The view keeps the file and the mapping object open
+	HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hMapping == NULL)
+		return false;
+
+	void *pData = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	if (pData == NULL)
+		return false;
+
+	m_pData = pData;
+	m_ulSize = (size_t)size.QuadPart;
+	return true;
+}
+
+void CMappedFile::Unmap() {
+	if (m_pData != NULL)
+		UnmapViewOfFile(m_pData);
+	m_pData = NULL;
+	m_ulSize = 0;
+}
+
+#else
+
+bool CMappedFile::Map(const char *csPath) {
+	Unmap();
+
+	int fd = open(csPath, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	// The mapping stays valid after the descriptor is closed
+	bool bMapped = MapDescriptor(fd);
+	close(fd);
+	return bMapped;
+}
+
+bool CMappedFile::Map(FILE *pFile) {
+	Unmap();
+
+	return MapDescriptor(fileno(pFile));
+}
+
+bool CMappedFile::MapDescriptor(int fd) {
+	struct stat sb;
+	if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size == 0 ||
+		(unsigned long long)sb.st_size > SIZE_MAX)
+		return false;
+
+	void *pData = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (pData == MAP_FAILED)
+		return false;
+
+	madvise(pData, (size_t)sb.st_size, MADV_SEQUENTIAL);
+
+	m_pData = pData;
+	m_ulSize = (size_t)sb.st_size;
+	return true;
+}
+
+void CMappedFile::Unmap() {
+	if (m_pData != NULL)
+		munmap(m_pData, m_ulSize);
+	m_pData = NULL;
+	m_ulSize = 0;
+}
+
+#endif
+
+} // namespace eIDMW
@@ -0,0 +1,61 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+#pragma once
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include "Export.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+namespace eIDMW {
+
+/**
+ * Read-only memory mapping of a whole file, to read large documents sequentially without
+ * copying them through stdio buffers. The kernel is told that the pages are read in order.
+ *
+ * Only non-empty regular files are mapped: Map() returns false for pipes, devices and the like,
+ * or if the mapping fails, and the caller is expected to fall back to buffered reads.
+ * Reading pages of a file truncated by someone else faults (SIGBUS), so a file is only kept
+ * mapped for one bounded operation, a copy or a digest, and never behind a long-lived stream.
+ */
+class EIDMW_CMN_API CMappedFile {
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	/* csPath is UTF-8 */
+	bool Map(const char *csPath);
+#ifdef WIN32
+	bool Map(const wchar_t *wsPath);
+#endif
+	/* The file already open in pFile, which stays open and at the same position */
+	bool Map(FILE *pFile);
+	void Unmap();
+
+	bool IsMapped() const { return m_pData != NULL; }
+	const unsigned char *GetData() const { return (const unsigned char *)m_pData; }
+	size_t GetSize() const { return m_ulSize; }
+
+private:
+	// No copies allowed
+	CMappedFile(const CMappedFile &oMappedFile);
+	CMappedFile &operator=(const CMappedFile &oMappedFile);
+
+#ifdef WIN32
+	bool MapHandle(void *hFile);
+#else
+	bool MapDescriptor(int fd);
+#endif
+
+	void *m_pData;
+	size_t m_ulSize;
+};
+
+} // namespace eIDMW
+
+#endif
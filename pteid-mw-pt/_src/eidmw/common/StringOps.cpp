@@ -16,11 +16,24 @@
  */
 
 #include "StringOps.h"
+#include "Mutex.h"
+#include <algorithm>
+#include <map>
 #include <string>
 #include <cstring>
+#include <tuple>
 
 namespace eIDMW {
 
+/* Layouts computed by wrapString(), keyed by all its arguments. A batch of signatures lays out the same seal strings
+   for every document, and calculateFontParams() lays them out again at each font size it tries */
+typedef std::tuple<std::string, int, double, double, int, double> WrapKey;
+
+#define WRAP_CACHE_MAX_ENTRIES 512
+
+static CMutex wrapCacheMutex;
+static std::map<WrapKey, std::vector<std::string>> wrapCache;
+
 void replace(std::string &str, const std::string &from, const std::string &to) {
 	size_t start_pos = 0;
 	while ((start_pos = str.find(from, start_pos)) != std::string::npos) {
@@ -42,34 +55,44 @@ bool endsWith(const std::string &fullString, const std::string &ending) {
  * Units: postscript points (pts)
  */
 double getStringWidth(const char *winansi_encoded_string, double font_size, MyriadFontType font) {
-	double total_width = 0;
-	unsigned int w = 0;
-	unsigned char code = 0;
+	// The glyph widths are integers in 1/1000 of the font size, summed exactly and scaled once
+	unsigned long total_units = 0;
 
 	// Lookup each winansi char width
-	for (unsigned int i = 0; i != strlen(winansi_encoded_string); i++) {
-		code = (unsigned char)winansi_encoded_string[i];
-		w = getWidth(code, font);
-		total_width += 0.001 * font_size * w;
-	}
+	for (const unsigned char *p = (const unsigned char *)winansi_encoded_string; *p != 0; p++)
+		total_units += getWidth(*p, font);
 
-	return total_width;
+	return 0.001 * font_size * total_units;
 }
 
+/*
+ * Longest proper prefix of 'str' that fits in 'space_available' followed by "(...)".
+ * The prefix widths only grow, so the prefix is found by binary search on their running sums
+ */
 std::string getFittingSubString(const std::string &str, double font_size, MyriadFontType font, double space_available) {
-	size_t i = str.length() - 1;
+	if (str.length() < 2)
+		return "";
+
 	const double reserved = getStringWidth("(...)", font_size, font);
-	while (i > 0) {
-		std::string tmp = str.substr(0, i);
-		if (getStringWidth(tmp.c_str(), font_size, font) <= (space_available - reserved))
-			return tmp;
-		i--;
+	const double limit = space_available - reserved;
+
+	// prefix_width[i] is the width, in glyph units, of the first i + 1 chars
+	std::vector<unsigned long> prefix_width(str.length() - 1);
+	unsigned long units = 0;
+	for (size_t i = 0; i < prefix_width.size(); i++) {
+		units += getWidth((unsigned char)str[i], font);
+		prefix_width[i] = units;
 	}
-	return "";
+
+	auto fits = [&](unsigned long prefix_units) { return 0.001 * font_size * prefix_units <= limit; };
+	auto first_too_wide = std::partition_point(prefix_width.begin(), prefix_width.end(), fits);
+
+	return str.substr(0, first_too_wide - prefix_width.begin());
 }
 
-std::vector<std::string> wrapString(const std::string &content, double available_space, double font_size,
-									MyriadFontType font, int available_lines, double first_line_offset) {
+static std::vector<std::string> wrapStringUncached(const std::string &content, double available_space,
+												   double font_size, MyriadFontType font, int available_lines,
+												   double first_line_offset) {
 
 	std::vector<std::string> result;
 	std::string current_line;
@@ -127,6 +150,25 @@ std::vector<std::string> wrapString(const std::string &content, double available
 	return result;
 }
 
+std::vector<std::string> wrapString(const std::string &content, double available_space, double font_size,
+									MyriadFontType font, int available_lines, double first_line_offset) {
+	WrapKey key(content, font, font_size, available_space, available_lines, first_line_offset);
+
+	CAutoMutex autoMutex(&wrapCacheMutex);
+	auto it = wrapCache.find(key);
+	if (it != wrapCache.end())
+		return it->second;
+
+	std::vector<std::string> result =
+		wrapStringUncached(content, available_space, font_size, font, available_lines, first_line_offset);
+
+	if (wrapCache.size() >= WRAP_CACHE_MAX_ENTRIES)
+		wrapCache.clear();
+	wrapCache[key] = result;
+
+	return result;
+}
+
 /*
  * Determines maximum font size and number of lines
  * that fit in the available space and height left
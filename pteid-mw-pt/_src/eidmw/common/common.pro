@@ -65,6 +65,7 @@ HEADERS += ByteArray.h \
            Hash.h \
            Log.h \
            LogBase.h \
+           MappedFile.h \
            Mutex.h \
            MWException.h \
            Thread.h \
@@ -85,6 +86,7 @@ SOURCES += ByteArray.cpp \
            Hash.cpp \
            Log.cpp \
            LogBase.cpp \
+           MappedFile.cpp \
            Mutex.cpp \
            MWException.cpp \
            Thread.cpp \
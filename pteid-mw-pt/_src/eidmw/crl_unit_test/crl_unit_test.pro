@@ -104,6 +104,9 @@ HEADERS += \
 	../applayer/SSLConnection.h \
 	../applayer/PNGConverter.h \
 	../applayer/PAdESExtender.h \
+	../applayer/PAdESBatchExtender.h \
+	../applayer/SignatureVerifier.h \
+	../applayer/ValidationDataCache.h \
 	../applayer/J2KHelper.h \
 	../applayer/PDFSignature.h \
 	../applayer/CurlUtil.h \
@@ -133,11 +136,15 @@ SOURCES += \
 	../applayer/SSLConnection.cpp \
 	../applayer/TSAClient.cpp \
 	../applayer/SecurityContext.cpp \
+	../applayer/SharedCertStore.cpp \
 	../applayer/sign-pkcs7.cpp \
 	../applayer/cJSON.c \
 	../applayer/PKIFetcher.cpp \
 	../applayer/PDFSignature.cpp \
 	../applayer/PAdESExtender.cpp \
+	../applayer/PAdESBatchExtender.cpp \
+	../applayer/SignatureVerifier.cpp \
+	../applayer/ValidationDataCache.cpp \
 	../applayer/MutualAuthentication.cpp \
 	../applayer/PNGConverter.cpp \
 	../applayer/J2KHelper.cpp \
@@ -387,11 +387,32 @@ struct WndGeometry {
 };
 typedef struct WndGeometry Type_WndGeometry;
 
+/**
+   Request sent to a dialogsQTsrv started in server mode (DLG_SERVER_ARG), over its unix socket.
+   The dialog arguments stay in the shared memory segment of csFilename, as when the dialog is run
+   by a dialogsQTsrv of its own. The server answers with one byte, 1 if it shows the dialog, and
+   then with a DlgServerReply once the dialog is closed */
+#define DLG_SERVER_ARG "--server"
+#define DLG_SERVER_FILENAME_LEN 64
+
+struct DlgServerRequest {
+	int index; // DlgFunctionIndex
+	char csFilename[DLG_SERVER_FILENAME_LEN];
+	int hasGeometry;
+	Type_WndGeometry geometry;
+};
+
+struct DlgServerReply {
+	int status; // exit code of a dialogsQTsrv that would have run the dialog
+};
+
 void InitializeRand();
 std::string RandomFileName();
 std::string CreateRandomFile();
 void DeleteFile(const char *csFilename);
 void CallQTServer(const DlgFunctionIndex index, const char *csFilename, void *wndGeometry = 0);
+bool CallDialogServer(const DlgFunctionIndex index, const char *csFilename, void *wndGeometry);
+std::string DlgServerSocketPath();
 
 DLGS_EXPORT bool getWndCenterPos(Type_WndGeometry *pWndGeometry, int desktop_width, int desktop_height, int wnd_width,
 								 int wnd_height, Type_WndGeometry *outWndGeometry);
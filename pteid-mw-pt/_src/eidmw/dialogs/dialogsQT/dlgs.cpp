@@ -26,8 +26,13 @@
 ********************************************************************************/
 #include <unistd.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <signal.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include "errno.h"
 
@@ -59,6 +64,17 @@ bool bRandInitialized = false;
 
 static bool g_bSystemCallsFail = false;
 
+// Set when the dialog server couldn't be started: this process then starts a dialogsQTsrv for each dialog
+static bool g_bDialogServerFailed = false;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Time given to a new dialog server to create its socket
+#define DLG_SERVER_START_TIMEOUT 5000
+#define DLG_SERVER_START_POLL 50
+
 /************************
  *       DIALOGS
  ************************/
@@ -638,16 +654,212 @@ void eIDMW::DeleteFile(const char *csFilename) {
 	}
 }
 
-void eIDMW::CallQTServer(const DlgFunctionIndex index, const char *csFilename, void *wndGeometry) {
-	char csCommand[150];
-	Type_WndGeometry *pWndGeometry = (Type_WndGeometry *)wndGeometry;
-
+static std::string GetServerPath() {
 	std::string csServerPath = STRINGIFY(EIDMW_PREFIX) "/bin/";
 #ifdef __APPLE__
 	csServerPath += "pteiddialogsQTsrv.app/Contents/MacOS/";
 #endif
+	return csServerPath + csServerName;
+}
+
+/* The modal dialogs go to the dialog server. The pinpad and CMD message dialogs stay in a process of their own,
+   which DlgClosePinpadInfo() and DlgCloseCMDMessage() close with a signal */
+static bool UseDialogServer(const DlgFunctionIndex index) {
+	if (g_bDialogServerFailed || index == DLG_DISPLAY_PINPAD_INFO || index == DLG_CMD_MSG)
+		return false;
+	return CConfig::GetLong(CConfig::EIDMW_CONFIG_PARAM_GUITOOL_DIALOGSERVER) != 0;
+}
+
+/* The server shows its dialogs on the display it was started with, so each display of the user gets its own */
+static std::string DlgServerDisplay() {
+	std::string csDisplay;
+#ifndef __APPLE__
+	const char *csWayland = getenv("WAYLAND_DISPLAY");
+	const char *csX11 = getenv("DISPLAY");
+	if (csWayland != NULL && csWayland[0] != '\0')
+		csDisplay = std::string("_w") + csWayland;
+	else if (csX11 != NULL && csX11[0] != '\0')
+		csDisplay = std::string("_x") + csX11;
+
+	for (size_t i = 0; i < csDisplay.size(); i++) {
+		if (!isalnum((unsigned char)csDisplay[i]) && csDisplay[i] != '.')
+			csDisplay[i] = '_';
+	}
+#endif
+	return csDisplay;
+}
+
+std::string eIDMW::DlgServerSocketPath() {
+	std::string csDisplay = DlgServerDisplay();
+	const char *csRuntimeDir = getenv("XDG_RUNTIME_DIR");
+	if (csRuntimeDir != NULL && csRuntimeDir[0] == '/')
+		return std::string(csRuntimeDir) + "/pteiddialogs" + csDisplay + ".sock";
+
+	char csPath[64];
+	sprintf(csPath, "/tmp/.pteiddialogs_%u", (unsigned int)getuid());
+	return csPath + csDisplay + ".sock";
+}
+
+static int ConnectDialogServer(const std::string &csSocketPath) {
+	// Only a server of the same user is used
+	struct stat st;
+	if (lstat(csSocketPath.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode) || st.st_uid != getuid())
+		return -1;
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (csSocketPath.size() >= sizeof(addr.sun_path))
+		return -1;
+	strcpy(addr.sun_path, csSocketPath.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1)
+		return -1;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool StartDialogServer(const std::string &csSocketPath) {
+	std::string csServer = GetServerPath();
+	long lMaxFd = sysconf(_SC_OPEN_MAX);
+	if (lMaxFd < 0)
+		lMaxFd = 1024;
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		MWLOG(LEV_ERROR, MOD_DLG, L"  eIDMW::StartDialogServer fork : %s ", strerror(errno));
+		return false;
+	}
+
+	if (pid == 0) {
+		// The server is started by a second fork so that it's not a child of the application
+		setsid();
+		if (fork() == 0) {
+			// It outlives the application: it mustn't keep its terminal, pipes or sockets open
+			int nullFd = open("/dev/null", O_RDWR);
+			if (nullFd != -1) {
+				dup2(nullFd, 0);
+				dup2(nullFd, 1);
+				dup2(nullFd, 2);
+			}
+			for (long fd = 3; fd < lMaxFd; fd++)
+				close((int)fd);
+			execl(csServer.c_str(), csServer.c_str(), DLG_SERVER_ARG, csSocketPath.c_str(), (char *)NULL);
+		}
+		_exit(0);
+	}
+
+	waitpid(pid, NULL, 0);
+	return true;
+}
+
+static bool WriteAll(int fd, const void *pData, size_t len) {
+	const char *p = (const char *)pData;
+	while (len > 0) {
+		ssize_t written = send(fd, p, len, MSG_NOSIGNAL);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		p += written;
+		len -= written;
+	}
+	return true;
+}
+
+static bool ReadAll(int fd, void *pData, size_t len) {
+	char *p = (char *)pData;
+	while (len > 0) {
+		ssize_t got = read(fd, p, len);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			return false;
+		p += got;
+		len -= got;
+	}
+	return true;
+}
+
+/* Runs the dialog in the dialog server of this user, starting it if needed. Returns false, without having shown
+   anything, if the server can't be used; throws if the server failed while the dialog was running */
+bool eIDMW::CallDialogServer(const DlgFunctionIndex index, const char *csFilename, void *wndGeometry) {
+	DlgServerRequest request;
+	memset(&request, 0, sizeof(request));
+	if (strlen(csFilename) >= sizeof(request.csFilename))
+		return false;
+
+	request.index = index;
+	strcpy(request.csFilename, csFilename);
+	Type_WndGeometry *pWndGeometry = (Type_WndGeometry *)wndGeometry;
+	if ((pWndGeometry != NULL) && (pWndGeometry->x >= 0) && (pWndGeometry->y >= 0) && (pWndGeometry->width >= 0) &&
+		(pWndGeometry->height >= 0)) {
+		request.hasGeometry = 1;
+		request.geometry = *pWndGeometry;
+	}
+
+	std::string csSocketPath = DlgServerSocketPath();
+	int fd = ConnectDialogServer(csSocketPath);
+	if (fd == -1) {
+		MWLOG(LEV_INFO, MOD_DLG, L"  eIDMW::CallDialogServer starting the dialog server");
+		if (StartDialogServer(csSocketPath)) {
+			for (int i = 0; i < DLG_SERVER_START_TIMEOUT / DLG_SERVER_START_POLL && fd == -1; i++) {
+				CThread::SleepMillisecs(DLG_SERVER_START_POLL);
+				fd = ConnectDialogServer(csSocketPath);
+			}
+		}
+		if (fd == -1) {
+			MWLOG(LEV_WARN, MOD_DLG, L"  eIDMW::CallDialogServer the dialog server didn't start, not using it");
+			g_bDialogServerFailed = true;
+			return false;
+		}
+	}
+
+	if (!WriteAll(fd, &request, sizeof(request))) {
+		MWLOG(LEV_WARN, MOD_DLG, L"  eIDMW::CallDialogServer %i : %s ", index, strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	// Without the acknowledgement nothing was shown, e.g. the server was exiting after being idle
+	char accepted = 0;
+	if (!ReadAll(fd, &accepted, 1) || !accepted) {
+		MWLOG(LEV_WARN, MOD_DLG, L"  eIDMW::CallDialogServer %i : not accepted by the dialog server", index);
+		close(fd);
+		return false;
+	}
+
+	// Blocks until the user closes the dialog
+	DlgServerReply reply;
+	bool bReply = ReadAll(fd, &reply, sizeof(reply));
+	close(fd);
+
+	if (!bReply || reply.status != 0) {
+		MWLOG(LEV_ERROR, MOD_DLG, L"  eIDMW::CallDialogServer %i %s : dialog failed (%d)", index, csFilename,
+			  bReply ? reply.status : -1);
+		throw CMWEXCEPTION(EIDMW_ERR_UNKNOWN);
+	}
+	return true;
+}
+
+void eIDMW::CallQTServer(const DlgFunctionIndex index, const char *csFilename, void *wndGeometry) {
+	if (UseDialogServer(index) && CallDialogServer(index, csFilename, wndGeometry))
+		return;
+
+	char csCommand[150];
+	Type_WndGeometry *pWndGeometry = (Type_WndGeometry *)wndGeometry;
 
-	sprintf(csCommand, "%s/%s %i %s", csServerPath.c_str(), csServerName.c_str(), index, csFilename);
+	sprintf(csCommand, "%s %i %s", GetServerPath().c_str(), index, csFilename);
 
 	if ((pWndGeometry != NULL) && (pWndGeometry->x >= 0) && (pWndGeometry->y >= 0) && (pWndGeometry->width >= 0) &&
 		(pWndGeometry->height >= 0)) {
@@ -25,7 +25,7 @@ INSTALLS += target
 CONFIG -= warn_on
 
 #For Qt5
-QT += widgets
+QT += widgets network
 
 DEPENDPATH += .
 INCLUDEPATH += . ../dialogsQT ../../common
@@ -29,6 +29,8 @@
 #include <QPushButton>
 #include <QMessageBox>
 #include <QFontDatabase>
+#include <QLocalServer>
+#include <QLocalSocket>
 
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -101,6 +103,10 @@ void sigint_handler(int sig) {
 
 int g_UseKeyPad = -1;
 
+// In milliseconds
+#define DLG_SERVER_IDLE_TIMEOUT (10 * 60 * 1000)
+#define DLG_SERVER_READ_TIMEOUT 5000
+
 bool DlgGetKeyPad() {
 	if (g_UseKeyPad == -1) {
 		g_UseKeyPad = (CConfig::GetLong(CConfig::EIDMW_CONFIG_PARAM_GUITOOL_VIRTUALKBD) ? 1 : 0);
@@ -166,235 +172,454 @@ QFont getLatoFont() {
 	return font;
 }
 
-int main(int argc, char *argv[]) {
-	int iFunctionIndex = 0;
-	std::string readableFilePath;
+static int runAskPin(const std::string &readableFilePath, Type_WndGeometry &parentWndGeometry) {
+	// attach to the segment and get a pointer
+	DlgAskPINArguments *oData = NULL;
+
+	SharedMem oShMemory;
+	oShMemory.Attach(sizeof(DlgAskPINArguments), readableFilePath.c_str(), (void **)&oData);
+	MWLOG(LEV_DEBUG, MOD_DLG, L"Running DLG_ASK_PIN with args: operation=> %d usage=> %d\n", oData->operation,
+		  oData->usage);
+
+	// do something
+	dlgWndAskPIN *dlg = NULL;
+	try {
+		QString PINName = getPinName(oData->usage, oData->pinName);
+		QString Header;
+		switch (oData->operation) {
+		case DLG_PIN_OP_VERIFY:
+			switch (oData->usage) {
+			case DLG_PIN_AUTH:
+				Header = GETQSTRING_DLG(AuthenticateWith);
+				Header += " ";
+				Header += GETQSTRING_DLG(CitizenCard);
+				Header += "\n";
+				break;
+			case DLG_PIN_SIGN:
+				Header = GETQSTRING_DLG(SigningWith);
+				Header += " ";
+				Header += GETQSTRING_DLG(CitizenCard);
+				Header += "\n";
+				break;
+			case DLG_PIN_ADDRESS:
+				Header = GETQSTRING_DLG(ReadAddressFrom);
+				Header += " ";
+				Header += GETQSTRING_DLG(CitizenCard);
+				Header += "\n";
+				break;
+			default:
+				Header = GETQSTRING_DLG(PleaseEnterYourPin);
+				Header += "\n";
+				break;
+			}
+			break;
+		case DLG_PIN_OP_UNBLOCK_NO_CHANGE:
+			Header = GETQSTRING_DLG(PleaseEnterYourPuk);
+			Header += ", ";
+			Header = GETQSTRING_DLG(ToUnblock);
+			Header += " ";
+			Header = GETQSTRING_DLG(Your);
+			Header += " \"";
+			if (wcslen(oData->pinName) == 0) {
+				Header += QString::fromWCharArray(oData->pinName);
+			} else {
+				Header += GETQSTRING_DLG(Pin);
+			}
+			Header += "\"\n";
+			break;
+		default:
+			oData->returnValue = DLG_BAD_PARAM;
+			oShMemory.Detach((void *)oData);
+			return 0;
+			break;
+		}
 
-	Type_WndGeometry parentWndGeometry;
+		dlg =
+			new dlgWndAskPIN(oData->pinInfo, oData->usage, Header, PINName, DlgGetKeyPad(), 0, &parentWndGeometry);
+		int retVal = dlg->exec();
+		if (retVal == QDialog::Accepted) {
+			wcscpy_s(oData->pin, sizeof(oData->pin) / sizeof(wchar_t), dlg->getPIN().c_str());
+			oData->returnValue = DLG_OK;
+		} else // we'll consider as cancel
+		{
+			oData->returnValue = DLG_CANCEL;
+		}
+		delete dlg;
+		dlg = NULL;
+		oShMemory.Detach((void *)oData);
+		return 0;
+	} catch (...) {
+		if (dlg)
+			delete dlg;
+		oData->returnValue = DLG_ERR;
+		oShMemory.Detach((void *)oData);
+		return 0;
+	}
+}
 
-	if (signal(SIGINT, sigint_handler) == SIG_ERR) {
-		MWLOG(LEV_ERROR, MOD_DLG, L"  %s setup of signal handler : %s ", argv[0], strerror(errno));
-		exit(DLG_ERR);
+static int runAskPins(const std::string &readableFilePath, Type_WndGeometry &parentWndGeometry) {
+	// attach to the segment and get a pointer
+	DlgAskPINsArguments *oData = NULL;
+	SharedMem oShMemory;
+	oShMemory.Attach(sizeof(DlgAskPINsArguments), readableFilePath.c_str(), (void **)&oData);
+	MWLOG(LEV_ERROR, MOD_DLG, L"Running DLG_ASK_PINS with args: operation=> %d usage=> %d\n", oData->operation,
+		  oData->usage);
+
+	dlgWndAskPINs *dlg = NULL;
+	try {
+		QString Header;
+		QString tr_pin = getPinName(oData->usage, oData->pinName);
+		switch (oData->operation) {
+		case DLG_PIN_OP_CHANGE:
+			Header = GETQSTRING_DLG(Change);
+			Header += " ";
+			Header += tr_pin;
+			break;
+		case DLG_PIN_OP_UNBLOCK_CHANGE:
+			Header = GETQSTRING_DLG(Unblock);
+			Header += " ";
+			Header += tr_pin;
+			tr_pin = GETQSTRING_DLG(Puk);
+			break;
+		default:
+			oData->returnValue = DLG_BAD_PARAM;
+			oShMemory.Detach((void *)oData);
+			return 0;
+		}
+		dlg = new dlgWndAskPINs(oData->pin1Info, oData->pin2Info, Header, tr_pin, DlgGetKeyPad(), 0,
+								&parentWndGeometry);
+		if (dlg->exec()) {
+			wcscpy_s(oData->pin1, sizeof(oData->pin1) / sizeof(wchar_t), dlg->getPIN1().c_str());
+			wcscpy_s(oData->pin2, sizeof(oData->pin2) / sizeof(wchar_t), dlg->getPIN2().c_str());
+			delete dlg;
+			dlg = NULL;
+			oData->returnValue = DLG_OK;
+			oShMemory.Detach((void *)oData);
+			return 0;
+		}
+		delete dlg;
+		dlg = NULL;
+	} catch (...) {
+		if (dlg)
+			delete dlg;
+		oData->returnValue = DLG_ERR;
+		oShMemory.Detach((void *)oData);
+		return 0;
 	}
+	oData->returnValue = DLG_CANCEL;
+	oShMemory.Detach((void *)oData);
+	return 0;
+}
 
-	int iRet = DLG_CANCEL;
+static int runBadPin(const std::string &readableFilePath, Type_WndGeometry &parentWndGeometry) {
+	// attach to the segment and get a pointer
+	DlgBadPinArguments *oData = NULL;
+	SharedMem oShMemory;
+	oShMemory.Attach(sizeof(DlgBadPinArguments), readableFilePath.c_str(), (void **)&oData);
+
+	dlgWndBadPIN *dlg = NULL;
+	try {
+		QString PINName;
+		PINName = getPinName(oData->usage, oData->pinName);
+		dlg = new dlgWndBadPIN(PINName, oData->ulRemainingTries, 0, &parentWndGeometry);
+		if (dlg->exec()) {
+			delete dlg;
+			dlg = NULL;
 
-	// parse the arguments according to the operation requested
-	MWLOG(LEV_INFO, MOD_DLG, L"  Running %s ...", argv[0]);
+			eIDMW::DlgRet dlgResult = DLG_RETRY;
+			if (oData->ulRemainingTries == 0) {
+				dlgResult = DLG_OK;
+			}
 
-	if (argc > 2) {
-		iFunctionIndex = atoi(argv[1]);
-		readableFilePath = argv[2];
+			oData->returnValue = dlgResult;
+			oShMemory.Detach((void *)oData);
 
-		if (argc > 5) {
-			parentWndGeometry.x = atoi(argv[3]);
-			parentWndGeometry.y = atoi(argv[4]);
-			parentWndGeometry.width = atoi(argv[5]);
-			parentWndGeometry.height = atoi(argv[6]);
+			return 0;
 		}
+		delete dlg;
+		dlg = NULL;
+	} catch (...) {
+		if (dlg)
+			delete dlg;
 
-	} else {
-		qCritical("pteiddialogsQTsrv: missing arguments");
+		oData->returnValue = DLG_ERR;
+		oShMemory.Detach((void *)oData);
 
-		exit(DLG_ERR);
+		return 0;
 	}
 
-#ifdef __APPLE__
-	// In MacOS we deploy the QT plugins in a specific location which is common
-	// to all the QT applications (eidguiV2, pteiddialogs)
-	QCoreApplication::addLibraryPath(QString("/Applications/Autentica\xC3\xA7\xC3\xA3o.gov.app/Contents/PlugIns/"));
-#endif
+	oData->returnValue = DLG_CANCEL;
+	oShMemory.Detach((void *)oData);
+	return 0;
+}
 
-	if (iFunctionIndex == DLG_ASK_PIN) {
-		QApplication a(argc, argv);
-		a.setFont(getLatoFont());
-		a.setWindowIcon(QIcon(":/images/appicon.ico"));
+static int runAskCmdInput(const std::string &readableFilePath, Type_WndGeometry &parentWndGeometry) {
+	// attach to the segment and get a pointer
+	DlgAskInputCMDArguments *oData = NULL;
+	SharedMem oShMemory;
+	oShMemory.Attach(sizeof(DlgAskInputCMDArguments), readableFilePath.c_str(), (void **)&oData);
+	MWLOG(LEV_DEBUG, MOD_DLG, L"Running DLG_ASK_CMD_INPUT with args: isValidateOtp=%s length of inOutId=%ld",
+		  (oData->isValidateOtp ? "true" : "false"), wcslen(oData->inOutId));
+
+	bool askForId = oData->askForId || (wcslen(oData->inOutId) == 0);
+	dlgWndAskCmd *dlg = NULL;
+	try {
+		size_t ulOutCodeBufferLen = sizeof(oData->Code) / sizeof(wchar_t);
+		if ((!oData->isValidateOtp && ulOutCodeBufferLen < 9) || (oData->isValidateOtp && ulOutCodeBufferLen < 7)) {
+			MWLOG(LEV_ERROR, MOD_DLG, L"  --> DlgAskCMD() returns DLG_BAD_PARAM: buffer does not have enough size");
+			return DLG_BAD_PARAM;
+		}
 
-		// attach to the segment and get a pointer
-		DlgAskPINArguments *oData = NULL;
+		QString sMessage;
+		std::wstring userName;
+		std::wstring userId = oData->inOutId;
 
-		SharedMem oShMemory;
-		oShMemory.Attach(sizeof(DlgAskPINArguments), readableFilePath.c_str(), (void **)&oData);
-		MWLOG(LEV_DEBUG, MOD_DLG, L"Running DLG_ASK_PIN with args: operation=> %d usage=> %d\n", oData->operation,
-			  oData->usage);
-
-		// do something
-		dlgWndAskPIN *dlg = NULL;
-		try {
-			QString PINName = getPinName(oData->usage, oData->pinName);
-			QString Header;
-			switch (oData->operation) {
-			case DLG_PIN_OP_VERIFY:
-				switch (oData->usage) {
-				case DLG_PIN_AUTH:
-					Header = GETQSTRING_DLG(AuthenticateWith);
-					Header += " ";
-					Header += GETQSTRING_DLG(CitizenCard);
-					Header += "\n";
-					break;
-				case DLG_PIN_SIGN:
-					Header = GETQSTRING_DLG(SigningWith);
-					Header += " ";
-					Header += GETQSTRING_DLG(CitizenCard);
-					Header += "\n";
-					break;
-				case DLG_PIN_ADDRESS:
-					Header = GETQSTRING_DLG(ReadAddressFrom);
-					Header += " ";
-					Header += GETQSTRING_DLG(CitizenCard);
-					Header += "\n";
-					break;
-				default:
-					Header = GETQSTRING_DLG(PleaseEnterYourPin);
-					Header += "\n";
-					break;
-				}
-				break;
-			case DLG_PIN_OP_UNBLOCK_NO_CHANGE:
-				Header = GETQSTRING_DLG(PleaseEnterYourPuk);
-				Header += ", ";
-				Header = GETQSTRING_DLG(ToUnblock);
-				Header += " ";
-				Header = GETQSTRING_DLG(Your);
-				Header += " \"";
-				if (wcslen(oData->pinName) == 0) {
-					Header += QString::fromWCharArray(oData->pinName);
-				} else {
-					Header += GETQSTRING_DLG(Pin);
-				}
-				Header += "\"\n";
-				break;
-			default:
-				oData->returnValue = DLG_BAD_PARAM;
-				oShMemory.Detach((void *)oData);
-				return 0;
-				break;
+		if (!oData->isValidateOtp) {
+			if (oData->operation == DlgCmdOperation::DLG_CMD_SIGNATURE) {
+				sMessage += GETQSTRING_DLG(Caution);
+				sMessage += " ";
+				sMessage += GETQSTRING_DLG(YouAreAboutToMakeALegallyBindingElectronicWithCmd);
 			}
 
-			dlg =
-				new dlgWndAskPIN(oData->pinInfo, oData->usage, Header, PINName, DlgGetKeyPad(), 0, &parentWndGeometry);
-			int retVal = dlg->exec();
-			if (retVal == QDialog::Accepted) {
-				wcscpy_s(oData->pin, sizeof(oData->pin) / sizeof(wchar_t), dlg->getPIN().c_str());
+			// userName.append(csUserName, ulUserNameBufferLen);
+		} else {
+			if (oData->operation == DlgCmdOperation::DLG_CMD_SIGNATURE) {
+				sMessage += GETQSTRING_DLG(InsertOtpSignature);
+			} else if (oData->operation == DlgCmdOperation::DLG_CMD_GET_CERTIFICATE) {
+				sMessage += GETQSTRING_DLG(InsertOtpCert);
+			}
+		}
+
+		dlg = new dlgWndAskCmd(oData->operation, oData->isValidateOtp, sMessage, &userId, &userName,
+							   oData->callbackWasCalled, askForId, NULL, &parentWndGeometry);
+
+		if (dlg->exec()) {
+			if (dlg->callCallback()) {
+				oData->returnValue = DLG_CALLBACK;
+			} else {
 				oData->returnValue = DLG_OK;
-			} else // we'll consider as cancel
-			{
-				oData->returnValue = DLG_CANCEL;
 			}
+
+			if (askForId) {
+				wcscpy_s(oData->inOutId, sizeof(oData->inOutId) / sizeof(wchar_t), dlg->getId().c_str());
+			}
+
+			wcscpy_s(oData->Code, sizeof(oData->Code) / sizeof(wchar_t), dlg->getCode().c_str());
+
 			delete dlg;
 			dlg = NULL;
 			oShMemory.Detach((void *)oData);
 			return 0;
-		} catch (...) {
-			if (dlg)
-				delete dlg;
-			oData->returnValue = DLG_ERR;
-			oShMemory.Detach((void *)oData);
-			return 0;
 		}
+		delete dlg;
+		dlg = NULL;
+	} catch (...) {
+		if (dlg)
+			delete dlg;
+		oData->returnValue = DLG_ERR;
+		oShMemory.Detach((void *)oData);
+		return 0;
+	}
+	oData->returnValue = DLG_CANCEL;
+	oShMemory.Detach((void *)oData);
+	return 0;
+}
 
-	} else if (iFunctionIndex == DLG_ASK_PINS) {
-		QApplication a(argc, argv);
-		a.setFont(getLatoFont());
-		a.setWindowIcon(QIcon(":/images/appicon.ico"));
-
-		// attach to the segment and get a pointer
-		DlgAskPINsArguments *oData = NULL;
-		SharedMem oShMemory;
-		oShMemory.Attach(sizeof(DlgAskPINsArguments), readableFilePath.c_str(), (void **)&oData);
-		MWLOG(LEV_ERROR, MOD_DLG, L"Running DLG_ASK_PINS with args: operation=> %d usage=> %d\n", oData->operation,
-			  oData->usage);
-
-		dlgWndAskPINs *dlg = NULL;
-		try {
-			QString Header;
-			QString tr_pin = getPinName(oData->usage, oData->pinName);
-			switch (oData->operation) {
-			case DLG_PIN_OP_CHANGE:
-				Header = GETQSTRING_DLG(Change);
-				Header += " ";
-				Header += tr_pin;
-				break;
-			case DLG_PIN_OP_UNBLOCK_CHANGE:
-				Header = GETQSTRING_DLG(Unblock);
-				Header += " ";
-				Header += tr_pin;
-				tr_pin = GETQSTRING_DLG(Puk);
-				break;
-			default:
-				oData->returnValue = DLG_BAD_PARAM;
-				oShMemory.Detach((void *)oData);
-				return 0;
-			}
-			dlg = new dlgWndAskPINs(oData->pin1Info, oData->pin2Info, Header, tr_pin, DlgGetKeyPad(), 0,
-									&parentWndGeometry);
-			if (dlg->exec()) {
-				wcscpy_s(oData->pin1, sizeof(oData->pin1) / sizeof(wchar_t), dlg->getPIN1().c_str());
-				wcscpy_s(oData->pin2, sizeof(oData->pin2) / sizeof(wchar_t), dlg->getPIN2().c_str());
-				delete dlg;
-				dlg = NULL;
-				oData->returnValue = DLG_OK;
-				oShMemory.Detach((void *)oData);
-				return 0;
-			}
+static int runPickDevice(const std::string &readableFilePath, Type_WndGeometry &parentWndGeometry) {
+	// attach to the segment and get a pointer
+	DlgPickDeviceArguments *oData = NULL;
+	SharedMem oShMemory;
+	oShMemory.Attach(sizeof(DlgPickDeviceArguments), readableFilePath.c_str(), (void **)&oData);
+	MWLOG(LEV_DEBUG, MOD_DLG, L"Running DLG_PICK_DEVICE");
+
+	dlgWndPickDevice *dlg = NULL;
+	try {
+		dlg = new dlgWndPickDevice(NULL, &parentWndGeometry);
+		if (dlg->exec()) {
+			oData->outDevice = dlg->getOutDevice();
+			oData->returnValue = DLG_OK;
 			delete dlg;
 			dlg = NULL;
-		} catch (...) {
-			if (dlg)
-				delete dlg;
-			oData->returnValue = DLG_ERR;
 			oShMemory.Detach((void *)oData);
 			return 0;
 		}
-		oData->returnValue = DLG_CANCEL;
+		delete dlg;
+		dlg = NULL;
+	} catch (...) {
+		if (dlg)
+			delete dlg;
+		oData->returnValue = DLG_ERR;
 		oShMemory.Detach((void *)oData);
 		return 0;
+	}
+	oData->returnValue = DLG_CANCEL;
+	oShMemory.Detach((void *)oData);
+	return 0;
+}
 
-	} else if (iFunctionIndex == DLG_BAD_PIN) {
-		QApplication a(argc, argv);
-		a.setFont(getLatoFont());
-		a.setWindowIcon(QIcon(":/images/appicon.ico"));
+static bool isModalDialog(int iFunctionIndex) {
+	return iFunctionIndex == DLG_ASK_PIN || iFunctionIndex == DLG_ASK_PINS || iFunctionIndex == DLG_BAD_PIN ||
+		   iFunctionIndex == DLG_ASK_CMD_INPUT || iFunctionIndex == DLG_PICK_DEVICE;
+}
 
-		// attach to the segment and get a pointer
-		DlgBadPinArguments *oData = NULL;
-		SharedMem oShMemory;
-		oShMemory.Attach(sizeof(DlgBadPinArguments), readableFilePath.c_str(), (void **)&oData);
-
-		dlgWndBadPIN *dlg = NULL;
-		try {
-			QString PINName;
-			PINName = getPinName(oData->usage, oData->pinName);
-			dlg = new dlgWndBadPIN(PINName, oData->ulRemainingTries, 0, &parentWndGeometry);
-			if (dlg->exec()) {
-				delete dlg;
-				dlg = NULL;
-
-				eIDMW::DlgRet dlgResult = DLG_RETRY;
-				if (oData->ulRemainingTries == 0) {
-					dlgResult = DLG_OK;
-				}
+/* Runs one of the modal dialogs, the QApplication must already exist. Returns the exit code of dialogsQTsrv */
+static int runModalDialog(int iFunctionIndex, const std::string &readableFilePath,
+						  Type_WndGeometry &parentWndGeometry) {
+	switch (iFunctionIndex) {
+	case DLG_ASK_PIN:
+		return runAskPin(readableFilePath, parentWndGeometry);
+	case DLG_ASK_PINS:
+		return runAskPins(readableFilePath, parentWndGeometry);
+	case DLG_BAD_PIN:
+		return runBadPin(readableFilePath, parentWndGeometry);
+	case DLG_ASK_CMD_INPUT:
+		return runAskCmdInput(readableFilePath, parentWndGeometry);
+	case DLG_PICK_DEVICE:
+		return runPickDevice(readableFilePath, parentWndGeometry);
+	default:
+		return DLG_BAD_PARAM;
+	}
+}
 
-				oData->returnValue = dlgResult;
-				oShMemory.Detach((void *)oData);
+static bool readRequest(QLocalSocket *socket, DlgServerRequest *request) {
+	while (socket->bytesAvailable() < (qint64)sizeof(*request)) {
+		if (!socket->waitForReadyRead(DLG_SERVER_READ_TIMEOUT))
+			return false;
+	}
+	return socket->read((char *)request, sizeof(*request)) == sizeof(*request);
+}
 
-				return 0;
-			}
-			delete dlg;
-			dlg = NULL;
-		} catch (...) {
-			if (dlg)
-				delete dlg;
+/* Protocol: the server answers a DlgServerRequest with one byte, 1 if it's going to show the dialog, and then
+   with a DlgServerReply once the dialog is closed */
+static void serveRequest(QLocalSocket *socket) {
+	DlgServerRequest request;
+	if (!readRequest(socket, &request))
+		return;
+	request.csFilename[sizeof(request.csFilename) - 1] = '\0';
 
-			oData->returnValue = DLG_ERR;
-			oShMemory.Detach((void *)oData);
+	char accepted = isModalDialog(request.index) ? 1 : 0;
+	socket->write(&accepted, 1);
+	if (!socket->waitForBytesWritten(DLG_SERVER_READ_TIMEOUT) || !accepted)
+		return;
+
+	Type_WndGeometry parentWndGeometry;
+	if (request.hasGeometry)
+		parentWndGeometry = request.geometry;
+	else
+		memset(&parentWndGeometry, -1, sizeof(parentWndGeometry));
+
+	// The language and the keypad setting may have been changed since the previous dialog
+	CLang::ResetInit();
+	g_UseKeyPad = -1;
+
+	MWLOG(LEV_DEBUG, MOD_DLG, L"  dialog server: running dialog %d", request.index);
+	DlgServerReply reply;
+	reply.status = runModalDialog(request.index, request.csFilename, parentWndGeometry);
+
+	socket->write((const char *)&reply, sizeof(reply));
+	socket->waitForBytesWritten(DLG_SERVER_READ_TIMEOUT);
+}
 
+/* Server mode: a single QApplication runs the modal dialogs of the dialogs library of this user, one at a time,
+   and exits when no dialog was asked for DLG_SERVER_IDLE_TIMEOUT */
+static int runDialogServer(int argc, char *argv[], const char *csSocketPath) {
+	// The application may exit while its dialog is open
+	signal(SIGPIPE, SIG_IGN);
+
+	QApplication a(argc, argv);
+	a.setFont(getLatoFont());
+	a.setWindowIcon(QIcon(":/images/appicon.ico"));
+	a.setQuitOnLastWindowClosed(false);
+
+	QLocalServer server;
+	server.setSocketOptions(QLocalServer::UserAccessOption);
+	if (!server.listen(csSocketPath)) {
+		// Either another application started a server at the same time or a previous server died
+		QLocalSocket probe;
+		probe.connectToServer(csSocketPath);
+		if (probe.waitForConnected(DLG_SERVER_READ_TIMEOUT)) {
+			MWLOG(LEV_INFO, MOD_DLG, L"  dialog server: already running on %s", csSocketPath);
 			return 0;
 		}
 
-		oData->returnValue = DLG_CANCEL;
-		oShMemory.Detach((void *)oData);
-		return 0;
+		QLocalServer::removeServer(csSocketPath);
+		if (!server.listen(csSocketPath)) {
+			MWLOG(LEV_ERROR, MOD_DLG, L"  dialog server: listen on %s failed: %ls", csSocketPath,
+				  server.errorString().toStdWString().c_str());
+			return DLG_ERR;
+		}
+	}
+	MWLOG(LEV_INFO, MOD_DLG, L"  dialog server: listening on %s", csSocketPath);
+
+	for (;;) {
+		bool bTimedOut = false;
+		if (!server.waitForNewConnection(DLG_SERVER_IDLE_TIMEOUT, &bTimedOut)) {
+			if (!bTimedOut)
+				MWLOG(LEV_ERROR, MOD_DLG, L"  dialog server: %ls", server.errorString().toStdWString().c_str());
+			break;
+		}
+
+		QLocalSocket *socket = server.nextPendingConnection();
+		if (socket == NULL)
+			continue;
+
+		serveRequest(socket);
+		socket->disconnectFromServer();
+		delete socket;
+	}
+
+	MWLOG(LEV_INFO, MOD_DLG, L"  dialog server: exiting");
+	server.close();
+	return 0;
+}
 
+int main(int argc, char *argv[]) {
+	int iFunctionIndex = 0;
+	std::string readableFilePath;
+
+	Type_WndGeometry parentWndGeometry;
+
+	if (signal(SIGINT, sigint_handler) == SIG_ERR) {
+		MWLOG(LEV_ERROR, MOD_DLG, L"  %s setup of signal handler : %s ", argv[0], strerror(errno));
+		exit(DLG_ERR);
+	}
+
+	int iRet = DLG_CANCEL;
+
+	// parse the arguments according to the operation requested
+	MWLOG(LEV_INFO, MOD_DLG, L"  Running %s ...", argv[0]);
+
+#ifdef __APPLE__
+	// In MacOS we deploy the QT plugins in a specific location which is common
+	// to all the QT applications (eidguiV2, pteiddialogs)
+	QCoreApplication::addLibraryPath(QString("/Applications/Autentica\xC3\xA7\xC3\xA3o.gov.app/Contents/PlugIns/"));
+#endif
+
+	if (argc > 2 && strcmp(argv[1], DLG_SERVER_ARG) == 0) {
+		return runDialogServer(argc, argv, argv[2]);
+	} else if (argc > 2) {
+		iFunctionIndex = atoi(argv[1]);
+		readableFilePath = argv[2];
+
+		if (argc > 5) {
+			parentWndGeometry.x = atoi(argv[3]);
+			parentWndGeometry.y = atoi(argv[4]);
+			parentWndGeometry.width = atoi(argv[5]);
+			parentWndGeometry.height = atoi(argv[6]);
+		}
+
+	} else {
+		qCritical("pteiddialogsQTsrv: missing arguments");
+
+		exit(DLG_ERR);
+	}
+
+	if (isModalDialog(iFunctionIndex)) {
+		QApplication a(argc, argv);
+		a.setFont(getLatoFont());
+		a.setWindowIcon(QIcon(":/images/appicon.ico"));
+
+		return runModalDialog(iFunctionIndex, readableFilePath, parentWndGeometry);
 	} else if (iFunctionIndex == DLG_DISPLAY_PINPAD_INFO) {
 		// To avoid problem on Mac Leopard, we follow these steps
 		// 1. The server is call with the 2 usual param
@@ -590,116 +815,6 @@ int main(int argc, char *argv[]) {
 			}
 		}
 		return 0;
-	} else if (iFunctionIndex == DLG_ASK_CMD_INPUT) {
-		QApplication a(argc, argv);
-		a.setFont(getLatoFont());
-		a.setWindowIcon(QIcon(":/images/appicon.ico"));
-
-		// attach to the segment and get a pointer
-		DlgAskInputCMDArguments *oData = NULL;
-		SharedMem oShMemory;
-		oShMemory.Attach(sizeof(DlgAskInputCMDArguments), readableFilePath.c_str(), (void **)&oData);
-		MWLOG(LEV_DEBUG, MOD_DLG, L"Running DLG_ASK_CMD_INPUT with args: isValidateOtp=%s length of inOutId=%ld",
-			  (oData->isValidateOtp ? "true" : "false"), wcslen(oData->inOutId));
-
-		bool askForId = oData->askForId || (wcslen(oData->inOutId) == 0);
-		dlgWndAskCmd *dlg = NULL;
-		try {
-			size_t ulOutCodeBufferLen = sizeof(oData->Code) / sizeof(wchar_t);
-			if ((!oData->isValidateOtp && ulOutCodeBufferLen < 9) || (oData->isValidateOtp && ulOutCodeBufferLen < 7)) {
-				MWLOG(LEV_ERROR, MOD_DLG, L"  --> DlgAskCMD() returns DLG_BAD_PARAM: buffer does not have enough size");
-				return DLG_BAD_PARAM;
-			}
-
-			QString sMessage;
-			std::wstring userName;
-			std::wstring userId = oData->inOutId;
-
-			if (!oData->isValidateOtp) {
-				if (oData->operation == DlgCmdOperation::DLG_CMD_SIGNATURE) {
-					sMessage += GETQSTRING_DLG(Caution);
-					sMessage += " ";
-					sMessage += GETQSTRING_DLG(YouAreAboutToMakeALegallyBindingElectronicWithCmd);
-				}
-
-				// userName.append(csUserName, ulUserNameBufferLen);
-			} else {
-				if (oData->operation == DlgCmdOperation::DLG_CMD_SIGNATURE) {
-					sMessage += GETQSTRING_DLG(InsertOtpSignature);
-				} else if (oData->operation == DlgCmdOperation::DLG_CMD_GET_CERTIFICATE) {
-					sMessage += GETQSTRING_DLG(InsertOtpCert);
-				}
-			}
-
-			dlg = new dlgWndAskCmd(oData->operation, oData->isValidateOtp, sMessage, &userId, &userName,
-								   oData->callbackWasCalled, askForId, NULL, &parentWndGeometry);
-
-			if (dlg->exec()) {
-				if (dlg->callCallback()) {
-					oData->returnValue = DLG_CALLBACK;
-				} else {
-					oData->returnValue = DLG_OK;
-				}
-
-				if (askForId) {
-					wcscpy_s(oData->inOutId, sizeof(oData->inOutId) / sizeof(wchar_t), dlg->getId().c_str());
-				}
-
-				wcscpy_s(oData->Code, sizeof(oData->Code) / sizeof(wchar_t), dlg->getCode().c_str());
-
-				delete dlg;
-				dlg = NULL;
-				oShMemory.Detach((void *)oData);
-				return 0;
-			}
-			delete dlg;
-			dlg = NULL;
-		} catch (...) {
-			if (dlg)
-				delete dlg;
-			oData->returnValue = DLG_ERR;
-			oShMemory.Detach((void *)oData);
-			return 0;
-		}
-		oData->returnValue = DLG_CANCEL;
-		oShMemory.Detach((void *)oData);
-		return 0;
-
-	} else if (iFunctionIndex == DLG_PICK_DEVICE) {
-		QApplication a(argc, argv);
-		a.setFont(getLatoFont());
-		a.setWindowIcon(QIcon(":/images/appicon.ico"));
-
-		// attach to the segment and get a pointer
-		DlgPickDeviceArguments *oData = NULL;
-		SharedMem oShMemory;
-		oShMemory.Attach(sizeof(DlgPickDeviceArguments), readableFilePath.c_str(), (void **)&oData);
-		MWLOG(LEV_DEBUG, MOD_DLG, L"Running DLG_PICK_DEVICE");
-
-		dlgWndPickDevice *dlg = NULL;
-		try {
-			dlg = new dlgWndPickDevice(NULL, &parentWndGeometry);
-			if (dlg->exec()) {
-				oData->outDevice = dlg->getOutDevice();
-				oData->returnValue = DLG_OK;
-				delete dlg;
-				dlg = NULL;
-				oShMemory.Detach((void *)oData);
-				return 0;
-			}
-			delete dlg;
-			dlg = NULL;
-		} catch (...) {
-			if (dlg)
-				delete dlg;
-			oData->returnValue = DLG_ERR;
-			oShMemory.Detach((void *)oData);
-			return 0;
-		}
-		oData->returnValue = DLG_CANCEL;
-		oShMemory.Detach((void *)oData);
-		return 0;
-
 	} else if (iFunctionIndex == DLG_CMD_MSG) {
 		// Similar to PinpadInfo
 		oShMemory = new SharedMem();
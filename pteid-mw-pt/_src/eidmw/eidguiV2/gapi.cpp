@@ -17,6 +17,7 @@
 #include <QDate>
 #include <QRegExp>
 #include <cstdio>
+#include <algorithm>
 #include <QQuickImageProvider>
 #include <QDesktopServices>
 #include <QPrinter>
@@ -2248,77 +2249,149 @@ void GAPI::doSignBatchPDF(SignParams &params) {
 	END_TRY_CATCH
 }
 
-QPixmap PDFPreviewImageProvider::requestPixmap(const QString &id, QSize *size, const QSize &requestedSize) {
+QImage PDFPreviewImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize) {
 	qDebug() << "PDFPreviewImageProvider received request for (width height): " << requestedSize.width() << " - "
 			 << requestedSize.height();
 	QStringList strList = id.split("?");
 
 	QString pdf_path = QUrl::fromPercentEncoding(strList.at(0).toUtf8());
-	m_filePath = pdf_path.toStdString();
+	std::string filePath = pdf_path.toStdString();
 
 	// URL param ?page=xx
 	unsigned int page = (unsigned int)strList.at(1).split("=").at(1).toInt();
 
-	if (m_docs.find(m_filePath) == m_docs.end()) {
+	PDFPreviewPage rendered;
+	// The neighbours of a cached page were already scheduled when it was rendered
+	if (!getCachedPage(cacheKey(filePath, page, requestedSize), rendered)) {
+		if (!renderPDFPage(filePath, page, requestedSize, rendered))
+			return QImage();
 
-		Poppler::Document *newdoc = Poppler::Document::load(pdf_path);
+		Concurrent::run(this, &PDFPreviewImageProvider::prerenderPages, pdf_path, page, requestedSize);
+	}
+
+	size->setHeight(rendered.image.height());
+	size->setWidth(rendered.image.width());
+
+	emit signalPdfSourceChanged(rendered.referenceWidth);
+
+	return rendered.image;
+}
+
+QSize PDFPreviewImageProvider::getPageSize(QString filePath, int page) {
+	QMutexLocker locker(&renderMutex);
+	auto it = m_docs.find(filePath.toStdString());
+	if (it == m_docs.end())
+		return QSize();
+
+	Poppler::Page *popplerPage = it->second->page(page - 1);
+	if (popplerPage == NULL)
+		return QSize();
+
+	QSize pageSize = popplerPage->pageSize();
+	delete popplerPage;
+	return pageSize;
+}
+
+QString PDFPreviewImageProvider::cacheKey(const std::string &filePath, unsigned int page, const QSize &requestedSize) {
+	return QString("%1|%2|%3x%4")
+		.arg(QString::fromStdString(filePath))
+		.arg(page)
+		.arg(requestedSize.width())
+		.arg(requestedSize.height());
+}
+
+bool PDFPreviewImageProvider::getCachedPage(const QString &key, PDFPreviewPage &rendered) {
+	QMutexLocker locker(&cacheMutex);
+	PDFPreviewPage *cached = m_renderCache.object(key);
+	if (cached == NULL)
+		return false;
+
+	rendered = *cached;
+	return true;
+}
+
+void PDFPreviewImageProvider::removeCachedPages(const std::string &filePath) {
+	QMutexLocker locker(&cacheMutex);
+	QString prefix = QString::fromStdString(filePath) + "|";
+	for (const QString &key : m_renderCache.keys()) {
+		if (key.startsWith(prefix))
+			m_renderCache.remove(key);
+	}
+}
+
+bool PDFPreviewImageProvider::renderPDFPage(const std::string &filePath, unsigned int page,
+											const QSize &requestedSize, PDFPreviewPage &rendered, bool prerender) {
+	QString key = cacheKey(filePath, page, requestedSize);
+	if (getCachedPage(key, rendered))
+		return true;
+
+	QMutexLocker locker(&renderMutex);
+
+	// Another thread may have rendered it while we waited for the lock
+	if (getCachedPage(key, rendered))
+		return true;
+
+	if (m_docs.find(filePath) == m_docs.end()) {
+		// Don't reopen a document closed after the prerender request
+		if (prerender)
+			return false;
+
+		Poppler::Document *newdoc = Poppler::Document::load(QString::fromStdString(filePath));
 		if (!newdoc) {
 			qDebug() << "Failed to load PDF file";
-			return QPixmap();
+			return false;
 		}
-		m_docs.insert(std::pair<std::string, Poppler::Document *>(m_filePath, newdoc));
+		m_docs.insert(std::pair<std::string, Poppler::Document *>(filePath, newdoc));
 
 		newdoc->setRenderHint(Poppler::Document::TextAntialiasing, true);
 		newdoc->setRenderHint(Poppler::Document::Antialiasing, true);
 		newdoc->setRenderBackend(Poppler::Document::RenderBackend::SplashBackend);
 	}
 
-	if (m_file_id != id) {
-		m_cache = renderPDFPage(page);
-		m_file_id = id;
+	Poppler::Document *doc = m_docs.at(filePath);
+	if (page < 1 || (int)page > doc->numPages()) {
+		if (!prerender)
+			qDebug() << "Invalid page number: " << page;
+		return false;
 	}
 
-	QPixmap scaled =
-		m_cache.scaled(requestedSize.width(), requestedSize.height(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
-	size->setHeight(scaled.height());
-	size->setWidth(scaled.width());
-
-	emit signalPdfSourceChanged(m_cache.width());
-
-	return scaled;
-}
-
-QSize PDFPreviewImageProvider::getPageSize(int page) {
-	Poppler::Page *popplerPage = m_docs.at(m_filePath)->page(page - 1);
-	return popplerPage->pageSize();
-}
-
-QPixmap PDFPreviewImageProvider::renderPDFPage(unsigned int page) {
-	renderMutex.lock();
-	if (m_docs.empty()) {
-		qDebug() << "Pdf to be rendered was unloaded!";
-		return QPixmap();
-	}
 	// Document starts at page 0 in the poppler-qt5 API
-	Poppler::Page *popplerPage = m_docs.at(m_filePath)->page(page - 1);
-
+	Poppler::Page *popplerPage = doc->page(page - 1);
 	if (popplerPage == NULL) {
 		qDebug() << "Failed to get page object: " << page;
-		return QPixmap();
+		return false;
 	}
 
-	const double resX = 300.0;
-	const double resY = 300.0;
-	QImage image = popplerPage->renderToImage(resX, resY);
+	// Render directly at the resolution that fits the requested size instead of scaling down a 300 DPI image
+	QSizeF pageSize = popplerPage->pageSizeF();
+	double res = PDF_PREVIEW_REFERENCE_DPI;
+	if (requestedSize.width() > 0 && requestedSize.height() > 0 && pageSize.width() > 0 && pageSize.height() > 0)
+		res = 72.0 * std::min(requestedSize.width() / pageSize.width(), requestedSize.height() / pageSize.height());
 
+	rendered.image = popplerPage->renderToImage(res, res);
+	rendered.referenceWidth = pageSize.width() * PDF_PREVIEW_REFERENCE_DPI / 72.0;
 	delete popplerPage;
-	renderMutex.unlock();
 
-	if (!image.isNull()) {
-		return QPixmap::fromImage(image);
-	} else {
+	if (rendered.image.isNull()) {
 		qDebug() << "Error rendering PDF page to image!";
-		return QPixmap();
+		return false;
+	}
+
+	QMutexLocker cacheLocker(&cacheMutex);
+	int cost = std::max(1, rendered.image.bytesPerLine() * rendered.image.height() / 1024);
+	m_renderCache.insert(key, new PDFPreviewPage(rendered), cost);
+
+	return true;
+}
+
+void PDFPreviewImageProvider::prerenderPages(QString filePath, unsigned int page, QSize requestedSize) {
+	std::string filePathStd = filePath.toStdString();
+	PDFPreviewPage rendered;
+
+	for (unsigned int i = 1; i <= PDF_PREVIEW_PRERENDER_PAGES; i++) {
+		renderPDFPage(filePathStd, page + i, requestedSize, rendered, true);
+		if (page > i)
+			renderPDFPage(filePathStd, page - i, requestedSize, rendered, true);
 	}
 }
 
@@ -2333,6 +2406,7 @@ void PDFPreviewImageProvider::doCloseDoc(QString filePath) {
 		delete m_docs.at(filePathStd);
 		m_docs.erase(filePathStd);
 	}
+	removeCachedPages(filePathStd);
 	renderMutex.unlock();
 }
 void PDFPreviewImageProvider::doCloseAllDocs() {
@@ -2343,6 +2417,9 @@ void PDFPreviewImageProvider::doCloseAllDocs() {
 		it++;
 	}
 	m_docs.clear();
+	cacheMutex.lock();
+	m_renderCache.clear();
+	cacheMutex.unlock();
 	renderMutex.unlock();
 }
 
@@ -3008,6 +3085,10 @@ int GAPI::getReaderIndex(void) {
 
 void GAPI::finishLoadingCardData(PTEID_EIDCard *card) {
 	card->doSODCheck(true); // Enable SOD checking
+	// Read what's shown below in one card transaction
+	PTEID_CardLoadStats loadStats = card->loadFiles(PTEID_LOAD_FILE_ID | PTEID_LOAD_FILE_PHOTO | PTEID_LOAD_FILE_SOD);
+	PTEID_LOG(PTEID_LOG_LEVEL_DEBUG, "eidgui", "Card files loaded in %.3f s with %lu APDUs", loadStats.elapsedSeconds,
+			  loadStats.apdus);
 	PTEID_EId &eid_file = card->getID();
 
 	qDebug() << "C++: loading Card Data";
@@ -20,6 +20,7 @@
 #include <QDebug>
 #include <QtQml>
 #include <QPixmap>
+#include <QCache>
 
 /*
 	We are not interested in these warnings due to being an external library
@@ -192,14 +193,29 @@ struct WindowGeometry {
 	int height;
 };
 
+// Resolution of the page width reported by signalPdfSourceChanged, the QML preview scales the seal with it
+#define PDF_PREVIEW_REFERENCE_DPI 300.0
+// Memory used by the rendered pages kept in the preview cache, in KB
+#define PDF_PREVIEW_CACHE_MAX_KB (64 * 1024)
+// Pages before and after the one in preview that are rendered in the background
+#define PDF_PREVIEW_PRERENDER_PAGES 1
+
+struct PDFPreviewPage {
+	QImage image;
+	double referenceWidth; // page width in pixels at PDF_PREVIEW_REFERENCE_DPI
+};
+
+/* Rendered pages are kept in an LRU cache keyed by (document, page, requested size) and are rendered directly at
+   the requested size. The image type provider lets QML load them asynchronously, outside the GUI thread. */
 class PDFPreviewImageProvider : public QObject, public QQuickImageProvider {
 	Q_OBJECT
 public:
-	PDFPreviewImageProvider() : QQuickImageProvider(QQuickImageProvider::Pixmap) {}
+	PDFPreviewImageProvider()
+		: QQuickImageProvider(QQuickImageProvider::Image), m_renderCache(PDF_PREVIEW_CACHE_MAX_KB) {}
 
-	QPixmap requestPixmap(const QString &id, QSize *size, const QSize &requestedSize);
-	// Returns page size in postscript points
-	QSize getPageSize(int page);
+	QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
+	// Returns page size in postscript points, the document must be open in the preview
+	QSize getPageSize(QString filePath, int page);
 
 	void closeDoc(QString filePath);
 	void closeAllDocs();
@@ -209,12 +225,18 @@ signals:
 private:
 	void doCloseDoc(QString filePath);
 	void doCloseAllDocs();
-	QPixmap renderPDFPage(unsigned int page);
+	void prerenderPages(QString filePath, unsigned int page, QSize requestedSize);
+	// If prerender is true only documents already open are rendered
+	bool renderPDFPage(const std::string &filePath, unsigned int page, const QSize &requestedSize,
+					   PDFPreviewPage &rendered, bool prerender = false);
+	bool getCachedPage(const QString &key, PDFPreviewPage &rendered);
+	void removeCachedPages(const std::string &filePath);
+	static QString cacheKey(const std::string &filePath, unsigned int page, const QSize &requestedSize);
+
 	std::unordered_map<std::string, Poppler::Document *> m_docs; // all loaded pdfs (remain open)
-	std::string m_filePath;										 // file in preview
-	QString m_file_id;											 // file and page in preview
-	QMutex renderMutex;
-	QPixmap m_cache;
+	QMutex renderMutex;											 // protects m_docs and rendering
+	QMutex cacheMutex;
+	QCache<QString, PDFPreviewPage> m_renderCache; // cost in KB
 };
 
 const QString MAIN_QML_PATH("qrc:/main.qml");
@@ -500,7 +522,7 @@ public slots:
 	QString getSCAPProviderLogo(QList<QString> qstring_ids);
 
 	// Returns page size in postscript points
-	QSize getPageSize(int page) { return image_provider_pdf->getPageSize(page); };
+	QSize getPageSize(QString filePath, int page) { return image_provider_pdf->getPageSize(filePath, page); };
 	void verifyAuthPin(QString pin);
 	void getTriesLeftAuthPin();
 	void verifySignPin(QString pin);
@@ -936,6 +936,9 @@ class APL_EIDCard;
 class PTEID_XmlUserRequestedInfo;
 class PTEID_CCXML_Doc;
 class PDFSignature;
+class PAdESBatchExtender;
+class SignatureVerifier;
+struct APL_SignSessionReport;
 
 /**
  * Helper class to deal with ASIC signature containers used by pteid-mw to deliver XAdES signatures
@@ -1037,6 +1040,123 @@ private:
 	friend class PTEID_Card;
 };
 
+/**
+ * Upgrade the signatures of already signed PDF documents to PAdES-LT (PTEID_LEVEL_LT) or PAdES-LTA
+ * (PTEID_LEVEL_LTV) without signing them again, e.g. to refresh an archive before its timestamps expire.
+ *
+ * The documents are processed in parallel by a pool of worker threads. The OCSP responses and CRLs added to the
+ * documents are kept in an on-disk cache until their nextUpdate time, so they are only fetched once for the whole
+ * batch and reused by later batches. Internet connection is required for the data that is not in the cache and for
+ * the document timestamps of PAdES-LTA.
+ * @since 3.13.0
+ */
+class PTEID_PDFLtvExtender {
+public:
+	/**
+	 * @param level PTEID_LEVEL_LT or PTEID_LEVEL_LTV
+	 * @param workers number of documents processed at the same time
+	 **/
+	PTEIDSDK_API PTEID_PDFLtvExtender(PTEID_SignatureLevel level, unsigned int workers = 4);
+	PTEIDSDK_API ~PTEID_PDFLtvExtender();
+
+	PTEIDSDK_API void addFile(const char *input_path);
+	/**
+	 * Add the PDF files found in a directory and its subdirectories.
+	 * @return number of files added
+	 **/
+	PTEIDSDK_API unsigned long addDirectory(const char *dir_path);
+	/**
+	 * Write the upgraded documents to this directory. By default the input files are overwritten.
+	 **/
+	PTEIDSDK_API void setOutputDirectory(const char *output_dir);
+	/**
+	 * Directory of the OCSP response and CRL cache. By default it's a subdirectory of the PTEID_PARAM_GENERAL_CACHEDIR
+	 **/
+	PTEIDSDK_API void setCacheDirectory(const char *cache_dir);
+
+	/**
+	 * Upgrade all the documents added.
+	 * @return number of documents that failed, see getFailedFile()
+	 **/
+	PTEIDSDK_API unsigned long extend();
+
+	PTEIDSDK_API const char *getFailedFile(unsigned long index);
+	/** Throughput of the last extend() call */
+	PTEIDSDK_API double getDocumentsPerSecond();
+	PTEIDSDK_API double getElapsedSeconds();
+
+private:
+	PTEID_PDFLtvExtender(const PTEID_PDFLtvExtender &);
+	PTEID_PDFLtvExtender &operator=(const PTEID_PDFLtvExtender &);
+
+	PAdESBatchExtender *mp_extender;
+};
+
+/**
+ * Verify the signatures of PDF documents (PAdES, including document timestamps) and ASiC-E containers (XAdES).
+ *
+ * For each signature the digest of the signed data, the signature value and the certificate chain of the signer are
+ * checked. The signed data is hashed straight from the files, so large documents aren't loaded in memory.
+ * Documents added with addFile() or addDirectory() are verified in parallel by a pool of worker threads.
+ * Internet connection is only required if revocation checking is enabled.
+ * @since 3.13.0
+ */
+class PTEID_SignatureVerifier {
+public:
+	/**
+	 * @param checkRevocation also check the OCSP status of the signer certificates
+	 * @param workers number of documents verified at the same time
+	 **/
+	PTEIDSDK_API PTEID_SignatureVerifier(bool checkRevocation = false, unsigned int workers = 4);
+	PTEIDSDK_API ~PTEID_SignatureVerifier();
+
+	PTEIDSDK_API void addFile(const char *input_path);
+	/**
+	 * Add the PDF and ASiC-E files found in a directory and its subdirectories.
+	 * @return number of files added
+	 **/
+	PTEIDSDK_API unsigned long addDirectory(const char *dir_path);
+
+	/**
+	 * Verify all the documents added.
+	 * @return number of documents that are not valid
+	 **/
+	PTEIDSDK_API unsigned long verify();
+	/**
+	 * Same as verify() but callback is called as soon as each document is verified, with its index in the order
+	 * the documents were added. The callback is called from the worker threads, one call at a time, and the
+	 * results of that document can be read with the accessors below from inside the callback.
+	 **/
+	PTEIDSDK_API unsigned long verify(void (*callback)(unsigned long index, void *context), void *context);
+
+	PTEIDSDK_API unsigned long countDocuments();
+	PTEIDSDK_API const char *getDocument(unsigned long index);
+	/** The document has signatures, all of them are PTEID_SIGVERIFY_VALID and they cover all of it */
+	PTEIDSDK_API bool isValid(unsigned long index);
+	/** Files of an ASiC container that none of its signatures covers */
+	PTEIDSDK_API unsigned long countUnsignedFiles(unsigned long index);
+	PTEIDSDK_API const char *getUnsignedFile(unsigned long index, unsigned long file);
+	/** A PDF revision after the last signature changes more than its validation data (DSS) */
+	PTEIDSDK_API bool hasUncoveredChanges(unsigned long index);
+	PTEIDSDK_API unsigned long countSignatures(unsigned long index);
+	PTEIDSDK_API PTEID_SignatureVerifyStatus getSignatureStatus(unsigned long index, unsigned long signature);
+	PTEIDSDK_API const char *getSignerName(unsigned long index, unsigned long signature);
+	/** Signing time claimed by the signer, or time of the document timestamp */
+	PTEIDSDK_API const char *getSigningTime(unsigned long index, unsigned long signature);
+	/** Time spent in one stage of the verification of a document, in milliseconds */
+	PTEIDSDK_API double getStageMilliseconds(unsigned long index, PTEID_SignatureVerifyStage stage);
+
+	/** Throughput of the last verify() call */
+	PTEIDSDK_API double getDocumentsPerSecond();
+	PTEIDSDK_API double getElapsedSeconds();
+
+private:
+	PTEID_SignatureVerifier(const PTEID_SignatureVerifier &);
+	PTEID_SignatureVerifier &operator=(const PTEID_SignatureVerifier &);
+
+	SignatureVerifier *mp_verifier;
+};
+
 class SecurityContext;
 
 class SSLConnection;
@@ -1045,6 +1165,16 @@ class SSLConnection;
  * This class represents a Portugal EID card.
  * To get such an object you have to ask it from the ReaderContext.
  */
+/** Result of PTEID_EIDCard::loadFiles() */
+struct PTEID_CardLoadStats {
+	unsigned long filesRead;		 /**< Files read from the card */
+	unsigned long filesFailed;		 /**< Files that couldn't be read */
+	unsigned long apdus;			 /**< APDUs sent to the card */
+	unsigned long selectsSkipped;	 /**< SELECT commands avoided because the application or file was selected */
+	unsigned long transactionsSaved; /**< Card transactions avoided by keeping the card locked */
+	double elapsedSeconds;
+};
+
 class PTEID_EIDCard : public PTEID_SmartCard {
 public:
 	PTEIDSDK_API virtual ~PTEID_EIDCard(); /**< Destructor */
@@ -1064,6 +1194,16 @@ public:
 	/** Enable/disable the verification of ID and address data against the SOD file */
 	PTEIDSDK_API void doSODCheck(bool check);
 
+	/**
+	 * Read the files in one card transaction, selecting each card application and file only once. getID(),
+	 * getSod(), getCertificates()... then use the files read without accessing the card. A file that can't be read
+	 * is left out, the method that uses it reports the error.
+	 * @param files PTEID_CardLoadFile flags
+	 * @return statistics of the card accesses
+	 * @since 3.13.0
+	 */
+	PTEIDSDK_API PTEID_CardLoadStats loadFiles(unsigned long files = PTEID_LOAD_FILE_ALL);
+
 #if !defined SWIG
 	PTEIDSDK_API SSLConnection *buildSSLConnection();
 
@@ -1089,6 +1229,39 @@ private:
 	friend PTEID_Card & PTEID_ReaderContext::getCard(); /**< For internal use : This method must access protected constructor */
 	friend PTEIDSDK_API long ::PTEID_CVC_Init(const unsigned char *pucCert, int iCertLen, unsigned char *pucChallenge,
 											  int iChallengeLen);
+	friend class PTEID_SignSession; /**< For internal use : access to the card implementation */
+};
+
+/**
+ * Sign session for high-volume signing with the citizen card.
+ *
+ * While the session is open the card is kept locked and the signature PIN is only asked for the first signature.
+ * The following signatures, made with any of the signing methods of the PTEID_EIDCard, reuse the PIN verification
+ * and the security environment left in the card by the previous one. Other applications can't use the card
+ * until the session ends, with end() or when the object is destroyed.
+ * @since 3.13.0
+ */
+class PTEID_SignSession {
+public:
+	PTEIDSDK_API PTEID_SignSession(PTEID_EIDCard &card);
+	PTEIDSDK_API ~PTEID_SignSession();
+
+	PTEIDSDK_API void end();
+
+	/** Statistics of the session, available after end() */
+	PTEIDSDK_API unsigned long getSignatureCount();
+	/** Number of MSE SET and PIN VERIFY commands that the session avoided sending to the card */
+	PTEIDSDK_API unsigned long getSkippedCommands();
+	PTEIDSDK_API double getSignaturesPerSecond();
+	PTEIDSDK_API double getElapsedSeconds();
+
+private:
+	PTEID_SignSession(const PTEID_SignSession &);
+	PTEID_SignSession &operator=(const PTEID_SignSession &);
+
+	APL_EIDCard *mp_card;
+	APL_SignSessionReport *mp_report;
+	bool m_active;
 };
 
 /**
@@ -1353,6 +1526,13 @@ public:
 	PTEIDSDK_API const char *getMRZ3();					 /**< Return field MRZ block 3 */
 	PTEIDSDK_API const char *getAccidentalIndications(); /**< Return field AccidentalIndications */
 
+	/**
+	 * Return all the text fields of the ID file as one JSON object, read in a single pass.
+	 * The returned string is valid until the next call.
+	 * @since 3.13.0
+	 */
+	PTEIDSDK_API const char *exportJson();
+
 private:
 	PTEID_EId(const PTEID_EId &doc);			/**< Copy not allowed - not implemented */
 	PTEID_EId &operator=(const PTEID_EId &doc); /**< Copy not allowed - not implemented */
@@ -41,6 +41,8 @@
 #include "CardPteid.h"
 #include "SSLConnection.h"
 #include "PDFSignature.h"
+#include "PAdESBatchExtender.h"
+#include "SignatureVerifier.h"
 #include "SecurityContext.h"
 #include "dialogs.h"
 #include "Util.h"
@@ -368,6 +370,174 @@ char *PTEID_PDFSignature::getCertificateCitizenName() { return mp_signature->get
 
 char *PTEID_PDFSignature::getCertificateCitizenID() { return mp_signature->getCitizenCertificateID(); }
 
+PTEID_PDFLtvExtender::PTEID_PDFLtvExtender(PTEID_SignatureLevel level, unsigned int workers) {
+	if (level != PTEID_LEVEL_LT && level != PTEID_LEVEL_LTV)
+		throw PTEID_ExParamRange();
+
+	mp_extender = new PAdESBatchExtender(ConvertSignatureLevel(level), workers);
+}
+
+PTEID_PDFLtvExtender::~PTEID_PDFLtvExtender() { delete mp_extender; }
+
+void PTEID_PDFLtvExtender::addFile(const char *input_path) { mp_extender->addFile(input_path); }
+
+unsigned long PTEID_PDFLtvExtender::addDirectory(const char *dir_path) {
+	return (unsigned long)mp_extender->addDirectory(dir_path);
+}
+
+void PTEID_PDFLtvExtender::setOutputDirectory(const char *output_dir) { mp_extender->setOutputDirectory(output_dir); }
+
+void PTEID_PDFLtvExtender::setCacheDirectory(const char *cache_dir) { mp_extender->setCacheDirectory(cache_dir); }
+
+unsigned long PTEID_PDFLtvExtender::extend() {
+	try {
+		return (unsigned long)mp_extender->extend();
+	} catch (CMWException &e) {
+		throw PTEID_Exception::THROWException(e);
+	}
+}
+
+const char *PTEID_PDFLtvExtender::getFailedFile(unsigned long index) {
+	if (index >= mp_extender->getFailedFiles().size())
+		throw PTEID_ExParamRange();
+
+	return mp_extender->getFailedFiles()[index].c_str();
+}
+
+double PTEID_PDFLtvExtender::getDocumentsPerSecond() { return mp_extender->getReport().documentsPerSecond; }
+
+double PTEID_PDFLtvExtender::getElapsedSeconds() { return mp_extender->getReport().elapsedSeconds; }
+
+static PTEID_SignatureVerifyStatus ConvertSignatureVerifyStatus(APL_SignatureVerifyStatus status) {
+	switch (status) {
+	case SIGVERIFY_VALID:
+		return PTEID_SIGVERIFY_VALID;
+	case SIGVERIFY_INVALID_DIGEST:
+		return PTEID_SIGVERIFY_INVALID_DIGEST;
+	case SIGVERIFY_INVALID_SIGNATURE:
+		return PTEID_SIGVERIFY_INVALID_SIGNATURE;
+	case SIGVERIFY_UNTRUSTED_CHAIN:
+		return PTEID_SIGVERIFY_UNTRUSTED_CHAIN;
+	case SIGVERIFY_REVOKED:
+		return PTEID_SIGVERIFY_REVOKED;
+	case SIGVERIFY_REVOCATION_UNKNOWN:
+		return PTEID_SIGVERIFY_REVOCATION_UNKNOWN;
+	default:
+		return PTEID_SIGVERIFY_ERROR;
+	}
+}
+
+PTEID_SignatureVerifier::PTEID_SignatureVerifier(bool checkRevocation, unsigned int workers) {
+	mp_verifier = new SignatureVerifier(checkRevocation, workers);
+}
+
+PTEID_SignatureVerifier::~PTEID_SignatureVerifier() { delete mp_verifier; }
+
+void PTEID_SignatureVerifier::addFile(const char *input_path) { mp_verifier->addFile(input_path); }
+
+unsigned long PTEID_SignatureVerifier::addDirectory(const char *dir_path) {
+	return (unsigned long)mp_verifier->addDirectory(dir_path);
+}
+
+unsigned long PTEID_SignatureVerifier::verify() {
+	try {
+		return (unsigned long)mp_verifier->verifyAll();
+	} catch (CMWException &e) {
+		throw PTEID_Exception::THROWException(e);
+	}
+}
+
+unsigned long PTEID_SignatureVerifier::verify(void (*callback)(unsigned long index, void *context), void *context) {
+	if (callback == NULL)
+		throw PTEID_ExParamRange();
+
+	try {
+		return (unsigned long)mp_verifier->verifyAll(
+			[callback, context](size_t index, const DocumentVerifyReport &) { callback((unsigned long)index, context); });
+	} catch (CMWException &e) {
+		throw PTEID_Exception::THROWException(e);
+	}
+}
+
+unsigned long PTEID_SignatureVerifier::countDocuments() { return (unsigned long)mp_verifier->getReports().size(); }
+
+static const DocumentVerifyReport &getVerifyReport(SignatureVerifier *verifier, unsigned long index) {
+	if (index >= verifier->getReports().size())
+		throw PTEID_ExParamRange();
+
+	return verifier->getReports()[index];
+}
+
+static const SignatureVerifyResult &getVerifyResult(SignatureVerifier *verifier, unsigned long index,
+													unsigned long signature) {
+	const DocumentVerifyReport &report = getVerifyReport(verifier, index);
+	if (signature >= report.signatures.size())
+		throw PTEID_ExParamRange();
+
+	return report.signatures[signature];
+}
+
+const char *PTEID_SignatureVerifier::getDocument(unsigned long index) {
+	return getVerifyReport(mp_verifier, index).path.c_str();
+}
+
+bool PTEID_SignatureVerifier::isValid(unsigned long index) { return getVerifyReport(mp_verifier, index).valid; }
+
+unsigned long PTEID_SignatureVerifier::countUnsignedFiles(unsigned long index) {
+	return (unsigned long)getVerifyReport(mp_verifier, index).unsignedFiles.size();
+}
+
+const char *PTEID_SignatureVerifier::getUnsignedFile(unsigned long index, unsigned long file) {
+	const DocumentVerifyReport &report = getVerifyReport(mp_verifier, index);
+	if (file >= report.unsignedFiles.size())
+		throw PTEID_ExParamRange();
+
+	return report.unsignedFiles[file].c_str();
+}
+
+bool PTEID_SignatureVerifier::hasUncoveredChanges(unsigned long index) {
+	return getVerifyReport(mp_verifier, index).uncoveredChanges;
+}
+
+unsigned long PTEID_SignatureVerifier::countSignatures(unsigned long index) {
+	return (unsigned long)getVerifyReport(mp_verifier, index).signatures.size();
+}
+
+PTEID_SignatureVerifyStatus PTEID_SignatureVerifier::getSignatureStatus(unsigned long index, unsigned long signature) {
+	return ConvertSignatureVerifyStatus(getVerifyResult(mp_verifier, index, signature).status);
+}
+
+const char *PTEID_SignatureVerifier::getSignerName(unsigned long index, unsigned long signature) {
+	return getVerifyResult(mp_verifier, index, signature).signerName.c_str();
+}
+
+const char *PTEID_SignatureVerifier::getSigningTime(unsigned long index, unsigned long signature) {
+	return getVerifyResult(mp_verifier, index, signature).signingTime.c_str();
+}
+
+double PTEID_SignatureVerifier::getStageMilliseconds(unsigned long index, PTEID_SignatureVerifyStage stage) {
+	const DocumentVerifyReport &report = getVerifyReport(mp_verifier, index);
+	switch (stage) {
+	case PTEID_SIGVERIFY_STAGE_PARSE:
+		return report.parseMs;
+	case PTEID_SIGVERIFY_STAGE_HASH:
+		return report.hashMs;
+	case PTEID_SIGVERIFY_STAGE_SIGNATURE:
+		return report.signatureMs;
+	case PTEID_SIGVERIFY_STAGE_CERTIFICATE:
+		return report.certificateMs;
+	default:
+		return report.totalMs;
+	}
+}
+
+double PTEID_SignatureVerifier::getDocumentsPerSecond() {
+	double elapsed = mp_verifier->getElapsedSeconds();
+	return elapsed > 0 ? mp_verifier->getReports().size() / elapsed : 0;
+}
+
+double PTEID_SignatureVerifier::getElapsedSeconds() { return mp_verifier->getElapsedSeconds(); }
+
 bool PTEID_SmartCard::writeFile(const char *fileID, const PTEID_ByteArray &baOut, PTEID_Pin *pin, const char *csPinCode,
 								unsigned long ulOffset) {
 	bool out = false;
@@ -665,6 +835,27 @@ void PTEID_EIDCard::doSODCheck(bool check) {
 	END_TRY_CATCH
 }
 
+PTEID_CardLoadStats PTEID_EIDCard::loadFiles(unsigned long files) {
+	PTEID_CardLoadStats stats = {};
+
+	BEGIN_TRY_CATCH
+
+	APL_EIDCard *pcard = static_cast<APL_EIDCard *>(m_impl);
+	APL_CardLoadReport report;
+	pcard->loadFiles(files, report);
+
+	stats.filesRead = (unsigned long)report.files.size();
+	stats.filesFailed = report.filesFailed;
+	stats.apdus = report.apdus;
+	stats.selectsSkipped = report.selectsSkipped;
+	stats.transactionsSaved = report.transactionsSaved;
+	stats.elapsedSeconds = report.elapsedMs / 1000.0;
+
+	END_TRY_CATCH
+
+	return stats;
+}
+
 bool PTEID_EIDCard::Activate(const char *pinCode, PTEID_ByteArray &BCDDate, bool blockActivationPIN) {
 	bool out = false;
 	CByteArray cBCDDate = CByteArray(BCDDate.GetBytes(), BCDDate.Size());
@@ -750,6 +941,51 @@ const char *PTEID_EIDCard::readPersonalNotes() {
 	return out;
 }
 
+/*****************************************************************************************
+------------------------------------ PTEID_SignSession -----------------------------------
+*****************************************************************************************/
+PTEID_SignSession::PTEID_SignSession(PTEID_EIDCard &card)
+	: mp_card(static_cast<APL_EIDCard *>(card.m_impl)), mp_report(new APL_SignSessionReport()), m_active(false) {
+	try {
+		mp_card->beginSignSession();
+	} catch (CMWException &e) {
+		delete mp_report;
+		throw PTEID_Exception::THROWException(e);
+	}
+	m_active = true;
+}
+
+PTEID_SignSession::~PTEID_SignSession() {
+	try {
+		end();
+	} catch (...) {
+		// The card may have been removed, its session ended with it
+	}
+	delete mp_report;
+}
+
+void PTEID_SignSession::end() {
+	if (!m_active)
+		return;
+
+	m_active = false;
+	try {
+		mp_card->endSignSession(*mp_report);
+	} catch (CMWException &e) {
+		throw PTEID_Exception::THROWException(e);
+	}
+}
+
+unsigned long PTEID_SignSession::getSignatureCount() { return mp_report->signatures; }
+
+unsigned long PTEID_SignSession::getSkippedCommands() {
+	return mp_report->securityEnvsSkipped + mp_report->pinVerifiesSkipped;
+}
+
+double PTEID_SignSession::getSignaturesPerSecond() { return mp_report->signaturesPerSecond; }
+
+double PTEID_SignSession::getElapsedSeconds() { return mp_report->elapsedMs / 1000.0; }
+
 /*****************************************************************************************
 ----------------------------- PTEID_XmlUserRequestedInfo ---------------------------------
 *****************************************************************************************/
@@ -1482,6 +1718,9 @@ PTEIDSDK_API long PTEID_CVC_Init(const unsigned char *pucCert, int iCertLen, uns
 
 			// Accessing PTEID_EIDCard internal object, hope he doesn't mind :)
 			APL_Card *card_impl = static_cast<APL_Card *>(card.m_impl);
+
+			// A new authentication replaces the previous secure channel, if any
+			delete securityContext;
 			securityContext = new SecurityContext(card_impl);
 
 			CByteArray cvc_certificate(pucCert, iCertLen);
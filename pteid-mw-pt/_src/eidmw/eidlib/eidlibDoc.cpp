@@ -1110,6 +1110,19 @@ const char *PTEID_EId::getAccidentalIndications() {
 	return out;
 }
 
+const char *PTEID_EId::exportJson() {
+	const char *out = NULL;
+
+	BEGIN_TRY_CATCH
+
+	APL_DocEId *pimpl = static_cast<APL_DocEId *>(m_impl);
+	out = pimpl->exportJson();
+
+	END_TRY_CATCH
+
+	return out;
+}
+
 const char *PTEID_EId::getCivilianIdNumber() {
 	const char *out = NULL;
 
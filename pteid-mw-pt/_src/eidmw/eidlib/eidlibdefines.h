@@ -94,6 +94,35 @@ enum PTEID_FileType { PTEID_FILETYPE_UNKNOWN = 0, PTEID_FILETYPE_TLV, PTEID_FILE
 
 enum PTEID_SignatureLevel { PTEID_LEVEL_BASIC, PTEID_LEVEL_TIMESTAMP, PTEID_LEVEL_LT, PTEID_LEVEL_LTV };
 
+/* Card files that PTEID_EIDCard::loadFiles() reads ahead */
+enum PTEID_CardLoadFile {
+	PTEID_LOAD_FILE_ID = 0x01,		  /**< ID file, and MRZ file of IAS5 cards */
+	PTEID_LOAD_FILE_PHOTO = 0x02,	  /**< Photo, part of the ID file on cards older than IAS5 */
+	PTEID_LOAD_FILE_SOD = 0x04,		  /**< SOD file */
+	PTEID_LOAD_FILE_CERTS = 0x08,	  /**< Certificates of the card */
+	PTEID_LOAD_FILE_TRACE = 0x10,	  /**< Trace file */
+	PTEID_LOAD_FILE_TOKENINFO = 0x20, /**< PKCS15 TokenInfo file */
+	PTEID_LOAD_FILE_ALL = 0x3F
+};
+
+enum PTEID_SignatureVerifyStatus {
+	PTEID_SIGVERIFY_VALID,				/**< Digest and signature match and the signer certificate is trusted */
+	PTEID_SIGVERIFY_INVALID_DIGEST,		/**< The signed data was modified after signing or isn't all covered by it */
+	PTEID_SIGVERIFY_INVALID_SIGNATURE,	/**< The signature value doesn't match the signer certificate */
+	PTEID_SIGVERIFY_UNTRUSTED_CHAIN,	/**< The signer certificate doesn't chain to a trusted root */
+	PTEID_SIGVERIFY_REVOKED,			/**< The signer certificate is revoked or suspended */
+	PTEID_SIGVERIFY_REVOCATION_UNKNOWN, /**< The revocation status of the signer certificate is unknown */
+	PTEID_SIGVERIFY_ERROR				/**< Malformed or unsupported signature */
+};
+
+enum PTEID_SignatureVerifyStage {
+	PTEID_SIGVERIFY_STAGE_PARSE,	   /**< Loading the document and extracting the signatures */
+	PTEID_SIGVERIFY_STAGE_HASH,		   /**< Hashing the signed data */
+	PTEID_SIGVERIFY_STAGE_SIGNATURE,   /**< Verifying the signature values */
+	PTEID_SIGVERIFY_STAGE_CERTIFICATE, /**< Checking the signer certificates */
+	PTEID_SIGVERIFY_STAGE_TOTAL
+};
+
 /**
 	Enumeration that includes all the configuration values of pteid-mw
 	They are grouped in different sections: general, logging, certcache, proxy, guitool, xsign
@@ -0,0 +1,25 @@
+######################################################################
+# Throughput benchmark of the CHash backends, not part of the default build
+######################################################################
+
+include(../_Builds/eidcommon.mak)
+
+TEMPLATE = app
+TARGET = hash_benchmark
+
+message("Compile $$TARGET")
+
+CONFIG -= qt
+CONFIG += c++11 console
+
+DESTDIR = .
+
+DEPENDPATH += .
+INCLUDEPATH += . ../common
+
+macx: LIBS += -L$$DEPS_DIR/openssl-3/lib/
+!macx: LIBS += -Wl,-R,'../lib'
+
+LIBS += -L../lib -l$${COMMONLIB} -lcrypto
+
+SOURCES += main.cpp
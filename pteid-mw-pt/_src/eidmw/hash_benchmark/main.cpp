@@ -0,0 +1,85 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+/*
+ * hash_benchmark: throughput of the CHash backends for each algorithm
+ *
+ * Usage: hash_benchmark [size_in_MB]
+ */
+
+#include "Hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+using namespace eIDMW;
+
+typedef std::chrono::steady_clock Clock;
+
+static const struct {
+	tHashAlgo algo;
+	const char *name;
+} algorithms[] = {{ALGO_SHA1, "SHA1"}, {ALGO_SHA256, "SHA256"}, {ALGO_SHA384, "SHA384"}, {ALGO_SHA512, "SHA512"}};
+
+static const struct {
+	tHashBackend backend;
+	const char *name;
+} backends[] = {{HASH_BACKEND_OPENSSL, "openssl"}, {HASH_BACKEND_PORTABLE, "libtomcrypt"}};
+
+static double elapsedSeconds(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+	unsigned long ulSizeMB = argc > 1 ? strtoul(argv[1], NULL, 10) : 64;
+	if (ulSizeMB == 0) {
+		fprintf(stderr, "Usage: %s [size_in_MB]\n", argv[0]);
+		return 2;
+	}
+
+	// Hashed in 1 MB updates, like a large document read in blocks
+	const unsigned long ulBlockSize = 1024 * 1024;
+	CByteArray block(ulBlockSize);
+	for (unsigned long i = 0; i < ulBlockSize; i++)
+		block.Append((unsigned char)(i * 31 + 7));
+
+	// Many small inputs, like the references of a XAdES signature
+	std::vector<CByteArray> inputs(4096, CByteArray(block.GetBytes(), 1024));
+
+	int ret = 0;
+	printf("%-8s %-12s %12s %16s\n", "algo", "backend", "MB/s", "1 KB inputs/s");
+	for (const auto &algorithm : algorithms) {
+		CByteArray reference;
+		for (const auto &backend : backends) {
+			CHash oHash(backend.backend);
+			Clock::time_point start = Clock::now();
+			oHash.Init(algorithm.algo);
+			for (unsigned long i = 0; i < ulSizeMB; i++)
+				oHash.Update(block);
+			CByteArray hash = oHash.GetHash();
+			double seconds = elapsedSeconds(start);
+
+			start = Clock::now();
+			std::vector<CByteArray> hashes = CHash::HashAll(algorithm.algo, inputs, backend.backend);
+			double batchSeconds = elapsedSeconds(start);
+
+			printf("%-8s %-12s %12.1f %16.0f\n", algorithm.name, backend.name, ulSizeMB / seconds,
+				   hashes.size() / batchSeconds);
+
+			if (reference.Size() == 0) {
+				reference = hash;
+			} else if (!reference.Equals(hash)) {
+				fprintf(stderr, "%s: the backends give different hashes\n", algorithm.name);
+				ret = 1;
+			}
+		}
+	}
+
+	return ret;
+}
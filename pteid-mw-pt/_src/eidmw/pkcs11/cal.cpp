@@ -54,6 +54,20 @@ int cal_translate_error(const char *WHERE, long err);
 int cal_map_status(tCardStatus calstatus);
 }
 
+/* End the sign session of pkcs11_sign_session once it's idle: it keeps the card locked and the PIN verified */
+#define WHERE "cal_end_idle_sign_session()"
+static void cal_end_idle_sign_session(P11_SLOT *pSlot, CReader &oReader) {
+	if (!oReader.IsSignSession())
+		return;
+
+	long lTimeout = CConfig::GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PKCS11_SIGN_SESSION);
+	if (time(NULL) - pSlot->sign_session_used >= lTimeout) {
+		log_trace(WHERE, "I: ending the sign session idle for %ld s", (long)(time(NULL) - pSlot->sign_session_used));
+		oReader.EndSignSession();
+	}
+}
+#undef WHERE
+
 #define WHERE "cal_init()"
 int cal_init() {
 	int ret = 0;
@@ -806,9 +820,15 @@ int cal_logout(CK_SLOT_ID hSlot) {
 	}
 
 	std::string szReader = pSlot->name;
-	// CReader &oReader = oCardLayer->getReader(szReader);
 
-	/*TODO ??? oReader.*/
+	try {
+		CReader &oReader = oCardLayer->getReader(szReader);
+		// End the sign session started by cal_sign()
+		if (oReader.IsSignSession())
+			oReader.EndSignSession();
+	} catch (CMWException &e) {
+		return (cal_translate_error(WHERE, e.GetError()));
+	}
 
 	return (ret);
 }
@@ -1188,7 +1208,14 @@ int cal_sign(CK_SLOT_ID hSlot, P11_SIGN_DATA *pSignData, unsigned char *in, unsi
 			algo = SIGN_ALGO_SHA256_RSA_PKCS;
 		}
 
+		// Private keys are CKA_ALWAYS_AUTHENTICATE=false: with pkcs11_sign_session the PIN is only asked for the
+		// first signature, the sign session lasts until it's idle for pkcs11_sign_session seconds or until logout
+		cal_end_idle_sign_session(pSlot, oReader);
+		if (CConfig::GetLong(CConfig::EIDMW_CONFIG_PARAM_GENERAL_PKCS11_SIGN_SESSION) > 0 && !oReader.IsSignSession())
+			oReader.BeginSignSession();
+
 		oDataOut = oReader.Sign(key, algo, oData);
+		pSlot->sign_session_used = time(NULL);
 	} catch (CMWException &e) {
 		return (cal_translate_error(WHERE, e.GetError()));
 	} catch (...) {
@@ -1279,6 +1306,10 @@ int cal_update_token(CK_SLOT_ID hSlot) {
 		CReader &oReader = oCardLayer->getReader(reader);
 		status = cal_map_status(oReader.Status(true));
 
+		// Checked here as most PKCS#11 calls validate their session, there's no timer ending an idle sign session
+		if (status == P11_CARD_STILL_PRESENT)
+			cal_end_idle_sign_session(pSlot, oReader);
+
 		if (status != P11_CARD_STILL_PRESENT) {
 			// clean objects
 			for (i = 1; i <= pSlot->nobjects; i++) {
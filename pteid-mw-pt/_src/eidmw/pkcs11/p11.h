@@ -27,6 +27,8 @@
 #include "pteid_p11.h"
 #include "util.h"
 
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -111,6 +113,7 @@ typedef struct P11_SLOT {
 	P11_OBJECT *pobjects;
 	unsigned int nobjects;
 	void *pReader; // CReader
+	time_t sign_session_used; // Last signature of the sign session, see cal_sign()
 } P11_SLOT;
 
 // pReader = &oReader;
@@ -87,9 +87,8 @@ cleanup:
 int hash_update(void *phashinfo, char *p, unsigned long l) {
 	int ret = CKR_OK;
 	CHash *oHash = (CHash *)phashinfo;
-	CByteArray data((unsigned char *)p, l);
 
-	oHash->Update(data);
+	oHash->Update((const unsigned char *)p, l);
 
 	return (ret);
 }
@@ -0,0 +1,172 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+/*
+ * pkcs7_benchmark: PKCS7 signatures assembled per second for batch PDF signing, building every signature from
+ * the certificates or cloning a PKCS7Template, in one or more threads
+ *
+ * Usage: pkcs7_benchmark [documents] [threads]
+ */
+
+#include "sign-pkcs7.h"
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace eIDMW;
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedSeconds(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static CByteArray toDER(X509 *cert) {
+	unsigned char *der = NULL;
+	int len = i2d_X509(cert, &der);
+	CByteArray result(der, len);
+	OPENSSL_free(der);
+	return result;
+}
+
+/* Certificate for key signed by issuer_key, self-signed if issuer is NULL */
+static X509 *makeCertificate(const char *name, EVP_PKEY *key, X509 *issuer, EVP_PKEY *issuer_key, long serial) {
+	X509 *cert = X509_new();
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 365 * 24 * 3600L);
+	X509_set_pubkey(cert, key);
+
+	X509_NAME *subject = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(subject, "C", MBSTRING_ASC, (const unsigned char *)"PT", -1, -1, 0);
+	X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC, (const unsigned char *)name, -1, -1, 0);
+	X509_set_issuer_name(cert, issuer != NULL ? X509_get_subject_name(issuer) : subject);
+
+	X509_sign(cert, issuer_key, EVP_sha256());
+	return cert;
+}
+
+struct Signer {
+	CByteArray certificate;
+	std::vector<CByteArray> ca_certificates;
+};
+
+/* A signer certificate issued by an intermediate and a root CA, like the ones of the citizen card */
+static Signer makeSigner() {
+	EVP_PKEY *root_key = EVP_EC_gen("P-256");
+	EVP_PKEY *ca_key = EVP_EC_gen("P-256");
+	EVP_PKEY *signer_key = EVP_EC_gen("P-256");
+
+	X509 *root = makeCertificate("Benchmark Root CA", root_key, NULL, root_key, 1);
+	X509 *ca = makeCertificate("Benchmark Signature CA", ca_key, root, root_key, 2);
+	X509 *signer = makeCertificate("Benchmark Signer", signer_key, ca, ca_key, 3);
+
+	Signer result;
+	result.certificate = toDER(signer);
+	result.ca_certificates.push_back(toDER(ca));
+	result.ca_certificates.push_back(toDER(root));
+
+	X509_free(signer);
+	X509_free(ca);
+	X509_free(root);
+	EVP_PKEY_free(signer_key);
+	EVP_PKEY_free(ca_key);
+	EVP_PKEY_free(root_key);
+	return result;
+}
+
+/* Hash the signed attributes and encode the signature with a fixed signature value, like signClose() */
+static std::string assemble(unsigned char *data, unsigned long dataLen, Signer &signer,
+							const PKCS7Template *pkcs7_template) {
+	PKCS7 *p7 = PKCS7_new();
+	PKCS7_SIGNER_INFO *signer_info = NULL;
+	CByteArray hash = pkcs7_template != NULL
+						  ? computeHash_pkcs7(data, dataLen, *pkcs7_template, p7, &signer_info)
+						  : computeHash_pkcs7(data, dataLen, signer.certificate, signer.ca_certificates, false, p7,
+											  &signer_info, NULL);
+
+	std::string result;
+	unsigned char signature[72] = {0x30, 0x46};
+	const char *signature_contents = NULL;
+	if (hash.Size() > 0 &&
+		getSignedData_pkcs7(signature, sizeof(signature), signer_info, false, p7, &signature_contents) == 0) {
+		result = signature_contents;
+	}
+
+	free((void *)signature_contents);
+	PKCS7_free(p7);
+	return result;
+}
+
+int main(int argc, char **argv) {
+	unsigned long documents = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+	unsigned long threads = argc > 2 ? strtoul(argv[2], NULL, 10) : std::thread::hardware_concurrency();
+	if (documents == 0 || threads == 0) {
+		fprintf(stderr, "Usage: %s [documents] [threads]\n", argv[0]);
+		return 2;
+	}
+
+	Signer signer = makeSigner();
+
+	// The ByteRange of a small PDF document
+	std::vector<unsigned char> data(64 * 1024);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (unsigned char)(i * 31 + 7);
+
+	PKCS7Template pkcs7_template(signer.certificate, signer.ca_certificates, NULL);
+
+	std::string reference = assemble(data.data(), data.size(), signer, NULL);
+	if (reference.empty() || assemble(data.data(), data.size(), signer, &pkcs7_template) != reference) {
+		fprintf(stderr, "The template gives a different signature\n");
+		return 1;
+	}
+
+	printf("%-24s %8s %14s\n", "assembly", "threads", "signatures/s");
+
+	Clock::time_point start = Clock::now();
+	for (unsigned long i = 0; i < documents; i++)
+		assemble(data.data(), data.size(), signer, NULL);
+	printf("%-24s %8d %14.0f\n", "per document", 1, documents / elapsedSeconds(start));
+
+	start = Clock::now();
+	for (unsigned long i = 0; i < documents; i++)
+		assemble(data.data(), data.size(), signer, &pkcs7_template);
+	printf("%-24s %8d %14.0f\n", "template", 1, documents / elapsedSeconds(start));
+
+	// Every thread clones the same template
+	std::vector<std::string> results(threads);
+	std::vector<std::thread> workers;
+	start = Clock::now();
+	for (unsigned long t = 0; t < threads; t++) {
+		workers.push_back(std::thread([&, t]() {
+			for (unsigned long i = t; i < documents; i += threads)
+				results[t] = assemble(data.data(), data.size(), signer, &pkcs7_template);
+		}));
+	}
+	for (std::thread &worker : workers)
+		worker.join();
+	printf("%-24s %8lu %14.0f\n", "template", threads, documents / elapsedSeconds(start));
+
+	for (const std::string &result : results) {
+		if (!result.empty() && result != reference) {
+			fprintf(stderr, "The threads give different signatures\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+/*
+ * pteid-ltv-extend: upgrade the signatures of already signed PDF documents to PAdES-LT or PAdES-LTA
+ *
+ * Usage: pteid-ltv-extend [-l lt|lta] [-j workers] [-o output_dir] [-c cache_dir] file_or_dir...
+ */
+
+#include "eidlib.h"
+#include "eidlibException.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+using namespace eIDMW;
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+			"Usage: %s [-l lt|lta] [-j workers] [-o output_dir] [-c cache_dir] file_or_dir...\n"
+			"  -l  target level, PAdES-LT or PAdES-LTA (default: lta)\n"
+			"  -j  number of documents processed at the same time (default: 4)\n"
+			"  -o  write the upgraded documents to output_dir instead of overwriting the input files\n"
+			"  -c  directory of the OCSP response and CRL cache\n"
+			"Directories are searched recursively for PDF files.\n",
+			prog);
+}
+
+static bool isDirectory(const char *path) {
+	struct stat buffer;
+	return stat(path, &buffer) == 0 && (buffer.st_mode & S_IFDIR) != 0;
+}
+
+int main(int argc, char **argv) {
+	PTEID_SignatureLevel level = PTEID_LEVEL_LTV;
+	unsigned int workers = 4;
+	const char *output_dir = NULL;
+	const char *cache_dir = NULL;
+	std::vector<const char *> inputs;
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-l") == 0 && hasValue) {
+			const char *value = argv[++i];
+			if (strcmp(value, "lt") == 0) {
+				level = PTEID_LEVEL_LT;
+			} else if (strcmp(value, "lta") == 0) {
+				level = PTEID_LEVEL_LTV;
+			} else {
+				usage(argv[0]);
+				return 2;
+			}
+		} else if (strcmp(argv[i], "-j") == 0 && hasValue) {
+			workers = (unsigned int)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-o") == 0 && hasValue) {
+			output_dir = argv[++i];
+		} else if (strcmp(argv[i], "-c") == 0 && hasValue) {
+			cache_dir = argv[++i];
+		} else if (argv[i][0] == '-') {
+			usage(argv[0]);
+			return 2;
+		} else {
+			inputs.push_back(argv[i]);
+		}
+	}
+
+	if (inputs.empty() || workers == 0) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	int ret = 0;
+	PTEID_InitSDK();
+
+	try {
+		PTEID_PDFLtvExtender extender(level, workers);
+		if (output_dir)
+			extender.setOutputDirectory(output_dir);
+		if (cache_dir)
+			extender.setCacheDirectory(cache_dir);
+
+		unsigned long documents = 0;
+		for (const char *input : inputs) {
+			if (isDirectory(input)) {
+				documents += extender.addDirectory(input);
+			} else {
+				extender.addFile(input);
+				documents++;
+			}
+		}
+
+		unsigned long failed = extender.extend();
+		for (unsigned long i = 0; i < failed; i++)
+			fprintf(stderr, "Failed: %s\n", extender.getFailedFile(i));
+
+		printf("%lu documents, %lu failed in %.1f s (%.2f documents/s)\n", documents, failed,
+			   extender.getElapsedSeconds(), extender.getDocumentsPerSecond());
+
+		ret = failed == 0 ? 0 : 1;
+	} catch (PTEID_Exception &e) {
+		fprintf(stderr, "Error: %s (0x%08lx)\n", e.GetMessage(), e.GetError());
+		ret = 1;
+	}
+
+	PTEID_ReleaseSDK();
+	return ret;
+}
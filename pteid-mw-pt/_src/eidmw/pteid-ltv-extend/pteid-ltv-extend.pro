@@ -0,0 +1,34 @@
+######################################################################
+# Command line tool to upgrade signed PDF documents to PAdES-LT/LTA
+######################################################################
+
+include(../_Builds/eidcommon.mak)
+
+TEMPLATE = app
+TARGET = pteid-ltv-extend
+
+message("Compile $$TARGET")
+
+###
+### Installation setup
+###
+target.path = $${INSTALL_DIR_BIN}
+INSTALLS += target
+
+CONFIG -= qt
+CONFIG += c++11 console
+
+DESTDIR = ../bin
+
+DEPENDPATH += .
+INCLUDEPATH += . ../eidlib ../common
+
+macx: LIBS += -L$$DEPS_DIR/openssl-3/lib/
+unix:!macx: LIBS += -Wl,-rpath-link,../lib
+
+LIBS += -L../lib -l$${EIDLIB} -l$${APPLAYERLIB} -l$${CARDLAYERLIB} -l$${COMMONLIB}
+LIBS += -lpthread
+
+!macx:LIBS += -Wl,-R,"'\$\$ORIGIN/$${LINK_RELATIVE_PATH}'"
+
+SOURCES += main.cpp
@@ -25,6 +25,7 @@ SUBDIRS += pkcs11/pkcs11.pro \
 
 applayer.depends = pteid-poppler		
 
+SUBDIRS += pteid-ltv-extend
 SUBDIRS += scap
 SUBDIRS += eidguiV2
 
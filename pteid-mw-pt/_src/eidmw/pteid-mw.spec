@@ -161,6 +161,7 @@ mkdir -p $RPM_BUILD_ROOT/usr/local/bin/
 install -m 755 eidguiV2/eidguiV2 $RPM_BUILD_ROOT/usr/local/bin/eidguiV2
 
 install -m 755 -p bin/pteiddialogsQTsrv $RPM_BUILD_ROOT/usr/local/bin/pteiddialogsQTsrv
+install -m 755 -p bin/pteid-ltv-extend $RPM_BUILD_ROOT/usr/local/bin/pteid-ltv-extend
 install -m 644 -p eidguiV2/eidmw_en.qm $RPM_BUILD_ROOT/usr/local/bin/
 install -m 644 -p eidguiV2/eidmw_nl.qm $RPM_BUILD_ROOT/usr/local/bin/
 
@@ -287,6 +288,7 @@ fi
 /usr/local/lib/*
 /usr/local/bin/eidguiV2
 /usr/local/bin/pteiddialogsQTsrv
+/usr/local/bin/pteid-ltv-extend
 /usr/local/bin/eidmw_en.qm
 /usr/local/bin/eidmw_nl.qm
 /usr/local/include/*
@@ -54,9 +54,12 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <time.h>
+#include <algorithm>
 #include <iostream>
 //For unique_ptr
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <math.h>
@@ -127,6 +130,11 @@ Catalog::Catalog(PDFDoc *docA) {
   lastCachedPage = 0;
   m_sig_dict = NULL;
   useCCLogo = false;
+  appearanceResourcesFound = gFalse;
+  for (int i = 0; i != 3; i++) {
+    myriadFontDescriptors[i].num = -1;
+    myriadFontDescriptors[i].gen = 0;
+  }
 
   xref->getCatalog(&catDict);
    
@@ -711,6 +719,211 @@ GBool Catalog::addSigRefToPage(Ref * refPage, Object* sig_ref)
 	return gTrue;
 }
 
+/*
+ * Find the characters shown with each of the fonts F1 (regular), F2 (italic) and F3 (bold)
+ * in the text commands of a signature appearance. The strings are escaped by escape_pdf_string()
+ */
+static void findUsedChars(const char *commands, GBool used_chars[3][256])
+{
+	int font = -1;
+
+	memset(used_chars, 0, 3 * 256 * sizeof(GBool));
+
+	for (const char *p = commands; *p != '\0'; p++)
+	{
+		if (p[0] == '/' && p[1] == 'F' && p[2] >= '1' && p[2] <= '3')
+		{
+			font = p[2] - '1';
+		}
+		else if (*p == '(')
+		{
+			for (p++; *p != '\0' && *p != ')'; p++)
+			{
+				if (*p == '\\' && p[1] != '\0')
+					p++;
+				if (font >= 0)
+					used_chars[font][(unsigned char)*p] = gTrue;
+			}
+			if (*p == '\0')
+				break;
+		}
+	}
+}
+
+/*
+ * Look for the fonts and images of the previous signature appearances: the Myriad font programs
+ * and the seal images only need to be embedded once per document.
+ */
+void Catalog::findAppearanceResources()
+{
+	Object fields, field, type, ap, normal;
+
+	appearanceResourcesFound = gTrue;
+
+	if (!acroForm.isDict() || !acroForm.dictLookup("Fields", &fields)->isArray())
+	{
+		fields.free();
+		return;
+	}
+
+	for (int i = 0; i < fields.arrayGetLength(); i++)
+	{
+		if (fields.arrayGet(i, &field)->isDict() && field.dictLookup("FT", &type)->isName("Sig")
+			&& field.dictLookup("AP", &ap)->isDict() && ap.dictLookup("N", &normal)->isStream())
+		{
+			findAppearanceResources(&normal, 0);
+		}
+
+		normal.free();
+		ap.free();
+		type.free();
+		field.free();
+	}
+
+	fields.free();
+}
+
+/* Our appearances reference the fonts and images from the n2 layer, one level below the top-level XObject */
+void Catalog::findAppearanceResources(Object *xobject, int depth)
+{
+	Object resources, fonts, xobjects, obj, ref, desc_ref, desc, subtype;
+
+	if (!xobject->streamGetDict()->lookup("Resources", &resources)->isDict())
+	{
+		resources.free();
+		return;
+	}
+
+	if (resources.dictLookup("Font", &fonts)->isDict())
+	{
+		for (int i = 0; i < fonts.dictGetLength(); i++)
+		{
+			if (fonts.dictGetVal(i, &obj)->isDict() && obj.dictLookupNF("FontDescriptor", &desc_ref)->isRef())
+			{
+				desc_ref.fetch(xref, &desc);
+				for (int ft = 0; ft != 3; ft++)
+				{
+					if (myriadFontDescriptors[ft].num == -1 && isMyriadFontDescriptor(&desc, (MyriadFontType)ft))
+						myriadFontDescriptors[ft] = desc_ref.getRef();
+				}
+				desc.free();
+			}
+			desc_ref.free();
+			obj.free();
+		}
+	}
+	fonts.free();
+
+	if (resources.dictLookup("XObject", &xobjects)->isDict())
+	{
+		for (int i = 0; i < xobjects.dictGetLength(); i++)
+		{
+			if (xobjects.dictGetValNF(i, &ref)->isRef() && ref.fetch(xref, &obj)->isStream())
+			{
+				obj.streamGetDict()->lookup("Subtype", &subtype);
+				if (subtype.isName("Image"))
+				{
+					Ref image_ref = ref.getRef();
+					if (std::find_if(appearanceImages.begin(), appearanceImages.end(), [&image_ref](const Ref &r) {
+							return r.num == image_ref.num && r.gen == image_ref.gen;
+						}) == appearanceImages.end())
+						appearanceImages.push_back(image_ref);
+				}
+				else if (subtype.isName("Form") && depth < 2)
+				{
+					findAppearanceResources(&obj, depth + 1);
+				}
+				subtype.free();
+			}
+			obj.free();
+			ref.free();
+		}
+	}
+	xobjects.free();
+
+	resources.free();
+}
+
+GBool Catalog::isSameImage(Ref image_ref, int width, int height, unsigned char *data, unsigned long length_in_bytes)
+{
+	Object image, obj;
+	GBool same = gFalse;
+
+	if (xref->fetch(image_ref.num, image_ref.gen, &image)->isStream())
+	{
+		Dict *dict = image.streamGetDict();
+		same = dict->lookup("Width", &obj)->isInt() && obj.getInt() == width;
+		obj.free();
+		same = same && dict->lookup("Height", &obj)->isInt() && obj.getInt() == height;
+		obj.free();
+		same = same && dict->lookup("Filter", &obj)->isName("DCTDecode");
+		obj.free();
+		same = same && dict->lookup("Length", &obj)->isInt() && (unsigned long)obj.getInt() == length_in_bytes;
+		obj.free();
+
+		if (same)
+		{
+			//Compare the JPEG data itself, without decoding it
+			Stream *str = image.getStream()->getUndecodedStream();
+			Guchar buf[4096];
+			unsigned long offset = 0;
+			int n = 0;
+
+			str->reset();
+			while (same && offset < length_in_bytes
+				&& (n = str->doGetChars((int)std::min<unsigned long>(sizeof(buf), length_in_bytes - offset), buf)) > 0)
+			{
+				same = memcmp(buf, data + offset, n) == 0;
+				offset += n;
+			}
+			same = same && offset == length_in_bytes;
+			str->close();
+		}
+	}
+	image.free();
+
+	return same;
+}
+
+/*
+ * Adds a Myriad font dictionary with the widths of the characters in used_chars.
+ * The font program is embedded only if no previous signature of the document did it.
+ * Returns a Ref with num -1 if none of the characters is used.
+ */
+Ref Catalog::addMyriadFont(int font_type, GBool used_chars[256])
+{
+	Ref font_ref;
+	int first_char = 0;
+	int last_char = 255;
+
+	font_ref.num = -1;
+	font_ref.gen = 0;
+
+	while (first_char <= last_char && !used_chars[first_char])
+		first_char++;
+	if (first_char > last_char)
+		return font_ref;
+	while (!used_chars[last_char])
+		last_char--;
+
+	if (!appearanceResourcesFound)
+		findAppearanceResources();
+
+	Ref &font_descriptor = myriadFontDescriptors[font_type];
+	if (font_descriptor.num == -1)
+	{
+		Object desc = createFontDescriptor(xref, (MyriadFontType)font_type);
+		font_descriptor = xref->addIndirectObject(&desc);
+		desc.free();
+	}
+
+	Object font_dict = createMyriadDict(xref, (MyriadFontType)font_type, font_descriptor, first_char, last_char);
+	font_ref = xref->addIndirectObject(&font_dict);
+	font_dict.free();
+
+	return font_ref;
+}
+
 /**
 * Creates an XObject with plain text content stream for the Visual Signature N0 and N2 Layers
 * For the N2 layer it adds the needed fonts and image.
@@ -720,8 +933,7 @@ Ref Catalog::newXObject(char *plain_text_stream, int height, int width, bool nee
 	unsigned char *img_data, unsigned long img_length)
 {
 	Object * appearance_obj = new Object();
-	Object obj1, obj2, font_dict, ref_to_dict, ref_to_dict2, 
-	       ref_to_dict3;
+	Object obj1, obj2, font_dict, ref_to_dict;
 
 	appearance_obj->initDict(xref);
 	appearance_obj->dictAdd(copyString("Type"), obj1.initName("XObject"));
@@ -738,22 +950,38 @@ Ref Catalog::newXObject(char *plain_text_stream, int height, int width, bool nee
 
 	if (needs_font)
 	{
+		const MyriadFontType appearance_fonts[] = { MYRIAD_REGULAR, MYRIAD_ITALIC, MYRIAD_BOLD };
+		const char *font_names[] = { "F1", "F2", "F3" };
+		GBool used_chars[3][256];
+		Ref font_refs[3];
+		Ref shown_font;
 
-		Object myriad_regular = createMyriadDict(xref, MYRIAD_REGULAR);
-		Object myriad_italic = createMyriadDict(xref, MYRIAD_ITALIC);
-		Object myriad_bold = createMyriadDict(xref, MYRIAD_BOLD);
+		findUsedChars(plain_text_stream, used_chars);
 
-		Ref font_f1 = xref->addIndirectObject(&myriad_regular);
-		Ref font_f2 = xref->addIndirectObject(&myriad_italic);
-		Ref font_f3 = xref->addIndirectObject(&myriad_bold);
-		ref_to_dict.initRef(font_f1.num, font_f1.gen);
-		ref_to_dict2.initRef(font_f2.num, font_f2.gen);
-		ref_to_dict3.initRef(font_f3.num, font_f3.gen);
+		//Each font only gets the widths of the characters it shows
+		shown_font.num = -1;
+		for (int i = 0; i != 3; i++)
+		{
+			font_refs[i] = addMyriadFont(appearance_fonts[i], used_chars[i]);
+			if (shown_font.num == -1)
+				shown_font = font_refs[i];
+		}
+
+		if (shown_font.num == -1)
+		{
+			for (int c = 0; c != 256; c++)
+				used_chars[0][c] = gTrue;
+			shown_font = font_refs[0] = addMyriadFont(MYRIAD_REGULAR, used_chars[0]);
+		}
 
 		font_dict.initDict(xref);
-		font_dict.dictAdd(copyString("F1"), &ref_to_dict);
-		font_dict.dictAdd(copyString("F2"), &ref_to_dict2);
-		font_dict.dictAdd(copyString("F3"), &ref_to_dict3);
+		for (int i = 0; i != 3; i++)
+		{
+			//A font that is selected but doesn't show any text (e.g. F2 without a reason) isn't embedded
+			Ref font_ref = font_refs[i].num != -1 ? font_refs[i] : shown_font;
+			ref_to_dict.initRef(font_ref.num, font_ref.gen);
+			font_dict.dictAdd(copyString(font_names[i]), &ref_to_dict);
+		}
 		resources.dictAdd(copyString("Font"), &font_dict);
 
 	}
@@ -852,6 +1080,15 @@ Ref Catalog::addFontDict(const char *baseFontName, const char *font_name)
 
 Ref Catalog::addImageXObject(int width, int height, unsigned char *data, unsigned long length_in_bytes)
 {
+	if (!appearanceResourcesFound)
+		findAppearanceResources();
+
+	//The same seal image of a previous signature is referenced instead of embedded again
+	for (size_t i = 0; i != appearanceImages.size(); i++)
+	{
+		if (isSameImage(appearanceImages[i], width, height, data, length_in_bytes))
+			return appearanceImages[i];
+	}
 
 	Object * image_obj = new Object();
 	Object obj1, obj2;
@@ -875,6 +1112,7 @@ Ref Catalog::addImageXObject(int width, int height, unsigned char *data, unsigne
 	aStream->initStream(mStream);
 
 	Ref ref_to_appearance = xref->addIndirectObject(aStream);
+	appearanceImages.push_back(ref_to_appearance);
 
 	delete aStream;
 	delete image_obj;
@@ -972,49 +1210,64 @@ std::string Catalog::get_commands_template(int rect_y, unsigned char *img_data){
   return commands_template;
 }
 
-void Catalog::addSignatureAppearance(Object *signature_field, SignatureSignerInfo *signer_info,
-	char * date_str, const char* location, const char* reason, int rect_x, int rect_y,
-	unsigned char *img_data, unsigned long img_length, int rotate_signature, bool isPTLanguage)
-{
-	const char * strings_pt[] = {	"(Assinado por: ) Tj\r\n{0:f} 0 Td\r\n/F3 {1:d} Tf\r\n", 
+static const char * seal_strings_pt[] = {	"(Assinado por: ) Tj\r\n{0:f} 0 Td\r\n/F3 {1:d} Tf\r\n", 
 									"(Num. de Identifica\xE7\xE3o: {0:s}) Tj\r\n",
 									"(Data: {0:s}) Tj\r\n",
 									"(Localiza\xE7\xE3o: ) Tj\r\n{0:f} 0 Td\r\n/F1 {1:d} Tf\r\n"};
 
-	const char * strings_en[] = {	"(Signed by: ) Tj\r\n{0:f} 0 Td\r\n/F3 {1:d} Tf\r\n",
+static const char * seal_strings_en[] = {	"(Signed by: ) Tj\r\n{0:f} 0 Td\r\n/F3 {1:d} Tf\r\n",
 									"(Identification number: {0:s}) Tj\r\n",
 									"(Date: {0:s}) Tj\r\n",
 									"(Location: ) Tj\r\n{0:f} 0 Td\r\n/F1 {1:d} Tf\r\n"};
 
-	Object ap_dict, appearance_obj, obj1, obj2, obj3,
-	       ref_to_dict, ref_to_dict2, ref_to_n2, ref_to_n0, font_dict, xobject_layers;
+/*
+ * Seal text of a signer as laid out by layoutSealText(), kept for the next documents signed with the same seal
+ */
+struct SealTextTemplate {
+  std::string head; // up to the date line
+  std::string tail; // after the date line
+  int line_height;
+};
 
-	GooString ap_command_toplevel;
+#define SEAL_TEXT_CACHE_MAX_ENTRIES 16
 
-	if (rotate_signature == 90)
-	{
-		ap_command_toplevel.appendf("0 1 -1 0 {0:d} 0 cm \r\n", rect_x);
-	}
-	else if (rotate_signature == 270)
-	{
-		ap_command_toplevel.appendf("0 -1 1 0 0 {0:d} cm \r\n", rect_y);
-	}
-	else if (rotate_signature == 180)
-	{
-		ap_command_toplevel.appendf("-1 0 0 -1 {0:d} {1:d} cm \r\n", rect_x, rect_y);
-	}
+static std::mutex seal_text_mutex;
+static std::map<std::string, SealTextTemplate> seal_text_cache;
 
+static void appendSealKey(std::string &key, const char *value)
+{
+  // A NULL civil number leaves its line out, unlike an empty one
+  if (value != NULL)
+    key.append(value);
+  key.push_back(value != NULL ? '\0' : '\1');
+}
 
+static bool findSealText(const std::string &key, SealTextTemplate &seal_text)
+{
+  std::lock_guard<std::mutex> lock(seal_text_mutex);
+  auto it = seal_text_cache.find(key);
+  if (it == seal_text_cache.end())
+    return false;
 
-	initBuiltinFontTables();
-	
-	//const char appearance_command1[] = 
-	ap_command_toplevel.append("q 1 0 0 1 0 0 cm /n0 Do Q\r\nq 1 0 0 1 0 0 cm /n2 Do Q\r\n");
-		
-	char n0_commands[] = "% DSBlank\n";
-	int rect_width  = ((rotate_signature == 90 || rotate_signature == 270) ? rect_y : rect_x);
-	int rect_height = ((rotate_signature == 90 || rotate_signature == 270) ? rect_x : rect_y);
-	
+  seal_text = it->second;
+  return true;
+}
+
+static void storeSealText(const std::string &key, const SealTextTemplate &seal_text)
+{
+  std::lock_guard<std::mutex> lock(seal_text_mutex);
+  if (seal_text_cache.size() >= SEAL_TEXT_CACHE_MAX_ENTRIES)
+    seal_text_cache.clear();
+  seal_text_cache[key] = seal_text;
+}
+
+/*
+ * Seal text of addSignatureAppearance() before and after the date line
+ */
+void Catalog::layoutSealText(SignatureSignerInfo *signer_info, bool have_date, const char* location,
+	const char* reason, int rect_y, int rect_width, int rect_height, unsigned char *img_data, bool isPTLanguage,
+	SealTextTemplate &seal_text)
+{
 	std::string _reason;
   if (!small_signature_format && reason != NULL && strlen(reason) > 0)
   {
@@ -1041,7 +1294,7 @@ void Catalog::addSignatureAppearance(Object *signature_field, SignatureSignerInf
     _reason, 
     _name, 
     signer_info->civil_number != NULL, 
-    date_str != NULL,
+    have_date,
     _location,
     _entities,
     _attributes,
@@ -1075,7 +1328,7 @@ void Catalog::addSignatureAppearance(Object *signature_field, SignatureSignerInf
 
 	double assinado_por_length = (int)font_size * SEAL_NAME_OFFSET;
 	//Change to bold font for the signer name
-	std::unique_ptr<GooString> str1(GooString::format(isPTLanguage ? strings_pt[0] : strings_en[0],
+	std::unique_ptr<GooString> str1(GooString::format(isPTLanguage ? seal_strings_pt[0] : seal_strings_en[0],
 		assinado_por_length, (int)font_size));
 
 	n2_commands->append(str1.get());
@@ -1114,27 +1367,24 @@ void Catalog::addSignatureAppearance(Object *signature_field, SignatureSignerInf
     n2_commands->append(str3.get());
 
   if (signer_info->civil_number != NULL){
-	  std::unique_ptr<GooString> str4(GooString::format(isPTLanguage ? strings_pt[1] : strings_en[1],
+	  std::unique_ptr<GooString> str4(GooString::format(isPTLanguage ? seal_strings_pt[1] : seal_strings_en[1],
 				signer_info->civil_number));
 	  n2_commands->append(str4.get());
         std::unique_ptr<GooString> changeLine(GooString::format("0 -{0:d} Td\r\n", (int)line_height));
     n2_commands->append(changeLine.get());
   }
 
-  if (date_str != NULL){
-    
-	  std::unique_ptr<GooString> str5(GooString::format(isPTLanguage ? strings_pt[2] : strings_en[2],
-		  date_str));
-	  n2_commands->append(str5.get());
-    std::unique_ptr<GooString> changeLine(GooString::format("0 -{0:d} Td\r\n", (int)line_height));
-    n2_commands->append(changeLine.get());
-  }
+  // The date line goes here, it's the only part of the seal text that isn't the same for every document
+  seal_text.head.assign(n2_commands->getCString(), n2_commands->getLength());
+  seal_text.line_height = (int)line_height;
+  n2_commands->clear();
+
 
 	if (!small_signature_format && location != NULL && strlen(location) > 0)
 	{
     double location_length = (int)font_size * SEAL_LOCATION_OFFSET;
     //Change to bold font for the signer name
-    std::unique_ptr<GooString> str1(GooString::format(isPTLanguage ? strings_pt[3] : strings_en[3],
+    std::unique_ptr<GooString> str1(GooString::format(isPTLanguage ? seal_strings_pt[3] : seal_strings_en[3],
       location_length, (int)font_size));
 
     n2_commands->append(str1.get());
@@ -1169,6 +1419,73 @@ void Catalog::addSignatureAppearance(Object *signature_field, SignatureSignerInf
 
 	n2_commands->append("\r\nET\r\nQ\r\n");
 
+  seal_text.tail.assign(n2_commands->getCString(), n2_commands->getLength());
+
+  delete name_str;
+  delete n2_commands;
+
+  free(name_latin1);
+}
+
+void Catalog::addSignatureAppearance(Object *signature_field, SignatureSignerInfo *signer_info,
+	char * date_str, const char* location, const char* reason, int rect_x, int rect_y,
+	unsigned char *img_data, unsigned long img_length, int rotate_signature, bool isPTLanguage)
+{
+	Object ap_dict, appearance_obj, obj1, obj2, obj3,
+	       ref_to_dict, ref_to_dict2, ref_to_n2, ref_to_n0, font_dict, xobject_layers;
+
+	GooString ap_command_toplevel;
+
+	if (rotate_signature == 90)
+	{
+		ap_command_toplevel.appendf("0 1 -1 0 {0:d} 0 cm \r\n", rect_x);
+	}
+	else if (rotate_signature == 270)
+	{
+		ap_command_toplevel.appendf("0 -1 1 0 0 {0:d} cm \r\n", rect_y);
+	}
+	else if (rotate_signature == 180)
+	{
+		ap_command_toplevel.appendf("-1 0 0 -1 {0:d} {1:d} cm \r\n", rect_x, rect_y);
+	}
+
+
+
+	initBuiltinFontTables();
+	
+	//const char appearance_command1[] = 
+	ap_command_toplevel.append("q 1 0 0 1 0 0 cm /n0 Do Q\r\nq 1 0 0 1 0 0 cm /n2 Do Q\r\n");
+		
+	char n0_commands[] = "% DSBlank\n";
+	int rect_width  = ((rotate_signature == 90 || rotate_signature == 270) ? rect_y : rect_x);
+	int rect_height = ((rotate_signature == 90 || rotate_signature == 270) ? rect_x : rect_y);
+	
+  // Only the date changes between the seals of a signer, so a batch lays the rest of the text out once
+  std::string seal_key;
+  appendSealKey(seal_key, signer_info->name);
+  appendSealKey(seal_key, signer_info->civil_number);
+  appendSealKey(seal_key, small_signature_format ? NULL : reason);
+  appendSealKey(seal_key, small_signature_format ? NULL : location);
+  seal_key += std::to_string(rect_y) + " " + std::to_string(rect_width) + " " + std::to_string(rect_height) + " ";
+  seal_key += std::to_string(img_data != NULL) + std::to_string(useCCLogo) + std::to_string(small_signature_format)
+            + std::to_string(isPTLanguage) + std::to_string(date_str != NULL);
+  SealTextTemplate seal_text;
+  if (!findSealText(seal_key, seal_text)) {
+    layoutSealText(signer_info, date_str != NULL, location, reason, rect_y, rect_width, rect_height, img_data,
+                   isPTLanguage, seal_text);
+    storeSealText(seal_key, seal_text);
+  }
+
+  GooString *n2_commands = new GooString(seal_text.head.c_str(), seal_text.head.size());
+  if (date_str != NULL){
+	  std::unique_ptr<GooString> str5(GooString::format(isPTLanguage ? seal_strings_pt[2] : seal_strings_en[2],
+		  date_str));
+	  n2_commands->append(str5.get());
+    std::unique_ptr<GooString> changeLine(GooString::format("0 -{0:d} Td\r\n", seal_text.line_height));
+    n2_commands->append(changeLine.get());
+  }
+  n2_commands->append(seal_text.tail.c_str(), seal_text.tail.size());
+
 	appearance_obj.initDict(xref);
 	appearance_obj.dictAdd(copyString("Type"), obj1.initName("XObject"));
 	appearance_obj.dictAdd(copyString("Subtype"), obj1.initName("Form"));
@@ -1226,10 +1543,7 @@ void Catalog::addSignatureAppearance(Object *signature_field, SignatureSignerInf
 	
 	signature_field->dictAdd(copyString("AP"), &ap_dict);
 
-	delete name_str;
 	delete n2_commands;
-
-	free(name_latin1);
 }
 
 void Catalog::addSignatureAppearanceSCAP(Object *signature_field, SignatureSignerInfo *signer_info,
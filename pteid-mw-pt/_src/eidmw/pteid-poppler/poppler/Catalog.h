@@ -84,6 +84,7 @@ class OCGs;
 class ViewerPreferences;
 class FileSpec;
 class PDFRectangle;
+struct SealTextTemplate;
 
 //------------------------------------------------------------------------
 // NameTree
@@ -181,6 +182,11 @@ public:
   void closeSignature(const char *signature_contents, size_t placeholder_len);
 
   std::string get_commands_template(int rect_y, unsigned char *img_data);
+  /* Seal text of addSignatureAppearance() split around the date line, which is the only line that changes
+     between the signatures of the same signer */
+  void layoutSealText(SignatureSignerInfo *signer_info, bool have_date, const char* location, const char* reason,
+      int rect_y, int rect_width, int rect_height, unsigned char *img_data, bool isPTLanguage,
+      SealTextTemplate &seal_text);
 
   /* Fill the following keys of the signature field dictionary: Type, SubType, FT, F, SigSector, Rect, T and P.*/
   void fillSignatureField(Object *signatureFieldDict, PDFRectangle *rect, int sig_sector, 
@@ -274,6 +280,12 @@ private:
   PageLabelInfo *getPageLabelInfo();
   void createFieldsArray(Object *acro_form, Object *fields);
 
+  // Fonts and images of the signature appearances are shared with the previous signatures of the document
+  void findAppearanceResources();
+  void findAppearanceResources(Object *xobject, int depth);
+  GBool isSameImage(Ref image_ref, int width, int height, unsigned char *data, unsigned long length_in_bytes);
+  Ref addMyriadFont(int font_type, GBool used_chars[256]);
+
   PDFDoc *doc;
   XRef *xref;			// the xref table for this PDF file
   Page **pages;			// array of pages
@@ -313,6 +325,9 @@ private:
   PageLayout pageLayout;	// page layout
 
   GBool useCCLogo;
+  GBool appearanceResourcesFound;
+  Ref myriadFontDescriptors[3];	// indexed by MyriadFontType, num is -1 if the font wasn't embedded yet
+  std::vector<Ref> appearanceImages;
 
   GBool cachePageTree(int page); // Cache first <page> pages.
   Object *findDestInTree(Object *tree, GooString *name, Object *obj);
@@ -1,4 +1,7 @@
 #include "Myriad-Font.h"
+#include "Stream.h"
+
+#include <string.h>
 
 
 /* data statements for file MyriadPro-Regular.bin at Mon Oct 22 09:55:12 2012 */
@@ -13693,27 +13696,29 @@ unsigned char MyriadFonts::myriad_italic_compressed[] =
 
 };
 
-Object createFontDescriptor(XRef * xref, MyriadFontType ft)
+static const FontDescriptor *getFontDescriptor(MyriadFontType ft)
 {
-	Object font_descriptor, obj_attr, obj_bbox, font_file;
-	const FontDescriptor *my_font = NULL;
-
 	switch(ft)
 	{
 		case MYRIAD_REGULAR:
-			my_font = &myriad_regular_font_desc;
-			break;
+			return &myriad_regular_font_desc;
 		case MYRIAD_ITALIC:
-			my_font = &myriad_italic_font_desc;
-			break;
+			return &myriad_italic_font_desc;
 		case MYRIAD_BOLD:
-			my_font = &myriad_bold_font_desc;
-			break;
-
-    default:
-      return font_descriptor;
+			return &myriad_bold_font_desc;
 	}
 
+	return NULL;
+}
+
+Object createFontDescriptor(XRef * xref, MyriadFontType ft)
+{
+	Object font_descriptor, obj_attr, obj_bbox, font_file;
+	const FontDescriptor *my_font = getFontDescriptor(ft);
+
+	if (my_font == NULL)
+		return font_descriptor;
+
 	font_descriptor.initDict(xref);
 	font_descriptor.dictAdd(copyString("Type"),
 			obj_attr.initName("FontDescriptor"));
@@ -13760,6 +13765,60 @@ Object createFontDescriptor(XRef * xref, MyriadFontType ft)
 	return font_descriptor;
 }
 
+/* Does the decoded font program of font_file match our own font data? */
+static GBool hasMyriadFontProgram(Object *font_file, const FontDescriptor *my_font)
+{
+	Object null_dict;
+	null_dict.initNull();
+	FlateStream my_program(new MemStream((char *)my_font->font_data, 0, my_font->font_length, &null_dict),
+			1, 1, 1, 8);
+
+	Guchar buf[4096], my_buf[4096];
+	GBool same = gTrue;
+	int len = 0;
+	font_file->streamReset();
+	my_program.reset();
+	while (same)
+	{
+		len = font_file->streamGetChars(sizeof(buf), buf);
+		same = my_program.doGetChars(sizeof(my_buf), my_buf) == len && memcmp(buf, my_buf, len) == 0;
+		if (len == 0)
+			break;
+	}
+	font_file->streamClose();
+	my_program.close();
+
+	return same;
+}
+
+GBool isMyriadFontDescriptor(Object *font_descriptor, MyriadFontType ft)
+{
+	const FontDescriptor *my_font = getFontDescriptor(ft);
+	Object font_name, font_file, length, length1;
+	GBool ret = gFalse;
+
+	if (my_font == NULL || !font_descriptor->isDict("FontDescriptor"))
+		return gFalse;
+
+	// The font program sizes tell our fonts apart from other MyriadPro versions embedded by other producers, and
+	// the font program itself from a font that only claims to be ours
+	if (font_descriptor->dictLookup("FontName", &font_name)->isName(my_font->font_name)
+		&& font_descriptor->dictLookup("FontFile3", &font_file)->isStream())
+	{
+		Dict *font_file_dict = font_file.streamGetDict();
+		ret = font_file_dict->lookup("Length", &length)->isInt() && length.getInt() == my_font->font_length
+			&& font_file_dict->lookup("Length1", &length1)->isInt() && length1.getInt() == my_font->font_length1
+			&& hasMyriadFontProgram(&font_file, my_font);
+		length.free();
+		length1.free();
+	}
+
+	font_name.free();
+	font_file.free();
+
+	return ret;
+}
+
 
 int MYRIAD_REGULAR_WIDTHS[] =
 {
@@ -13777,6 +13836,14 @@ int MYRIAD_ITALIC_WIDTHS[] =
 };
 
 Object createMyriadDict(XRef *xref, MyriadFontType ft)
+{
+	Object desc = createFontDescriptor(xref, ft);
+	Ref desc_ref = xref->addIndirectObject(&desc);
+
+	return createMyriadDict(xref, ft, desc_ref, 0, 255);
+}
+
+Object createMyriadDict(XRef *xref, MyriadFontType ft, Ref font_descriptor, int first_char, int last_char)
 {
 	Object font_dict, obj_tmp, widths;
 	const char *my_base_font = NULL;
@@ -13805,22 +13872,19 @@ Object createMyriadDict(XRef *xref, MyriadFontType ft)
 	font_dict.dictAdd(copyString("Encoding"),
 			obj_tmp.initName("WinAnsiEncoding"));
 	font_dict.dictAdd(copyString("BaseFont"), obj_tmp.initName(my_base_font));
-	font_dict.dictAdd(copyString("FirstChar"), obj_tmp.initInt(0));
-	font_dict.dictAdd(copyString("LastChar"), obj_tmp.initInt(255));
+	font_dict.dictAdd(copyString("FirstChar"), obj_tmp.initInt(first_char));
+	font_dict.dictAdd(copyString("LastChar"), obj_tmp.initInt(last_char));
 
 	widths.initArray(xref);
 	if ( myriad_widths !=NULL ){
-        for (int i=0; i!= 256; i++)
+        for (int i=first_char; i <= last_char; i++)
             widths.arrayAdd(obj_tmp.initInt(*(myriad_widths + i)));
 	}/* if ( myriad_widths !=NULL ) */
 
 	font_dict.dictAdd(copyString("Widths"), &widths);
 
-	Object desc = createFontDescriptor(xref, ft);
-	Ref desc_ref = xref->addIndirectObject(&desc);
-
 	font_dict.dictAdd(copyString("FontDescriptor"),
-			obj_tmp.initRef(desc_ref.num, desc_ref.gen));
+			obj_tmp.initRef(font_descriptor.num, font_descriptor.gen));
 
 	return font_dict;
 }
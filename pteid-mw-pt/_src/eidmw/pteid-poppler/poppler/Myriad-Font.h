@@ -35,6 +35,14 @@ typedef struct __font_descriptor
 Object createFontDescriptor(XRef * xref, MyriadFontType ft);
 Object createMyriadDict(XRef *xref, MyriadFontType ft);
 
+/* Font dictionary that uses an existing FontDescriptor and only has the widths of the characters
+   first_char to last_char */
+Object createMyriadDict(XRef *xref, MyriadFontType ft, Ref font_descriptor, int first_char, int last_char);
+
+/* Is font_descriptor one of the descriptors written by createFontDescriptor() for ft?
+   Used to find the fonts embedded by previous signatures of the same document */
+GBool isMyriadFontDescriptor(Object *font_descriptor, MyriadFontType ft);
+
 class MyriadFonts
 {
 
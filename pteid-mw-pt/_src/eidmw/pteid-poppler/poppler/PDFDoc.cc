@@ -90,6 +90,7 @@
 #endif
 #include "PDFDoc.h"
 #include "Hints.h"
+#include "MappedFile.h"
 
 extern "C"
 {
@@ -567,6 +568,32 @@ GBool PDFDoc::isReaderEnabled()
 
 }
 
+// Signature fields are told apart by their field type, which a field can
+// inherit from its parent. /Type /Annot is only there when the widget is
+// merged with the field, and even then it's optional
+static GBool isSignatureField(Object *field)
+{
+    Object node, parent, ft;
+    GBool isSig = gFalse;
+
+    field->copy(&node);
+    // Bounded, a malformed document may have a /Parent loop
+    for (int depth = 0; depth < 32 && node.isDict(); depth++) {
+        node.dictLookup("FT", &ft);
+        if (!ft.isNull()) {
+            isSig = ft.isName("Sig");
+            ft.free();
+            break;
+        }
+        node.dictLookup("Parent", &parent);
+        node.free();
+        node = parent;
+    }
+    node.free();
+
+    return isSig;
+}
+
 std::unordered_set<int> PDFDoc::getSignaturesIndexesUntilLastTimestamp()
 {
     std::unordered_set<int> indexes;
@@ -589,12 +616,7 @@ std::unordered_set<int> PDFDoc::getSignaturesIndexesUntilLastTimestamp()
 			continue;
 		}
 
-        f.dictLookup("Type", &type);
-        f.dictLookup("FT", &obj1);
-        if (!type.isName() || !obj1.isName())
-          continue;
-        if (strcmp(type.getName(), "Annot") == 0
-            && strcmp(obj1.getName(), "Sig") == 0)
+        if (isSignatureField(&f))
         {
 
             f.dictLookup("V", &sig_dict);
@@ -622,7 +644,7 @@ std::unordered_set<int> PDFDoc::getSignaturesIndexesUntilLastTimestamp()
 int PDFDoc::getSignatureContents(unsigned char **contents, int sigIdx)
 {
 	Object *acro_form = getCatalog()->getAcroForm();
-	Object fields, f, sig_dict, contents_obj, type, obj1;
+	Object fields, f, sig_dict, contents_obj;
 
 	if (acro_form->isNull())
 		return 0;
@@ -638,10 +660,7 @@ int PDFDoc::getSignatureContents(unsigned char **contents, int sigIdx)
 		return 0;
 	}
 
-	f.dictLookup("Type", &type);
-	f.dictLookup("FT", &obj1);
-	if (strcmp(type.getName(), "Annot") == 0
-			    && strcmp(obj1.getName(), "Sig") == 0)
+	if (isSignatureField(&f))
 	{
 		f.dictLookup("V", &sig_dict);
 		//Signature field may be empty so "/V" dictionary is optional
@@ -666,13 +685,72 @@ int PDFDoc::getSignatureContents(unsigned char **contents, int sigIdx)
 	return 0;
 }
 
+int PDFDoc::getNumFields()
+{
+	Object *acro_form = getCatalog()->getAcroForm();
+	Object fields;
+	int count = 0;
+
+	if (acro_form->isNull())
+		return 0;
+	acro_form->dictLookup("Fields", &fields);
+	if (fields.isArray())
+		count = fields.arrayGetLength();
+	fields.free();
+
+	return count;
+}
+
+GBool PDFDoc::getSignatureByteRange(int sigIdx, int byteRange[4])
+{
+	Object *acro_form = getCatalog()->getAcroForm();
+	Object fields, f, sig_dict, byterange_obj, item;
+	GBool ret = gFalse;
+
+	if (acro_form->isNull())
+		return gFalse;
+	acro_form->dictLookup("Fields", &fields);
+	if (!fields.isArray() || sigIdx < 0 || sigIdx >= fields.arrayGetLength()) {
+		fields.free();
+		return gFalse;
+	}
+
+	fields.arrayGet(fields.arrayGetLength()-1-sigIdx, &f);
+	if (f.isDict()) {
+		if (isSignatureField(&f))
+		{
+			f.dictLookup("V", &sig_dict);
+			if (sig_dict.isDict()) {
+				sig_dict.dictLookup("ByteRange", &byterange_obj);
+				if (byterange_obj.isArray() && byterange_obj.arrayGetLength() == 4) {
+					ret = gTrue;
+					for (int i = 0; i < 4; i++) {
+						byterange_obj.arrayGet(i, &item);
+						if (item.isInt() && item.getInt() >= 0)
+							byteRange[i] = item.getInt();
+						else
+							ret = gFalse;
+						item.free();
+					}
+				}
+				byterange_obj.free();
+			}
+			sig_dict.free();
+		}
+	}
+	f.free();
+	fields.free();
+
+	return ret;
+}
+
 //TODO: The next method considers only the first signature it happens to find
 // in the file
 Object *PDFDoc::getByteRange()
 {
 
 	Object *acro_form = getCatalog()->getAcroForm();
-	Object fields, f, sig_dict, byterange_obj, type, obj1;
+	Object fields, f, sig_dict, byterange_obj;
 
 	if (acro_form->isNull())
 		return 0;
@@ -683,10 +761,7 @@ Object *PDFDoc::getByteRange()
 	{
 	    fields.arrayGet(i, &f);
 
-	    f.dictLookup("Type", &type);
-	    f.dictLookup("FT", &obj1);
-	    if (strcmp(type.getName(), "Annot") == 0
-			    && strcmp(obj1.getName(), "Sig") == 0)
+	    if (isSignatureField(&f))
 	    {
 		f.dictLookup("V", &sig_dict);
 		if (!sig_dict.isDict())
@@ -1320,13 +1395,7 @@ int PDFDoc::saveAs(wchar_t *name, PDFWriteMode mode) {
 int PDFDoc::saveAs(OutStream *outStr, PDFWriteMode mode) {
 
   // find if we have updated objects
-  GBool updated = gFalse;
-  for(int i=0; i<xref->getNumObjects(); i++) {
-    if (xref->getEntry(i)->updated) {
-      updated = gTrue;
-      break;
-    }
-  }
+  GBool updated = xref->hasUpdatedEntries();
 
   // we don't support rewriting files with Encrypt at the moment
   Object obj;
@@ -1382,48 +1451,77 @@ int PDFDoc::saveWithoutChangesAs(GooString *name) {
 }
 
 int PDFDoc::saveWithoutChangesAs(OutStream *outStr) {
-  int c;
-  
+  copyOriginalFile(outStr);
+
+  return errNone;
+}
+
+#define copyBufSize 65536
+
+Guint PDFDoc::copyOriginalFile (OutStream* outStr)
+{
+  Guint copied = 0;
+  int n;
+
   str->reset();
-  while ((c = str->getChar()) != EOF) {
-    outStr->put(c);
+
+  // File to file: let the kernel copy the data without going through our buffers
+  FileOutStream *fileOutStr = dynamic_cast<FileOutStream *>(outStr);
+  GBool wholeFile = str->getKind() == strFile && !((FileStream *)str)->isLimited();
+  if (fileOutStr && wholeFile) {
+    copied = fileOutStr->copyFile(((FileStream *)str)->getFile(), str->getStart());
+    if (copied > 0)
+      str->setPos(str->getStart() + copied);
+  } else if (wholeFile && str->getStart() == 0) {
+    // File to memory: straight from a mapping of the file, only kept for the copy.
+    // A mapping that outlived it would fault on pages of a file truncated meanwhile
+    eIDMW::CMappedFile mapped;
+    if (mapped.Map(((FileStream *)str)->getFile()) && mapped.GetSize() <= INT_MAX) {
+      outStr->write((const char *)mapped.GetData(), (int)mapped.GetSize());
+      copied = (Guint)mapped.GetSize();
+      str->setPos(copied);
+    }
   }
+
+  // Whatever is left is copied in blocks
+  Guchar *buf = (Guchar *)gmalloc(copyBufSize);
+  while ((n = str->doGetChars(copyBufSize, buf)) > 0) {
+    outStr->write((const char *)buf, n);
+    copied += n;
+  }
+  gfree(buf);
   str->close();
 
-  return errNone;
+  return copied;
 }
 
 void PDFDoc::saveIncrementalUpdate (OutStream* outStr)
 {
   XRef *uxref;
-  int c;
   //copy the original file
-  str->reset();
-  while ((c = str->getChar()) != EOF) {
-    outStr->put(c);
-  }
-  str->close();
+  copyOriginalFile(outStr);
 
   uxref = new XRef();
   uxref->add(0, 65535, 0, gFalse);
-  for(int i=0; i<xref->getNumObjects(); i++) {
+  // Only the updated objects are written, the other entries of the table aren't even read
+  std::vector<int> updatedEntries = xref->getUpdatedEntries();
+  for(size_t j=0; j<updatedEntries.size(); j++) {
+    int i = updatedEntries[j];
     if ((xref->getEntry(i)->type == xrefEntryFree) && 
         (xref->getEntry(i)->gen == 0)) //we skip the irrelevant free objects
       continue;
 
-    if (xref->getEntry(i)->updated) { //we have an updated object
-      Ref ref;
-      ref.num = i;
-      ref.gen = xref->getEntry(i)->type == xrefEntryCompressed ? 0 : xref->getEntry(i)->gen;
-      if (xref->getEntry(i)->type != xrefEntryFree) {
-        Object obj1;
-        xref->fetch(ref.num, ref.gen, &obj1);
-        Guint offset = writeObject(&obj1, &ref, outStr);
-        uxref->add(ref.num, ref.gen, offset, gTrue);
-        obj1.free();
-      } else {
-        uxref->add(ref.num, ref.gen, 0, gFalse);
-      }
+    Ref ref;
+    ref.num = i;
+    ref.gen = xref->getEntry(i)->type == xrefEntryCompressed ? 0 : xref->getEntry(i)->gen;
+    if (xref->getEntry(i)->type != xrefEntryFree) {
+      Object obj1;
+      xref->fetch(ref.num, ref.gen, &obj1);
+      Guint offset = writeObject(&obj1, &ref, outStr);
+      uxref->add(ref.num, ref.gen, offset, gTrue);
+      obj1.free();
+    } else {
+      uxref->add(ref.num, ref.gen, 0, gFalse);
     }
   }
   if (uxref->getNumObjects() == 0) { //we have nothing to update
@@ -1573,10 +1671,13 @@ void PDFDoc::writeDictionnary (Dict* dict, OutStream* outStr, XRef *xRef, Guint
 
 void PDFDoc::writeStream (Stream* str, OutStream* outStr)
 {
+  Guchar buf[4096];
+  int n;
+
   outStr->printf("stream\r\n");
   str->reset();
-  for (int c=str->getChar(); c!= EOF; c=str->getChar()) {
-    outStr->printf("%c", c);  
+  while ((n = str->doGetChars(sizeof(buf), buf)) > 0) {
+    outStr->write((const char *)buf, n);
   }
   outStr->printf("\r\nendstream\r\n");
 }
@@ -1593,11 +1694,17 @@ void PDFDoc::writeRawStream (Stream* str, OutStream* outStr)
   const int length = obj1.getInt();
   obj1.free();
 
+  char buf[4096];
+  int n = 0;
+
   outStr->printf("stream\r\n");
   str->unfilteredReset();
   for (int i=0; i<length; i++) {
-    int c = str->getUnfilteredChar();
-    outStr->printf("%c", c);  
+    buf[n++] = (char)str->getUnfilteredChar();
+    if (n == (int)sizeof(buf) || i == length - 1) {
+      outStr->write(buf, n);
+      n = 0;
+    }
   }
   str->reset();
   outStr->printf("\r\nendstream\r\n");
@@ -1906,12 +2013,14 @@ void PDFDoc::writeXRefTableTrailer(Guint uxrefOffset, XRef *uxref, GBool writeAl
   const char *fileNameA = fileName ? fileName->getCString() : NULL;
   // file size (doesn't include the trailer)
   unsigned int fileSize = 0;
-  int c;
+  int n;
+  Guchar *buf = (Guchar *)gmalloc(copyBufSize);
   str->reset();
-  while ((c = str->getChar()) != EOF) {
-    fileSize++;
+  while ((n = str->doGetChars(copyBufSize, buf)) > 0) {
+    fileSize += n;
   }
   str->close();
+  gfree(buf);
   Ref ref;
   ref.num = getXRef()->getRootNum();
   ref.gen = getXRef()->getRootGen();
@@ -252,6 +252,11 @@ POPPLER_API PDFDoc(GooString *fileNameA, GooString *ownerPassword = NULL,
   The indexes are relative to the last signature: 0 is the last, 1 is the previous one, ... */
   POPPLER_API std::unordered_set<int> getSignaturesIndexesUntilLastTimestamp();
   POPPLER_API int getSignatureContents(unsigned char **, int sigIdx = 0);
+  /* Number of fields in the AcroForm: valid sigIdx values for getSignatureContents() are 0 to getNumFields()-1 */
+  POPPLER_API int getNumFields();
+  /* ByteRange of the signature sigIdx, with the same indexing as getSignatureContents().
+     Returns gFalse if that field is not a signed signature field */
+  POPPLER_API GBool getSignatureByteRange(int sigIdx, int byteRange[4]);
 
   POPPLER_API Object *getByteRange();
 
@@ -355,6 +360,8 @@ private:
   void writeXRefTableTrailer (Guint uxrefOffset, XRef *uxref, GBool writeAllEntries,
                               int uxrefSize, OutStream* outStr, GBool incrUpdate);
   static void writeString (GooString* s, OutStream* outStr);
+  // Copy the original file to outStr, returns the number of bytes copied
+  Guint copyOriginalFile (OutStream* outStr);
   void saveIncrementalUpdate (OutStream* outStr);
   void saveCompleteRewrite (OutStream* outStr);
 
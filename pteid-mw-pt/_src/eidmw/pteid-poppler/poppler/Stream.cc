@@ -46,6 +46,11 @@
 #endif
 #include <string.h>
 #include <ctype.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #include "goo/gmem.h"
 #include "goo/gfile.h"
 #include "poppler-config.h"
@@ -336,6 +341,12 @@ OutStream::~OutStream ()
 {
 }
 
+void OutStream::write (const char *buf, int len)
+{
+  for (int i = 0; i < len; ++i)
+    put(buf[i]);
+}
+
 MemOutStream::MemOutStream(unsigned long initial_size)
 {
 	buffer = (unsigned char *)gmalloc(initial_size);
@@ -348,27 +359,54 @@ MemOutStream::~MemOutStream()
 	free(buffer);
 }
 
+void MemOutStream::reserve(unsigned long len) {
+	if (len <= buffer_size - used)
+		return;
+
+	unsigned long needed = used + len;
+	unsigned long new_size = buffer_size * 2;
+	if (new_size < needed)
+		new_size = needed;
+	// Sizes that don't fit an int are reported by greallocn()
+	if (new_size >= INT_MAX)
+		new_size = needed < INT_MAX ? needed : INT_MAX;
+
+	buffer = (unsigned char *)greallocn(buffer, (int)new_size, 1);
+	buffer_size = new_size;
+}
+
 void MemOutStream::put(char c) {
+	reserve(1);
 	*(buffer+used) = c;
 	used++;
 }
 
+void MemOutStream::write(const char *buf, int len) {
+	if (len <= 0)
+		return;
+
+	reserve(len);
+	memcpy(buffer+used, buf, len);
+	used += len;
+}
+
 void MemOutStream::printf(const char *format, ...)
 {
   va_list argptr;
   va_start (argptr, format);
 
-  unsigned int ret = vsnprintf((char *)buffer+used, buffer_size-used, format, argptr);
+  int ret = vsnprintf((char *)buffer+used, buffer_size-used, format, argptr);
   va_end (argptr);
-  if (ret >= buffer_size-used)
+  if (ret < 0)
+    return;
+  if ((unsigned long)ret >= buffer_size-used)
   {
     /* It's mandatory to start another traversal of the va_list because vsnprintf calls va_arg()
      * so calling it again right away would return undefined values as there would be no more arguments
      * More info at the stdarg(3) manpage ... */
     va_start (argptr, format);
-    //Buffer is full need to reallocate to twice the size
-    buffer = (unsigned char *)grealloc(buffer, buffer_size*2);
-    buffer_size *=2;
+    //Buffer is full, grow it to fit the formatted string and its terminator
+    reserve((unsigned long)ret + 1);
     ret = vsnprintf((char *)buffer+used, buffer_size-used, format, argptr);
     va_end (argptr);
   }
@@ -406,6 +444,49 @@ void FileOutStream::put (char c)
   fputc(c,f);
 }
 
+void FileOutStream::write (const char *buf, int len)
+{
+  if (len > 0)
+    fwrite(buf, 1, len, f);
+}
+
+Guint FileOutStream::copyFile (FILE *in, Guint inStart)
+{
+  Guint copied = 0;
+#ifdef __linux__
+  // The data written so far must reach the file before it's appended to by the kernel
+  if (fflush(f) != 0)
+    return 0;
+
+  int inFd = fileno(in);
+  int outFd = fileno(f);
+  off_t inOffset = inStart;
+  off_t outOffset = lseek(outFd, 0, SEEK_CUR);
+  if (outOffset < 0)
+    return 0;
+
+  const size_t chunk = 1 << 30;
+  ssize_t n = -1;
+#ifdef SYS_copy_file_range
+  // copy_file_range() shares the data blocks on filesystems that support it (reflink)
+  while ((n = syscall(SYS_copy_file_range, inFd, &inOffset, outFd, &outOffset, chunk, 0)) > 0)
+    copied += (Guint)n;
+#endif
+  if (n < 0) {
+    // Not supported by the kernel or between these filesystems: sendfile() writes at the current offset
+    if (lseek(outFd, outOffset, SEEK_SET) < 0)
+      return copied;
+    while ((n = sendfile(outFd, inFd, &inOffset, chunk)) > 0)
+      copied += (Guint)n;
+    outOffset = lseek(outFd, 0, SEEK_CUR);
+  }
+
+  // Put the FILE position after the copied data, where the next write goes
+  fseeko(f, outOffset, SEEK_SET);
+#endif
+  return copied;
+}
+
 void FileOutStream::printf(const char *format, ...)
 {
   va_list argptr;
@@ -1013,6 +1094,10 @@ Stream *MemStream::makeSubStream(Guint startA, GBool limited,
   MemStream *subStr;
   Guint newLength;
 
+  // unlike a FileStream, a MemStream can't read past its end
+  if (startA > start + length) {
+    startA = start + length;
+  }
   if (!limited || startA + lengthA > start + length) {
     newLength = start + length - startA;
   } else {
@@ -257,6 +257,9 @@ public:
   // Put a char in the stream
   virtual void put (char c) = 0;
 
+  // Write len bytes to the stream
+  virtual void write (const char *buf, int len);
+
   //FIXME
   // Printf-like function                         2,3 because the first arg is class instance ?
   virtual void printf (const char *format, ...) = 0 ; //__attribute__((format(printf, 2,3))) = 0;
@@ -276,6 +279,8 @@ class MemOutStream : public OutStream {
 
 		virtual void put (char c);
 
+		virtual void write (const char *buf, int len);
+
 		~MemOutStream();
 		virtual void printf (const char *format, ...);
 		unsigned char *getData() { return buffer; };
@@ -283,6 +288,9 @@ class MemOutStream : public OutStream {
 		unsigned int size() {return used;};
 
 	private:
+		// Grow the buffer so that len more bytes fit in it
+		void reserve(unsigned long len);
+
 		unsigned char *buffer;
 		unsigned long buffer_size;
 		unsigned long used;
@@ -304,7 +312,13 @@ public:
 
   virtual void put (char c);
 
+  virtual void write (const char *buf, int len);
+
   virtual void printf (const char *format, ...);
+
+  // Append the content of file in from offset inStart up to its end, copying it inside the kernel
+  // where the OS supports it. Returns the number of bytes copied, the caller copies the rest
+  Guint copyFile (FILE *in, Guint inStart);
 private:
   FILE *f;
   Guint start;
@@ -483,6 +497,9 @@ public:
   virtual int getUnfilteredChar () { return getChar(); }
   virtual void unfilteredReset () { reset(); }
 
+  FILE *getFile() { return f; }
+  GBool isLimited() { return limited; }
+
 private:
 
   GBool fillBuf();
@@ -39,6 +39,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <algorithm>
 #include "goo/gmem.h"
 #include "Object.h"
 #include "Stream.h"
@@ -444,7 +445,9 @@ GBool XRef::readXRef(Guint *pos, std::vector<Guint> *followedXRefStm) {
   // parse an old-style xref table
   if (obj.isCmd("xref")) {
     obj.free();
-    more = readXRefTable(parser, pos, followedXRefStm);
+    if (!readXRefTableLazy(pos, followedXRefStm, &more)) {
+      more = readXRefTable(parser, pos, followedXRefStm);
+    }
 
   // parse an xref stream
   } else if (obj.isInt()) {
@@ -482,9 +485,7 @@ GBool XRef::readXRef(Guint *pos, std::vector<Guint> *followedXRefStm) {
 
 GBool XRef::readXRefTable(Parser *parser, Guint *pos, std::vector<Guint> *followedXRefStm) {
   XRefEntry entry;
-  GBool more;
-  Object obj, obj2;
-  Guint pos2;
+  Object obj;
   int first, n, i;
 
   while (1) {
@@ -550,6 +551,173 @@ GBool XRef::readXRefTable(Parser *parser, Guint *pos, std::vector<Guint> *follow
     }
   }
 
+  return readXRefTrailer(parser, pos, followedXRefStm);
+
+ err1:
+  obj.free();
+ err0:
+  ok = gFalse;
+  return gFalse;
+}
+
+static int skipXRefSpace(Stream *s) {
+  int c;
+  while ((c = s->lookChar()) != EOF && Lexer::isSpace(c)) {
+    s->getChar();
+  }
+  return c;
+}
+
+static GBool readXRefInt(Stream *s, int *value) {
+  int c = skipXRefSpace(s);
+  if (!isdigit(c)) {
+    return gFalse;
+  }
+  *value = 0;
+  while ((c = s->lookChar()) != EOF && isdigit(c)) {
+    if (*value > (INT_MAX - (c - '0')) / 10) {
+      return gFalse;
+    }
+    *value = *value * 10 + (c - '0');
+    s->getChar();
+  }
+  return gTrue;
+}
+
+static GBool readXRefKeyword(Stream *s, const char *keyword) {
+  for (const char *p = keyword; *p; ++p) {
+    if (s->getChar() != *p) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+// Is there a well-formed 20 byte xref table entry ("nnnnnnnnnn ggggg n" and EOL) at offset?
+GBool XRef::isXRefEntryLine(Guint offset) {
+  Object obj;
+  char line[20];
+  int i;
+
+  obj.initNull();
+  Stream *s = str->makeSubStream(offset, gFalse, 0, &obj);
+  s->reset();
+  for (i = 0; i < 20; ++i) {
+    int c = s->getChar();
+    if (c == EOF) {
+      break;
+    }
+    line[i] = (char)c;
+  }
+  delete s;
+
+  if (i < 20) {
+    return gFalse;
+  }
+  for (i = 0; i < 18; ++i) {
+    if (i == 10 || i == 16) {
+      if (line[i] != ' ')
+        return gFalse;
+    } else if (i == 17) {
+      if (line[i] != 'n' && line[i] != 'f')
+        return gFalse;
+    } else if (!isdigit(line[i])) {
+      return gFalse;
+    }
+  }
+  return (line[18] == ' ' && (line[19] == '\r' || line[19] == '\n'))
+    || (line[18] == '\r' && line[19] == '\n');
+}
+
+// Read an xref table section without parsing its entries. The entries of a table are
+// fixed 20 byte lines, so only the subsection headers are read and each entry gets the
+// position of its line, to be parsed by getEntry() when the object is first needed.
+// This keeps the time to open large documents independent of the number of objects.
+// Returns gFalse, without changing any entry, if the section doesn't have the exact
+// layout of the spec: the caller then parses it with readXRefTable().
+GBool XRef::readXRefTableLazy(Guint *pos, std::vector<Guint> *followedXRefStm, GBool *more) {
+  struct Subsection {
+    int first;
+    int n;
+    Guint offset;
+  };
+  std::vector<Subsection> subsections;
+  Object obj;
+  GBool valid;
+  Guint trailerPos = 0;
+
+  obj.initNull();
+  Stream *s = str->makeSubStream(start + *pos, gFalse, 0, &obj);
+  s->reset();
+
+  valid = skipXRefSpace(s) == 'x' && readXRefKeyword(s, "xref");
+  while (valid) {
+    Subsection sub;
+    if (skipXRefSpace(s) == 't') {
+      valid = readXRefKeyword(s, "trailer");
+      trailerPos = s->getPos();
+      break;
+    }
+    if (!readXRefInt(s, &sub.first) || !readXRefInt(s, &sub.n) || sub.first + sub.n < 0) {
+      valid = gFalse;
+      break;
+    }
+    // Files with the table starting at 1 instead of 0 are fixed by readXRefTable()
+    if (sub.first == 1 && subsections.empty()) {
+      valid = gFalse;
+      break;
+    }
+    skipXRefSpace(s);
+    sub.offset = s->getPos();
+    if (sub.n > (int)((UINT_MAX - sub.offset) / 20)) {
+      valid = gFalse;
+      break;
+    }
+    if (sub.n > 0) {
+      valid = isXRefEntryLine(sub.offset) && isXRefEntryLine(sub.offset + 20 * (sub.n - 1));
+      s->setPos(sub.offset + 20 * sub.n);
+    }
+    subsections.push_back(sub);
+  }
+  delete s;
+
+  if (!valid || subsections.empty()) {
+    return gFalse;
+  }
+
+  for (size_t j = 0; j < subsections.size(); ++j) {
+    const Subsection &sub = subsections[j];
+    if (sub.first + sub.n > size && resize(sub.first + sub.n) != sub.first + sub.n) {
+      error(errSyntaxError, -1, "Invalid 'obj' parameters'");
+      ok = gFalse;
+      *more = gFalse;
+      return gTrue;
+    }
+    // As in readXRefTable(), the entries of the newer sections take precedence
+    for (int i = sub.first; i < sub.first + sub.n; ++i) {
+      if (entries[i].offset == 0xffffffff) {
+        entries[i].offset = sub.offset + 20 * (i - sub.first);
+      }
+    }
+  }
+
+  obj.initNull();
+  Parser *parser = new Parser(NULL,
+	     new Lexer(NULL, str->makeSubStream(trailerPos, gFalse, 0, &obj)),
+	     gTrue);
+  *more = readXRefTrailer(parser, pos, followedXRefStm);
+  delete parser;
+
+  return gTrue;
+}
+
+// Read the trailer dictionary of an xref table section, and the xref stream it
+// references in hybrid files. Returns gTrue if there is a previous section to read at *pos.
+GBool XRef::readXRefTrailer(Parser *parser, Guint *pos, std::vector<Guint> *followedXRefStm) {
+  GBool more;
+  Object obj, obj2;
+  Guint pos2;
+
   // read the trailer dictionary
   if (!parser->getObj(&obj)->isDict()) {
     goto err1;
@@ -611,7 +779,6 @@ GBool XRef::readXRefTable(Parser *parser, Guint *pos, std::vector<Guint> *follow
 
  err1:
   obj.free();
- err0:
   ok = gFalse;
   return gFalse;
 }
@@ -789,6 +956,7 @@ GBool XRef::constructXRef(GBool *wasReconstructed) {
   capacity = 0;
   size = 0;
   entries = NULL;
+  updatedEntries.clear();
 
   gotRoot = gFalse;
   streamEndsLen = streamEndsSize = 0;
@@ -1065,14 +1233,17 @@ Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
       goto err;
     }
 #endif
-    if (e->offset >= (Guint)size ||
-	entries[e->offset].type != xrefEntryUncompressed) {
+    // the object stream entry may still have to be read, which can move entries
+    Guint objStrNum = e->offset;
+    int objIndex = e->gen;
+    if (objStrNum >= (Guint)size ||
+	getEntry(objStrNum)->type != xrefEntryUncompressed) {
       error(errSyntaxError, -1, "Invalid object stream");
       goto err;
     }
 
     ObjectStream *objStr = NULL;
-    ObjectStreamKey key(e->offset);
+    ObjectStreamKey key(objStrNum);
     PopplerCacheItem *item = objStrs->lookup(key);
     if (item) {
       ObjectStreamItem *it = static_cast<ObjectStreamItem *>(item);
@@ -1080,18 +1251,18 @@ Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
     }
 
     if (!objStr) {
-      objStr = new ObjectStream(this, e->offset);
+      objStr = new ObjectStream(this, objStrNum);
       if (!objStr->isOk()) {
 	delete objStr;
 	objStr = NULL;
 	goto err;
       } else {
-	ObjectStreamKey *newkey = new ObjectStreamKey(e->offset);
+	ObjectStreamKey *newkey = new ObjectStreamKey(objStrNum);
 	ObjectStreamItem *newitem = new ObjectStreamItem(objStr);
 	objStrs->put(newkey, newitem);
       }
     }
-    objStr->getObject(e->gen, num, obj);
+    objStr->getObject(objIndex, num, obj);
   }
   break;
 
@@ -1194,13 +1365,15 @@ void XRef::setModifiedObject (Object* o, Ref r) {
   XRefEntry *e = getEntry(r.num);
   e->obj.free();
   o->copy(&(e->obj));
-  e->updated = true;
+  setUpdated(e);
 }
 
 Ref XRef::addIndirectObject (Object* o) {
   int entryIndexToUse = -1;
+  // Only the entries already read are candidates for reuse: calling getEntry() on all of them
+  // would read every xref section of the document just to add an object
   for (int i = 1; entryIndexToUse == -1 && i < size; ++i) {
-    XRefEntry *e = getEntry(i, false /* complainIfMissing */);
+    XRefEntry *e = &entries[i];
     if (e->type == xrefEntryFree && e->gen != 65535) {
       entryIndexToUse = i;
     }
@@ -1219,7 +1392,7 @@ Ref XRef::addIndirectObject (Object* o) {
   }
   e->type = xrefEntryUncompressed;
   o->copy(&e->obj);
-  e->updated = true;
+  setUpdated(e);
 
   Ref r;
   r.num = entryIndexToUse;
@@ -1238,7 +1411,7 @@ void XRef::removeIndirectObject(Ref r) {
   e->obj.free();
   e->type = xrefEntryFree;
   e->gen++;
-  e->updated = true;
+  setUpdated(e);
 }
 
 void XRef::removeEntry(XRefEntry * e) {
@@ -1247,8 +1420,30 @@ void XRef::removeEntry(XRefEntry * e) {
   e->obj.free();
   e->type = xrefEntryFree;
   e->gen++;
+  setUpdated(e);
+
+}
+
+void XRef::setUpdated(XRefEntry *e) {
+  if (!e->updated) {
+    updatedEntries.push_back((int)(e - entries));
+  }
   e->updated = true;
+}
 
+std::vector<int> XRef::getUpdatedEntries() {
+  std::vector<int> nums;
+
+  std::sort(updatedEntries.begin(), updatedEntries.end());
+  updatedEntries.erase(std::unique(updatedEntries.begin(), updatedEntries.end()), updatedEntries.end());
+  for (size_t i = 0; i < updatedEntries.size(); i++) {
+    int num = updatedEntries[i];
+    if (num >= 0 && num < size && entries[num].updated) {
+      nums.push_back(num);
+    }
+  }
+
+  return nums;
 }
 
 void XRef::writeXRef(XRef::XRefWriter *writer, GBool writeAllEntries) {
@@ -1384,7 +1579,8 @@ GBool XRef::parseEntry(Guint offset, XRefEntry *entry)
 
 XRefEntry *XRef::getEntry(int i, GBool complainIfMissing)
 {
-  if (entries[i].type == xrefEntryNone) {
+  // Entries registered by readXRefTableLazy() have the position of their line instead of 0xffffffff
+  if (entries[i].type == xrefEntryNone && entries[i].offset == 0xffffffff) {
 
     if ((!xRefStream) && mainXRefEntriesOffset) {
       if (!parseEntry(mainXRefEntriesOffset + 20*i, &entries[i])) {
@@ -1392,7 +1588,7 @@ XRefEntry *XRef::getEntry(int i, GBool complainIfMissing)
       }
     } else {
       std::vector<Guint> followedPrev;
-      while (prevXRefOffset && entries[i].type == xrefEntryNone) {
+      while (prevXRefOffset && entries[i].type == xrefEntryNone && entries[i].offset == 0xffffffff) {
         bool followed = false;
         for (size_t j = 0; j < followedPrev.size(); j++) {
           if (followedPrev.at(j) == prevXRefOffset) {
@@ -1417,7 +1613,7 @@ XRefEntry *XRef::getEntry(int i, GBool complainIfMissing)
 
         // if there was a problem with the xref table,
         // try to reconstruct it
-        if (!ok || (!prevXRefOffset && entries[i].type == xrefEntryNone)) {
+        if (!ok || (!prevXRefOffset && entries[i].type == xrefEntryNone && entries[i].offset == 0xffffffff)) {
            GBool wasReconstructed = false;
            if (!xRefStream && !(ok = constructXRef(&wasReconstructed))) {
                errCode = errDamaged;
@@ -1438,6 +1634,35 @@ XRefEntry *XRef::getEntry(int i, GBool complainIfMissing)
         return &dummy;
       }
 
+      if (entries[i].type == xrefEntryNone && entries[i].offset == 0xffffffff) {
+        if (complainIfMissing) {
+          error(errSyntaxError, -1, "Invalid XRef entry {0:d}", i);
+        }
+        entries[i].type = xrefEntryFree;
+      }
+    }
+  }
+
+  if (entries[i].type == xrefEntryNone) {
+    if (!parseEntry(entries[i].offset, &entries[i])) {
+      // readXRefTableLazy() only checked the first and last lines of each subsection
+      error(errSyntaxError, -1, "Failed to parse XRef entry [{0:d}], reconstructing the XRef", i);
+      if (!(ok = constructXRef(NULL))) {
+        errCode = errDamaged;
+      }
+      // The reconstructed table covers the whole file, the xref sections must not be read again over it
+      prevXRefOffset = 0;
+      mainXRefEntriesOffset = 0;
+
+      if (unlikely(i >= size)) {
+        static XRefEntry dummy;
+        dummy.offset = 0;
+        dummy.gen = -1;
+        dummy.type = xrefEntryNone;
+        dummy.updated = false;
+        return &dummy;
+      }
+
       if (entries[i].type == xrefEntryNone) {
         if (complainIfMissing) {
           error(errSyntaxError, -1, "Invalid XRef entry {0:d}", i);
@@ -141,6 +141,11 @@ public:
   void removeEntry(XRefEntry * e);
   void add(int num, int gen,  Guint offs, GBool used);
 
+  // Numbers of the entries changed by the write access methods, in ascending order.
+  // Incremental updates only need these, without going through (and loading) the whole table
+  std::vector<int> getUpdatedEntries();
+  GBool hasUpdatedEntries() { return !getUpdatedEntries().empty(); }
+
   // Output XRef table to stream
   void writeTableToFile(OutStream* outStr, GBool writeAllEntries);
   // Output XRef stream contents to GooString and fill trailerDict fields accordingly
@@ -181,6 +186,7 @@ private:
   GBool xRefStream;		// true if last XRef section is a stream
 
   int m_sig_dict_offset; //file offset of the new signature dictionary after saveAs() is executed
+  std::vector<int> updatedEntries; // entries marked as updated, may have duplicates
 
   void init();
   int reserve(int newSize);
@@ -188,6 +194,10 @@ private:
   Guint getStartXref();
   GBool readXRef(Guint *pos, std::vector<Guint> *followedXRefStm);
   GBool readXRefTable(Parser *parser, Guint *pos, std::vector<Guint> *followedXRefStm);
+  GBool readXRefTableLazy(Guint *pos, std::vector<Guint> *followedXRefStm, GBool *more);
+  GBool readXRefTrailer(Parser *parser, Guint *pos, std::vector<Guint> *followedXRefStm);
+  GBool isXRefEntryLine(Guint offset);
+  void setUpdated(XRefEntry *e);
   GBool readXRefStreamSection(Stream *xrefStr, int *w, int first, int n);
   GBool readXRefStream(Stream *xrefStr, Guint *pos);
   GBool constructXRef(GBool *wasReconstructed);
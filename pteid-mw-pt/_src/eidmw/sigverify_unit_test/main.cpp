@@ -0,0 +1,127 @@
+/*-****************************************************************************
+
+ * Licensed under the EUPL V.1.2
+
+****************************************************************************-*/
+
+/*
+ * sigverify_unit_test: SignatureVerifier::verifyChain() with generated certificate chains, including a signer
+ * certificate issued by an end-entity certificate, which must never be trusted
+ */
+
+#include "SignatureVerifier.h"
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#include <vector>
+
+using namespace eIDMW;
+
+static CByteArray toDER(X509 *cert) {
+	unsigned char *der = NULL;
+	int len = i2d_X509(cert, &der);
+	CByteArray result(der, len);
+	OPENSSL_free(der);
+	return result;
+}
+
+static void addExtension(X509 *cert, X509 *issuer, int nid, const char *value) {
+	X509V3_CTX ctx;
+	X509V3_set_ctx(&ctx, issuer != NULL ? issuer : cert, cert, NULL, NULL, 0);
+	X509_EXTENSION *ext = X509V3_EXT_conf_nid(NULL, &ctx, nid, value);
+	X509_add_ext(cert, ext, -1);
+	X509_EXTENSION_free(ext);
+}
+
+/* Certificate for key signed by issuer_key, self-signed if issuer is NULL, valid from notBefore for days */
+static X509 *makeCertificate(const char *name, EVP_PKEY *key, X509 *issuer, EVP_PKEY *issuer_key, long serial,
+							 bool isCA, const char *keyUsage, long notBefore = -60 * 24 * 3600L, long days = 365) {
+	X509 *cert = X509_new();
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+	X509_gmtime_adj(X509_getm_notBefore(cert), notBefore);
+	X509_gmtime_adj(X509_getm_notAfter(cert), notBefore + days * 24 * 3600L);
+	X509_set_pubkey(cert, key);
+
+	X509_NAME *subject = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(subject, "C", MBSTRING_ASC, (const unsigned char *)"PT", -1, -1, 0);
+	X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC, (const unsigned char *)name, -1, -1, 0);
+	X509_set_issuer_name(cert, issuer != NULL ? X509_get_subject_name(issuer) : subject);
+
+	addExtension(cert, issuer, NID_basic_constraints, isCA ? "critical,CA:TRUE" : "critical,CA:FALSE");
+	addExtension(cert, issuer, NID_key_usage, keyUsage);
+	addExtension(cert, issuer, NID_subject_key_identifier, "hash");
+	addExtension(cert, issuer, NID_authority_key_identifier, "keyid:always");
+
+	X509_sign(cert, issuer_key, EVP_sha256());
+	return cert;
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char *description) {
+	printf("%-60s %s\n", description, condition ? "OK" : "FAILED");
+	if (!condition)
+		failures++;
+}
+
+int main() {
+	EVP_PKEY *root_key = EVP_EC_gen("P-256");
+	EVP_PKEY *ca_key = EVP_EC_gen("P-256");
+	EVP_PKEY *signer_key = EVP_EC_gen("P-256");
+	EVP_PKEY *forged_key = EVP_EC_gen("P-256");
+	EVP_PKEY *other_root_key = EVP_EC_gen("P-256");
+
+	X509 *root = makeCertificate("Test Root CA", root_key, NULL, root_key, 1, true, "critical,keyCertSign,cRLSign");
+	X509 *ca = makeCertificate("Test Signature CA", ca_key, root, root_key, 2, true, "critical,keyCertSign,cRLSign");
+	X509 *signer =
+		makeCertificate("Test Signer", signer_key, ca, ca_key, 3, false, "critical,digitalSignature,nonRepudiation");
+	/* Anyone holding the signer key can issue this one */
+	X509 *forged = makeCertificate("Forged Signer", forged_key, signer, signer_key, 4, false,
+								   "critical,digitalSignature,nonRepudiation");
+	/* A CA certificate without keyCertSign can't issue certificates either */
+	X509 *ca_no_certsign = makeCertificate("Test CA without keyCertSign", ca_key, root, root_key, 5, true,
+										   "critical,digitalSignature");
+	X509 *signer_of_bad_ca =
+		makeCertificate("Test Signer", signer_key, ca_no_certsign, ca_key, 6, false, "critical,nonRepudiation");
+	X509 *expired_signer = makeCertificate("Expired Signer", signer_key, ca, ca_key, 7, false,
+										   "critical,digitalSignature", -30 * 24 * 3600L, 10);
+	X509 *other_root =
+		makeCertificate("Other Root CA", other_root_key, NULL, other_root_key, 8, true, "critical,keyCertSign");
+	X509 *ca_as_signer = makeCertificate("Test Signature CA", ca_key, root, root_key, 9, true,
+										 "critical,keyCertSign,digitalSignature,nonRepudiation");
+
+	std::vector<CByteArray> roots = {toDER(root)};
+	time_t now = time(NULL);
+
+	check(SignatureVerifier::verifyChain(toDER(signer), {toDER(ca)}, roots, now), "signer issued by the CA");
+	check(!SignatureVerifier::verifyChain(toDER(signer), {}, roots, now), "signer without its CA certificate");
+	check(!SignatureVerifier::verifyChain(toDER(forged), {toDER(signer), toDER(ca)}, roots, now),
+		  "signer issued by an end-entity certificate");
+	check(!SignatureVerifier::verifyChain(toDER(signer_of_bad_ca), {toDER(ca_no_certsign)}, roots, now),
+		  "signer issued by a CA without keyCertSign");
+	check(!SignatureVerifier::verifyChain(toDER(signer), {toDER(ca)}, {toDER(other_root)}, now),
+		  "signer chaining to an untrusted root");
+	check(!SignatureVerifier::verifyChain(toDER(signer), {toDER(ca), toDER(root)}, {}, now),
+		  "root embedded in the signature is not trusted");
+	check(!SignatureVerifier::verifyChain(toDER(expired_signer), {toDER(ca)}, roots, now), "expired signer");
+	check(SignatureVerifier::verifyChain(toDER(expired_signer), {toDER(ca)}, roots, now - 25 * 24 * 3600L),
+		  "expired signer at a signing time in its validity");
+	check(!SignatureVerifier::verifyChain(toDER(ca_as_signer), {}, roots, now), "CA certificate as signer");
+
+	X509 *certs[] = {root, ca, signer, forged, ca_no_certsign, signer_of_bad_ca, expired_signer, other_root,
+					 ca_as_signer};
+	for (X509 *cert : certs)
+		X509_free(cert);
+	EVP_PKEY *keys[] = {root_key, ca_key, signer_key, forged_key, other_root_key};
+	for (EVP_PKEY *key : keys)
+		EVP_PKEY_free(key);
+
+	printf("%d failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
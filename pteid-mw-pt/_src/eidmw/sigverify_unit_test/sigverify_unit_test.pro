@@ -0,0 +1,27 @@
+######################################################################
+# Unit test of the signer certificate chain validation of SignatureVerifier, not part of the default build
+######################################################################
+
+include(../_Builds/eidcommon.mak)
+
+TEMPLATE = app
+TARGET = sigverify_unit_test
+
+message("Compile $$TARGET")
+
+CONFIG -= qt
+CONFIG += c++11 console
+
+DESTDIR = .
+
+DEPENDPATH += .
+INCLUDEPATH += . ../applayer ../cardlayer ../common
+
+macx: LIBS += -L$$DEPS_DIR/openssl-3/lib/
+unix:!macx: LIBS += -Wl,-rpath-link,../lib
+!macx: LIBS += -Wl,-R,'../lib'
+
+LIBS += -L../lib -l$${APPLAYERLIB} -l$${CARDLAYERLIB} -l$${COMMONLIB} -lcrypto
+LIBS += -lpthread
+
+SOURCES += main.cpp